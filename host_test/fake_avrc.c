@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "fake_avrc.h"
+#include "bt_avrcp.h"
+#include <string.h>
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+static fake_avrc_calls_t s_calls;
+static void (*s_volume_hook)(uint8_t tl, uint8_t volume);
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+fake_avrc_calls_t *fake_avrc_calls(void) { return &s_calls; }
+
+void fake_avrc_reset(void) { memset(&s_calls, 0, sizeof(s_calls)); }
+
+void fake_avrc_set_volume_hook(void (*hook)(uint8_t tl, uint8_t volume)) {
+  s_volume_hook = hook;
+}
+
+void fake_avrc_conn_state(bool connected) {
+  esp_avrc_ct_cb_param_t param = {.conn_stat.connected = connected};
+  bt_avrcp_ct_callback(ESP_AVRC_CT_CONNECTION_STATE_EVT, &param);
+}
+
+void fake_avrc_rn_caps(uint16_t bits) {
+  esp_avrc_ct_cb_param_t param = {.get_rn_caps_rsp.evt_set.bits = bits};
+  for (uint16_t b = bits; b; b &= b - 1) {
+    param.get_rn_caps_rsp.cap_count++;
+  }
+  bt_avrcp_ct_callback(ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT, &param);
+}
+
+void fake_avrc_volume_rsp(uint8_t volume) {
+  esp_avrc_ct_cb_param_t param = {.set_volume_rsp.volume = volume};
+  bt_avrcp_ct_callback(ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT, &param);
+}
+
+void fake_avrc_volume_notify(uint8_t volume) {
+  esp_avrc_ct_cb_param_t param = {
+      .change_ntf.event_id = ESP_AVRC_RN_VOLUME_CHANGE,
+      .change_ntf.event_parameter.volume = volume};
+  bt_avrcp_ct_callback(ESP_AVRC_CT_CHANGE_NOTIFY_EVT, &param);
+}
+
+/* AVRCP controller */
+esp_err_t esp_avrc_ct_init(void) { return ESP_OK; }
+
+esp_err_t esp_avrc_ct_register_callback(esp_avrc_ct_cb_t callback) {
+  return ESP_OK;
+}
+
+esp_err_t
+esp_avrc_tg_set_rn_evt_cap(const esp_avrc_rn_evt_cap_mask_t *evt_set) {
+  return ESP_OK;
+}
+
+bool esp_avrc_rn_evt_bit_mask_operation(esp_avrc_bit_mask_op_t op,
+                                        esp_avrc_rn_evt_cap_mask_t *events,
+                                        esp_avrc_rn_event_ids_t event_id) {
+  uint16_t bit = 1 << event_id;
+  switch (op) {
+  case ESP_AVRC_BIT_MASK_OP_SET:
+    events->bits |= bit;
+    return true;
+  case ESP_AVRC_BIT_MASK_OP_CLEAR:
+    events->bits &= ~bit;
+    return true;
+  default:
+    return (events->bits & bit) != 0;
+  }
+}
+
+esp_err_t esp_avrc_ct_send_register_notification_cmd(uint8_t tl,
+                                                     uint8_t event_id,
+                                                     uint32_t interval) {
+  s_calls.rn_registers++;
+  return ESP_OK;
+}
+
+esp_err_t esp_avrc_ct_send_set_absolute_volume_cmd(uint8_t tl,
+                                                   uint8_t volume) {
+  s_calls.abs_volumes++;
+  s_calls.last_abs_volume = volume;
+  s_calls.last_abs_tl = tl;
+  if (s_volume_hook) {
+    s_volume_hook(tl, volume);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_avrc_ct_send_get_rn_capabilities_cmd(uint8_t tl) {
+  s_calls.cap_queries++;
+  return ESP_OK;
+}
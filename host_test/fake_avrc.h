@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __FAKE_AVRC_H__
+#define __FAKE_AVRC_H__
+
+#include "esp_avrc_api.h"
+#include <stdbool.h>
+
+/*
+ * The AVRCP controller as far as bt_avrcp.c and volume_ctrl.c see it:
+ * commands are counted instead of sent, and the helpers below deliver the
+ * sink's events through bt_avrcp_ct_callback(). Link with fake_bt.c for
+ * the BT app task.
+ */
+
+typedef struct {
+  int cap_queries;         /*!< get-capabilities commands */
+  int rn_registers;        /*!< notification registrations */
+  int abs_volumes;         /*!< set-absolute-volume commands */
+  uint8_t last_abs_volume; /*!< volume of the last one */
+  uint8_t last_abs_tl;     /*!< its transaction label */
+} fake_avrc_calls_t;
+
+/**
+ * @brief Commands sent since the last fake_avrc_reset()
+ */
+fake_avrc_calls_t *fake_avrc_calls(void);
+
+/**
+ * @brief Zero the command counters
+ */
+void fake_avrc_reset(void);
+
+/**
+ * @brief Call a function on every set-absolute-volume command, after
+ * counting it (NULL to stop)
+ */
+void fake_avrc_set_volume_hook(void (*hook)(uint8_t tl, uint8_t volume));
+
+/**
+ * @brief Deliver an AVRCP connection state change
+ */
+void fake_avrc_conn_state(bool connected);
+
+/**
+ * @brief Answer the capability query with these notification events
+ *
+ * @param bits One bit per esp_avrc_rn_event_ids_t, as the stack reports
+ */
+void fake_avrc_rn_caps(uint16_t bits);
+
+/**
+ * @brief Deliver the response to a set-absolute-volume command
+ */
+void fake_avrc_volume_rsp(uint8_t volume);
+
+/**
+ * @brief Deliver a volume change notification from the sink
+ */
+void fake_avrc_volume_notify(uint8_t volume);
+
+#endif /* __FAKE_AVRC_H__ */
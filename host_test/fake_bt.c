@@ -0,0 +1,193 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "fake_bt.h"
+#include "audio_player.h"
+#include "bt_a2dp.h"
+#include "bt_app_core.h"
+#include "bt_gap.h"
+#include <string.h>
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+static fake_bt_calls_t s_calls;
+static void (*s_connect_hook)(void);
+static void (*s_media_ctrl_hook)(esp_a2d_media_ctrl_t ctrl);
+static uint8_t s_volume;
+static audio_volume_mode_t s_volume_mode = AUDIO_VOLUME_SOFTWARE;
+static bool s_ring_empty;
+
+/*********************************
+ * MODULE VARIABLES
+ ********************************/
+bool s_is_playing = true;
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+fake_bt_calls_t *fake_bt_calls(void) { return &s_calls; }
+
+void fake_bt_reset(void) { memset(&s_calls, 0, sizeof(s_calls)); }
+
+void fake_bt_set_connect_hook(void (*hook)(void)) { s_connect_hook = hook; }
+
+void fake_bt_set_media_ctrl_hook(void (*hook)(esp_a2d_media_ctrl_t ctrl)) {
+  s_media_ctrl_hook = hook;
+}
+
+void fake_bt_a2d_conn_state(esp_a2d_connection_state_t state) {
+  esp_a2d_cb_param_t param = {.conn_stat.state = state};
+  bt_a2dp_callback(ESP_A2D_CONNECTION_STATE_EVT, &param);
+}
+
+void fake_bt_media_ctrl_ack(esp_a2d_media_ctrl_t ctrl,
+                            esp_a2d_media_ctrl_ack_t status) {
+  esp_a2d_cb_param_t param = {.media_ctrl_stat.cmd = ctrl,
+                              .media_ctrl_stat.status = status};
+  bt_a2dp_callback(ESP_A2D_MEDIA_CTRL_ACK_EVT, &param);
+}
+
+void fake_bt_inquiry_result(const esp_bd_addr_t bda, const char *name) {
+  uint32_t cod = ESP_BT_COD_SRVC_RENDERING << 13 | 0x0400; // audio major
+  int8_t rssi = -60;
+  uint8_t eir[2 + ESP_BT_GAP_MAX_BDNAME_LEN] = {0};
+  size_t name_len = strlen(name);
+  eir[0] = name_len + 1;
+  eir[1] = ESP_BT_EIR_TYPE_CMPL_LOCAL_NAME;
+  memcpy(&eir[2], name, name_len);
+
+  esp_bt_gap_dev_prop_t props[] = {
+      {ESP_BT_GAP_DEV_PROP_COD, sizeof(cod), &cod},
+      {ESP_BT_GAP_DEV_PROP_RSSI, sizeof(rssi), &rssi},
+      {ESP_BT_GAP_DEV_PROP_EIR, sizeof(eir), eir},
+  };
+  esp_bt_gap_cb_param_t param = {.disc_res.num_prop = 3,
+                                 .disc_res.prop = props};
+  memcpy(param.disc_res.bda, bda, ESP_BD_ADDR_LEN);
+  bt_gap_callback(ESP_BT_GAP_DISC_RES_EVT, &param);
+}
+
+void fake_bt_discovery_state(esp_bt_gap_discovery_state_t state) {
+  esp_bt_gap_cb_param_t param = {.disc_st_chg.state = state};
+  bt_gap_callback(ESP_BT_GAP_DISC_STATE_CHANGED_EVT, &param);
+}
+
+/* The BT app task, minus the task: run the work right away */
+bool bt_app_work_dispatch_prio(bt_app_cb_t p_cback, uint16_t event,
+                               void *p_params, int param_len,
+                               bt_app_copy_cb_t p_copy_cback,
+                               bt_app_prio_t prio) {
+  p_cback(event, param_len ? p_params : NULL);
+  return true;
+}
+
+bool bt_app_work_dispatch(bt_app_cb_t p_cback, uint16_t event,
+                          void *p_params, int param_len,
+                          bt_app_copy_cb_t p_copy_cback) {
+  return bt_app_work_dispatch_prio(p_cback, event, p_params, param_len,
+                                   p_copy_cback, BT_APP_PRIO_NORMAL);
+}
+
+/* GAP */
+esp_err_t esp_bt_gap_register_callback(esp_bt_gap_cb_t callback) {
+  return ESP_OK;
+}
+
+esp_err_t esp_bt_gap_start_discovery(esp_bt_inq_mode_t mode, uint8_t len,
+                                     uint8_t num_rsps) {
+  s_calls.discoveries++;
+  return ESP_OK;
+}
+
+esp_err_t esp_bt_gap_cancel_discovery(void) {
+  s_calls.cancels++;
+  return ESP_OK;
+}
+
+bool esp_bt_gap_is_valid_cod(uint32_t cod) { return cod != 0; }
+
+uint32_t esp_bt_gap_get_cod_srvc(uint32_t cod) {
+  return (cod & 0xffe000) >> 13;
+}
+
+uint8_t *esp_bt_gap_resolve_eir_data(uint8_t *eir, esp_bt_eir_type_t type,
+                                     uint8_t *length) {
+  for (int i = 0; i < ESP_BT_GAP_MAX_BDNAME_LEN && eir[i] != 0;
+       i += eir[i] + 1) {
+    if (eir[i + 1] == type) {
+      *length = eir[i] - 1;
+      return &eir[i + 2];
+    }
+  }
+  return NULL;
+}
+
+esp_err_t esp_bt_gap_pin_reply(esp_bd_addr_t bda, bool accept,
+                               uint8_t pin_len, esp_bt_pin_code_t pin) {
+  return ESP_OK;
+}
+
+esp_err_t esp_bt_gap_ssp_confirm_reply(esp_bd_addr_t bda, bool accept) {
+  return ESP_OK;
+}
+
+/* A2DP */
+esp_err_t esp_a2d_register_callback(esp_a2d_cb_t callback) { return ESP_OK; }
+
+esp_err_t esp_a2d_source_init(void) { return ESP_OK; }
+
+esp_err_t esp_a2d_source_register_data_callback(esp_a2d_source_data_cb_t cb) {
+  return ESP_OK;
+}
+
+esp_err_t esp_a2d_source_connect(esp_bd_addr_t bda) {
+  s_calls.connects++;
+  memcpy(s_calls.connect_bda, bda, ESP_BD_ADDR_LEN);
+  if (s_connect_hook) {
+    s_connect_hook();
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_a2d_source_disconnect(esp_bd_addr_t bda) {
+  s_calls.disconnects++;
+  return ESP_OK;
+}
+
+esp_err_t esp_a2d_media_ctrl(esp_a2d_media_ctrl_t ctrl) {
+  s_calls.media_ctrls++;
+  s_calls.last_media_ctrl = ctrl;
+  if (s_media_ctrl_hook) {
+    s_media_ctrl_hook(ctrl);
+  }
+  return ESP_OK;
+}
+
+/* Audio player */
+int32_t audio_player_get_data(uint8_t *data, int32_t len, int32_t *filled) {
+  memset(data, 0, len);
+  if (filled) {
+    *filled = s_ring_empty ? 0 : len;
+  }
+  return len;
+}
+
+void fake_bt_set_ring_empty(bool empty) { s_ring_empty = empty; }
+
+void audio_player_set_sink_delay(uint16_t delay_01ms) {}
+
+void audio_player_set_volume(uint8_t volume) {
+  s_volume = volume > 127 ? 127 : volume;
+}
+
+uint8_t audio_player_get_volume(void) { return s_volume; }
+
+void audio_player_set_volume_mode(audio_volume_mode_t mode) {
+  s_volume_mode = mode;
+}
+
+audio_volume_mode_t audio_player_get_volume_mode(void) { return s_volume_mode; }
@@ -0,0 +1,80 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __FAKE_BT_H__
+#define __FAKE_BT_H__
+
+#include "esp_a2dp_api.h"
+#include "esp_gap_bt_api.h"
+
+/*
+ * Bluedroid as far as bt_gap.c and bt_a2dp.c see it: GAP and A2DP calls
+ * are counted instead of reaching a controller, and work dispatched to the
+ * BT app task runs at once on the caller's stack. Also stands in for the
+ * audio player those modules call into.
+ */
+
+typedef struct {
+  int discoveries;        /*!< esp_bt_gap_start_discovery() calls */
+  int cancels;            /*!< esp_bt_gap_cancel_discovery() calls */
+  int connects;           /*!< esp_a2d_source_connect() calls */
+  esp_bd_addr_t connect_bda;
+  int disconnects;
+  int media_ctrls;
+  esp_a2d_media_ctrl_t last_media_ctrl;
+} fake_bt_calls_t;
+
+/**
+ * @brief Calls made since the last fake_bt_reset()
+ */
+fake_bt_calls_t *fake_bt_calls(void);
+
+/**
+ * @brief Zero the call counters
+ */
+void fake_bt_reset(void);
+
+/**
+ * @brief Call a function on every esp_a2d_source_connect(), after counting
+ * it (NULL to stop)
+ */
+void fake_bt_set_connect_hook(void (*hook)(void));
+
+/**
+ * @brief Call a function on every esp_a2d_media_ctrl(), after counting it
+ * (NULL to stop)
+ */
+void fake_bt_set_media_ctrl_hook(void (*hook)(esp_a2d_media_ctrl_t ctrl));
+
+/**
+ * @brief Deliver an A2DP connection state change, as the stack would
+ */
+void fake_bt_a2d_conn_state(esp_a2d_connection_state_t state);
+
+/**
+ * @brief Deliver the acknowledgement of a media control command
+ */
+void fake_bt_media_ctrl_ack(esp_a2d_media_ctrl_t ctrl,
+                            esp_a2d_media_ctrl_ack_t status);
+
+/**
+ * @brief Deliver an inquiry result with a name in its EIR and the
+ * rendering service class
+ */
+void fake_bt_inquiry_result(const esp_bd_addr_t bda, const char *name);
+
+/**
+ * @brief Deliver a discovery state change
+ */
+void fake_bt_discovery_state(esp_bt_gap_discovery_state_t state);
+
+/**
+ * @brief Empty the stand-in audio player's ring buffer, so data callbacks
+ * get silence only, or give it audio again
+ */
+void fake_bt_set_ring_empty(bool empty);
+
+#endif /* __FAKE_BT_H__ */
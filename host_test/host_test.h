@@ -0,0 +1,52 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __HOST_TEST_H__
+#define __HOST_TEST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Minimal assertions: report every failure, exit non-zero at the end */
+static int s_failures;
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,     \
+              #cond);                                                      \
+      s_failures++;                                                        \
+    }                                                                      \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                     \
+  do {                                                                     \
+    long long _a = (long long)(a);                                         \
+    long long _b = (long long)(b);                                         \
+    if (_a != _b) {                                                        \
+      fprintf(stderr, "%s:%d: %s == %lld, expected %s == %lld\n",          \
+              __FILE__, __LINE__, #a, _a, #b, _b);                         \
+      s_failures++;                                                        \
+    }                                                                      \
+  } while (0)
+
+#define CHECK_NEAR(a, b, tol)                                              \
+  do {                                                                     \
+    double _a = (double)(a);                                               \
+    double _b = (double)(b);                                               \
+    if (_a - _b > (tol) || _b - _a > (tol)) {                              \
+      fprintf(stderr, "%s:%d: %s == %g, expected %g +/- %g\n", __FILE__,   \
+              __LINE__, #a, _a, _b, (double)(tol));                        \
+      s_failures++;                                                        \
+    }                                                                      \
+  } while (0)
+
+#define TEST_RESULT()                                                      \
+  (s_failures ? (fprintf(stderr, "%d check(s) failed\n", s_failures),     \
+                 EXIT_FAILURE)                                             \
+              : EXIT_SUCCESS)
+
+#endif /* __HOST_TEST_H__ */
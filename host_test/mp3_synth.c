@@ -0,0 +1,222 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "mp3_synth.h"
+#include <assert.h>
+#include <string.h>
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+static const uint16_t s_kbps_v1[15] = {0,   32,  40,  48,  56,  64,  80, 96,
+                                       112, 128, 160, 192, 224, 256, 320};
+static const uint16_t s_kbps_v2[15] = {0,  8,  16, 24,  32,  40,  48, 56,
+                                       64, 80, 96, 112, 128, 144, 160};
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+static void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static void put_header(uint8_t *p, const mp3_synth_fmt_t *fmt, uint16_t kbps,
+                       bool pad) {
+  const uint16_t *table = fmt->mpeg1 ? s_kbps_v1 : s_kbps_v2;
+  int br = 1;
+  while (br < 15 && table[br] != kbps) {
+    br++;
+  }
+  assert(br < 15);
+  uint32_t base = fmt->mpeg1 ? fmt->hz : fmt->hz * 2;
+  int sr = base == 44100 ? 0 : base == 48000 ? 1 : 2;
+  p[0] = 0xFF;
+  p[1] = fmt->mpeg1 ? 0xFB : 0xF3; // layer III, no CRC
+  p[2] = (br << 4) | (sr << 2) | (pad ? 2 : 0);
+  p[3] = fmt->mono ? 0xC0 : 0x00;
+}
+
+static size_t side_bytes(const mp3_synth_fmt_t *fmt) {
+  return fmt->mpeg1 ? (fmt->mono ? 17 : 32) : (fmt->mono ? 9 : 17);
+}
+
+/* MSB first, as the decoder reads side info */
+static void put_bits(uint8_t *p, uint32_t *bit, uint32_t v, int n) {
+  while (n--) {
+    if ((v >> n) & 1) {
+      p[*bit / 8] |= 0x80 >> (*bit % 8);
+    }
+    (*bit)++;
+  }
+}
+
+static uint32_t next_rand(uint32_t *s) {
+  *s ^= *s << 13;
+  *s ^= *s >> 17;
+  *s ^= *s << 5;
+  return *s;
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+uint32_t mp3_synth_frame_samples(const mp3_synth_fmt_t *fmt) {
+  return fmt->mpeg1 ? 1152 : 576;
+}
+
+uint32_t mp3_synth_frame_bytes(const mp3_synth_fmt_t *fmt, uint16_t kbps,
+                               bool pad) {
+  return mp3_synth_frame_samples(fmt) / 8 * kbps * 1000 / fmt->hz + pad;
+}
+
+uint32_t mp3_synth_frame(FILE *f, const mp3_synth_fmt_t *fmt, uint16_t kbps,
+                         bool pad) {
+  uint8_t frame[1441] = {0};
+  uint32_t n = mp3_synth_frame_bytes(fmt, kbps, pad);
+  put_header(frame, fmt, kbps, pad);
+  fwrite(frame, 1, n, f);
+  return n;
+}
+
+uint32_t mp3_synth_cbr(FILE *f, const mp3_synth_fmt_t *fmt, uint16_t kbps,
+                       uint32_t frames) {
+  // Bits per frame as a fraction of hz; pad whenever the remainder carries
+  uint64_t num = (uint64_t)mp3_synth_frame_samples(fmt) / 8 * kbps * 1000;
+  uint64_t rest = 0;
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < frames; i++) {
+    rest += num % fmt->hz;
+    bool pad = rest >= fmt->hz;
+    if (pad) {
+      rest -= fmt->hz;
+    }
+    total += mp3_synth_frame(f, fmt, kbps, pad);
+  }
+  return total;
+}
+
+uint32_t mp3_synth_xing(FILE *f, const mp3_synth_fmt_t *fmt, const char *id,
+                        uint32_t frames, uint32_t bytes, const uint8_t *lame,
+                        size_t lame_len) {
+  uint8_t frame[1441] = {0};
+  uint16_t kbps = fmt->mpeg1 ? 128 : 64;
+  uint32_t n = mp3_synth_frame_bytes(fmt, kbps, false);
+  put_header(frame, fmt, kbps, false);
+  uint8_t *x = frame + 4 + side_bytes(fmt);
+  memcpy(x, id, 4);
+  put_be32(x + 4, 3); // frames and bytes fields
+  put_be32(x + 8, frames);
+  put_be32(x + 12, bytes);
+  if (lame) {
+    assert(16 + lame_len <= n - 4 - side_bytes(fmt));
+    memcpy(x + 16, lame, lame_len);
+  }
+  fwrite(frame, 1, n, f);
+  return n;
+}
+
+uint32_t mp3_synth_vbri(FILE *f, const mp3_synth_fmt_t *fmt, uint32_t frames,
+                        uint32_t bytes) {
+  uint8_t frame[1441] = {0};
+  uint32_t n = mp3_synth_frame_bytes(fmt, 128, false);
+  put_header(frame, fmt, 128, false);
+  uint8_t *v = frame + 36;
+  memcpy(v, "VBRI", 4);
+  v[5] = 1; // version
+  put_be32(v + 10, bytes);
+  put_be32(v + 14, frames);
+  fwrite(frame, 1, n, f);
+  return n;
+}
+
+uint32_t mp3_synth_id3v2(FILE *f, uint32_t size, const uint8_t *frames,
+                         size_t frames_len) {
+  if (size < 10 + frames_len) {
+    size = 10 + frames_len;
+  }
+  uint32_t body = size - 10;
+  uint8_t h[10] = {'I', 'D', '3', 4, 0, 0};
+  h[6] = (body >> 21) & 0x7F;
+  h[7] = (body >> 14) & 0x7F;
+  h[8] = (body >> 7) & 0x7F;
+  h[9] = body & 0x7F;
+  fwrite(h, 1, 10, f);
+  fwrite(frames, 1, frames_len, f);
+  for (uint32_t i = frames_len; i < body; i++) {
+    fputc(0, f);
+  }
+  return size;
+}
+
+void mp3_synth_id3v1(FILE *f) {
+  uint8_t tag[128] = {'T', 'A', 'G'};
+  memcpy(tag + 3, "Silence", 7);
+  fwrite(tag, 1, sizeof(tag), f);
+}
+
+uint32_t mp3_synth_noise(FILE *f, const mp3_synth_fmt_t *fmt, uint16_t kbps,
+                         uint32_t frames, uint32_t seed) {
+  // Codes of at most 11 bits and no linbits: 13 bits a pair with signs
+  static const uint8_t tables[] = {7, 10};
+  const int nch = fmt->mono ? 1 : 2;
+  const int parts = (fmt->mpeg1 ? 2 : 1) * nch; // granules x channels
+  const uint32_t max_begin = fmt->mpeg1 ? 511 : 255;
+  const uint32_t n = mp3_synth_frame_bytes(fmt, kbps, false);
+  const uint32_t main_bytes = n - 4 - side_bytes(fmt);
+  uint32_t backlog = 0; // main data left unused by the frames so far
+  uint32_t rng = seed | 1;
+
+  for (uint32_t i = 0; i < frames; i++) {
+    uint8_t frame[1441] = {0};
+    put_header(frame, fmt, kbps, false);
+
+    // Each frame uses half to one and a half frames' worth of main data,
+    // starting as far back in the reservoir as the format allows
+    uint32_t begin = backlog < max_begin ? backlog : max_begin;
+    uint32_t avail = begin + main_bytes;
+    uint32_t used = main_bytes / 2 + next_rand(&rng) % (main_bytes + 1);
+    used = used < avail ? used : avail - 1; // sign bits may read past
+    used = used < parts * 4095 / 8 ? used : parts * 4095 / 8;
+    backlog = avail - used;
+
+    uint8_t *side = frame + 4;
+    uint32_t bit = 0;
+    put_bits(side, &bit, begin, fmt->mpeg1 ? 9 : 8);
+    // Private bits, and no scale factors shared between granules
+    put_bits(side, &bit, 0, fmt->mpeg1 ? (nch == 1 ? 9 : 11) : nch);
+    for (int p = 0; p < parts; p++) {
+      uint32_t bits = used * 8 / parts;
+      if (p == parts - 1) {
+        bits = used * 8 - bits * (parts - 1);
+      }
+      // The big values pairs are not checked against part2_3_length, so
+      // they must fit in it whatever the bits turn out to be
+      uint32_t pairs = bits / 13 < 288 ? bits / 13 : 288;
+      put_bits(side, &bit, bits, 12);                      // part2_3
+      put_bits(side, &bit, pairs, 9);                      // big_values
+      put_bits(side, &bit, 140 + next_rand(&rng) % 20, 8); // global_gain
+      put_bits(side, &bit, 0, fmt->mpeg1 ? 4 : 9); // no scale factors
+      put_bits(side, &bit, 0, 1);                  // long blocks
+      for (int t = 0; t < 3; t++) {
+        put_bits(side, &bit, tables[next_rand(&rng) % sizeof(tables)], 5);
+      }
+      put_bits(side, &bit, next_rand(&rng) % 16, 4); // region0_count
+      put_bits(side, &bit, next_rand(&rng) % 8, 3);  // region1_count
+      put_bits(side, &bit, 0, fmt->mpeg1 ? 3 : 2);
+    }
+    assert(bit == side_bytes(fmt) * 8);
+
+    // The bits themselves are noise to the Huffman decoder
+    for (uint32_t j = 4 + side_bytes(fmt); j < n; j++) {
+      frame[j] = next_rand(&rng);
+    }
+    fwrite(frame, 1, n, f);
+  }
+  return n * frames;
+}
@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __MP3_SYNTH_H__
+#define __MP3_SYNTH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Synthetic layer III streams for the parser tests: valid frame headers
+ * with silent (all-zero) side info and main data, the VBR headers encoders
+ * put in the first frame, and ID3 tags. Only mp3_synth_noise() writes
+ * frames that decode to audio.
+ */
+
+typedef struct {
+  bool mpeg1; /*!< MPEG-1 (1152 samples), else MPEG-2 (576) */
+  uint32_t hz;
+  bool mono;
+} mp3_synth_fmt_t;
+
+#define MP3_SYNTH_44K_STEREO ((mp3_synth_fmt_t){true, 44100, false})
+
+/**
+ * @brief Bytes of one frame at this bitrate
+ */
+uint32_t mp3_synth_frame_bytes(const mp3_synth_fmt_t *fmt, uint16_t kbps,
+                               bool pad);
+
+/**
+ * @brief Per-channel samples of one frame
+ */
+uint32_t mp3_synth_frame_samples(const mp3_synth_fmt_t *fmt);
+
+/**
+ * @brief Write one silent frame
+ *
+ * @return Bytes written
+ */
+uint32_t mp3_synth_frame(FILE *f, const mp3_synth_fmt_t *fmt, uint16_t kbps,
+                         bool pad);
+
+/**
+ * @brief Write CBR frames, padded as an encoder does so the average
+ * bitrate is exactly kbps
+ *
+ * @return Bytes written
+ */
+uint32_t mp3_synth_cbr(FILE *f, const mp3_synth_fmt_t *fmt, uint16_t kbps,
+                       uint32_t frames);
+
+/**
+ * @brief Write frames that decode to noise, their main data spread across
+ * frames through the bit reservoir the way an encoder does
+ *
+ * @param seed Picks the noise and how far back each frame's data starts
+ * @return Bytes written
+ */
+uint32_t mp3_synth_noise(FILE *f, const mp3_synth_fmt_t *fmt, uint16_t kbps,
+                         uint32_t frames, uint32_t seed);
+
+/**
+ * @brief Write a 128 kbit/s (64 for MPEG-2) frame holding a Xing or Info
+ * header with the frame and byte counts
+ *
+ * @param id "Xing" or "Info"
+ * @param lame LAME tag written after the header fields (may be NULL)
+ * @param lame_len Its length
+ * @return Bytes written
+ */
+uint32_t mp3_synth_xing(FILE *f, const mp3_synth_fmt_t *fmt, const char *id,
+                        uint32_t frames, uint32_t bytes, const uint8_t *lame,
+                        size_t lame_len);
+
+/**
+ * @brief Write a 128 kbit/s frame holding a Fraunhofer VBRI header
+ *
+ * @return Bytes written
+ */
+uint32_t mp3_synth_vbri(FILE *f, const mp3_synth_fmt_t *fmt, uint32_t frames,
+                        uint32_t bytes);
+
+/**
+ * @brief Write an ID3v2.4 tag of this total size holding the frames given
+ * (raw, headers included), padded with zeros
+ *
+ * @return Bytes written, at least 10 + frames_len
+ */
+uint32_t mp3_synth_id3v2(FILE *f, uint32_t size, const uint8_t *frames,
+                         size_t frames_len);
+
+/**
+ * @brief Write a 128-byte ID3v1 tag
+ */
+void mp3_synth_id3v1(FILE *f);
+
+#endif /* __MP3_SYNTH_H__ */
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef int spi_host_device_t;
+#define SPI2_HOST 1
+#define SPI_DMA_CH_AUTO 3
+
+typedef struct {
+  int mosi_io_num;
+  int miso_io_num;
+  int sclk_io_num;
+  int quadwp_io_num;
+  int quadhd_io_num;
+  int max_transfer_sz;
+  uint32_t flags;
+} spi_bus_config_t;
+
+typedef struct spi_device_t *spi_device_handle_t;
+
+typedef struct {
+  int clock_speed_hz;
+  int spics_io_num;
+  int queue_size;
+  uint8_t mode;
+  uint32_t flags;
+} spi_device_interface_config_t;
+
+typedef struct {
+  uint32_t flags;
+  size_t length;
+  size_t rxlength;
+  void *user;
+  const void *tx_buffer;
+  void *rx_buffer;
+} spi_transaction_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host,
+                             const spi_bus_config_t *config, int dma);
+esp_err_t spi_bus_add_device(spi_host_device_t host,
+                             const spi_device_interface_config_t *config,
+                             spi_device_handle_t *dev);
+esp_err_t spi_device_transmit(spi_device_handle_t dev,
+                              spi_transaction_t *trans);
+esp_err_t spi_device_queue_trans(spi_device_handle_t dev,
+                                 spi_transaction_t *trans, uint32_t ticks);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t dev,
+                                      spi_transaction_t **trans,
+                                      uint32_t ticks);
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "esp_bt.h"
+
+const uint8_t *esp_bt_dev_get_address(void);
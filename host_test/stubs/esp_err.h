@@ -0,0 +1,33 @@
+#pragma once
+
+#include "esp_idf_version.h"
+#include "sdkconfig.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_TIMEOUT 0x107
+
+#define ESP_ERROR_CHECK(x)                                                 \
+  do {                                                                     \
+    esp_err_t _err = (x);                                                  \
+    if (_err != ESP_OK) {                                                  \
+      fprintf(stderr, "%s:%d: %s failed: %d\n", __FILE__, __LINE__, #x,    \
+              _err);                                                       \
+      abort();                                                             \
+    }                                                                      \
+  } while (0)
+
+const char *esp_err_to_name(esp_err_t err);
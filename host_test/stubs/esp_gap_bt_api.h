@@ -0,0 +1,115 @@
+#pragma once
+
+#include "esp_bt.h"
+
+#define ESP_BT_GAP_MAX_BDNAME_LEN 248
+#define ESP_BT_COD_SRVC_RENDERING 0x20
+
+typedef uint8_t esp_bt_pin_code_t[16];
+
+typedef enum {
+  ESP_BT_INQ_MODE_GENERAL_INQUIRY,
+  ESP_BT_INQ_MODE_LIMITED_INQUIRY,
+} esp_bt_inq_mode_t;
+
+typedef enum {
+  ESP_BT_GAP_DISCOVERY_STOPPED,
+  ESP_BT_GAP_DISCOVERY_STARTED,
+} esp_bt_gap_discovery_state_t;
+
+typedef enum {
+  ESP_BT_GAP_DEV_PROP_BDNAME = 1,
+  ESP_BT_GAP_DEV_PROP_COD,
+  ESP_BT_GAP_DEV_PROP_RSSI,
+  ESP_BT_GAP_DEV_PROP_EIR,
+} esp_bt_gap_dev_prop_type_t;
+
+typedef enum {
+  ESP_BT_EIR_TYPE_SHORT_LOCAL_NAME = 0x08,
+  ESP_BT_EIR_TYPE_CMPL_LOCAL_NAME = 0x09,
+} esp_bt_eir_type_t;
+
+typedef struct {
+  esp_bt_gap_dev_prop_type_t type;
+  int len;
+  void *val;
+} esp_bt_gap_dev_prop_t;
+
+typedef enum {
+  ESP_BT_GAP_DISC_RES_EVT = 0,
+  ESP_BT_GAP_DISC_STATE_CHANGED_EVT,
+  ESP_BT_GAP_RMT_SRVCS_EVT,
+  ESP_BT_GAP_RMT_SRVC_REC_EVT,
+  ESP_BT_GAP_AUTH_CMPL_EVT,
+  ESP_BT_GAP_PIN_REQ_EVT,
+  ESP_BT_GAP_CFM_REQ_EVT,
+  ESP_BT_GAP_KEY_NOTIF_EVT,
+  ESP_BT_GAP_KEY_REQ_EVT,
+  ESP_BT_GAP_READ_RSSI_DELTA_EVT,
+  ESP_BT_GAP_CONFIG_EIR_DATA_EVT,
+  ESP_BT_GAP_SET_AFH_CHANNELS_EVT,
+  ESP_BT_GAP_READ_REMOTE_NAME_EVT,
+  ESP_BT_GAP_MODE_CHG_EVT,
+  ESP_BT_GAP_REMOVE_BOND_DEV_COMPLETE_EVT,
+  ESP_BT_GAP_QOS_CMPL_EVT,
+  ESP_BT_GAP_ACL_CONN_CMPL_STAT_EVT,
+  ESP_BT_GAP_ACL_DISCONN_CMPL_STAT_EVT,
+  ESP_BT_GAP_SET_PAGE_TO_EVT,
+  ESP_BT_GAP_GET_PAGE_TO_EVT,
+  ESP_BT_GAP_ACL_PKT_TYPE_CHANGED_EVT,
+  ESP_BT_GAP_ENC_CHG_EVT,
+  ESP_BT_GAP_SET_MIN_ENC_KEY_SIZE_EVT,
+  ESP_BT_GAP_GET_DEV_NAME_CMPL_EVT,
+} esp_bt_gap_cb_event_t;
+
+typedef union {
+  struct {
+    esp_bd_addr_t bda;
+    int num_prop;
+    esp_bt_gap_dev_prop_t *prop;
+  } disc_res;
+  struct {
+    esp_bt_gap_discovery_state_t state;
+  } disc_st_chg;
+  struct {
+    esp_bd_addr_t bda;
+    esp_bt_status_t stat;
+    uint8_t device_name[ESP_BT_GAP_MAX_BDNAME_LEN + 1];
+  } auth_cmpl;
+  struct {
+    esp_bd_addr_t bda;
+    bool min_16_digit;
+  } pin_req;
+  struct {
+    esp_bd_addr_t bda;
+    uint32_t num_val;
+  } cfm_req;
+  struct {
+    esp_bd_addr_t bda;
+    uint32_t passkey;
+  } key_notif;
+  struct {
+    esp_bd_addr_t bda;
+    int mode;
+  } mode_chg;
+  struct {
+    esp_bt_status_t status;
+    char *name;
+  } get_dev_name_cmpl;
+} esp_bt_gap_cb_param_t;
+
+typedef void (*esp_bt_gap_cb_t)(esp_bt_gap_cb_event_t event,
+                                esp_bt_gap_cb_param_t *param);
+
+/* Not in host_stubs.c: tests that link GAP code provide these */
+esp_err_t esp_bt_gap_register_callback(esp_bt_gap_cb_t callback);
+esp_err_t esp_bt_gap_start_discovery(esp_bt_inq_mode_t mode, uint8_t len,
+                                     uint8_t num_rsps);
+esp_err_t esp_bt_gap_cancel_discovery(void);
+bool esp_bt_gap_is_valid_cod(uint32_t cod);
+uint32_t esp_bt_gap_get_cod_srvc(uint32_t cod);
+uint8_t *esp_bt_gap_resolve_eir_data(uint8_t *eir, esp_bt_eir_type_t type,
+                                     uint8_t *length);
+esp_err_t esp_bt_gap_pin_reply(esp_bd_addr_t bda, bool accept,
+                               uint8_t pin_len, esp_bt_pin_code_t pin);
+esp_err_t esp_bt_gap_ssp_confirm_reply(esp_bd_addr_t bda, bool accept);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "esp_err.h"
+
+/* Warnings and errors go to stderr; the rest is format-checked only */
+#define ESP_LOG_HOST(tag, fmt, ...)                                        \
+  fprintf(stderr, "%s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOG_NONE(tag, fmt, ...)                                        \
+  do {                                                                     \
+    if (0) {                                                               \
+      ESP_LOG_HOST(tag, fmt, ##__VA_ARGS__);                               \
+    }                                                                      \
+  } while (0)
+
+#define ESP_LOGE(tag, fmt, ...) ESP_LOG_HOST(tag, "E " fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) ESP_LOG_HOST(tag, "W " fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) ESP_LOG_NONE(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ESP_LOG_NONE(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) ESP_LOG_NONE(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOG_BUFFER_HEX(tag, buf, len)                                  \
+  ((void)(tag), (void)(buf), (void)(len))
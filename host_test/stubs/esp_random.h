@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Repeatable sequence, reseeded with host_stub_seed_random() */
+uint32_t esp_random(void);
@@ -0,0 +1,3 @@
+#pragma once
+
+/* The host settings live in FreeRTOS.h */
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#define tskIDLE_PRIORITY 0
+
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+typedef struct {
+  void *reserved[4];
+} StaticTask_t;
+
+/* Tasks are recorded, never run; tests call the task body themselves */
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                       uint32_t stack_bytes, void *arg, UBaseType_t prio,
+                       TaskHandle_t *task);
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name,
+                               uint32_t stack_bytes, void *arg,
+                               UBaseType_t prio, StackType_t *stack,
+                               StaticTask_t *tcb);
+void vTaskDelete(TaskHandle_t task);
+void vTaskSuspend(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+char *pcTaskGetName(TaskHandle_t task);
+
+/* Advances the simulated clock by the delay, firing due timers */
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+/* Never blocks: returns the notifications given so far */
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
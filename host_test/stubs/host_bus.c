@@ -0,0 +1,67 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "driver/gpio.h"
+#include "driver/i2c_master.h"
+#include "driver/spi_master.h"
+#include "ssd1306_emu.h"
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+/* GPIO and SPI do nothing; I2C writes go to the SSD1306 emulator */
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level) { return ESP_OK; }
+esp_err_t gpio_reset_pin(gpio_num_t gpio) { return ESP_OK; }
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode) {
+  return ESP_OK;
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *config,
+                             i2c_master_bus_handle_t *bus) {
+  *bus = NULL;
+  return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus,
+                                    const i2c_device_config_t *config,
+                                    i2c_master_dev_handle_t *dev) {
+  *dev = NULL;
+  return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t dev, const uint8_t *buf,
+                              size_t len, int timeout_ms) {
+  ssd1306_emu_i2c_write(ssd1306_emu_get(), buf, len);
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host,
+                             const spi_bus_config_t *config, int dma) {
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host,
+                             const spi_device_interface_config_t *config,
+                             spi_device_handle_t *dev) {
+  *dev = NULL;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t dev,
+                              spi_transaction_t *trans) {
+  return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t dev,
+                                 spi_transaction_t *trans, uint32_t ticks) {
+  return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t dev,
+                                      spi_transaction_t **trans,
+                                      uint32_t ticks) {
+  return ESP_OK;
+}
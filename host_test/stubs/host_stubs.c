@@ -0,0 +1,668 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "host_stubs.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "nvs_flash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define HOST_MAX_TASKS 32
+#define HOST_MAX_TIMERS 16
+#define HOST_MAX_QUEUES 16
+#define HOST_MAX_NVS_ENTRIES 32
+#define HOST_MAX_NVS_HANDLES 8
+#define HOST_NVS_NAME_LEN 16 // NVS limit, including the terminator
+#define HOST_NVS_VALUE_LEN 512
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+struct tskTaskControlBlock {
+  bool used;
+  bool deleted;
+  bool suspended;
+  char name[16];
+  uint32_t stack_bytes;
+  uint32_t high_water;
+};
+
+struct tmrTimerControl {
+  bool used;
+  bool active;
+  bool reload;
+  const char *name;
+  TickType_t period;
+  void *id;
+  TimerCallbackFunction_t cb;
+  int64_t due_us;
+};
+
+struct esp_timer {
+  bool used;
+  bool active;
+  esp_timer_create_args_t args;
+  uint64_t period_us; // 0 for one-shot
+  int64_t due_us;
+};
+
+struct QueueDefinition {
+  bool used;
+  bool heap;
+  uint8_t *storage;
+  UBaseType_t len;
+  UBaseType_t item_size;
+  UBaseType_t head;
+  UBaseType_t count;
+};
+
+typedef struct {
+  bool used;
+  char ns[HOST_NVS_NAME_LEN];
+  char key[HOST_NVS_NAME_LEN];
+  bool is_str;
+  size_t len;
+  uint8_t value[HOST_NVS_VALUE_LEN];
+} nvs_entry_t;
+
+typedef struct {
+  bool open;
+  bool writable;
+  char ns[HOST_NVS_NAME_LEN];
+} nvs_open_t;
+
+static int64_t s_now_us;
+static uint32_t s_notifications;
+static uint32_t s_kernel_allocs;
+static struct tskTaskControlBlock s_main_task = {.used = true, .name = "main"};
+static struct tskTaskControlBlock s_tasks[HOST_MAX_TASKS];
+static struct tskTaskControlBlock *s_current = &s_main_task;
+static struct tmrTimerControl s_timers[HOST_MAX_TIMERS];
+static struct esp_timer s_esp_timers[HOST_MAX_TIMERS];
+static struct QueueDefinition s_queues[HOST_MAX_QUEUES];
+static nvs_entry_t s_nvs[HOST_MAX_NVS_ENTRIES];
+static nvs_open_t s_nvs_handles[HOST_MAX_NVS_HANDLES];
+static uint32_t s_nvs_writes;
+static size_t s_free_heap = 200 * 1024;
+static size_t s_min_free_heap = 200 * 1024;
+static uint32_t s_random = 1;
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+static int64_t ticks_to_us(TickType_t ticks) {
+  return (int64_t)ticks * 1000000 / configTICK_RATE_HZ;
+}
+
+/* Fire the earliest timer due by 'until'; false when none is */
+static bool fire_next(int64_t until) {
+  struct tmrTimerControl *tmr = NULL;
+  struct esp_timer *etmr = NULL;
+  int64_t due = until + 1;
+  for (int i = 0; i < HOST_MAX_TIMERS; i++) {
+    if (s_timers[i].active && s_timers[i].due_us < due) {
+      tmr = &s_timers[i];
+      due = tmr->due_us;
+    }
+  }
+  for (int i = 0; i < HOST_MAX_TIMERS; i++) {
+    if (s_esp_timers[i].active && s_esp_timers[i].due_us < due) {
+      etmr = &s_esp_timers[i];
+      tmr = NULL;
+      due = etmr->due_us;
+    }
+  }
+  if (tmr == NULL && etmr == NULL) {
+    return false;
+  }
+
+  if (due > s_now_us) {
+    s_now_us = due;
+  }
+  if (tmr) {
+    tmr->active = tmr->reload;
+    tmr->due_us += ticks_to_us(tmr->period);
+    tmr->cb(tmr);
+  } else {
+    etmr->active = etmr->period_us != 0;
+    etmr->due_us += etmr->period_us;
+    etmr->args.callback(etmr->args.arg);
+  }
+  return true;
+}
+
+static struct tskTaskControlBlock *new_task(const char *name,
+                                            uint32_t stack_bytes) {
+  for (int i = 0; i < HOST_MAX_TASKS; i++) {
+    struct tskTaskControlBlock *t = &s_tasks[i];
+    if (!t->used) {
+      memset(t, 0, sizeof(*t));
+      t->used = true;
+      strncpy(t->name, name, sizeof(t->name) - 1);
+      t->stack_bytes = stack_bytes;
+      t->high_water = stack_bytes / 2;
+      return t;
+    }
+  }
+  return NULL;
+}
+
+static TimerHandle_t new_timer(const char *name, TickType_t period,
+                               UBaseType_t reload, void *id,
+                               TimerCallbackFunction_t cb) {
+  for (int i = 0; i < HOST_MAX_TIMERS; i++) {
+    struct tmrTimerControl *t = &s_timers[i];
+    if (!t->used) {
+      *t = (struct tmrTimerControl){.used = true,
+                                    .reload = reload,
+                                    .name = name,
+                                    .period = period,
+                                    .id = id,
+                                    .cb = cb};
+      return t;
+    }
+  }
+  return NULL;
+}
+
+static QueueHandle_t new_queue(UBaseType_t len, UBaseType_t item_size,
+                               uint8_t *storage, bool heap) {
+  for (int i = 0; i < HOST_MAX_QUEUES; i++) {
+    struct QueueDefinition *q = &s_queues[i];
+    if (!q->used) {
+      *q = (struct QueueDefinition){.used = true,
+                                    .heap = heap,
+                                    .storage = storage,
+                                    .len = len,
+                                    .item_size = item_size};
+      return q;
+    }
+  }
+  return NULL;
+}
+
+static nvs_open_t *nvs_get_handle(nvs_handle_t handle) {
+  if (handle == 0 || handle > HOST_MAX_NVS_HANDLES ||
+      !s_nvs_handles[handle - 1].open) {
+    return NULL;
+  }
+  return &s_nvs_handles[handle - 1];
+}
+
+static nvs_entry_t *nvs_find(const char *ns, const char *key) {
+  for (int i = 0; i < HOST_MAX_NVS_ENTRIES; i++) {
+    nvs_entry_t *e = &s_nvs[i];
+    if (e->used && strcmp(e->ns, ns) == 0 &&
+        (key == NULL || strcmp(e->key, key) == 0)) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+static esp_err_t nvs_get(nvs_handle_t handle, const char *key, bool is_str,
+                         void *out, size_t *len) {
+  nvs_open_t *h = nvs_get_handle(handle);
+  if (h == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  nvs_entry_t *e = nvs_find(h->ns, key);
+  if (e == NULL || e->is_str != is_str) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (out == NULL) {
+    *len = e->len;
+    return ESP_OK;
+  }
+  if (*len < e->len) {
+    return ESP_ERR_NVS_INVALID_LENGTH;
+  }
+  memcpy(out, e->value, e->len);
+  *len = e->len;
+  return ESP_OK;
+}
+
+static esp_err_t nvs_set(nvs_handle_t handle, const char *key, bool is_str,
+                         const void *value, size_t len) {
+  nvs_open_t *h = nvs_get_handle(handle);
+  if (h == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!h->writable) {
+    return ESP_ERR_NVS_READ_ONLY;
+  }
+  if (len > HOST_NVS_VALUE_LEN) {
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+  }
+  nvs_entry_t *e = nvs_find(h->ns, key);
+  for (int i = 0; e == NULL && i < HOST_MAX_NVS_ENTRIES; i++) {
+    if (!s_nvs[i].used) {
+      e = &s_nvs[i];
+      memset(e, 0, sizeof(*e));
+      e->used = true;
+      strncpy(e->ns, h->ns, sizeof(e->ns) - 1);
+      strncpy(e->key, key, sizeof(e->key) - 1);
+    }
+  }
+  if (e == NULL) {
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+  }
+  e->is_str = is_str;
+  e->len = len;
+  memcpy(e->value, value, len);
+  s_nvs_writes++;
+  return ESP_OK;
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void host_stub_advance_us(int64_t us) {
+  int64_t until = s_now_us + us;
+  while (fire_next(until)) {
+  }
+  // A callback that delayed may already have gone past 'until'
+  if (s_now_us < until) {
+    s_now_us = until;
+  }
+}
+
+uint32_t host_stub_take_notifications(void) {
+  uint32_t n = s_notifications;
+  s_notifications = 0;
+  return n;
+}
+
+TimerHandle_t host_stub_find_timer(const char *name) {
+  // Newest first, for code that creates a timer on every call
+  for (int i = HOST_MAX_TIMERS - 1; i >= 0; i--) {
+    if (s_timers[i].used && strcmp(s_timers[i].name, name) == 0) {
+      return &s_timers[i];
+    }
+  }
+  return NULL;
+}
+
+TaskHandle_t host_stub_find_task(const char *name) {
+  for (int i = 0; i < HOST_MAX_TASKS; i++) {
+    if (s_tasks[i].used && strcmp(s_tasks[i].name, name) == 0) {
+      return &s_tasks[i];
+    }
+  }
+  return NULL;
+}
+
+void host_stub_set_high_water(TaskHandle_t task, uint32_t bytes) {
+  task->high_water = bytes;
+}
+
+bool host_stub_task_deleted(TaskHandle_t task) { return task->deleted; }
+
+void host_stub_set_current_task(TaskHandle_t task) {
+  s_current = task ? task : &s_main_task;
+}
+
+uint32_t host_stub_kernel_allocs(void) { return s_kernel_allocs; }
+
+void host_stub_set_free_heap(size_t bytes) {
+  s_free_heap = bytes;
+  if (bytes < s_min_free_heap) {
+    s_min_free_heap = bytes;
+  }
+}
+
+void host_stub_seed_random(uint32_t seed) { s_random = seed ? seed : 1; }
+
+void host_stub_nvs_clear(void) { memset(s_nvs, 0, sizeof(s_nvs)); }
+
+uint32_t host_stub_nvs_take_writes(void) {
+  uint32_t n = s_nvs_writes;
+  s_nvs_writes = 0;
+  return n;
+}
+
+const char *esp_err_to_name(esp_err_t err) {
+  return err == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+/* xorshift32: repeatable, and good enough for backoff jitter */
+uint32_t esp_random(void) {
+  s_random ^= s_random << 13;
+  s_random ^= s_random >> 17;
+  s_random ^= s_random << 5;
+  return s_random;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) { return s_free_heap; }
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  return s_min_free_heap;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return s_free_heap / 2;
+}
+
+/* esp_timer */
+int64_t esp_timer_get_time(void) { return s_now_us; }
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args,
+                           esp_timer_handle_t *out) {
+  for (int i = 0; i < HOST_MAX_TIMERS; i++) {
+    struct esp_timer *t = &s_esp_timers[i];
+    if (!t->used) {
+      *t = (struct esp_timer){.used = true, .args = *args};
+      *out = t;
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t us) {
+  if (timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->active = true;
+  timer->period_us = 0;
+  timer->due_us = s_now_us + (int64_t)us;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t us) {
+  if (timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->active = true;
+  timer->period_us = us;
+  timer->due_us = s_now_us + (int64_t)us;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (!timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->active = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  if (timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->used = false;
+  return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) { return timer->active; }
+
+/* Tasks */
+BaseType_t xPortGetCoreID(void) { return 0; }
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                       uint32_t stack_bytes, void *arg, UBaseType_t prio,
+                       TaskHandle_t *task) {
+  TaskHandle_t t = new_task(name, stack_bytes);
+  if (t == NULL) {
+    return pdFAIL;
+  }
+  if (task) {
+    *task = t;
+  }
+  s_kernel_allocs++;
+  return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name,
+                               uint32_t stack_bytes, void *arg,
+                               UBaseType_t prio, StackType_t *stack,
+                               StaticTask_t *tcb) {
+  return new_task(name, stack_bytes);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  (task ? task : xTaskGetCurrentTaskHandle())->deleted = true;
+}
+
+void vTaskSuspend(TaskHandle_t task) {
+  (task ? task : xTaskGetCurrentTaskHandle())->suspended = true;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  task = task ? task : xTaskGetCurrentTaskHandle();
+  // On target the TCB is freed: reading it is a use-after-free
+  if (task->deleted) {
+    fprintf(stderr, "uxTaskGetStackHighWaterMark on deleted task %s\n",
+            task->name);
+    abort();
+  }
+  return task->high_water;
+}
+
+char *pcTaskGetName(TaskHandle_t task) {
+  return (task ? task : xTaskGetCurrentTaskHandle())->name;
+}
+
+void vTaskDelay(TickType_t ticks) { host_stub_advance_us(ticks_to_us(ticks)); }
+
+TickType_t xTaskGetTickCount(void) {
+  return (TickType_t)(s_now_us * configTICK_RATE_HZ / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return s_current; }
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  s_notifications++;
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  uint32_t n = s_notifications;
+  if (n) {
+    s_notifications = clear ? 0 : n - 1;
+  }
+  return n;
+}
+
+/* Timers */
+TimerHandle_t xTimerCreate(const char *name, TickType_t period,
+                           UBaseType_t reload, void *id,
+                           TimerCallbackFunction_t cb) {
+  TimerHandle_t timer = new_timer(name, period, reload, id, cb);
+  if (timer) {
+    s_kernel_allocs++;
+  }
+  return timer;
+}
+
+TimerHandle_t xTimerCreateStatic(const char *name, TickType_t period,
+                                 UBaseType_t reload, void *id,
+                                 TimerCallbackFunction_t cb,
+                                 StaticTimer_t *buf) {
+  return new_timer(name, period, reload, id, cb);
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait) {
+  return xTimerReset(timer, wait);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait) {
+  timer->active = false;
+  return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait) {
+  timer->active = true;
+  timer->due_us = s_now_us + ticks_to_us(timer->period);
+  return pdPASS;
+}
+
+/* As in FreeRTOS, this also starts a dormant timer */
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period,
+                              TickType_t wait) {
+  timer->period = period;
+  return xTimerReset(timer, wait);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer) {
+  return timer->active ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t wait) {
+  timer->used = false;
+  timer->active = false;
+  return pdPASS;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer) { return timer->id; }
+
+/* Queues */
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size) {
+  uint8_t *storage = malloc(len * item_size);
+  QueueHandle_t queue = new_queue(len, item_size, storage, true);
+  if (queue == NULL) {
+    free(storage);
+    return NULL;
+  }
+  s_kernel_allocs++;
+  return queue;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t len, UBaseType_t item_size,
+                                 uint8_t *storage, StaticQueue_t *buf) {
+  return new_queue(len, item_size, storage, false);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item,
+                      TickType_t wait) {
+  if (queue->count == queue->len) {
+    return errQUEUE_FULL;
+  }
+  UBaseType_t tail = (queue->head + queue->count) % queue->len;
+  memcpy(queue->storage + tail * queue->item_size, item, queue->item_size);
+  queue->count++;
+  return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item,
+                             BaseType_t *woken) {
+  if (woken) {
+    *woken = pdFALSE;
+  }
+  return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+  if (queue->count == 0) {
+    return pdFALSE;
+  }
+  memcpy(item, queue->storage + queue->head * queue->item_size,
+         queue->item_size);
+  queue->head = (queue->head + 1) % queue->len;
+  queue->count--;
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return queue->count;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  if (queue->heap) {
+    free(queue->storage);
+  }
+  queue->used = false;
+}
+
+/* NVS */
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+
+esp_err_t nvs_flash_erase(void) {
+  host_stub_nvs_clear();
+  return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out) {
+  // As on flash, a namespace exists only once something was written to it
+  if (mode == NVS_READONLY && nvs_find(ns, NULL) == NULL) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  for (int i = 0; i < HOST_MAX_NVS_HANDLES; i++) {
+    nvs_open_t *h = &s_nvs_handles[i];
+    if (!h->open) {
+      *h = (nvs_open_t){.open = true, .writable = mode == NVS_READWRITE};
+      strncpy(h->ns, ns, sizeof(h->ns) - 1);
+      *out = i + 1;
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle) {
+  nvs_open_t *h = nvs_get_handle(handle);
+  if (h) {
+    h->open = false;
+  }
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  return nvs_get_handle(handle) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out,
+                       size_t *len) {
+  return nvs_get(handle, key, false, out, len);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key,
+                       const void *value, size_t len) {
+  return nvs_set(handle, key, false, value, len);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out,
+                      size_t *len) {
+  return nvs_get(handle, key, true, out, len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key,
+                      const char *value) {
+  return nvs_set(handle, key, true, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out) {
+  size_t len = sizeof(*out);
+  return nvs_get(handle, key, false, out, &len);
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value) {
+  return nvs_set(handle, key, false, &value, sizeof(value));
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+  nvs_open_t *h = nvs_get_handle(handle);
+  if (h == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!h->writable) {
+    return ESP_ERR_NVS_READ_ONLY;
+  }
+  nvs_entry_t *e = nvs_find(h->ns, key);
+  if (e == NULL) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  e->used = false;
+  s_nvs_writes++;
+  return ESP_OK;
+}
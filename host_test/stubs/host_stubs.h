@@ -0,0 +1,85 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __HOST_STUBS_H__
+#define __HOST_STUBS_H__
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Controls for the ESP-IDF/FreeRTOS stand-ins in host_stubs.c. Time only
+ * moves when a test (or vTaskDelay()) moves it, so runs are repeatable;
+ * FreeRTOS and esp_timer callbacks fire inline as their deadline passes.
+ * Tasks are recorded but never scheduled, queues never block, and NVS is
+ * an in-memory table. I2C transfers are fed to ssd1306_emu_get() by
+ * host_bus.c.
+ */
+
+/**
+ * @brief Move the simulated esp_timer/tick clock forward, firing due timers
+ */
+void host_stub_advance_us(int64_t us);
+
+/**
+ * @brief Number of xTaskNotifyGive() calls since the last call
+ */
+uint32_t host_stub_take_notifications(void);
+
+/**
+ * @brief Find a FreeRTOS timer by the name it was created with
+ */
+TimerHandle_t host_stub_find_timer(const char *name);
+
+/**
+ * @brief Find a task by the name it was created with
+ */
+TaskHandle_t host_stub_find_task(const char *name);
+
+/**
+ * @brief Set what uxTaskGetStackHighWaterMark() reports for a task
+ */
+void host_stub_set_high_water(TaskHandle_t task, uint32_t bytes);
+
+/**
+ * @brief true once vTaskDelete() was called on the task
+ */
+bool host_stub_task_deleted(TaskHandle_t task);
+
+/**
+ * @brief Pretend to run as a task created earlier (NULL: back to "main")
+ */
+void host_stub_set_current_task(TaskHandle_t task);
+
+/**
+ * @brief Queues, tasks and timers created from the heap so far
+ */
+uint32_t host_stub_kernel_allocs(void);
+
+/**
+ * @brief Set the free heap reported by heap_caps_get_free_size()
+ */
+void host_stub_set_free_heap(size_t bytes);
+
+/**
+ * @brief Restart the esp_random() sequence
+ */
+void host_stub_seed_random(uint32_t seed);
+
+/**
+ * @brief Empty the NVS store
+ */
+void host_stub_nvs_clear(void);
+
+/**
+ * @brief Number of NVS set/erase calls since the last call
+ */
+uint32_t host_stub_nvs_take_writes(void);
+
+#endif /* __HOST_STUBS_H__ */
@@ -0,0 +1,13 @@
+/*
+ * Host build configuration: the Kconfig defaults from main/Kconfig.projbuild.
+ * The panel is the SSD1306 emulator behind the stand-in I2C driver in
+ * host_stubs.c, so CONFIG_EXAMPLE_OLED_EMULATOR stays off.
+ */
+#pragma once
+
+#define CONFIG_EXAMPLE_PEER_DEVICE_NAME "ESP_SPEAKER"
+#define CONFIG_EXAMPLE_SSP_ENABLED 1
+#define CONFIG_EXAMPLE_TRACE 1
+#ifndef CONFIG_EXAMPLE_CROSSFADE_SEC
+#define CONFIG_EXAMPLE_CROSSFADE_SEC 3
+#endif
@@ -0,0 +1,229 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Flood tests for the BT app dispatcher. bt_app_core.c is included so the
+ * test can play the task and drain the queues itself. malloc/calloc/realloc
+ * are wrapped at link time: dispatch and handling must not touch the heap.
+ * Also compares media-control ACK latency under a heartbeat/notification
+ * storm with and without the priority classes.
+ */
+
+#include "bt_app_core.c"
+#include "common.h"
+#include "host_stubs.h"
+#include "host_test.h"
+
+#define HANDLER_COST_US 1000 // time each handled message takes
+#define STORM_ROUNDS 100
+
+static uint32_t s_heap_calls;
+static uint16_t s_got_event[64];
+static esp_a2d_cb_param_t s_got_param[64];
+static int s_got;
+static int64_t s_ack_wait_us;
+static int64_t s_ack_posted_us;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  s_heap_calls++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  s_heap_calls++;
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+  s_heap_calls++;
+  return __real_realloc(p, size);
+}
+
+static void record(uint16_t event, void *param) {
+  if (s_got < 64) {
+    s_got_event[s_got] = event;
+    if (param) {
+      s_got_param[s_got] = *(esp_a2d_cb_param_t *)param;
+    }
+  }
+  s_got++;
+  host_stub_advance_us(HANDLER_COST_US);
+}
+
+static void ack_handler(uint16_t event, void *param) {
+  s_ack_wait_us += esp_timer_get_time() - s_ack_posted_us;
+  host_stub_advance_us(HANDLER_COST_US);
+}
+
+static esp_a2d_cb_param_t numbered_param(int n) {
+  esp_a2d_cb_param_t p;
+  memset(&p, 0xa5, sizeof(p));
+  p.media_ctrl_stat.cmd = ESP_A2D_MEDIA_CTRL_START;
+  p.media_ctrl_stat.status = n;
+  return p;
+}
+
+static void restart(void) {
+  bt_app_task_shut_down();
+  memset(&s_bt_app_stats, 0, sizeof(s_bt_app_stats));
+  bt_app_task_start_up();
+  s_got = 0;
+}
+
+static void test_flood_to_depth(void) {
+  restart();
+  uint32_t heap_calls = s_heap_calls;
+  uint32_t kernel_allocs = host_stub_kernel_allocs();
+
+  for (int round = 0; round < 1000; round++) {
+    s_got = 0;
+    for (int i = 0; i < BT_APP_QUEUE_LEN; i++) {
+      esp_a2d_cb_param_t p = numbered_param(i);
+      CHECK(bt_app_work_dispatch(record, 100 + i, &p, sizeof(p), NULL));
+    }
+    for (int i = 0; i < BT_APP_HIGH_QUEUE_LEN; i++) {
+      esp_a2d_cb_param_t p = numbered_param(i);
+      CHECK(bt_app_work_dispatch_prio(record, 200 + i, &p, sizeof(p), NULL,
+                                      BT_APP_PRIO_HIGH));
+    }
+    bt_app_drain();
+
+    // Every event, HIGH first, each class in order, parameters intact
+    CHECK_EQ(s_got, BT_APP_QUEUE_LEN + BT_APP_HIGH_QUEUE_LEN);
+    for (int i = 0; i < s_got; i++) {
+      bool high = i < BT_APP_HIGH_QUEUE_LEN;
+      int n = high ? i : i - BT_APP_HIGH_QUEUE_LEN;
+      esp_a2d_cb_param_t p = numbered_param(n);
+      CHECK_EQ(s_got_event[i], (high ? 200 : 100) + n);
+      CHECK(memcmp(&s_got_param[i], &p, sizeof(p)) == 0);
+    }
+  }
+
+  bt_app_stats_t stats;
+  bt_app_get_stats(&stats);
+  CHECK_EQ(stats.sent, 1000 * (BT_APP_QUEUE_LEN + BT_APP_HIGH_QUEUE_LEN));
+  CHECK_EQ(stats.dropped, 0);
+  CHECK_EQ(stats.high_watermark, BT_APP_QUEUE_LEN + BT_APP_HIGH_QUEUE_LEN);
+  CHECK_EQ(s_heap_calls - heap_calls, 0);
+  CHECK_EQ(host_stub_kernel_allocs() - kernel_allocs, 0);
+}
+
+static void test_overflow_is_counted(void) {
+  restart();
+  for (int i = 0; i < BT_APP_QUEUE_LEN; i++) {
+    CHECK(bt_app_work_dispatch(record, i, NULL, 0, NULL));
+  }
+  CHECK(!bt_app_work_dispatch(record, 99, NULL, 0, NULL));
+
+  // Too large a parameter is refused, not truncated
+  uint8_t big[sizeof(bt_app_param_t) + 1] = {0};
+  CHECK(!bt_app_work_dispatch_prio(record, 98, big, sizeof(big), NULL,
+                                   BT_APP_PRIO_HIGH));
+
+  bt_app_stats_t stats;
+  bt_app_get_stats(&stats);
+  CHECK_EQ(stats.dropped, 2);
+  bt_app_drain();
+  CHECK_EQ(s_got, BT_APP_QUEUE_LEN);
+}
+
+static void test_low_events_coalesce(void) {
+  restart();
+  uint32_t heap_calls = s_heap_calls;
+  for (int i = 0; i < 100; i++) {
+    CHECK(bt_app_work_dispatch_prio(record, BT_APP_HEART_BEAT_EVT, NULL, 0,
+                                    NULL, BT_APP_PRIO_LOW));
+  }
+  // A different event has its own slot; the newest parameter wins
+  for (int i = 0; i < 5; i++) {
+    esp_a2d_cb_param_t p = numbered_param(i);
+    CHECK(bt_app_work_dispatch_prio(record, 7, &p, sizeof(p), NULL,
+                                    BT_APP_PRIO_LOW));
+  }
+  bt_app_drain();
+  CHECK_EQ(s_got, 2);
+  esp_a2d_cb_param_t last = numbered_param(4);
+  CHECK(memcmp(&s_got_param[1], &last, sizeof(last)) == 0);
+
+  // Once handled, the next one is delivered again
+  CHECK(bt_app_work_dispatch_prio(record, BT_APP_HEART_BEAT_EVT, NULL, 0,
+                                  NULL, BT_APP_PRIO_LOW));
+  bt_app_drain();
+  CHECK_EQ(s_got, 3);
+
+  // More distinct LOW events than slots still get through, uncoalesced
+  s_got = 0;
+  for (int i = 0; i < BT_APP_COALESCE_SLOTS + 2; i++) {
+    CHECK(bt_app_work_dispatch_prio(record, 300 + i, NULL, 0, NULL,
+                                    BT_APP_PRIO_LOW));
+  }
+  bt_app_drain();
+  CHECK_EQ(s_got, BT_APP_COALESCE_SLOTS + 2);
+
+  bt_app_stats_t stats;
+  bt_app_get_stats(&stats);
+  CHECK_EQ(stats.coalesced, 99 + 4);
+  CHECK_EQ(stats.dropped, 0);
+  CHECK_EQ(s_heap_calls - heap_calls, 0);
+}
+
+/*
+ * Per round: AVRCP notifications, a burst of heartbeats, then the ACK.
+ * Sized to fit the NORMAL queue so the all-FIFO run loses nothing.
+ */
+static int64_t storm_ack_wait_us(bool classes) {
+  restart();
+  s_ack_wait_us = 0;
+  for (int round = 0; round < STORM_ROUNDS; round++) {
+    for (int i = 0; i < 4; i++) {
+      esp_avrc_ct_cb_param_t rc = {.change_ntf.event_id = i};
+      bt_app_work_dispatch(record, ESP_AVRC_CT_CHANGE_NOTIFY_EVT, &rc,
+                           sizeof(rc), NULL);
+    }
+    for (int i = 0; i < 5; i++) {
+      bt_app_work_dispatch_prio(record, BT_APP_HEART_BEAT_EVT, NULL, 0, NULL,
+                                classes ? BT_APP_PRIO_LOW
+                                        : BT_APP_PRIO_NORMAL);
+    }
+    esp_a2d_cb_param_t ack = numbered_param(0);
+    s_ack_posted_us = esp_timer_get_time();
+    bt_app_work_dispatch_prio(ack_handler, ESP_A2D_MEDIA_CTRL_ACK_EVT, &ack,
+                              sizeof(ack), NULL,
+                              classes ? BT_APP_PRIO_HIGH : BT_APP_PRIO_NORMAL);
+    bt_app_drain();
+  }
+
+  bt_app_stats_t stats;
+  bt_app_get_stats(&stats);
+  CHECK_EQ(stats.dropped, 0);
+  if (classes) {
+    CHECK_EQ(stats.latency[BT_APP_PRIO_HIGH].count, STORM_ROUNDS);
+    CHECK_EQ(stats.latency[BT_APP_PRIO_LOW].count, STORM_ROUNDS);
+    CHECK_EQ(stats.coalesced, 4 * STORM_ROUNDS);
+  }
+  return s_ack_wait_us / STORM_ROUNDS;
+}
+
+static void test_ack_latency_under_storm(void) {
+  int64_t fifo_us = storm_ack_wait_us(false);
+  int64_t prio_us = storm_ack_wait_us(true);
+  printf("media ACK wait: %lld us FIFO, %lld us with classes\n",
+         (long long)fifo_us, (long long)prio_us);
+  CHECK_EQ(fifo_us, 9 * HANDLER_COST_US);
+  CHECK_EQ(prio_us, 0);
+}
+
+int main(void) {
+  test_flood_to_depth();
+  test_overflow_is_counted();
+  test_low_events_coalesce();
+  test_ack_latency_under_storm();
+  return TEST_RESULT();
+}
@@ -0,0 +1,174 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Boot-time connect in bt_gap.c/bt_a2dp.c against a fake GAP/A2DP layer.
+ * A peer remembered in NVS is paged directly and inquiry is skipped when
+ * it answers; inquiry only runs without a cache, for a renamed target, or
+ * once the cached peer has stayed silent for the fallback timeout. A page
+ * that gets through after inquiry took over brings the link up the same
+ * way: reconnect timer stopped, backoff reset, media polled.
+ */
+
+#include "bt_a2dp.h"
+#include "bt_gap.h"
+#include "common.h"
+#include "fake_bt.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include "nvs.h"
+#include <string.h>
+
+#define PEER_TIMEOUT_US (6000 * 1000LL) // PEER_CONNECT_TIMEOUT_MS in bt_gap.c
+
+static const esp_bd_addr_t s_sink = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+
+/* Power cycle as far as the connect path cares: state back to boot */
+static void reboot(void) {
+  s_a2d_state = APP_AV_STATE_IDLE;
+  s_media_state = APP_AV_MEDIA_STATE_IDLE;
+  memset(s_peer_bda, 0, sizeof(s_peer_bda));
+  fake_bt_reset();
+  host_stub_nvs_take_writes();
+}
+
+static void store_peer(const char *name) {
+  nvs_handle_t handle;
+  CHECK_EQ(nvs_open("bt_peer", NVS_READWRITE, &handle), ESP_OK);
+  CHECK_EQ(nvs_set_blob(handle, "bda", s_sink, ESP_BD_ADDR_LEN), ESP_OK);
+  CHECK_EQ(nvs_set_str(handle, "name", name), ESP_OK);
+  nvs_close(handle);
+  host_stub_nvs_take_writes();
+}
+
+static bool peer_timer_active(void) {
+  TimerHandle_t tmr = host_stub_find_timer("peerTmr");
+  return tmr && xTimerIsTimerActive(tmr);
+}
+
+static void test_no_cache_runs_inquiry(void) {
+  reboot();
+  bt_gap_connect_peer();
+  fake_bt_calls_t *calls = fake_bt_calls();
+  CHECK_EQ(calls->discoveries, 1);
+  CHECK_EQ(calls->connects, 0);
+  CHECK_EQ(s_a2d_state, APP_AV_STATE_DISCOVERING);
+
+  // Other sinks are ignored; the target cancels inquiry and is paged
+  const esp_bd_addr_t other = {1, 2, 3, 4, 5, 6};
+  fake_bt_inquiry_result(other, "SOMEONE_ELSE");
+  CHECK_EQ(calls->cancels, 0);
+  fake_bt_inquiry_result(s_sink, CONFIG_EXAMPLE_PEER_DEVICE_NAME);
+  CHECK_EQ(calls->cancels, 1);
+  fake_bt_discovery_state(ESP_BT_GAP_DISCOVERY_STOPPED);
+  CHECK_EQ(calls->connects, 1);
+  CHECK(memcmp(calls->connect_bda, s_sink, ESP_BD_ADDR_LEN) == 0);
+
+  // The peer is remembered once it connects
+  fake_bt_a2d_conn_state(ESP_A2D_CONNECTION_STATE_CONNECTED);
+  CHECK_EQ(s_a2d_state, APP_AV_STATE_CONNECTED);
+  CHECK_EQ(host_stub_nvs_take_writes(), 2);
+}
+
+static void test_cached_peer_skips_inquiry(void) {
+  reboot();
+  store_peer(CONFIG_EXAMPLE_PEER_DEVICE_NAME);
+  bt_gap_connect_peer();
+  fake_bt_calls_t *calls = fake_bt_calls();
+  CHECK_EQ(calls->connects, 1);
+  CHECK(memcmp(calls->connect_bda, s_sink, ESP_BD_ADDR_LEN) == 0);
+  CHECK_EQ(calls->discoveries, 0);
+  CHECK_EQ(s_a2d_state, APP_AV_STATE_CONNECTING);
+  CHECK(peer_timer_active());
+
+  // It answers within the page timeout: the fallback is disarmed
+  host_stub_advance_us(PEER_TIMEOUT_US / 2);
+  fake_bt_a2d_conn_state(ESP_A2D_CONNECTION_STATE_CONNECTED);
+  CHECK_EQ(s_a2d_state, APP_AV_STATE_CONNECTED);
+  CHECK(!peer_timer_active());
+
+  host_stub_advance_us(2 * PEER_TIMEOUT_US);
+  CHECK_EQ(calls->discoveries, 0);
+  CHECK_EQ(calls->cancels, 0);
+  // Same peer as stored: no flash write
+  CHECK_EQ(host_stub_nvs_take_writes(), 0);
+}
+
+static void test_silent_peer_falls_back(void) {
+  reboot();
+  bt_gap_connect_peer();
+  fake_bt_calls_t *calls = fake_bt_calls();
+  CHECK_EQ(calls->connects, 1);
+
+  host_stub_advance_us(PEER_TIMEOUT_US - 1000);
+  CHECK_EQ(calls->discoveries, 0);
+  host_stub_advance_us(1000);
+  CHECK_EQ(calls->discoveries, 1);
+  CHECK_EQ(s_a2d_state, APP_AV_STATE_DISCOVERING);
+
+  // The page can still complete while inquiry runs
+  fake_bt_a2d_conn_state(ESP_A2D_CONNECTION_STATE_CONNECTED);
+  CHECK_EQ(s_a2d_state, APP_AV_STATE_CONNECTED);
+  CHECK_EQ(calls->cancels, 1);
+}
+
+static bool reconnect_timer_active(void) {
+  TimerHandle_t tmr = host_stub_find_timer("reconnTmr");
+  return tmr && xTimerIsTimerActive(tmr);
+}
+
+static void test_failed_page_then_late_connect(void) {
+  reboot();
+  store_peer(CONFIG_EXAMPLE_PEER_DEVICE_NAME);
+  bt_gap_connect_peer();
+  fake_bt_calls_t *calls = fake_bt_calls();
+
+  // The cached peer refuses twice: the second retry waits on the timer
+  fake_bt_a2d_conn_state(ESP_A2D_CONNECTION_STATE_DISCONNECTED);
+  CHECK_EQ(calls->connects, 2);
+  fake_bt_a2d_conn_state(ESP_A2D_CONNECTION_STATE_DISCONNECTED);
+  CHECK(reconnect_timer_active());
+
+  // Inquiry takes over, then a page gets through after all
+  host_stub_advance_us(PEER_TIMEOUT_US);
+  CHECK_EQ(calls->discoveries, 1);
+  CHECK_EQ(s_a2d_state, APP_AV_STATE_DISCOVERING);
+  int media_ctrls = calls->media_ctrls;
+  fake_bt_a2d_conn_state(ESP_A2D_CONNECTION_STATE_CONNECTED);
+  CHECK_EQ(s_a2d_state, APP_AV_STATE_CONNECTED);
+  CHECK_EQ(calls->cancels, 1);
+  // Same bring-up as a connect from the connecting state
+  CHECK(!reconnect_timer_active());
+  CHECK(!peer_timer_active());
+  CHECK_EQ(calls->media_ctrls, media_ctrls + 1);
+
+  // The backoff starts over: the next drop is retried at once
+  int connects = calls->connects;
+  fake_bt_a2d_conn_state(ESP_A2D_CONNECTION_STATE_DISCONNECTED);
+  CHECK_EQ(calls->connects, connects + 1);
+  CHECK(!reconnect_timer_active());
+}
+
+static void test_renamed_target_runs_inquiry(void) {
+  reboot();
+  store_peer("OLD_SPEAKER");
+  bt_gap_connect_peer();
+  fake_bt_calls_t *calls = fake_bt_calls();
+  CHECK_EQ(calls->connects, 0);
+  CHECK_EQ(calls->discoveries, 1);
+}
+
+int main(void) {
+  host_stub_nvs_clear();
+  bt_a2dp_init();
+
+  test_no_cache_runs_inquiry();
+  test_cached_peer_skips_inquiry();
+  test_silent_peer_falls_back();
+  test_failed_page_then_late_connect();
+  test_renamed_target_runs_inquiry();
+  return TEST_RESULT();
+}
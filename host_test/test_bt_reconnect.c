@@ -0,0 +1,148 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Link-loss recovery in bt_a2dp.c against a sink that goes out of range
+ * for a while. A page is answered when the sink is back and fails after
+ * the controller's page timeout otherwise. Checks the immediate first
+ * retry, the jittered exponential backoff and its cap, and the median/p95
+ * recovery figures the module reports.
+ */
+
+#include "bt_a2dp.h"
+#include "common.h"
+#include "esp_timer.h"
+#include "fake_bt.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include <string.h>
+
+#define PAGE_OK_US (150 * 1000LL)       // sink in range answers the page
+#define PAGE_TIMEOUT_US (5120 * 1000LL) // controller gives up
+#define BASE_MS 1000                    // RECONNECT_BASE_MS in bt_a2dp.c
+#define MAX_MS 30000                    // RECONNECT_MAX_MS
+#define MAX_ATTEMPTS 32
+
+static esp_timer_handle_t s_page_tmr;
+static esp_a2d_connection_state_t s_page_result;
+static int64_t s_sink_back_us;
+static int64_t s_page_us[MAX_ATTEMPTS]; // when each page went out
+static int s_pages;
+static int64_t s_lost_us;
+static int64_t s_up_us; // when the last page was answered
+
+static int64_t now_us(void) { return esp_timer_get_time(); }
+
+static void page_done(void *arg) {
+  s_up_us = now_us();
+  fake_bt_a2d_conn_state(s_page_result);
+}
+
+static void sink_paged(void) {
+  bool in_range = now_us() >= s_sink_back_us;
+  if (s_pages < MAX_ATTEMPTS) {
+    s_page_us[s_pages++] = now_us();
+  }
+  s_page_result = in_range ? ESP_A2D_CONNECTION_STATE_CONNECTED
+                           : ESP_A2D_CONNECTION_STATE_DISCONNECTED;
+  esp_timer_start_once(s_page_tmr, in_range ? PAGE_OK_US : PAGE_TIMEOUT_US);
+}
+
+/* Drop an established link; the sink is back after down_us */
+static uint32_t outage(int64_t down_us) {
+  CHECK_EQ(s_a2d_state, APP_AV_STATE_CONNECTED);
+  s_pages = 0;
+  s_lost_us = now_us();
+  s_sink_back_us = s_lost_us + down_us;
+  fake_bt_a2d_conn_state(ESP_A2D_CONNECTION_STATE_DISCONNECTED);
+  while (s_a2d_state != APP_AV_STATE_CONNECTED &&
+         now_us() - s_lost_us < 10 * 60 * 1000000LL) {
+    host_stub_advance_us(10 * 1000);
+  }
+  CHECK_EQ(s_a2d_state, APP_AV_STATE_CONNECTED);
+  return (uint32_t)((s_up_us - s_lost_us) / 1000);
+}
+
+static uint32_t backoff_ms(int attempt) {
+  uint32_t ms = BASE_MS << (attempt < 6 ? attempt : 6);
+  return ms < MAX_MS ? ms : MAX_MS;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void test_first_retry_is_immediate(void) {
+  uint32_t ms = outage(0);
+  CHECK_EQ(s_pages, 1);
+  CHECK_EQ(s_page_us[0], s_lost_us);
+  CHECK_EQ(ms * 1000LL, PAGE_OK_US);
+}
+
+static void test_backoff_schedule(void) {
+  outage(150 * 1000000LL);
+  CHECK(s_pages >= 6);
+  CHECK(s_pages <= 12); // not hammering a sink that is away
+
+  for (int i = 1; i < s_pages; i++) {
+    // The wait starts when the previous page has failed
+    int64_t wait_ms =
+        (s_page_us[i] - s_page_us[i - 1] - PAGE_TIMEOUT_US) / 1000;
+    uint32_t full = backoff_ms(i - 1);
+    if (wait_ms < full / 2 || wait_ms > full) {
+      fprintf(stderr, "attempt %d waited %lld ms, expected %u..%u\n", i + 1,
+              (long long)wait_ms, full / 2, full);
+      s_failures++;
+    }
+  }
+}
+
+static void test_recovery_stats(void) {
+  static const int down_s[] = {0, 1, 2, 3,  5,  8,  12, 20,
+                               0, 1, 4, 6, 9, 15, 30, 45};
+  const int n = sizeof(down_s) / sizeof(down_s[0]);
+  uint32_t took[sizeof(down_s) / sizeof(down_s[0])];
+  for (int i = 0; i < n; i++) {
+    host_stub_seed_random(i + 1);
+    int64_t down_us = down_s[i] * 1000000LL;
+    took[i] = outage(down_us);
+
+    // Back within one page timeout plus one backoff step of its return
+    uint32_t slack_ms = (PAGE_TIMEOUT_US + PAGE_OK_US) / 1000;
+    uint32_t step_ms = down_s[i] * 1000 + BASE_MS;
+    slack_ms += step_ms < MAX_MS ? step_ms : MAX_MS;
+    if (took[i] > down_s[i] * 1000 + slack_ms) {
+      fprintf(stderr, "%d s outage took %u ms\n", down_s[i], took[i]);
+      s_failures++;
+    }
+  }
+
+  // The module's figures cover the last 16 recoveries, all of them here
+  uint32_t median_ms, p95_ms;
+  CHECK_EQ(bt_a2dp_get_recovery_stats(&median_ms, &p95_ms), 16);
+  qsort(took, n, sizeof(took[0]), cmp_u32);
+  CHECK_EQ(median_ms, took[n / 2]);
+  CHECK_EQ(p95_ms, took[(n * 95 - 1) / 100]);
+}
+
+int main(void) {
+  const esp_timer_create_args_t args = {.callback = page_done,
+                                        .name = "page"};
+  esp_timer_create(&args, &s_page_tmr);
+  bt_a2dp_init();
+  fake_bt_set_connect_hook(sink_paged);
+
+  s_a2d_state = APP_AV_STATE_CONNECTING;
+  fake_bt_a2d_conn_state(ESP_A2D_CONNECTION_STATE_CONNECTED);
+  uint32_t median_ms, p95_ms;
+  CHECK_EQ(bt_a2dp_get_recovery_stats(&median_ms, &p95_ms), 0);
+
+  test_first_retry_is_immediate();
+  test_backoff_schedule();
+  test_recovery_stats();
+  return TEST_RESULT();
+}
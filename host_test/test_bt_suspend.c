@@ -0,0 +1,208 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Pause/play against the media state machine in bt_a2dp.c. The fake stack
+ * calls the data callback every 20 ms while the stream runs, from a START
+ * acknowledgement to a SUSPEND one, and the sink acknowledges media
+ * commands after 40 ms. Checks that a short pause leaves the stream alone,
+ * a long one suspends it after the grace period, and the callback work a
+ * pause costs and the play-to-audio time the module reports. That time
+ * runs to the first callback that got ring buffer bytes, not silence.
+ */
+
+#include "bt_a2dp.h"
+#include "common.h"
+#include "esp_timer.h"
+#include "fake_bt.h"
+#include "host_stubs.h"
+#include "host_test.h"
+
+#define CB_PERIOD_US (20 * 1000LL) // data callback period while streaming
+#define SINK_ACK_US (40 * 1000LL)  // sink answers a media command
+#define GRACE_US (3000 * 1000LL)   // PAUSE_SUSPEND_GRACE_MS in bt_a2dp.c
+#define LONG_PAUSE_US (60 * 1000000LL)
+
+static esp_timer_handle_t s_stream_tmr;
+static esp_timer_handle_t s_ack_tmr;
+static esp_a2d_media_ctrl_t s_acking;
+static esp_a2d_media_ctrl_ack_t s_ack_status = ESP_A2D_MEDIA_CTRL_ACK_SUCCESS;
+
+static void stream_tick(void *arg) {
+  uint8_t data[512];
+  bt_a2dp_data_callback(data, sizeof(data));
+}
+
+static bool streaming(void) { return esp_timer_is_active(s_stream_tmr); }
+
+/* The stack streams from a START ack until a SUSPEND ack */
+static void sink_ack(void *arg) {
+  if (s_ack_status == ESP_A2D_MEDIA_CTRL_ACK_SUCCESS) {
+    if (s_acking == ESP_A2D_MEDIA_CTRL_START && !streaming()) {
+      esp_timer_start_periodic(s_stream_tmr, CB_PERIOD_US);
+    } else if (s_acking == ESP_A2D_MEDIA_CTRL_SUSPEND && streaming()) {
+      esp_timer_stop(s_stream_tmr);
+    }
+  }
+  fake_bt_media_ctrl_ack(s_acking, s_ack_status);
+}
+
+static void sink_media_ctrl(esp_a2d_media_ctrl_t ctrl) {
+  s_acking = ctrl;
+  esp_timer_start_once(s_ack_tmr, SINK_ACK_US);
+}
+
+/* What button_control.c does on a play/pause press */
+static void set_playing(bool playing) {
+  s_is_playing = playing;
+  bt_a2dp_play_state_changed();
+}
+
+static void test_short_pause_keeps_stream(void) {
+  fake_bt_reset();
+  set_playing(false);
+  host_stub_advance_us(GRACE_US / 3);
+  set_playing(true);
+  host_stub_advance_us(GRACE_US);
+  CHECK_EQ(fake_bt_calls()->media_ctrls, 0);
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_STARTED);
+
+  bt_a2dp_pause_stats_t stats;
+  bt_a2dp_get_pause_stats(&stats);
+  CHECK_EQ(stats.paused_ms, GRACE_US / 3 / 1000);
+  CHECK_EQ(stats.callbacks, GRACE_US / 3 / CB_PERIOD_US);
+  CHECK_EQ(stats.start_ack_ms, 0);
+  CHECK(stats.to_audio_ms <= CB_PERIOD_US / 1000);
+}
+
+static void test_long_pause_suspends(void) {
+  fake_bt_reset();
+  set_playing(false);
+  host_stub_advance_us(GRACE_US - 1000);
+  CHECK_EQ(fake_bt_calls()->media_ctrls, 0);
+  host_stub_advance_us(1000);
+  CHECK_EQ(fake_bt_calls()->media_ctrls, 1);
+  CHECK_EQ(fake_bt_calls()->last_media_ctrl, ESP_A2D_MEDIA_CTRL_SUSPEND);
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_SUSPENDING);
+  host_stub_advance_us(SINK_ACK_US);
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_SUSPENDED);
+  CHECK(!streaming());
+
+  host_stub_advance_us(LONG_PAUSE_US - GRACE_US - SINK_ACK_US);
+  set_playing(true);
+  CHECK_EQ(fake_bt_calls()->media_ctrls, 2);
+  CHECK_EQ(fake_bt_calls()->last_media_ctrl, ESP_A2D_MEDIA_CTRL_START);
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_RESUMING);
+  host_stub_advance_us(SINK_ACK_US + CB_PERIOD_US);
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_STARTED);
+
+  // A minute of pause costs the grace period's callbacks, not a minute's
+  bt_a2dp_pause_stats_t stats;
+  bt_a2dp_get_pause_stats(&stats);
+  printf("60 s pause: %u data callbacks (%lld unsuspended), start ack %u ms, "
+         "audio after %u ms\n",
+         stats.callbacks, LONG_PAUSE_US / CB_PERIOD_US, stats.start_ack_ms,
+         stats.to_audio_ms);
+  CHECK_EQ(stats.paused_ms, LONG_PAUSE_US / 1000);
+  CHECK_EQ(stats.callbacks, (GRACE_US + SINK_ACK_US) / CB_PERIOD_US);
+  CHECK_EQ(stats.start_ack_ms, SINK_ACK_US / 1000);
+  CHECK_EQ(stats.to_audio_ms, (SINK_ACK_US + CB_PERIOD_US) / 1000);
+}
+
+static void test_play_while_suspending(void) {
+  fake_bt_reset();
+  set_playing(false);
+  host_stub_advance_us(GRACE_US + SINK_ACK_US / 4);
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_SUSPENDING);
+  set_playing(true);
+  CHECK_EQ(fake_bt_calls()->media_ctrls, 1);
+
+  // START goes out as soon as the SUSPEND is acknowledged
+  host_stub_advance_us(SINK_ACK_US);
+  CHECK_EQ(fake_bt_calls()->media_ctrls, 2);
+  CHECK_EQ(fake_bt_calls()->last_media_ctrl, ESP_A2D_MEDIA_CTRL_START);
+  host_stub_advance_us(SINK_ACK_US + CB_PERIOD_US);
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_STARTED);
+  CHECK(streaming());
+}
+
+static void test_pause_while_resuming(void) {
+  fake_bt_reset();
+  set_playing(false);
+  host_stub_advance_us(GRACE_US + SINK_ACK_US);
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_SUSPENDED);
+  set_playing(true);
+  set_playing(false);
+  host_stub_advance_us(SINK_ACK_US);
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_STARTED);
+
+  // The grace period starts over from the acknowledgement
+  host_stub_advance_us(GRACE_US);
+  CHECK_EQ(fake_bt_calls()->media_ctrls, 3);
+  CHECK_EQ(fake_bt_calls()->last_media_ctrl, ESP_A2D_MEDIA_CTRL_SUSPEND);
+  host_stub_advance_us(SINK_ACK_US);
+  set_playing(true);
+  host_stub_advance_us(SINK_ACK_US + CB_PERIOD_US);
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_STARTED);
+}
+
+static void test_resume_waits_for_ring(void) {
+  fake_bt_reset();
+  set_playing(false);
+  host_stub_advance_us(GRACE_US / 3);
+  fake_bt_set_ring_empty(true);
+  set_playing(true);
+
+  // Silence while the decoder refills does not count as audio
+  host_stub_advance_us(5 * CB_PERIOD_US);
+  bt_a2dp_pause_stats_t stats;
+  bt_a2dp_get_pause_stats(&stats);
+  CHECK_EQ(stats.to_audio_ms, 0);
+
+  fake_bt_set_ring_empty(false);
+  host_stub_advance_us(CB_PERIOD_US);
+  bt_a2dp_get_pause_stats(&stats);
+  CHECK(stats.to_audio_ms >= 5 * CB_PERIOD_US / 1000);
+  CHECK(stats.to_audio_ms <= 6 * CB_PERIOD_US / 1000);
+}
+
+static void test_suspend_refused(void) {
+  fake_bt_reset();
+  s_ack_status = ESP_A2D_MEDIA_CTRL_ACK_FAILURE;
+  set_playing(false);
+  host_stub_advance_us(GRACE_US + SINK_ACK_US);
+  s_ack_status = ESP_A2D_MEDIA_CTRL_ACK_SUCCESS;
+  CHECK_EQ(s_media_state, APP_AV_MEDIA_STATE_STARTED);
+  CHECK(streaming());
+  set_playing(true);
+  host_stub_advance_us(CB_PERIOD_US);
+  CHECK_EQ(fake_bt_calls()->media_ctrls, 1);
+}
+
+int main(void) {
+  const esp_timer_create_args_t stream_args = {.callback = stream_tick,
+                                               .name = "stream"};
+  const esp_timer_create_args_t ack_args = {.callback = sink_ack,
+                                            .name = "sinkAck"};
+  esp_timer_create(&stream_args, &s_stream_tmr);
+  esp_timer_create(&ack_args, &s_ack_tmr);
+  bt_a2dp_init();
+  fake_bt_set_media_ctrl_hook(sink_media_ctrl);
+
+  // Connected and streaming, a while after boot
+  host_stub_advance_us(1000000);
+  s_a2d_state = APP_AV_STATE_CONNECTED;
+  s_media_state = APP_AV_MEDIA_STATE_STARTED;
+  esp_timer_start_periodic(s_stream_tmr, CB_PERIOD_US);
+
+  test_short_pause_keeps_stream();
+  test_long_pause_suspends();
+  test_play_while_suspending();
+  test_pause_while_resuming();
+  test_resume_waits_for_ring();
+  test_suspend_refused();
+  return TEST_RESULT();
+}
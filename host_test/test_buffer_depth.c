@@ -0,0 +1,185 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Adaptive buffer depth (buffer_depth.c) in a simulated player. A decode
+ * task fills the ring up to the target one MP3 frame at a time, reading the
+ * SD card every ten frames; the A2DP data callback drains what has played
+ * since its last call. Each link/card profile runs a minute against the
+ * fixed 32 KB ring, checking that the adaptive depth never underruns and
+ * keeps less audio queued where the link allows it.
+ */
+
+#include "buffer_depth.h"
+#include "host_test.h"
+#include <stdio.h>
+
+#define RING_BYTES (32 * 1024)
+#define BYTES_PER_MS 176        // 44.1 kHz stereo 16-bit
+#define FRAME_BYTES (1152 * 4)  // one MPEG-1 layer III frame of PCM
+#define DECODE_US 4000          // decode cost of one frame
+#define FRAMES_PER_READ 10      // 4 KB of 128 kbit/s MP3 per SD read
+#define POLL_US 5000            // buffer_wait_room() sleep
+#define RUN_US (60 * 1000000LL)
+#define SETTLED_US (20 * 1000000LL) // latency is measured after this
+
+typedef struct {
+  const char *name;
+  uint32_t cb_ms;        // mean data-callback period
+  uint32_t cb_spread_ms; // period is uniform in cb_ms +/- this
+  uint32_t sd_us;        // ordinary SD read
+  uint32_t stall_us;     // occasional slow read (0 = none)
+  uint32_t stall_every_ms;
+  uint16_t sink_delay_01ms;
+} profile_t;
+
+typedef struct {
+  uint32_t underruns;
+  uint32_t target;
+  uint32_t changes;   // target changes once settled
+  uint32_t queued_ms; // mean buffered audio seen by the callback
+} result_t;
+
+static const profile_t s_stable = {"stable", 20, 1, 2000, 0, 0, 0};
+static const profile_t s_jittery = {"jittery", 20, 18, 2000, 0, 0, 0};
+static const profile_t s_deep_sink = {"jittery, deep sink", 20, 18, 2000,
+                                      0, 0, 2000};
+static const profile_t s_slow_card = {"slow SD card", 20, 1, 2000,
+                                      100000, 4000, 0};
+
+static uint32_t s_rng;
+
+static uint32_t rnd(uint32_t n) {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng % n;
+}
+
+static result_t run(const profile_t *p, bool adaptive) {
+  buffer_depth_t d = BUFFER_DEPTH_INITIALIZER(RING_BYTES);
+  d.m.sink_delay_01ms = p->sink_delay_01ms;
+  s_rng = 0x2545f491;
+
+  uint32_t buffered = 0;
+  uint32_t frames = 0;
+  bool decoding = false;
+  int64_t busy_until = 0, next_poll = 0, last_stall = 0;
+  int64_t next_cb = p->cb_ms * 1000, last_cb = 0;
+  uint64_t queued_sum = 0, queued_cnt = 0;
+  result_t r = {0};
+
+  for (int64_t t = 0; t < RUN_US; t += 1000) {
+    // Producer: one frame in flight, then wait for room under the target
+    if (decoding && t >= busy_until) {
+      buffered += FRAME_BYTES;
+      decoding = false;
+    }
+    if (!decoding && t >= next_poll) {
+      if (buffered + FRAME_BYTES <= d.m.target_bytes) {
+        uint32_t cost = DECODE_US;
+        if (frames++ % FRAMES_PER_READ == 0) {
+          uint32_t read_us = p->sd_us;
+          if (p->stall_us && t - last_stall >= p->stall_every_ms * 1000LL) {
+            read_us = p->stall_us;
+            last_stall = t;
+          }
+          buffer_depth_note_sd_read(&d, read_us);
+          cost += read_us;
+        }
+        busy_until = t + cost;
+        decoding = true;
+      } else {
+        next_poll = t + POLL_US;
+      }
+    }
+
+    // Consumer: the stack asks for what has played since the last call
+    if (t >= next_cb) {
+      uint32_t want = (t - last_cb) / 1000 * BYTES_PER_MS;
+      uint32_t got = want < buffered ? want : buffered;
+      buffered -= got;
+      buffer_depth_note_callback(&d, t, want, got, buffered, true);
+      if (t >= SETTLED_US) {
+        queued_sum += buffered + got;
+        queued_cnt++;
+      }
+      last_cb = t;
+      next_cb = t + (p->cb_ms - p->cb_spread_ms +
+                     rnd(2 * p->cb_spread_ms + 1)) * 1000;
+    }
+
+    if (adaptive && t % 1000000 == 0 && buffer_depth_adapt(&d, t) &&
+        t >= SETTLED_US) {
+      r.changes++;
+    }
+  }
+
+  r.underruns = d.m.underruns;
+  r.target = d.m.target_bytes;
+  r.queued_ms = queued_sum / queued_cnt / BYTES_PER_MS;
+  printf("%-20s %-8s target %5u B, queued %3u ms, underruns %u\n", p->name,
+         adaptive ? "adaptive" : "fixed", r.target, r.queued_ms, r.underruns);
+  return r;
+}
+
+/* No underruns, and less queued than the fixed ring when shallower */
+static result_t check_profile(const profile_t *p) {
+  result_t fixed = run(p, false);
+  result_t adapt = run(p, true);
+  CHECK_EQ(fixed.underruns, 0);
+  CHECK_EQ(adapt.underruns, 0);
+  CHECK(adapt.target <= fixed.target);
+  if (adapt.target < fixed.target) {
+    CHECK(adapt.queued_ms < fixed.queued_ms);
+  }
+  // Hysteresis: settled links do not flap
+  CHECK(adapt.changes <= 1);
+  return adapt;
+}
+
+static void test_profiles(void) {
+  result_t stable = check_profile(&s_stable);
+  result_t jittery = check_profile(&s_jittery);
+  result_t deep_sink = check_profile(&s_deep_sink);
+  result_t slow_card = check_profile(&s_slow_card);
+
+  // Lean on a stable link, deeper as jitter grows
+  CHECK(stable.queued_ms < 100);
+  CHECK(jittery.target > stable.target);
+  // A sink that buffers 200 ms itself needs less margin from us
+  CHECK(deep_sink.target < jittery.target);
+  // A card that stalls for 100 ms keeps the ring deep enough to cover it
+  CHECK(slow_card.target >= 100 * BYTES_PER_MS);
+}
+
+static void test_underrun_grows_target(void) {
+  buffer_depth_t d = BUFFER_DEPTH_INITIALIZER(RING_BYTES);
+  d.m.target_bytes = 8000;
+  // Silence before any data flowed is start-up, not an underrun
+  buffer_depth_note_callback(&d, 1000, 512, 0, 0, true);
+  CHECK_EQ(d.m.underruns, 0);
+  buffer_depth_note_callback(&d, 2000, 512, 512, 1024, true);
+  buffer_depth_note_callback(&d, 3000, 512, 100, 0, true);
+  CHECK_EQ(d.m.underruns, 1);
+  CHECK_EQ(d.m.target_bytes, 10000);
+  CHECK_EQ(d.m.reason, AUDIO_BUF_REASON_UNDERRUN);
+  // One dry spell counts once
+  buffer_depth_note_callback(&d, 4000, 512, 0, 0, true);
+  CHECK_EQ(d.m.underruns, 1);
+
+  // No shrinking within BUF_UNDERRUN_HOLD_MS of it
+  for (int64_t t = 1000000; t < BUF_UNDERRUN_HOLD_MS * 1000LL; t += 1000000) {
+    buffer_depth_adapt(&d, t);
+    CHECK_EQ(d.m.target_bytes, 10000);
+  }
+}
+
+int main(void) {
+  test_profiles();
+  test_underrun_grows_target();
+  return TEST_RESULT();
+}
@@ -0,0 +1,214 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Button state machine (button_fsm.c) against a simulated contact. Presses
+ * are given as down/up times; the contact chatters for a while at each
+ * transition, every falling edge is fed to button_fsm_edge() and the timer
+ * it asks for fires with the level sampled then, as button_control.c does.
+ * A timer expiry can be delivered late or dropped altogether.
+ */
+
+#include "button_fsm.h"
+#include "host_test.h"
+#include <stdio.h>
+
+#define STEP_US 100
+#define CHATTER_US 300 // contact flips this often while bouncing
+#define DEBOUNCE_US (20 * 1000)
+#define POLL_US (30 * 1000)
+#define LONG_US (500 * 1000)
+#define REPEAT_US (150 * 1000)
+#define MAX_EVENTS 64
+
+typedef struct {
+  int64_t down_us;
+  int64_t up_us;
+} press_t;
+
+typedef struct {
+  button_evt_t evt;
+  int64_t t;
+} event_t;
+
+typedef struct {
+  const press_t *presses;
+  int n_presses;
+  int64_t bounce_us;  // chatter at each transition
+  int64_t late_at;    // first expiry due after this comes late ...
+  int64_t late_us;    // ... by this much (0: never)
+  int64_t drop_at;    // first expiry due after this is lost (0: never)
+  int64_t end_us;
+} scenario_t;
+
+static event_t s_events[MAX_EVENTS];
+static int s_n_events;
+
+static bool level_pressed(const scenario_t *sc, int64_t t) {
+  for (int i = 0; i < sc->n_presses; i++) {
+    const press_t *p = &sc->presses[i];
+    if (t < p->down_us || t >= p->up_us + sc->bounce_us) {
+      continue;
+    }
+    if (t < p->down_us + sc->bounce_us) {
+      return (t - p->down_us) / CHATTER_US % 2 == 0;
+    }
+    if (t >= p->up_us) {
+      return (t - p->up_us) / CHATTER_US % 2 == 1;
+    }
+    return true;
+  }
+  return false;
+}
+
+static void run(const scenario_t *sc) {
+  const button_fsm_cfg_t cfg = {
+      .debounce_us = DEBOUNCE_US,
+      .poll_us = POLL_US,
+      .long_press_us = LONG_US,
+      .repeat_us = REPEAT_US,
+  };
+  button_fsm_t fsm;
+  button_fsm_init(&fsm, &cfg);
+  int64_t deadline = 0;
+  bool late_done = false, drop_done = false;
+  bool was_pressed = false;
+  s_n_events = 0;
+
+  for (int64_t t = STEP_US; t <= sc->end_us; t += STEP_US) {
+    bool pressed = level_pressed(sc, t);
+    if (deadline && t >= deadline) {
+      if (sc->late_us && !late_done && deadline > sc->late_at) {
+        deadline += sc->late_us;
+        late_done = true;
+      } else if (sc->drop_at && !drop_done && deadline > sc->drop_at) {
+        deadline = 0;
+        drop_done = true;
+      } else {
+        int64_t next = 0;
+        button_evt_t evt = button_fsm_timer(&fsm, pressed, t, &next);
+        deadline = next;
+        if (evt != BUTTON_EVT_NONE && s_n_events < MAX_EVENTS) {
+          s_events[s_n_events++] = (event_t){evt, t};
+        }
+      }
+    }
+    if (pressed && !was_pressed) {
+      int64_t next = button_fsm_edge(&fsm, t);
+      if (next) {
+        deadline = next;
+      }
+    }
+    was_pressed = pressed;
+  }
+}
+
+static int count(button_evt_t evt) {
+  int n = 0;
+  for (int i = 0; i < s_n_events; i++) {
+    n += s_events[i].evt == evt;
+  }
+  return n;
+}
+
+static void test_bounce_train(void) {
+  // 3 ms of chatter on press and on release: one press, one release
+  const press_t presses[] = {{10000, 200000}};
+  const scenario_t sc = {presses, 1, 3000, .end_us = 400000};
+  run(&sc);
+  CHECK_EQ(s_n_events, 2);
+  CHECK_EQ(s_events[0].evt, BUTTON_EVT_PRESS);
+  CHECK_EQ(s_events[0].t, 10000 + DEBOUNCE_US);
+  CHECK_EQ(s_events[1].evt, BUTTON_EVT_RELEASE);
+  CHECK(s_events[1].t > 200000 + 3000);
+  CHECK(s_events[1].t <= 200000 + POLL_US + DEBOUNCE_US);
+}
+
+static void test_glitch(void) {
+  // Shorter than the debounce time: nothing at all
+  const press_t presses[] = {{10000, 11000}, {50000, 52000}};
+  const scenario_t sc = {presses, 2, 500, .end_us = 200000};
+  run(&sc);
+  CHECK_EQ(s_n_events, 0);
+}
+
+static void test_long_press_and_repeat(void) {
+  const press_t presses[] = {{10000, 1200000}};
+  const scenario_t sc = {presses, 1, 2000, .end_us = 1500000};
+  run(&sc);
+  int64_t press = 10000 + DEBOUNCE_US;
+  CHECK_EQ(count(BUTTON_EVT_PRESS), 1);
+  CHECK_EQ(count(BUTTON_EVT_LONG_PRESS), 1);
+  CHECK_EQ(count(BUTTON_EVT_RELEASE), 1);
+  CHECK_EQ(s_events[1].evt, BUTTON_EVT_LONG_PRESS);
+  CHECK_EQ(s_events[1].t, press + LONG_US);
+
+  // Every REPEAT_US after the long press until the release
+  int repeats = count(BUTTON_EVT_REPEAT);
+  CHECK_EQ(repeats, (1200000 - press - LONG_US) / REPEAT_US);
+  for (int i = 0; i < repeats; i++) {
+    CHECK_EQ(s_events[2 + i].evt, BUTTON_EVT_REPEAT);
+    CHECK_EQ(s_events[2 + i].t, press + LONG_US + (i + 1) * REPEAT_US);
+  }
+  CHECK_EQ(s_events[s_n_events - 1].evt, BUTTON_EVT_RELEASE);
+}
+
+static void test_late_wakeup_keeps_cadence(void) {
+  // One wake-up 400 ms late while held: one repeat for the lot, then
+  // back on the original grid
+  const press_t presses[] = {{10000, 1500000}};
+  const scenario_t sc = {presses, 1, 0, .late_at = 600000, .late_us = 400000,
+                         .end_us = 1700000};
+  run(&sc);
+  int64_t grid = 10000 + DEBOUNCE_US + LONG_US;
+  int late = -1;
+  for (int i = 0; i < s_n_events; i++) {
+    if (s_events[i].evt == BUTTON_EVT_REPEAT &&
+        (s_events[i].t - grid) % REPEAT_US != 0) {
+      CHECK_EQ(late, -1);
+      late = i;
+    }
+  }
+  CHECK(late > 0);
+  CHECK_EQ(s_events[late + 1].evt, BUTTON_EVT_REPEAT);
+  CHECK_EQ((s_events[late + 1].t - grid) % REPEAT_US, 0);
+  CHECK(s_events[late + 1].t - s_events[late].t < REPEAT_US);
+}
+
+static void test_dropped_expiry(void) {
+  // The sample after the press is lost, so the release is never seen and
+  // the machine sits in PRESSED. Edges within BUTTON_FSM_LOST_US are
+  // bounce as far as it can tell; a later press starts over cleanly.
+  const press_t presses[] = {
+      {10000, 100000}, {600000, 700000}, {2000000, 2100000}};
+  const scenario_t sc = {presses, 3, 2000, .drop_at = 10000 + DEBOUNCE_US,
+                         .end_us = 2500000};
+  run(&sc);
+  CHECK_EQ(s_n_events, 3);
+  CHECK_EQ(s_events[0].evt, BUTTON_EVT_PRESS);
+  CHECK_EQ(s_events[1].evt, BUTTON_EVT_PRESS);
+  CHECK_EQ(s_events[1].t, 2000000 + DEBOUNCE_US);
+  CHECK_EQ(s_events[2].evt, BUTTON_EVT_RELEASE);
+  CHECK(s_events[2].t > 2100000);
+  // No stale long press from the lost one
+  CHECK_EQ(count(BUTTON_EVT_LONG_PRESS), 0);
+
+  // Without the loss the same presses are three clean clicks
+  scenario_t ok = sc;
+  ok.drop_at = 0;
+  run(&ok);
+  CHECK_EQ(count(BUTTON_EVT_PRESS), 3);
+  CHECK_EQ(count(BUTTON_EVT_RELEASE), 3);
+}
+
+int main(void) {
+  test_bounce_train();
+  test_glitch();
+  test_long_press_and_repeat();
+  test_late_wakeup_keeps_cadence();
+  test_dropped_expiry();
+  return TEST_RESULT();
+}
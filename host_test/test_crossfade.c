@@ -0,0 +1,190 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Equal-power crossfade (crossfade.c) over a 3 s fade at 44.1 kHz, fed a
+ * frame at a time as the decode task does. Constant inputs trace the two
+ * gain curves against sin/cos, which must also join up across frame
+ * edges; uncorrelated noise must keep its power through the fade. Then
+ * the loudness handover: the mix is played at the incoming track's gain
+ * (pcm_gain.c), so the tail is scaled by the ratio of the two gains first
+ * and carries on at its own level.
+ */
+
+#include "crossfade.h"
+#include "host_test.h"
+#include "pcm_gain.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define HZ 44100
+#define FRAME 1152
+#define FADE_LEN ((uint32_t)CROSSFADE_MS * HZ / 1000)
+#define LEVEL 16384
+#define CURVE_TOL 4e-4 // of full scale, table and interpolation
+#define POWER_TOL_DB 0.25
+#define NOISE_WINDOW 4410 // 100 ms
+
+static uint32_t s_rng = 0x3c6ef372;
+
+static int16_t noise(void) {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return (int16_t)((s_rng >> 16) % 16384) - 8192;
+}
+
+/* Gain of one side through the fade, as crossfade_mix() applies it */
+static void trace_curve(bool incoming, float *gain) {
+  int16_t pcm[FRAME], tail[FRAME];
+  for (uint32_t pos = 0; pos < FADE_LEN; pos += FRAME) {
+    int n = FADE_LEN - pos < FRAME ? FADE_LEN - pos : FRAME;
+    for (int i = 0; i < n; i++) {
+      pcm[i] = incoming ? LEVEL : 0;
+      tail[i] = incoming ? 0 : LEVEL;
+    }
+    crossfade_mix(pcm, tail, n, n, 1, pos, FADE_LEN);
+    for (int i = 0; i < n; i++) {
+      gain[pos + i] = pcm[i] / (float)LEVEL;
+    }
+  }
+}
+
+static void test_curves(void) {
+  static float g_in[FADE_LEN], g_out[FADE_LEN];
+  trace_curve(true, g_in);
+  trace_curve(false, g_out);
+  double max_err = 0, max_power_err = 0, max_step = 0;
+  for (uint32_t i = 0; i < FADE_LEN; i++) {
+    double x = M_PI / 2 * i / FADE_LEN;
+    double e_in = fabs(g_in[i] - sin(x));
+    double e_out = fabs(g_out[i] - cos(x));
+    max_err = fmax(max_err, fmax(e_in, e_out));
+    double p = g_in[i] * g_in[i] + g_out[i] * g_out[i];
+    max_power_err = fmax(max_power_err, fabs(p - 1));
+    if (i > 0) {
+      max_step = fmax(max_step, fabs(g_in[i] - g_in[i - 1]));
+      max_step = fmax(max_step, fabs(g_out[i] - g_out[i - 1]));
+    }
+  }
+  // The steepest part of the curve moves (pi/2)/len per sample
+  double slope = M_PI / 2 / FADE_LEN;
+  printf("%u-sample fade: gain error %.5f of full scale, power %.4f off "
+         "unity, largest step %.6f (slope %.6f)\n",
+         FADE_LEN, max_err, max_power_err, max_step, slope);
+  CHECK(max_err < CURVE_TOL + 1.0 / LEVEL);
+  CHECK(max_power_err < 2 * (CURVE_TOL + 1.0 / LEVEL));
+  // No jumps at frame edges: steps stay near the slope of the curve
+  CHECK(max_step < slope + 2.0 / LEVEL);
+  CHECK(g_in[0] < 1e-3 && g_out[0] > 0.999);
+  CHECK(g_in[FADE_LEN - 1] > 0.999 && g_out[FADE_LEN - 1] < 1e-3);
+}
+
+static void test_noise_power(void) {
+  // Two uncorrelated noise tracks of equal power, in stereo
+  int16_t pcm[FRAME * 2], tail[FRAME * 2];
+  double ref = 0, sum = 0, min_db = 0, max_db = 0;
+  uint32_t in_win = 0;
+  for (uint32_t pos = 0; pos < FADE_LEN; pos += FRAME) {
+    int n = FADE_LEN - pos < FRAME ? FADE_LEN - pos : FRAME;
+    for (int i = 0; i < n * 2; i++) {
+      pcm[i] = noise();
+      tail[i] = noise();
+      ref += (double)tail[i] * tail[i];
+    }
+    crossfade_mix(pcm, tail, n, n, 2, pos, FADE_LEN);
+    for (int i = 0; i < n * 2; i++) {
+      sum += (double)pcm[i] * pcm[i];
+    }
+    in_win += n;
+    if (in_win >= NOISE_WINDOW) {
+      double db = 10 * log10(sum / ref);
+      min_db = fmin(min_db, db);
+      max_db = fmax(max_db, db);
+      sum = ref = 0;
+      in_win = 0;
+    }
+  }
+  printf("uncorrelated noise through the fade: %+.2f to %+.2f dB per "
+         "100 ms\n",
+         min_db, max_db);
+  CHECK(min_db > -POWER_TOL_DB);
+  CHECK(max_db < POWER_TOL_DB);
+}
+
+static void test_edges(void) {
+  int16_t pcm[FRAME * 2], tail[FRAME * 2];
+  // The outgoing track ends mid-frame: silence from there on
+  for (int i = 0; i < FRAME * 2; i++) {
+    pcm[i] = 0;
+    tail[i] = LEVEL;
+  }
+  crossfade_mix(pcm, tail, 100, FRAME, 2, 0, FADE_LEN);
+  CHECK(pcm[199] > LEVEL - 10);
+  CHECK_EQ(pcm[200], 0);
+  CHECK_EQ(pcm[FRAME * 2 - 1], 0);
+
+  // No tail at all, or past the end of the fade: the incoming track as is
+  for (int i = 0; i < FRAME * 2; i++) {
+    pcm[i] = 1000;
+  }
+  crossfade_mix(pcm, NULL, 0, FRAME, 2, FADE_LEN, FADE_LEN);
+  CHECK_EQ(pcm[0], 1000);
+  CHECK_EQ(pcm[FRAME * 2 - 1], 1000);
+
+  // Both at full scale mid-fade sum past it: clamped, not wrapped
+  for (int i = 0; i < FRAME * 2; i++) {
+    pcm[i] = i % 2 ? -32768 : 32767;
+    tail[i] = pcm[i];
+  }
+  crossfade_mix(pcm, tail, FRAME, FRAME, 2, FADE_LEN / 2, FADE_LEN);
+  CHECK_EQ(pcm[0], 32767);
+  CHECK_EQ(pcm[1], -32768);
+}
+
+/*
+ * The outgoing track plays at gain_out until the fade starts; from there
+ * the data callback applies the incoming track's gain_in to the mix.
+ * Returns the level of the tail just after the switch over the level
+ * just before it, as heard.
+ */
+static double handover(float gain_out, float gain_in, bool scale_tail) {
+  int16_t before[FRAME], pcm[FRAME], tail[FRAME];
+  for (int i = 0; i < FRAME; i++) {
+    before[i] = tail[i] = LEVEL;
+    pcm[i] = 0; // the next track starts quietly
+  }
+  pcm_gain_apply(before, FRAME, gain_out);
+  if (scale_tail) {
+    pcm_gain_apply(tail, FRAME, gain_out / gain_in);
+  }
+  crossfade_mix(pcm, tail, FRAME, FRAME, 1, 0, FADE_LEN);
+  pcm_gain_apply(pcm, FRAME, gain_in);
+  return (double)pcm[0] / before[FRAME - 1];
+}
+
+static void test_gain_handover(void) {
+  static const float gains[][2] = {{1.0f, 0.5f}, {0.4f, 1.0f}, {0.7f, 0.7f},
+                                   {0.25f, 0.8f}};
+  for (size_t i = 0; i < sizeof(gains) / sizeof(gains[0]); i++) {
+    float out = gains[i][0], in = gains[i][1];
+    double step = 20 * log10(handover(out, in, true));
+    double old = 20 * log10(handover(out, in, false));
+    printf("tail gain %.2f -> mix gain %.2f: %+.2f dB step at the switch "
+           "(%+.2f dB unscaled)\n",
+           out, in, step, old);
+    CHECK(fabs(step) < 0.01);
+  }
+}
+
+int main(void) {
+  test_curves();
+  test_noise_power();
+  test_edges();
+  test_gain_handover();
+  return TEST_RESULT();
+}
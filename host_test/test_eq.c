@@ -0,0 +1,263 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Subband equalizer (eq.c) in the decoder, bound to MINIMP3_GRANULE_HOOK
+ * as audio_player.c binds it. A synthesized stream is decoded without the
+ * EQ, flat and with the Bass preset, for the cost per frame. Flat must
+ * leave the PCM bit for bit as the decoder made it; a preset change must
+ * ramp across the granule with no step at its edges, in each of the two
+ * decoders of a crossfade; the auto preamp must keep the +8 dB band from
+ * clipping a stream that peaks just under full scale.
+ */
+
+#include "eq.h"
+#include "granule.h"
+#include "host_test.h"
+#include "mp3_synth.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define FRAMES 2000
+#define ROUNDS 25 // modes take turns; the fastest slice counts
+#define SLICE_FRAMES 100
+#define FRAME_SAMPLES 1152
+#define PEAK_DBFS (-1.0f)
+
+typedef enum {
+  HOOK_NONE,
+  HOOK_EQ,
+  HOOK_EQ_NO_PREAMP, // the EQ with its preamp taken back out
+} hook_mode_t;
+
+static hook_mode_t s_mode;
+static eq_stream_t s_stream;
+static float s_drive = 1.0f; // level into the EQ, for a loud stream
+static float s_preamp = 1.0f;
+
+static void granule_hook(float *grbuf, int n, int nch) {
+  if (s_mode == HOOK_NONE) {
+    return;
+  }
+  float drive = s_drive * (s_mode == HOOK_EQ_NO_PREAMP ? s_preamp : 1.0f);
+  if (drive != 1.0f) {
+    for (int i = 0; i < GRANULE_CH_STRIDE * nch; i++) {
+      grbuf[i] *= drive;
+    }
+  }
+  eq_apply(&s_stream, grbuf, n, nch);
+}
+
+#define MINIMP3_IMPLEMENTATION
+#define MINIMP3_ONLY_MP3
+#define MINIMP3_NO_SIMD
+#define MINIMP3_GRANULE_HOOK(grbuf, n, nch) granule_hook(grbuf, n, nch)
+#include "minimp3.h"
+
+static uint8_t *s_mp3;
+static long s_mp3_len;
+static int16_t s_pcm[2][FRAMES * FRAME_SAMPLES * 2];
+
+/* Host cycle counter where there is one, else CPU time in ns */
+static uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static void stream_make(void) {
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  FILE *f = tmpfile();
+  mp3_synth_noise(f, &fmt, 128, FRAMES, 7);
+  s_mp3_len = ftell(f);
+  s_mp3 = malloc(s_mp3_len);
+  rewind(f);
+  CHECK_EQ(fread(s_mp3, 1, s_mp3_len, f), (size_t)s_mp3_len);
+  fclose(f);
+}
+
+/* Decode up to max_frames of the stream into pcm; returns cycles per frame */
+static uint64_t decode(hook_mode_t mode, int16_t *pcm, int *samples,
+                       int max_frames) {
+  static mp3dec_t dec;
+  mp3dec_init(&dec);
+  eq_stream_init(&s_stream);
+  s_mode = mode;
+  int frames = 0;
+  *samples = 0;
+  uint64_t c0 = cycles();
+  for (long off = 0; off < s_mp3_len && frames < max_frames;) {
+    mp3dec_frame_info_t info;
+    int n = mp3dec_decode_frame(&dec, s_mp3 + off, s_mp3_len - off,
+                                pcm + *samples * 2, &info);
+    if (info.frame_bytes == 0) {
+      break;
+    }
+    off += info.frame_bytes;
+    *samples += n;
+    frames += n > 0;
+  }
+  uint64_t spent = cycles() - c0;
+  s_mode = HOOK_NONE;
+  return frames ? spent / frames : 0;
+}
+
+static int peak(const int16_t *pcm, int n, int *clipped) {
+  int p = 0;
+  *clipped = 0;
+  for (int i = 0; i < n; i++) {
+    int a = abs(pcm[i]);
+    p = a > p ? a : p;
+    *clipped += a >= 32767;
+  }
+  return p;
+}
+
+static void test_flat_bit_exact(void) {
+  int n_ref, n_eq;
+  eq_set_preset(EQ_PRESET_FLAT);
+  decode(HOOK_NONE, s_pcm[0], &n_ref, FRAMES);
+  decode(HOOK_EQ, s_pcm[1], &n_eq, FRAMES);
+  CHECK(n_ref > 0);
+  CHECK_EQ(n_eq, n_ref);
+  CHECK(memcmp(s_pcm[0], s_pcm[1], n_ref * 2 * sizeof(int16_t)) == 0);
+  CHECK(!eq_is_active(&s_stream));
+}
+
+/*
+ * A constant granule through two streams, as the decoders of a crossfade
+ * see it: the incoming track's frame, then the outgoing one's. Records the
+ * gain each subband sample got.
+ */
+static void test_ramp(void) {
+  enum { GRANULES = 6, CHANGE = 2 };
+  static float gain[2][EQ_SUBBANDS][GRANULES * 18];
+  eq_stream_t st[2];
+  eq_set_preset(EQ_PRESET_FLAT);
+  eq_stream_init(&st[0]);
+  eq_stream_init(&st[1]);
+  for (int g = 0; g < GRANULES; g++) {
+    if (g == CHANGE) {
+      eq_set_preset(EQ_PRESET_BASS);
+    }
+    for (int s = 0; s < 2; s++) {
+      float grbuf[GRANULE_CH_STRIDE * 2];
+      for (int i = 0; i < GRANULE_CH_STRIDE * 2; i++) {
+        grbuf[i] = 1.0f;
+      }
+      eq_apply(&st[s], grbuf, 18, 2);
+      for (int sb = 0; sb < EQ_SUBBANDS; sb++) {
+        for (int i = 0; i < 18; i++) {
+          int at = sb * GRANULE_SUBBAND_STRIDE + i;
+          gain[s][sb][g * 18 + i] = grbuf[at];
+          CHECK_EQ(grbuf[GRANULE_CH_STRIDE + at], grbuf[at]);
+        }
+      }
+    }
+  }
+
+  // Each stream moves from flat to the preset in steps of 1/18 of the
+  // change, across the granule edges too
+  for (int s = 0; s < 2; s++) {
+    float max_step = 0, max_allowed = 0;
+    for (int sb = 0; sb < EQ_SUBBANDS; sb++) {
+      float to = gain[s][sb][GRANULES * 18 - 1];
+      float allowed = fabsf(1.0f - to) / 18 + 1e-6f;
+      for (int i = 1; i < GRANULES * 18; i++) {
+        float step = fabsf(gain[s][sb][i] - gain[s][sb][i - 1]);
+        CHECK(step <= allowed);
+        max_step = fmaxf(max_step, step);
+      }
+      max_allowed = fmaxf(max_allowed, allowed);
+      CHECK_EQ(gain[s][sb][CHANGE * 18 - 1], 1.0f);
+      CHECK_NEAR(gain[s][sb][(CHANGE + 1) * 18 - 1], to, 1e-6);
+    }
+    printf("preset change in decoder %d: largest gain step %.4f per sample "
+           "(a jump would be %.4f)\n",
+           s, max_step, max_allowed * 18);
+  }
+  // Bass: +8 dB at the bottom over the top, taken off the top by the preamp
+  CHECK_NEAR(gain[0][0][GRANULES * 18 - 1], 1.0, 1e-6);
+  CHECK_NEAR(20 * log10f(gain[0][31][GRANULES * 18 - 1]), -8.0, 1e-3);
+  s_preamp = 1.0f / gain[0][31][GRANULES * 18 - 1];
+}
+
+static void test_preamp(void) {
+  int n, clipped;
+  eq_set_preset(EQ_PRESET_FLAT);
+  decode(HOOK_NONE, s_pcm[0], &n, FRAMES);
+  int p = peak(s_pcm[0], n * 2, &clipped);
+  CHECK(p > 0);
+  if (p == 0) {
+    return;
+  }
+  // Driven to peak just under full scale when flat
+  s_drive = 32767.0f * powf(10.0f, PEAK_DBFS / 20.0f) / p;
+  decode(HOOK_EQ, s_pcm[0], &n, FRAMES);
+  int flat_peak = peak(s_pcm[0], n * 2, &clipped);
+  CHECK_EQ(clipped, 0);
+
+  eq_set_preset(EQ_PRESET_BASS);
+  decode(HOOK_EQ, s_pcm[0], &n, FRAMES);
+  int bass_peak = peak(s_pcm[0], n * 2, &clipped);
+  printf("stream at %.1f dBFS: Bass preset peaks at %.1f dBFS, ",
+         20 * log10f(flat_peak / 32768.0f), 20 * log10f(bass_peak / 32768.0f));
+  CHECK_EQ(clipped, 0);
+  decode(HOOK_EQ_NO_PREAMP, s_pcm[0], &n, FRAMES);
+  peak(s_pcm[0], n * 2, &clipped);
+  printf("%d samples clipped without the preamp\n", clipped);
+  CHECK(clipped > 0);
+  s_drive = 1.0f;
+}
+
+static void test_benchmark(void) {
+  static const struct {
+    const char *name;
+    hook_mode_t mode;
+    eq_preset_t preset;
+  } runs[] = {
+      {"no EQ", HOOK_NONE, EQ_PRESET_FLAT},
+      {"EQ flat", HOOK_EQ, EQ_PRESET_FLAT},
+      {"EQ Bass", HOOK_EQ, EQ_PRESET_BASS},
+  };
+  // Interleaved, so frequency steps and other load hit all three alike
+  uint64_t best[3] = {UINT64_MAX, UINT64_MAX, UINT64_MAX};
+  for (int k = 0; k < ROUNDS; k++) {
+    for (int r = 0; r < 3; r++) {
+      int n;
+      eq_set_preset(runs[r].preset);
+      uint64_t c = decode(runs[r].mode, s_pcm[0], &n, SLICE_FRAMES);
+      best[r] = c < best[r] ? c : best[r];
+    }
+  }
+  for (int r = 0; r < 3; r++) {
+    printf("%-8s %7llu cycles/frame (%+.1f%%)\n", runs[r].name,
+           (unsigned long long)best[r],
+           (best[r] - (double)best[0]) * 100.0 / best[0]);
+  }
+  // 32 x 18 multiplies per channel and granule against a whole decode
+  CHECK(best[2] < best[0] * 1.15);
+}
+
+int main(void) {
+  eq_init();
+  stream_make();
+  test_flat_bit_exact();
+  test_ramp();
+  test_preamp();
+  test_benchmark();
+  free(s_mp3);
+  return TEST_RESULT();
+}
@@ -0,0 +1,230 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Intro cache (intro_cache.c) over a session of track changes on a
+ * playlist of real files. Each start goes through the cache the way
+ * audio_player.c does, and the neighbours are fetched in between unless
+ * the user skips on too quickly. fopen and fread are wrapped at link time
+ * and charged to an SD-over-SPI cost model, which gives the time from a
+ * skip to the first audio bytes; the decode after that is the same either
+ * way. Also checks the LRU order and that a cached start is byte for byte
+ * the file's.
+ */
+
+#include "host_test.h"
+#include "intro_cache.h"
+#include "mp3_synth.h"
+#include "resume.h"
+#include "sd_card.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TRACKS 12
+#define TRACK_FRAMES 200
+#define INPUT_BYTES 4096 // INPUT_BUF_SIZE in audio_player.c
+#define CHANGES 1000
+
+// SD card over SPI, roughly as the ESP32 sees it
+#define SD_OPEN_US 12000 // FAT directory lookup and cluster chain
+#define SD_READ_US 1500  // command and sector latency per read call
+#define SD_BYTE_NS 800   // ~1.2 MB/s
+
+static uint32_t s_rng = 0xbb67ae85;
+
+static uint32_t rnd(uint32_t n) {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng % n;
+}
+
+/* The SD card as the wrapped stdio calls see it */
+static bool s_metering;
+static int64_t s_sd_us;
+
+FILE *__real_fopen(const char *path, const char *mode);
+size_t __real_fread(void *ptr, size_t size, size_t n, FILE *f);
+
+FILE *__wrap_fopen(const char *path, const char *mode) {
+  if (s_metering) {
+    s_sd_us += SD_OPEN_US;
+  }
+  return __real_fopen(path, mode);
+}
+
+size_t __wrap_fread(void *ptr, size_t size, size_t n, FILE *f) {
+  size_t got = __real_fread(ptr, size, n, f);
+  if (s_metering) {
+    s_sd_us += SD_READ_US + (int64_t)got * size * SD_BYTE_NS / 1000;
+  }
+  return got;
+}
+
+/* The playlist: files with tags of different sizes (cover art) */
+static char s_dir[] = "/tmp/intro_cache_XXXXXX";
+static char s_paths[TRACKS][64];
+static uint32_t s_tag_bytes[TRACKS];
+
+int sd_card_get_playlist_count(void) { return TRACKS; }
+
+const char *sd_card_get_file_path(int index) {
+  return index >= 0 && index < TRACKS ? s_paths[index] : NULL;
+}
+
+static void playlist_make(void) {
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  CHECK(mkdtemp(s_dir) != NULL);
+  for (int i = 0; i < TRACKS; i++) {
+    snprintf(s_paths[i], sizeof(s_paths[i]), "%s/%02d.mp3", s_dir, i);
+    FILE *f = fopen(s_paths[i], "wb");
+    s_tag_bytes[i] = mp3_synth_id3v2(f, 1000 + rnd(60 * 1024), NULL, 0);
+    mp3_synth_noise(f, &fmt, 128, TRACK_FRAMES, i + 1);
+    fclose(f);
+  }
+}
+
+static void playlist_remove(void) {
+  for (int i = 0; i < TRACKS; i++) {
+    remove(s_paths[i]);
+  }
+  rmdir(s_dir);
+}
+
+/* The start of the audio must be the file's, however it was got */
+static bool intro_matches(int idx, const mp3_info_t *info, const uint8_t *buf,
+                          int len) {
+  uint8_t want[INPUT_BYTES];
+  FILE *f = fopen(s_paths[idx], "rb");
+  fseek(f, s_tag_bytes[idx], SEEK_SET);
+  int n = fread(want, 1, len, f);
+  fclose(f);
+  return info->data_offset == s_tag_bytes[idx] && n == len &&
+         memcmp(want, buf, len) == 0;
+}
+
+/* A track start as the decode task does it, to the first audio bytes */
+static int64_t start_track(int idx, bool *hit) {
+  mp3_info_t info;
+  uint8_t buf[INPUT_BYTES];
+  int len = 0;
+  uint32_t path_hash = resume_path_hash(s_paths[idx]);
+  intro_cache_hint(idx);
+  s_sd_us = 0;
+  s_metering = true;
+  *hit = intro_cache_take(path_hash, &info, buf, &len);
+  if (!*hit) {
+    FILE *f = fopen(s_paths[idx], "rb");
+    mp3_info_read(f, &info);
+    len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+  }
+  s_metering = false;
+  CHECK(intro_matches(idx, &info, buf, len));
+  if (!*hit) {
+    intro_cache_store(path_hash, &info, buf, len);
+  }
+  return s_sd_us;
+}
+
+static void test_lru(void) {
+  mp3_info_t info = {.data_offset = 10};
+  uint8_t buf[INPUT_BYTES];
+  int len;
+  for (int i = 0; i < INPUT_BYTES; i++) {
+    buf[i] = i * 7;
+  }
+  // Storing a cached track again takes no second slot
+  intro_cache_store(1, &info, buf, 100);
+  intro_cache_store(1, &info, buf, 100);
+  intro_cache_store(2, &info, buf, 200);
+  intro_cache_store(3, &info, buf, INPUT_BYTES);
+  intro_cache_store(4, &info, buf, 400);
+  CHECK(intro_cache_take(1, &info, buf, &len)); // 1 is now the newest
+  CHECK_EQ(len, 100);
+  intro_cache_store(5, &info, buf, 500);
+  CHECK(!intro_cache_take(2, &info, buf, &len)); // the oldest went
+  memset(buf, 0, sizeof(buf));
+  CHECK(intro_cache_take(3, &info, buf, &len));
+  CHECK_EQ(len, INPUT_BYTES);
+  CHECK_EQ(info.data_offset, 10);
+  CHECK_EQ(buf[INPUT_BYTES - 1], (uint8_t)((INPUT_BYTES - 1) * 7));
+  for (int h = 1; h <= 5; h++) {
+    CHECK_EQ(intro_cache_take(h, &info, buf, &len), h != 2);
+  }
+}
+
+static void test_session(void) {
+  uint32_t hits0, lookups0;
+  intro_cache_stats(&hits0, &lookups0);
+  int cur = 0, recent[3] = {0, 0, 0};
+  int hits = 0, after_fetch = 0, after_fetch_hits = 0;
+  int64_t hit_us = 0, miss_us = 0, max_hit_us = 0;
+  bool fetched = false;
+  for (int c = 0; c < CHANGES; c++) {
+    // Next, previous, one played a moment ago, or anything
+    int r = rnd(100), next;
+    if (r < 50) {
+      next = (cur + 1) % TRACKS;
+    } else if (r < 65) {
+      next = (cur - 1 + TRACKS) % TRACKS;
+    } else if (r < 80) {
+      next = recent[rnd(3)];
+    } else {
+      next = rnd(TRACKS);
+    }
+    bool neighbour = next == (cur + 1) % TRACKS ||
+                     next == (cur - 1 + TRACKS) % TRACKS;
+
+    bool hit;
+    int64_t us = start_track(next, &hit);
+    hits += hit;
+    if (hit) {
+      hit_us += us;
+      max_hit_us = us > max_hit_us ? us : max_hit_us;
+    } else {
+      miss_us += us;
+    }
+    if (fetched && neighbour) {
+      after_fetch++;
+      after_fetch_hits += hit;
+    }
+    recent[c % 3] = cur = next;
+
+    // The idle task gets its turn unless the next skip comes first
+    fetched = rnd(4) != 0;
+    if (fetched) {
+      intro_cache_fetch();
+    }
+  }
+
+  int misses = CHANGES - hits;
+  printf("%d track changes: %d%% intro cache hits; skip to first audio "
+         "%lld ms on a hit, %lld ms on a miss, %lld ms on average\n",
+         CHANGES, hits * 100 / CHANGES,
+         (long long)(hits ? hit_us / hits / 1000 : 0),
+         (long long)(misses ? miss_us / misses / 1000 : 0),
+         (long long)((hit_us + miss_us) / CHANGES / 1000));
+  // A fetched neighbour is always there; a hit never touches the card
+  CHECK(after_fetch > CHANGES / 3);
+  CHECK_EQ(after_fetch_hits, after_fetch);
+  CHECK_EQ(max_hit_us, 0);
+  CHECK(misses > 0 && miss_us / misses > SD_OPEN_US);
+
+  uint32_t h, l;
+  intro_cache_stats(&h, &l);
+  CHECK_EQ(h - hits0, hits);
+  CHECK_EQ(l - lookups0, CHANGES);
+}
+
+int main(void) {
+  playlist_make();
+  test_lru();
+  test_session();
+  playlist_remove();
+  return TEST_RESULT();
+}
@@ -0,0 +1,338 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Loudness index (loudness.c). The tag parser reads ReplayGain from ID3v2
+ * TXXX frames in each text encoding and from the LAME tag of the Info
+ * frame. The R128 meter is fed the EBU Tech 3341 sine cases, whose
+ * integrated loudness is known, at 48 and 44.1 kHz. loudness.c is included
+ * so the test can run the background task itself over a playlist of real
+ * files: the sampled scan must land near a full measure of the same track,
+ * and the task must leave the stack report before it deletes itself.
+ */
+
+#define MINIMP3_IMPLEMENTATION
+#define MINIMP3_ONLY_MP3
+#define MINIMP3_NO_SIMD
+#include "loudness.c"
+#include "host_stubs.h"
+#include "host_test.h"
+#include "mp3_synth.h"
+#include <unistd.h>
+
+// Tech 3341 allows 0.1 LU; the histogram bins add up to half of 0.25 LU
+#define METER_TOL 0.2f
+#define SCAN_TOL 1.0f // a quarter of the track against all of it
+#define TRACK_FRAMES 800
+#define TXXX_MAX 128
+#define LAME_TAG_BYTES 19 // encoder string up to the radio gain
+
+enum {
+  TRACK_ID3_UTF16,
+  TRACK_ID3_UTF8,
+  TRACK_LAME,
+  TRACK_BOTH,
+  TRACK_NOISE, // no tags: scanned
+  TRACKS,
+};
+
+/* The playlist */
+static char s_dir[] = "/tmp/loudness_XXXXXX";
+static char s_paths[TRACKS][64];
+
+int sd_card_get_playlist_count(void) { return TRACKS; }
+
+const char *sd_card_get_file_path(int index) {
+  return index >= 0 && index < TRACKS ? s_paths[index] : NULL;
+}
+
+/* Playback never underruns here */
+void audio_player_get_buffer_metrics(audio_buffer_metrics_t *metrics) {
+  memset(metrics, 0, sizeof(*metrics));
+}
+
+/* Text in a TXXX encoding: 0/3 as is, 1 as UTF-16LE with a BOM */
+static size_t txxx_text(uint8_t *out, uint8_t enc, const char *s) {
+  size_t n = 0;
+  if (enc == 1) {
+    out[n++] = 0xFF;
+    out[n++] = 0xFE;
+  }
+  for (size_t i = 0; i <= strlen(s); i++) { // with the terminator
+    out[n++] = s[i];
+    if (enc == 1) {
+      out[n++] = 0;
+    }
+  }
+  return n;
+}
+
+/* A TXXX frame, size syncsafe as v2.4 has it */
+static size_t txxx(uint8_t *out, uint8_t enc, const char *desc,
+                   const char *value) {
+  size_t n = 10;
+  out[n++] = enc;
+  n += txxx_text(out + n, enc, desc);
+  n += txxx_text(out + n, enc, value) - (enc == 1 ? 2 : 1);
+  uint32_t body = n - 10;
+  memcpy(out, "TXXX", 4);
+  for (int i = 0; i < 4; i++) {
+    out[4 + i] = (body >> (21 - 7 * i)) & 0x7F;
+  }
+  out[8] = out[9] = 0;
+  return n;
+}
+
+/* LAME tag up to the radio gain: peak 1.0 = 1 << 23, gain in 0.1 dB */
+static void lame_tag(uint8_t p[LAME_TAG_BYTES], uint32_t peak,
+                     int gain_01db) {
+  memset(p, 0, LAME_TAG_BYTES);
+  memcpy(p, "LAME3.100", 9);
+  p[11] = peak >> 24;
+  p[12] = peak >> 16;
+  p[13] = peak >> 8;
+  p[14] = peak;
+  // name 1 (radio), originator 3 (set automatically), sign, magnitude
+  uint16_t radio = (1 << 13) | (3 << 10) | (gain_01db < 0 ? 0x200 : 0) |
+                   (abs(gain_01db) & 0x1FF);
+  p[15] = radio >> 8;
+  p[16] = radio;
+}
+
+static void track_make(int idx) {
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  uint8_t frames[4 * TXXX_MAX], lame[LAME_TAG_BYTES];
+  size_t n = 0;
+  snprintf(s_paths[idx], sizeof(s_paths[idx]), "%s/%d.mp3", s_dir, idx);
+  FILE *f = fopen(s_paths[idx], "wb");
+  switch (idx) {
+  case TRACK_ID3_UTF16:
+    n += txxx(frames + n, 1, "REPLAYGAIN_TRACK_GAIN", "-7.25 dB");
+    n += txxx(frames + n, 1, "REPLAYGAIN_TRACK_PEAK", "0.988");
+    mp3_synth_id3v2(f, 512, frames, n);
+    break;
+  case TRACK_ID3_UTF8:
+    // foobar2000 writes the names in lower case; Latin-1 and UTF-8 mixed
+    n += txxx(frames + n, 0, "replaygain_track_peak", "1.021");
+    n += txxx(frames + n, 3, "replaygain_track_gain", "+3.10 dB");
+    mp3_synth_id3v2(f, 512, frames, n);
+    break;
+  case TRACK_LAME:
+    lame_tag(lame, 1 << 22, -63);
+    mp3_synth_xing(f, &fmt, "Info", TRACK_FRAMES, 0, lame, sizeof(lame));
+    break;
+  case TRACK_BOTH:
+    // The tag's gain wins; with no peak in it, the LAME one is used
+    n += txxx(frames + n, 3, "REPLAYGAIN_TRACK_GAIN", "-2.00 dB");
+    mp3_synth_id3v2(f, 512, frames, n);
+    lame_tag(lame, 3 << 21, 50);
+    mp3_synth_xing(f, &fmt, "Info", TRACK_FRAMES, 0, lame, sizeof(lame));
+    break;
+  }
+  mp3_synth_noise(f, &fmt, 128, TRACK_FRAMES, idx + 1);
+  fclose(f);
+}
+
+static void playlist_make(void) {
+  CHECK(mkdtemp(s_dir) != NULL);
+  for (int i = 0; i < TRACKS; i++) {
+    track_make(i);
+  }
+}
+
+static void playlist_remove(void) {
+  for (int i = 0; i < TRACKS; i++) {
+    remove(s_paths[i]);
+  }
+  rmdir(s_dir);
+}
+
+static mp3_gain_src_t read_gain(int idx, float *gain_db, float *peak) {
+  mp3_info_t info;
+  FILE *f = fopen(s_paths[idx], "rb");
+  mp3_gain_src_t src = MP3_GAIN_SRC_NONE;
+  *gain_db = *peak = 0.0f;
+  if (mp3_info_read(f, &info)) {
+    src = mp3_replaygain_read(f, &info, gain_db, peak);
+  }
+  fclose(f);
+  return src;
+}
+
+static void test_tags(void) {
+  static const struct {
+    mp3_gain_src_t src;
+    float gain_db, peak;
+  } want[TRACKS] = {
+      [TRACK_ID3_UTF16] = {MP3_GAIN_SRC_ID3, -7.25f, 0.988f},
+      [TRACK_ID3_UTF8] = {MP3_GAIN_SRC_ID3, 3.10f, 1.021f},
+      [TRACK_LAME] = {MP3_GAIN_SRC_LAME, -6.3f, 0.5f},
+      [TRACK_BOTH] = {MP3_GAIN_SRC_ID3, -2.0f, 0.75f},
+      [TRACK_NOISE] = {MP3_GAIN_SRC_NONE, 0.0f, 0.0f},
+  };
+  for (int i = 0; i < TRACKS; i++) {
+    float gain_db, peak;
+    CHECK_EQ(read_gain(i, &gain_db, &peak), want[i].src);
+    CHECK_NEAR(gain_db, want[i].gain_db, 1e-4);
+    CHECK_NEAR(peak, want[i].peak, 1e-4);
+  }
+}
+
+/* One section of a test signal: a 1 kHz sine at this level per channel */
+typedef struct {
+  float dbfs;
+  float sec;
+} tone_t;
+
+static float meter(uint32_t hz, int channels, const tone_t *parts, int n,
+                   float *peak) {
+  static scan_ctx_t c;
+  memset(&c, 0, sizeof(c));
+  c.sub_len = hz / 10;
+  k_filter_design(hz, c.k);
+  const int frame = 1152;
+  uint64_t t = 0;
+  for (int p = 0; p < n; p++) {
+    float amp = 32767.0f * powf(10.0f, parts[p].dbfs / 20.0f);
+    uint32_t len = (uint32_t)(parts[p].sec * hz);
+    for (uint32_t done = 0; done < len; done += frame) {
+      int samples = len - done < frame ? len - done : frame;
+      for (int i = 0; i < samples; i++, t++) {
+        int16_t v = (int16_t)lrintf(amp * sinf(2 * M_PI * 1000.0 * t / hz));
+        for (int ch = 0; ch < channels; ch++) {
+          c.pcm[i * channels + ch] = v;
+        }
+      }
+      scan_pcm(&c, samples, channels);
+    }
+  }
+  float lufs = -INFINITY;
+  CHECK(scan_integrate(&c, &lufs));
+  *peak = c.peak / 32768.0f;
+  return lufs;
+}
+
+static void test_meter(void) {
+  // EBU Tech 3341 cases 1 to 4 (stereo), and a mono sine
+  static const tone_t case1[] = {{-23, 20}};
+  static const tone_t case2[] = {{-33, 20}};
+  static const tone_t case3[] = {{-36, 10}, {-23, 60}, {-36, 10}};
+  static const tone_t case4[] = {{-72, 10}, {-36, 10}, {-23, 60}, {-36, 10},
+                                 {-72, 10}};
+  static const tone_t mono[] = {{-20, 20}};
+  static const struct {
+    const char *name;
+    const tone_t *parts;
+    int n;
+    int channels;
+    float lufs, peak;
+  } cases[] = {
+      {"3341 case 1", case1, 1, 2, -23.0f, 0.0708f},
+      {"3341 case 2", case2, 1, 2, -33.0f, 0.0224f},
+      {"3341 case 3 (relative gate)", case3, 3, 2, -23.0f, 0.0708f},
+      {"3341 case 4 (both gates)", case4, 5, 2, -23.0f, 0.0708f},
+      {"mono -20 dBFS", mono, 1, 1, -23.0f, 0.1f},
+  };
+  static const uint32_t rates[] = {48000, 44100};
+  for (size_t r = 0; r < 2; r++) {
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+      float peak;
+      float lufs = meter(rates[r], cases[i].channels, cases[i].parts,
+                         cases[i].n, &peak);
+      printf("%s at %" PRIu32 " Hz: %.2f LUFS (want %.1f), peak %.4f\n",
+             cases[i].name, rates[r], lufs, cases[i].lufs, peak);
+      CHECK_NEAR(lufs, cases[i].lufs, METER_TOL);
+      CHECK_NEAR(peak, cases[i].peak, 1e-3);
+    }
+  }
+}
+
+/* Decode the whole track and meter every frame, for the scan to match */
+static float full_measure(int idx) {
+  static scan_ctx_t c;
+  static uint8_t file[TRACK_FRAMES * 512];
+  memset(&c, 0, sizeof(c));
+  mp3dec_init(&c.dec);
+  FILE *f = fopen(s_paths[idx], "rb");
+  int len = fread(file, 1, sizeof(file), f);
+  fclose(f);
+  int off = 0;
+  for (;;) {
+    mp3dec_frame_info_t fi;
+    int samples = mp3dec_decode_frame(&c.dec, file + off, len - off, c.pcm,
+                                      &fi);
+    if (fi.frame_bytes == 0) {
+      break;
+    }
+    off += fi.frame_bytes;
+    if (samples > 0) {
+      if (c.sub_len == 0) {
+        c.sub_len = fi.hz / 10;
+        k_filter_design(fi.hz, c.k);
+      }
+      scan_pcm(&c, samples, fi.channels);
+    }
+  }
+  float lufs = -INFINITY;
+  CHECK(scan_integrate(&c, &lufs));
+  return lufs;
+}
+
+static void test_task(void) {
+  loudness_init(TRACK_LAME); // the player was on this one
+  TaskHandle_t task = host_stub_find_task("loudness");
+  CHECK(task != NULL);
+  if (!task) {
+    return;
+  }
+  host_stub_set_high_water(task, 4 * 1024);
+  host_stub_set_current_task(task);
+  loudness_task(NULL);
+  host_stub_set_current_task(NULL);
+
+  // Every track indexed, each from the right source
+  static const uint8_t want_src[TRACKS] = {
+      [TRACK_ID3_UTF16] = LOUDNESS_SRC_ID3, [TRACK_ID3_UTF8] = LOUDNESS_SRC_ID3,
+      [TRACK_LAME] = LOUDNESS_SRC_LAME,     [TRACK_BOTH] = LOUDNESS_SRC_ID3,
+      [TRACK_NOISE] = LOUDNESS_SRC_SCAN,
+  };
+  CHECK_EQ(s_index_cnt, TRACKS);
+  for (int i = 0; i < TRACKS; i++) {
+    portENTER_CRITICAL(&s_index_lock);
+    loudness_entry_t *e = index_find(resume_path_hash(s_paths[i]));
+    CHECK(e != NULL);
+    CHECK_EQ(e ? e->src : LOUDNESS_SRC_NONE, want_src[i]);
+    portEXIT_CRITICAL(&s_index_lock);
+  }
+  float g = loudness_track_gain(resume_path_hash(s_paths[TRACK_ID3_UTF16]));
+  CHECK_NEAR(g, powf(10.0f, -7.25f / 20.0f), 1e-3);
+  g = loudness_track_gain(resume_path_hash(s_paths[TRACK_LAME]));
+  CHECK_NEAR(g, powf(10.0f, -6.3f / 20.0f), 1e-3);
+
+  // The sampled scan against all of the track
+  float full = full_measure(TRACK_NOISE);
+  portENTER_CRITICAL(&s_index_lock);
+  float scanned =
+      LOUDNESS_TARGET_LUFS -
+      index_find(resume_path_hash(s_paths[TRACK_NOISE]))->gain_cdb / 100.0f;
+  portEXIT_CRITICAL(&s_index_lock);
+  printf("noise track: %.2f LUFS scanned, %.2f LUFS measured in full\n",
+         scanned, full);
+  CHECK_NEAR(scanned, full, SCAN_TOL);
+
+  // Gone, and out of the stack report (which would read a freed TCB)
+  CHECK(host_stub_task_deleted(task));
+  mem_budget_report();
+}
+
+int main(void) {
+  playlist_make();
+  test_tags();
+  test_meter();
+  test_task();
+  playlist_remove();
+  return TEST_RESULT();
+}
@@ -0,0 +1,336 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Track-change soak. The real per-track path runs a thousand times over a
+ * playlist of real files: track info, the intro cache, a few frames
+ * through the decoder, the loudness index and the resume point, with
+ * malloc/calloc/realloc/free wrapped at link time. The heap must end where
+ * it started, and mem_budget_checkpoint() fed the live bytes must stay
+ * quiet. loudness.c is included for its index update.
+ *
+ * Then the trend detector on its own: free heap at each track change as a
+ * steady level minus fragmentation noise. A thousand changes of noise
+ * alone, and a one-off dip, must not warn; a small leak per track must.
+ * Also checks that a task untracked before deletion drops out of the
+ * stack report.
+ */
+
+#define MINIMP3_IMPLEMENTATION
+#define MINIMP3_ONLY_MP3
+#define MINIMP3_NO_SIMD
+#include "loudness.c"
+#include "host_stubs.h"
+#include "host_test.h"
+#include "intro_cache.h"
+#include "mem_budget.h"
+#include "mp3_synth.h"
+#include "player_status.h"
+#include <malloc.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define SOAK_TRACKS 1000
+#define FREE_STEADY (120 * 1024)
+#define NOISE_BYTES 1536 // free heap wanders this far below steady
+#define LEAK_BYTES 64    // per track change
+#define PLAYLIST 10
+#define TRACK_FRAMES 100
+#define INPUT_BYTES 4096 // INPUT_BUF_SIZE in audio_player.c
+
+static uint32_t s_rng = 0x9e3779b9;
+
+static uint32_t rnd(uint32_t n) {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng % n;
+}
+
+static mem_budget_trend_t trend(void) {
+  mem_budget_trend_t t;
+  mem_budget_get_trend(&t);
+  return t;
+}
+
+/* The heap as the wrapped calls see it */
+static int64_t s_heap_calls;
+static int64_t s_live_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+void *__wrap_malloc(size_t size) {
+  void *p = __real_malloc(size);
+  s_heap_calls++;
+  s_live_bytes += p ? malloc_usable_size(p) : 0;
+  return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  void *p = __real_calloc(n, size);
+  s_heap_calls++;
+  s_live_bytes += p ? malloc_usable_size(p) : 0;
+  return p;
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+  size_t was = p ? malloc_usable_size(p) : 0;
+  void *q = __real_realloc(p, size);
+  s_heap_calls++;
+  if (q || size == 0) {
+    s_live_bytes += (q ? malloc_usable_size(q) : 0) - (int64_t)was;
+  }
+  return q;
+}
+
+void __wrap_free(void *p) {
+  if (p) {
+    s_heap_calls++;
+    s_live_bytes -= malloc_usable_size(p);
+  }
+  __real_free(p);
+}
+
+/* The playlist: tagged, LAME and untagged files */
+static char s_dir[] = "/tmp/mem_budget_XXXXXX";
+static char s_paths[PLAYLIST][64];
+
+int sd_card_get_playlist_count(void) { return PLAYLIST; }
+
+const char *sd_card_get_file_path(int index) {
+  return index >= 0 && index < PLAYLIST ? s_paths[index] : NULL;
+}
+
+void audio_player_get_buffer_metrics(audio_buffer_metrics_t *metrics) {
+  memset(metrics, 0, sizeof(*metrics));
+}
+
+/* A new file in place of track i (the card was swapped meanwhile) */
+static void track_write(int i) {
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  uint32_t frames = TRACK_FRAMES + rnd(TRACK_FRAMES);
+  FILE *f = fopen(s_paths[i], "wb");
+  if (i % 3 == 0) {
+    mp3_synth_id3v2(f, 1000 + rnd(8 * 1024), NULL, 0);
+  } else if (i % 3 == 1) {
+    mp3_synth_xing(f, &fmt, "Info", frames, 0, NULL, 0);
+  }
+  mp3_synth_noise(f, &fmt, 128, frames, rnd(1000));
+  fclose(f);
+}
+
+static void playlist_make(void) {
+  CHECK(mkdtemp(s_dir) != NULL);
+  for (int i = 0; i < PLAYLIST; i++) {
+    snprintf(s_paths[i], sizeof(s_paths[i]), "%s/%02d.mp3", s_dir, i);
+    track_write(i);
+  }
+}
+
+static void playlist_remove(void) {
+  for (int i = 0; i < PLAYLIST; i++) {
+    remove(s_paths[i]);
+  }
+  rmdir(s_dir);
+}
+
+static int s_reindexed;
+
+/* A track start and a few frames of it, as the decode task does them */
+static void play_track(int idx) {
+  static mp3dec_t dec;
+  static uint8_t buf[INPUT_BYTES];
+  static int16_t pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+  static resume_marks_t marks;
+  const char *path = sd_card_get_file_path(idx);
+  uint32_t path_hash = resume_path_hash(path);
+  player_status_set_track(idx);
+  intro_cache_hint(idx);
+  loudness_track_gain(path_hash);
+
+  mp3_info_t info;
+  int len = 0;
+  FILE *f = NULL;
+  if (!intro_cache_take(path_hash, &info, buf, &len)) {
+    f = fopen(path, "rb");
+    mp3_info_read(f, &info);
+    len = fread(buf, 1, sizeof(buf), f);
+    intro_cache_store(path_hash, &info, buf, len);
+  }
+
+  mp3dec_init(&dec);
+  marks.cnt = 0;
+  uint32_t off = info.data_offset;
+  uint64_t sample = 0;
+  for (int at = 0; at < len;) {
+    mp3dec_frame_info_t fi;
+    int n = mp3dec_decode_frame(&dec, buf + at, len - at, pcm, &fi);
+    if (fi.frame_bytes == 0) {
+      break;
+    }
+    resume_mark(&marks, off + at, sample, -1);
+    at += fi.frame_bytes;
+    sample += n;
+  }
+  resume_point_t pt;
+  if (resume_point_pick(&marks, path_hash, sample, &pt)) {
+    resume_save(&pt, true);
+  }
+
+  // The loudness pass indexing a changed track, as loudness_task() does
+  if (!f) {
+    f = fopen(path, "rb");
+  }
+  fseek(f, 0, SEEK_END);
+  loudness_entry_t e = {.path_hash = path_hash, .file_size = ftell(f)};
+  if (!index_has(e.path_hash, e.file_size)) {
+    float gain_db = 0.0f, peak = 0.0f;
+    if (mp3_info_read(f, &info)) {
+      e.src = mp3_replaygain_read(f, &info, &gain_db, &peak);
+    }
+    e.gain_cdb = (int16_t)lroundf(gain_db * 100.0f);
+    index_put(&e);
+    index_save();
+    s_reindexed++;
+  }
+  fclose(f);
+
+  host_stub_advance_us(rnd(8000) * 1000ULL); // listened for a while
+  if (rnd(4) != 0) {
+    intro_cache_fetch(); // the idle task got its turn
+  }
+}
+
+static void test_track_change_soak(void) {
+  playlist_make();
+  // Boot: what is allocated once stays out of the count
+  intro_cache_init();
+  loudness_init(0);
+  TaskHandle_t task = host_stub_find_task("loudness");
+  host_stub_set_current_task(task);
+  loudness_task(NULL);
+  host_stub_set_current_task(NULL);
+  play_track(0);
+
+  int64_t live0 = s_live_bytes, calls0 = s_heap_calls;
+  int64_t max_live = live0;
+  uint32_t warnings0 = trend().warnings;
+  int idx = 0;
+  s_reindexed = 0;
+  for (int i = 0; i < SOAK_TRACKS; i++) {
+    if (i % 50 == 49) {
+      track_write(rnd(PLAYLIST));
+    }
+    idx = rnd(3) ? (idx + 1) % PLAYLIST : (int)rnd(PLAYLIST);
+    play_track(idx);
+    max_live = s_live_bytes > max_live ? s_live_bytes : max_live;
+    host_stub_set_free_heap(FREE_STEADY - (s_live_bytes - live0));
+    mem_budget_checkpoint("track change");
+  }
+  printf("%d real track changes (%d loudness index updates): %lld heap "
+         "calls, net %lld B, at most %lld B held\n",
+         SOAK_TRACKS, s_reindexed, (long long)(s_heap_calls - calls0),
+         (long long)(s_live_bytes - live0), (long long)(max_live - live0));
+  CHECK(calls0 > 0); // the scan buffer at boot: the wraps see the heap
+  CHECK(s_reindexed > 0);
+  CHECK_EQ(s_live_bytes, live0);
+  CHECK_EQ(trend().warnings, warnings0);
+  playlist_remove();
+}
+
+/* One track change with this much held on top of the noise */
+static size_t track_change(size_t held) {
+  size_t free_now = FREE_STEADY - held - rnd(NOISE_BYTES);
+  host_stub_set_free_heap(free_now);
+  mem_budget_checkpoint("track change");
+  return free_now;
+}
+
+static void test_noise_is_quiet(void) {
+  // The old check warned whenever free heap fell below the first figure
+  size_t first = 0;
+  int below_first = 0;
+  for (int i = 0; i < SOAK_TRACKS; i++) {
+    size_t free_now = track_change(0);
+    if (i == 0) {
+      first = free_now;
+    } else if (free_now < first) {
+      below_first++;
+    }
+  }
+  printf("%d track changes of noise: %d below the first figure, "
+         "%u trend warnings\n",
+         SOAK_TRACKS, below_first, (unsigned)trend().warnings);
+  CHECK(below_first > 0);
+  CHECK_EQ(trend().checkpoints, SOAK_TRACKS);
+  CHECK_EQ(trend().warnings, 0);
+  CHECK(trend().floor_free >= FREE_STEADY - NOISE_BYTES);
+}
+
+static void test_one_off_dip_is_quiet(void) {
+  // A window's worth of tracks holding 6 KB more, then back to normal
+  for (int i = 0; i < MEM_TREND_WINDOW; i++) {
+    track_change(6 * 1024);
+  }
+  for (int i = 0; i < 4 * MEM_TREND_WINDOW; i++) {
+    track_change(0);
+  }
+  CHECK_EQ(trend().warnings, 0);
+  CHECK_EQ(trend().falling, 0);
+}
+
+static void test_leak_warns(void) {
+  int first_warning = -1;
+  uint32_t before = trend().warnings;
+  for (int i = 0; i < SOAK_TRACKS; i++) {
+    track_change(i * LEAK_BYTES);
+    if (first_warning < 0 && trend().warnings > before) {
+      first_warning = i;
+    }
+  }
+  printf("%d B per track leak: first warning after %d track changes, "
+         "%u in all\n",
+         LEAK_BYTES, first_warning, (unsigned)trend().warnings);
+  CHECK(first_warning > 0);
+  CHECK(first_warning * LEAK_BYTES < 4 * MEM_TREND_TOL_BYTES);
+  // It keeps warning as the leak goes on, once per step below the floor
+  CHECK(trend().warnings >=
+        SOAK_TRACKS * LEAK_BYTES / (4 * MEM_TREND_TOL_BYTES));
+}
+
+static void test_untrack_deleted_task(void) {
+  TaskHandle_t tasks[MEM_BUDGET_MAX_TASKS];
+  char name[16];
+  for (int i = 0; i < MEM_BUDGET_MAX_TASKS; i++) {
+    snprintf(name, sizeof(name), "task%d", i);
+    tasks[i] = mem_task_create(NULL, name, 2048, NULL, 1, NULL, NULL);
+    CHECK(tasks[i] != NULL);
+  }
+  // The stub aborts if the report reads a deleted task's stack
+  mem_budget_untrack_task(tasks[3]);
+  vTaskDelete(tasks[3]);
+  mem_budget_report();
+
+  // The freed slot takes the next task
+  TaskHandle_t late = mem_task_create(NULL, "late", 2048, NULL, 1, NULL, NULL);
+  mem_budget_untrack_task(tasks[0]);
+  vTaskDelete(tasks[0]);
+  mem_budget_untrack_task(late);
+  vTaskDelete(late);
+  mem_budget_report();
+}
+
+int main(void) {
+  test_noise_is_quiet();
+  test_one_off_dip_is_quiet();
+  test_leak_warns();
+  test_untrack_deleted_task();
+  test_track_change_soak();
+  return TEST_RESULT();
+}
@@ -0,0 +1,294 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Track length from the first frame (mp3_info.c) on synthetic streams:
+ * Xing/Info and VBRI frame counts, the CBR byte estimate, tags and junk in
+ * front of the audio. Then a 10-minute VBR track and the head of the next
+ * one play through the playback clock (play_clock.c) with a ring buffer in
+ * between; the position must stay within 30 ms of the sample being heard.
+ */
+
+#include "host_test.h"
+#include "mp3_info.h"
+#include "mp3_synth.h"
+#include "play_clock.h"
+#include <string.h>
+
+#define TEN_MIN_FRAMES 22969 // 600 s of 1152-sample frames at 44.1 kHz
+#define FRAME_MS(fmt) (mp3_synth_frame_samples(fmt) * 1000 / (fmt)->hz)
+#define POS_TOL_MS 30
+#define RING_BYTES (32 * 1024)
+#define CB_BYTES 512
+
+static uint32_t s_rng = 0x2545f491;
+
+static uint32_t rnd(uint32_t n) {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng % n;
+}
+
+static uint32_t frames_ms(const mp3_synth_fmt_t *fmt, uint32_t frames) {
+  return (uint64_t)frames * mp3_synth_frame_samples(fmt) * 1000 / fmt->hz;
+}
+
+/* 10 minutes of 32-128 kbit/s frames, with a Xing header if asked */
+static FILE *ten_minute_vbr(bool xing, uint32_t *audio_bytes) {
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  static const uint16_t kbps[] = {32, 48, 64, 80, 96, 112, 128};
+  FILE *f = tmpfile();
+  uint32_t bytes = 0;
+  if (xing) {
+    // The Xing frame is silent and counts as a frame
+    bytes += mp3_synth_xing(f, &fmt, "Xing", TEN_MIN_FRAMES, 0, NULL, 0);
+  }
+  for (int i = xing; i < TEN_MIN_FRAMES; i++) {
+    bytes += mp3_synth_frame(f, &fmt, kbps[rnd(7)], false);
+  }
+  if (xing) {
+    // Byte count is written like an encoder does, after the fact
+    uint8_t be[4] = {bytes >> 24, bytes >> 16, bytes >> 8, bytes};
+    fseek(f, 4 + 32 + 12, SEEK_SET);
+    fwrite(be, 1, 4, f);
+  }
+  *audio_bytes = bytes;
+  return f;
+}
+
+static void test_cbr(void) {
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  FILE *f = tmpfile();
+  uint32_t tag = mp3_synth_id3v2(f, 4096, NULL, 0);
+  uint32_t bytes = mp3_synth_cbr(f, &fmt, 128, 2000);
+  mp3_synth_id3v1(f);
+
+  mp3_info_t info;
+  CHECK(mp3_info_read(f, &info));
+  CHECK_EQ(info.src, MP3_INFO_SRC_CBR);
+  CHECK_EQ(info.data_offset, tag);
+  CHECK_EQ(info.audio_bytes, bytes); // without the ID3v1 tag
+  CHECK_EQ(info.first.hz, 44100);
+  CHECK_EQ(info.first.bitrate_kbps, 128);
+  CHECK_EQ(info.first.channels, 2);
+  CHECK_EQ(info.total_frames, 0);
+  CHECK_NEAR(info.duration_ms, frames_ms(&fmt, 2000), FRAME_MS(&fmt));
+  CHECK_EQ(ftell(f), tag);
+  fclose(f);
+}
+
+static void test_xing(void) {
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  uint32_t bytes;
+  FILE *f = ten_minute_vbr(true, &bytes);
+  mp3_info_t info;
+  CHECK(mp3_info_read(f, &info));
+  CHECK_EQ(info.src, MP3_INFO_SRC_XING);
+  CHECK_EQ(info.total_frames, TEN_MIN_FRAMES);
+  CHECK_EQ(info.audio_bytes, bytes);
+  CHECK_EQ(info.duration_ms, frames_ms(&fmt, TEN_MIN_FRAMES));
+  fclose(f);
+
+  // The same stream without the header is taken as CBR at its first
+  // frame's bitrate, which is what the header is there to avoid
+  f = ten_minute_vbr(false, &bytes);
+  CHECK(mp3_info_read(f, &info));
+  CHECK_EQ(info.src, MP3_INFO_SRC_CBR);
+  printf("10 min VBR: Xing %u ms, first-frame CBR estimate %u ms\n",
+         frames_ms(&fmt, TEN_MIN_FRAMES), info.duration_ms);
+  fclose(f);
+
+  // "Info" is LAME's name for the same header in a CBR file
+  f = tmpfile();
+  mp3_synth_xing(f, &fmt, "Info", 500, 0, NULL, 0);
+  mp3_synth_cbr(f, &fmt, 128, 499);
+  CHECK(mp3_info_read(f, &info));
+  CHECK_EQ(info.src, MP3_INFO_SRC_XING);
+  CHECK_EQ(info.duration_ms, frames_ms(&fmt, 500));
+  fclose(f);
+}
+
+static void test_xing_mpeg2_mono(void) {
+  // Side info is 9 bytes here, so the header sits elsewhere
+  const mp3_synth_fmt_t fmt = {false, 22050, true};
+  FILE *f = tmpfile();
+  mp3_synth_xing(f, &fmt, "Xing", 3000, 0, NULL, 0);
+  for (int i = 1; i < 3000; i++) {
+    mp3_synth_frame(f, &fmt, i % 2 ? 32 : 48, false);
+  }
+  mp3_info_t info;
+  CHECK(mp3_info_read(f, &info));
+  CHECK_EQ(info.src, MP3_INFO_SRC_XING);
+  CHECK_EQ(info.first.samples, 576);
+  CHECK_EQ(info.first.hz, 22050);
+  CHECK_EQ(info.first.channels, 1);
+  CHECK_EQ(info.duration_ms, frames_ms(&fmt, 3000));
+  fclose(f);
+}
+
+static void test_vbri(void) {
+  const mp3_synth_fmt_t fmt = {true, 48000, false};
+  FILE *f = tmpfile();
+  mp3_synth_id3v2(f, 300, NULL, 0);
+  uint32_t bytes = mp3_synth_vbri(f, &fmt, 4000, 0);
+  for (int i = 1; i < 4000; i++) {
+    bytes += mp3_synth_frame(f, &fmt, i % 3 ? 96 : 192, false);
+  }
+  mp3_info_t info;
+  CHECK(mp3_info_read(f, &info));
+  CHECK_EQ(info.src, MP3_INFO_SRC_VBRI);
+  CHECK_EQ(info.data_offset, 300);
+  CHECK_EQ(info.audio_bytes, bytes);
+  CHECK_EQ(info.total_frames, 4000);
+  CHECK_EQ(info.duration_ms, frames_ms(&fmt, 4000));
+  fclose(f);
+}
+
+static void test_junk_and_false_sync(void) {
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  FILE *f = tmpfile();
+  // A lone header-like pattern in the junk has no second frame after it
+  uint8_t junk[700] = {0};
+  junk[100] = 0xFF;
+  junk[101] = 0xFB;
+  junk[102] = 0x90;
+  fwrite(junk, 1, sizeof(junk), f);
+  uint32_t bytes = mp3_synth_cbr(f, &fmt, 128, 100);
+  mp3_info_t info;
+  CHECK(mp3_info_read(f, &info));
+  CHECK_EQ(info.data_offset, sizeof(junk));
+  CHECK_EQ(info.audio_bytes, bytes);
+  CHECK_NEAR(info.duration_ms, frames_ms(&fmt, 100), FRAME_MS(&fmt));
+  fclose(f);
+
+  // Nothing but junk
+  f = tmpfile();
+  fwrite(junk, 1, sizeof(junk), f);
+  CHECK(!mp3_info_read(f, &info));
+  CHECK_EQ(info.src, MP3_INFO_SRC_NONE);
+  CHECK_EQ(ftell(f), 0);
+  fclose(f);
+}
+
+/*
+ * The ring as the test sees it: chunks of decoded PCM, each knowing its
+ * track and first sample, taken by the callback 512 bytes at a time.
+ */
+typedef struct {
+  int track;
+  uint64_t sample;
+  uint32_t bytes;
+} chunk_t;
+
+#define MAX_CHUNKS (RING_BYTES / (1152 * 4) + 2)
+
+typedef struct {
+  int track;
+  uint64_t base;   // first sample decoded
+  uint32_t frames; // frames decoded from there
+  uint32_t duration_ms;
+} sim_track_t;
+
+static void test_position_clock(void) {
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  const uint32_t pcm_frame = 1152 * 4;
+  uint32_t bytes;
+  FILE *f = ten_minute_vbr(true, &bytes);
+  mp3_info_t info;
+  CHECK(mp3_info_read(f, &info));
+  fclose(f);
+
+  // The 10-minute track, then the next one resumed 2000 frames in
+  const sim_track_t tracks[2] = {
+      {0, 0, TEN_MIN_FRAMES, info.duration_ms},
+      {1, 2000 * 1152, 800, 200000},
+  };
+  chunk_t ring[MAX_CHUNKS];
+  int head = 0, cnt = 0;
+  uint32_t ring_bytes = 0, front_used = 0;
+  int dec_track = 0;
+  uint32_t dec_frame = 0;
+  play_clock_t clk = {0};
+
+  int max_err = 0, max_dec_err = 0;
+  uint32_t last_pos[2] = {0};
+  for (;;) {
+    // Decode task: fill the ring, one frame at a time
+    while (dec_track < 2 && ring_bytes + pcm_frame <= RING_BYTES) {
+      const sim_track_t *t = &tracks[dec_track];
+      if (dec_frame == 0) {
+        play_clock_track_begin(&clk, fmt.hz, 2, t->duration_ms, t->base,
+                               1.0f);
+      }
+      ring[(head + cnt++) % MAX_CHUNKS] =
+          (chunk_t){dec_track, t->base + dec_frame * 1152ULL, pcm_frame};
+      ring_bytes += pcm_frame;
+      play_clock_queued(&clk, pcm_frame);
+      if (++dec_frame == t->frames) {
+        dec_track++;
+        dec_frame = 0;
+      }
+    }
+    if (cnt == 0) {
+      break;
+    }
+
+    // Data callback
+    uint32_t want = CB_BYTES;
+    while (want && cnt) {
+      uint32_t take = ring[head].bytes - front_used;
+      take = take < want ? take : want;
+      front_used += take;
+      want -= take;
+      ring_bytes -= take;
+      if (front_used == ring[head].bytes) {
+        head = (head + 1) % MAX_CHUNKS;
+        cnt--;
+        front_used = 0;
+      }
+    }
+    play_clock_consumed(&clk, CB_BYTES - want);
+    if (cnt == 0) {
+      break;
+    }
+
+    // What is heard next, against what the clock says
+    const chunk_t *c = &ring[head];
+    uint32_t truth = (c->sample + front_used / 4) * 1000 / fmt.hz;
+    uint32_t pos = play_clock_position_ms(&clk);
+    CHECK_EQ(play_clock_duration_ms(&clk), tracks[c->track].duration_ms);
+    int err = (int)pos - (int)truth;
+    err = err < 0 ? -err : err;
+    max_err = err > max_err ? err : max_err;
+    last_pos[c->track] = pos;
+
+    // Counting decoded frames instead is off by the ring depth
+    if (dec_track == c->track) {
+      int dec = (tracks[dec_track].base + dec_frame * 1152ULL) * 1000 /
+                    fmt.hz - truth;
+      max_dec_err = dec > max_dec_err ? dec : max_dec_err;
+    }
+  }
+
+  printf("position over a 10 min VBR track: max error %d ms from consumed "
+         "PCM, %d ms from decoded frames\n",
+         max_err, max_dec_err);
+  CHECK(max_err <= POS_TOL_MS);
+  CHECK(max_dec_err > POS_TOL_MS);
+  CHECK_NEAR(last_pos[0], info.duration_ms, POS_TOL_MS);
+  CHECK(last_pos[1] > 2000 * 1152 * 1000ULL / fmt.hz);
+}
+
+int main(void) {
+  test_cbr();
+  test_xing();
+  test_xing_mpeg2_mono();
+  test_vbri();
+  test_junk_and_false_sync();
+  test_position_clock();
+  return TEST_RESULT();
+}
@@ -0,0 +1,181 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * The SSD1306 framebuffer on a fake I2C bus: the real ssd1306.c/i2c.c
+ * write into the command-stream emulator, which counts transactions and
+ * bytes. Checks that only changed columns go out, that near spans are
+ * merged, how the framebuffer compares with per-glyph writes, and what
+ * the contrast fade costs against the per-pixel-row wipe it replaced.
+ */
+
+#include "host_test.h"
+#include "ssd1306.h"
+#include "ssd1306_emu.h"
+#include <string.h>
+
+#define WINDOW_BYTES 13 // column/page window + data control byte
+#define ADDR_BYTES 1
+
+static SSD1306_t s_dev;
+
+static void open_display(void) {
+  memset(&s_dev, 0, sizeof(s_dev));
+  ssd1306_emu_reset(ssd1306_emu_get());
+  i2c_master_init(&s_dev, 21, 22, -1);
+  ssd1306_init(&s_dev, 128, 32);
+  ssd1306_clear_screen(&s_dev, false);
+  ssd1306_emu_reset_stats(ssd1306_emu_get());
+}
+
+static ssd1306_emu_stats_t take_stats(void) {
+  ssd1306_emu_t *emu = ssd1306_emu_get();
+  ssd1306_emu_stats_t stats = emu->stats;
+  ssd1306_emu_reset_stats(emu);
+  return stats;
+}
+
+/* The panel holds what the framebuffer says it holds */
+static bool panel_matches_framebuffer(void) {
+  ssd1306_emu_t *emu = ssd1306_emu_get();
+  for (int page = 0; page < s_dev._pages; page++) {
+    if (memcmp(emu->gddram[page], s_dev._page[page]._segs, 128) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void test_per_glyph_baseline(void) {
+  open_display();
+  uint32_t tx_count = s_dev._txCount;
+  uint32_t tx_bytes = s_dev._txBytes;
+  ssd1306_display_text(&s_dev, 0, "Track 01/12 [BT]", 16, false);
+  ssd1306_emu_stats_t st = take_stats();
+
+  // The driver's own counters agree with what reached the bus
+  CHECK_EQ(s_dev._txCount - tx_count, st.transactions);
+  CHECK_EQ(s_dev._txBytes - tx_bytes, st.bytes);
+
+  CHECK_EQ(st.transactions, 16);
+  CHECK_EQ(st.bytes, 16 * (ADDR_BYTES + WINDOW_BYTES + 8));
+  CHECK(panel_matches_framebuffer());
+  printf("per-glyph line: %u transactions, %u bytes\n",
+         (unsigned)st.transactions, (unsigned)st.bytes);
+}
+
+static void test_framebuffer_line(void) {
+  open_display();
+  ssd1306_fb_text(&s_dev, 0, 0, "Track 01/12 [BT]", 16, false);
+  ssd1306_flush(&s_dev);
+  ssd1306_emu_stats_t st = take_stats();
+
+  // One span per page, whole line in a single transfer
+  CHECK_EQ(st.transactions, 1);
+  CHECK(st.bytes <= ADDR_BYTES + WINDOW_BYTES + 128);
+  CHECK(panel_matches_framebuffer());
+  printf("framebuffer line: %u transactions, %u bytes\n",
+         (unsigned)st.transactions, (unsigned)st.bytes);
+
+  // Nothing changed, nothing sent
+  ssd1306_fb_text(&s_dev, 0, 0, "Track 01/12 [BT]", 16, false);
+  ssd1306_flush(&s_dev);
+  st = take_stats();
+  CHECK_EQ(st.transactions, 0);
+  CHECK_EQ(st.bytes, 0);
+
+  // One glyph changed: only its differing columns
+  ssd1306_fb_text(&s_dev, 0, 0, "Track 02/12 [BT]", 16, false);
+  ssd1306_flush(&s_dev);
+  st = take_stats();
+  CHECK_EQ(st.transactions, 1);
+  CHECK(st.data_bytes <= 8);
+  CHECK(panel_matches_framebuffer());
+}
+
+static void test_span_merging(void) {
+  static const uint8_t bar[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+  open_display();
+
+  // Gaps narrower than a transaction's overhead are sent through
+  ssd1306_fb_image(&s_dev, 1, 10, bar, 4);
+  ssd1306_fb_image(&s_dev, 1, 10 + 4 + SSD1306_SPAN_MERGE_GAP - 1, bar, 4);
+  ssd1306_flush(&s_dev);
+  ssd1306_emu_stats_t st = take_stats();
+  CHECK_EQ(st.transactions, 1);
+
+  // Far apart: two transactions beat sending the gap
+  ssd1306_fb_image(&s_dev, 2, 0, bar, 4);
+  ssd1306_fb_image(&s_dev, 2, 100, bar, 4);
+  ssd1306_flush(&s_dev);
+  st = take_stats();
+  CHECK_EQ(st.transactions, 2);
+  CHECK_EQ(st.data_bytes, 8);
+
+  // More spans than slots still reach the panel
+  for (int seg = 0; seg < 128; seg += 24) {
+    ssd1306_fb_image(&s_dev, 3, seg, bar, 2);
+  }
+  ssd1306_flush(&s_dev);
+  st = take_stats();
+  CHECK(st.transactions <= SSD1306_MAX_SPANS);
+  CHECK(panel_matches_framebuffer());
+}
+
+static void test_full_frame(void) {
+  uint8_t frame[4 * 128];
+  open_display();
+  for (int i = 0; i < (int)sizeof(frame); i++) {
+    frame[i] = (uint8_t)(i * 37);
+  }
+  for (int page = 0; page < 4; page++) {
+    ssd1306_fb_image(&s_dev, page, 0, &frame[page * 128], 128);
+  }
+  ssd1306_flush(&s_dev);
+  ssd1306_emu_stats_t st = take_stats();
+
+  // Everything dirty: one frame transfer instead of a span per page
+  CHECK_EQ(st.transactions, 1);
+  CHECK_EQ(st.data_bytes, sizeof(frame));
+  CHECK(panel_matches_framebuffer());
+}
+
+static void test_fadeout(void) {
+  open_display();
+  ssd1306_display_text(&s_dev, 0, "Track 01/12 [BT]", 16, false);
+  ssd1306_display_text(&s_dev, 1, "A long title ...", 16, false);
+  take_stats();
+  ssd1306_fadeout(&s_dev);
+  ssd1306_emu_stats_t st = take_stats();
+
+  // Old fade: a one-column write per pixel row of every page
+  const uint32_t old_tx = 4 * 8 * 128;
+  const uint32_t old_bytes = old_tx * (ADDR_BYTES + WINDOW_BYTES + 1);
+
+  // Contrast steps, one clear frame, contrast restored
+  CHECK_EQ(st.transactions, SSD1306_FADE_STEPS + 2);
+  CHECK_EQ(st.data_bytes, 4 * 128);
+  CHECK(st.bytes < old_bytes / 50);
+  CHECK_EQ(ssd1306_emu_get()->contrast, 0xFF);
+  CHECK(panel_matches_framebuffer());
+  for (int page = 0; page < 4; page++) {
+    for (int seg = 0; seg < 128; seg++) {
+      CHECK_EQ(s_dev._page[page]._segs[seg], 0);
+    }
+  }
+  printf("fade: %u transactions, %u bytes (was %u, %u)\n",
+         (unsigned)st.transactions, (unsigned)st.bytes, (unsigned)old_tx,
+         (unsigned)old_bytes);
+}
+
+int main(void) {
+  test_per_glyph_baseline();
+  test_framebuffer_line();
+  test_span_merging();
+  test_full_frame();
+  test_fadeout();
+  return TEST_RESULT();
+}
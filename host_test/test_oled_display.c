@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * oled_display_update() end to end: the real display code and driver on a
+ * stand-in I2C bus that feeds the SSD1306 emulator. Each scene is compared
+ * with a golden PBM in golden/, and the bus traffic with a budget.
+ *
+ * Run with UPDATE_GOLDEN=1 to rewrite the golden images after an intended
+ * change to the layout; review them before committing.
+ */
+
+#include "audio_levels.h"
+#include "audio_player.h"
+#include "common.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include "oled_display.h"
+#include "player_status.h"
+#include "sd_card.h"
+#include "ssd1306_emu.h"
+#include <string.h>
+
+#define UPDATE_MS 200 // OLED_METER_INTERVAL_MS in main.c
+#define I2C_HZ 400000
+#define TITLE_PAGE_MS 2600 // first update after OLED_TITLE_PAGE_MS
+
+/*********************************
+ * FAKE PLAYER
+ ********************************/
+static const char *s_playlist[] = {
+    "/sdcard/music/Intro.mp3",
+    "/sdcard/music/Song Two.mp3",
+    "/sdcard/music/A Rather Long Track Title (Live at the Hall).mp3",
+};
+static int s_playlist_count = 3;
+static uint32_t s_position_ms;
+static uint32_t s_duration_ms;
+static audio_levels_t s_levels;
+
+int sd_card_get_playlist_count(void) { return s_playlist_count; }
+
+const char *sd_card_get_file_path(int index) {
+  return index >= 0 && index < s_playlist_count ? s_playlist[index] : NULL;
+}
+
+uint32_t audio_player_get_position_ms(void) { return s_position_ms; }
+
+uint32_t audio_player_get_duration_ms(void) { return s_duration_ms; }
+
+void audio_levels_read(audio_levels_t *levels) { *levels = s_levels; }
+
+/*********************************
+ * HELPERS
+ ********************************/
+static ssd1306_emu_stats_t update(void) {
+  ssd1306_emu_t *emu = ssd1306_emu_get();
+  ssd1306_emu_reset_stats(emu);
+  oled_display_update();
+  return emu->stats;
+}
+
+/* Play for a while at the task's meter rate; returns the traffic */
+static ssd1306_emu_stats_t play_for(uint32_t ms) {
+  ssd1306_emu_stats_t total = {0};
+  for (uint32_t t = 0; t < ms; t += UPDATE_MS) {
+    host_stub_advance_us(UPDATE_MS * 1000);
+    s_position_ms += UPDATE_MS;
+    ssd1306_emu_stats_t st = update();
+    total.transactions += st.transactions;
+    total.bytes += st.bytes;
+    total.bus_clocks += st.bus_clocks;
+    total.scroll_writes += st.scroll_writes;
+  }
+  return total;
+}
+
+static void check_golden(const char *name) {
+  char path[64];
+  snprintf(path, sizeof(path), "golden/%s.pbm", name);
+
+  char *image = NULL;
+  size_t image_len = 0;
+  FILE *f = open_memstream(&image, &image_len);
+  ssd1306_emu_write_pbm(ssd1306_emu_get(), f);
+  fclose(f);
+
+  if (getenv("UPDATE_GOLDEN")) {
+    f = fopen(path, "w");
+    CHECK(f != NULL);
+    if (f) {
+      fwrite(image, 1, image_len, f);
+      fclose(f);
+    }
+    free(image);
+    return;
+  }
+
+  static char golden[8192];
+  size_t golden_len = 0;
+  f = fopen(path, "r");
+  if (f) {
+    golden_len = fread(golden, 1, sizeof(golden), f);
+    fclose(f);
+  }
+  if (golden_len != image_len || memcmp(golden, image, image_len) != 0) {
+    fprintf(stderr, "%s differs from the panel:\n%s", path, image);
+    s_failures++;
+  }
+  free(image);
+}
+
+/*********************************
+ * TESTS
+ ********************************/
+static void test_boot_screen(void) {
+  ssd1306_emu_reset(ssd1306_emu_get());
+  oled_display_init();
+  CHECK(ssd1306_emu_get()->display_on);
+  CHECK_EQ(ssd1306_emu_get()->stats.unknown_cmds, 0);
+  check_golden("boot");
+}
+
+static void test_playing(void) {
+  player_status_set_bt_state(APP_AV_STATE_CONNECTED,
+                             APP_AV_MEDIA_STATE_STARTED);
+  player_status_set_track(1);
+  player_status_set_volume(64);
+  player_status_set_playing(true);
+  s_position_ms = 45000;
+  s_duration_ms = 180000;
+  s_levels.vu[0] = 0.25f;
+  s_levels.vu[1] = 0.05f;
+  for (int b = 0; b < AUDIO_LEVELS_BANDS; b++) {
+    s_levels.band[b] = 0.5f / (1 + b);
+  }
+
+  ssd1306_emu_stats_t st = update();
+  CHECK_EQ(st.unknown_cmds, 0);
+  CHECK_EQ(st.scroll_writes, 0);
+  check_golden("playing");
+
+  // Steady playback with a still meter: only the progress bar moves
+  ssd1306_emu_stats_t sec = play_for(1000);
+  printf("playing, still meter: %u transactions, %u bytes/s, %u us/s bus\n",
+         (unsigned)sec.transactions, (unsigned)sec.bytes,
+         (unsigned)(sec.bus_clocks * 1000000 / I2C_HZ));
+  CHECK(sec.transactions <= 2);
+  CHECK(sec.bytes <= 40);
+
+  // Nothing changed at all: nothing on the bus
+  st = update();
+  CHECK_EQ(st.transactions, 0);
+}
+
+static void test_meter_budget(void) {
+  // A moving meter every update is the worst case while playing
+  ssd1306_emu_stats_t total = {0};
+  for (int i = 0; i < 1000 / UPDATE_MS; i++) {
+    s_levels.vu[0] = (i & 1) ? 0.5f : 0.01f;
+    s_levels.vu[1] = (i & 1) ? 0.01f : 0.5f;
+    for (int b = 0; b < AUDIO_LEVELS_BANDS; b++) {
+      s_levels.band[b] = ((i + b) & 1) ? 0.9f : 0.001f;
+    }
+    ssd1306_emu_stats_t st = play_for(UPDATE_MS);
+    total.bytes += st.bytes;
+    total.bus_clocks += st.bus_clocks;
+  }
+  uint32_t bus_us = total.bus_clocks * 1000000 / I2C_HZ;
+  printf("playing, busy meter: %u bytes/s, %u us/s bus\n",
+         (unsigned)total.bytes, (unsigned)bus_us);
+
+  // At most one meter page per update, under 2% of the bus at 400 kHz
+  CHECK(total.bytes <= (1000 / UPDATE_MS) * (1 + 13 + 128 + 40));
+  CHECK(bus_us <= 20000);
+}
+
+static void test_long_title(void) {
+  s_levels = (audio_levels_t){0};
+  player_status_set_track(2);
+  update();
+  check_golden("long_title");
+
+  // Paged every 2.5 s, one title span per move
+  ssd1306_emu_stats_t st = play_for(TITLE_PAGE_MS);
+  CHECK_EQ(st.scroll_writes, 0);
+  CHECK(st.bytes <= 2 * (1 + 13 + 128) + 2 * 40);
+  check_golden("long_title_paged");
+
+  // Pages through to the end, then starts over
+  play_for(TITLE_PAGE_MS);
+  play_for(TITLE_PAGE_MS);
+  check_golden("long_title_end");
+  play_for(TITLE_PAGE_MS);
+  check_golden("long_title_wrapped");
+}
+
+static void test_paused(void) {
+  player_status_set_playing(false);
+  ssd1306_emu_stats_t st = update();
+  CHECK(st.transactions > 0); // icon flips, meter blanks
+  check_golden("paused");
+
+  // Paused and unchanged: the task may sleep, nothing to send
+  host_stub_advance_us(10 * 1000 * 1000);
+  st = update();
+  CHECK_EQ(st.transactions, 0);
+}
+
+int main(void) {
+  test_boot_screen();
+  test_playing();
+  test_meter_budget();
+  test_long_title();
+  test_paused();
+  return TEST_RESULT();
+}
@@ -0,0 +1,143 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * status_snapshot under real threads: writers publish fields that are all
+ * derived from one counter, readers check every copy is self-consistent
+ * and that sequence numbers never go backwards.
+ */
+
+#include "host_test.h"
+#include "status_snapshot.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#define WRITERS 2
+#define READERS 3
+#define WRITES_PER_WRITER 20000
+
+static status_snapshot_t s_snap = STATUS_SNAPSHOT_INIT;
+static atomic_bool s_done;
+static atomic_int s_torn;
+static atomic_int s_backwards;
+static atomic_long s_reads;
+
+static void yield_wait(void) { sched_yield(); }
+
+/* Every field is a function of n, so a torn copy is detectable */
+static void fill(player_status_t *st, int n) {
+  st->a2d_state = n;
+  st->media_state = ~n;
+  st->song_idx = n * 7;
+  st->is_playing = n & 1;
+  st->volume = (uint8_t)(n & 0x7F);
+}
+
+static bool consistent(const player_status_t *st) {
+  int n = st->a2d_state;
+  return st->media_state == ~n && st->song_idx == n * 7 &&
+         st->is_playing == (bool)(n & 1) && st->volume == (n & 0x7F);
+}
+
+static void *writer(void *arg) {
+  int base = (int)(intptr_t)arg * WRITES_PER_WRITER;
+  for (int i = 1; i <= WRITES_PER_WRITER; i++) {
+    player_status_t st;
+    status_snapshot_begin(&s_snap, &st, yield_wait);
+    fill(&st, base + i);
+    status_snapshot_commit(&s_snap, &st, yield_wait);
+  }
+  return NULL;
+}
+
+static void *reader(void *arg) {
+  uint32_t last = 0;
+  long reads = 0;
+  while (!atomic_load(&s_done)) {
+    player_status_t st;
+    uint32_t seq = status_snapshot_read(&s_snap, &st);
+    if (!consistent(&st)) {
+      atomic_fetch_add(&s_torn, 1);
+    }
+    if (seq < last) {
+      atomic_fetch_add(&s_backwards, 1);
+    }
+    last = seq;
+    reads++;
+  }
+  atomic_fetch_add(&s_reads, reads);
+  return NULL;
+}
+
+static void test_single_thread(void) {
+  status_snapshot_t snap = STATUS_SNAPSHOT_INIT;
+  player_status_t st;
+
+  uint32_t seq0 = status_snapshot_read(&snap, &st);
+  CHECK_EQ(seq0, 0);
+  CHECK(!status_snapshot_changed_since(&snap, seq0));
+
+  status_snapshot_begin(&snap, &st, NULL);
+  st.volume = 64;
+  CHECK(status_snapshot_commit(&snap, &st, NULL));
+  CHECK(status_snapshot_changed_since(&snap, seq0));
+
+  uint32_t seq1 = status_snapshot_read(&snap, &st);
+  CHECK_EQ(seq1, seq0 + 1);
+  CHECK_EQ(st.volume, 64);
+
+  // Publishing an unchanged status is a no-op
+  status_snapshot_begin(&snap, &st, NULL);
+  CHECK(!status_snapshot_commit(&snap, &st, NULL));
+  CHECK(!status_snapshot_changed_since(&snap, seq1));
+
+  // Both instances are brought up to date
+  status_snapshot_begin(&snap, &st, NULL);
+  st.song_idx = 3;
+  CHECK(status_snapshot_commit(&snap, &st, NULL));
+  status_snapshot_read(&snap, &st);
+  CHECK_EQ(st.volume, 64);
+  CHECK_EQ(st.song_idx, 3);
+}
+
+static void test_threads(void) {
+  pthread_t w[WRITERS];
+  pthread_t r[READERS];
+  player_status_t st;
+
+  // Start from a consistent status rather than all zeroes
+  status_snapshot_begin(&s_snap, &st, NULL);
+  fill(&st, 0);
+  status_snapshot_commit(&s_snap, &st, NULL);
+  for (int i = 0; i < READERS; i++) {
+    pthread_create(&r[i], NULL, reader, NULL);
+  }
+  for (int i = 0; i < WRITERS; i++) {
+    pthread_create(&w[i], NULL, writer, (void *)(intptr_t)i);
+  }
+  for (int i = 0; i < WRITERS; i++) {
+    pthread_join(w[i], NULL);
+  }
+  atomic_store(&s_done, true);
+  for (int i = 0; i < READERS; i++) {
+    pthread_join(r[i], NULL);
+  }
+
+  CHECK_EQ(atomic_load(&s_torn), 0);
+  CHECK_EQ(atomic_load(&s_backwards), 0);
+  CHECK(atomic_load(&s_reads) > 0);
+
+  // Every write changed the status, so every write got its own number
+  CHECK_EQ(status_snapshot_read(&s_snap, &st), 1 + WRITERS * WRITES_PER_WRITER);
+  CHECK(consistent(&st));
+}
+
+int main(void) {
+  test_single_thread();
+  test_threads();
+  return TEST_RESULT();
+}
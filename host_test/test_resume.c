@@ -0,0 +1,297 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Resume after a power cycle (resume.c, mp3_prime.c). The NVS write
+ * throttle over an hour of play, the saved point surviving a reboot, and
+ * the seek itself: a noise stream whose frames borrow main data from the
+ * ones before is decoded from the start, resume points are picked along
+ * the way as audio_player.c does, and each one is primed and decoded as on
+ * boot. The first frame heard must match the straight decode sample for
+ * sample, and cost at most one MPEG-1 frame's decode (1152 samples) more
+ * than starting from zero.
+ */
+
+#define MINIMP3_IMPLEMENTATION
+#define MINIMP3_ONLY_MP3
+#define MINIMP3_NO_SIMD
+#include "minimp3.h"
+
+#include "host_stubs.h"
+#include "host_test.h"
+#include "mp3_info.h"
+#include "mp3_prime.h"
+#include "mp3_synth.h"
+#include "resume.h"
+#include <string.h>
+#include <time.h>
+
+#define HOUR_S 3600
+#define PAUSE_EVERY_S 600
+#define STREAM_FRAMES 400
+#define RING_FRAMES 8    // ring buffer depth the heard frame lags by
+#define INPUT_BYTES 4096 // INPUT_BUF_SIZE in audio_player.c
+#define MAX_SAMPLES MINIMP3_MAX_SAMPLES_PER_FRAME
+#define TIMING_ROUNDS 20
+
+static uint32_t s_rng = 0x3c6ef372;
+
+static uint32_t rnd(uint32_t n) {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng % n;
+}
+
+static void advance_s(int s) { host_stub_advance_us(s * 1000000LL); }
+
+static void test_path_hash(void) {
+  // FNV-1a test vectors
+  CHECK_EQ(resume_path_hash(""), 0x811c9dc5);
+  CHECK_EQ(resume_path_hash("a"), 0xe40c292c);
+  CHECK_EQ(resume_path_hash("foobar"), 0xbf9cf968);
+  CHECK(resume_path_hash("/sdcard/a/01.mp3") !=
+        resume_path_hash("/sdcard/b/01.mp3"));
+}
+
+static void test_load_before_init(void) {
+  // NVS not up within RESUME_WAIT_MS: start from the top
+  resume_point_t pt;
+  CHECK(!resume_load(&pt));
+  CHECK(!resume_save(&(resume_point_t){1, 100, 100, 0}, true));
+  resume_init();
+  CHECK_EQ(host_stub_take_notifications(), 1); // the waiter is released
+  CHECK(!resume_load(&pt));                    // nothing saved yet
+}
+
+static void test_save_throttle(void) {
+  resume_point_t pt = {resume_path_hash("/sdcard/01.mp3"), 5000, 4000, 0};
+  host_stub_nvs_take_writes();
+  CHECK(resume_save(&pt, false)); // the first point goes out at once
+  CHECK(!resume_save(&pt, true)); // identical: never rewritten
+
+  // Playing: at most once per RESUME_SAVE_PERIOD_MS
+  advance_s(10);
+  pt.offset += 1000;
+  CHECK(!resume_save(&pt, false));
+  advance_s(RESUME_SAVE_PERIOD_MS / 1000 - 10);
+  CHECK(resume_save(&pt, false));
+
+  // A pause is urgent, but not closer than RESUME_MIN_INTERVAL_MS
+  advance_s(1);
+  pt.offset += 1000;
+  CHECK(!resume_save(&pt, true));
+  advance_s(RESUME_MIN_INTERVAL_MS / 1000);
+  CHECK(resume_save(&pt, true));
+
+  // Another track counts as urgent
+  advance_s(RESUME_MIN_INTERVAL_MS / 1000);
+  pt.path_hash = resume_path_hash("/sdcard/02.mp3");
+  CHECK(resume_save(&pt, false));
+  CHECK_EQ(host_stub_nvs_take_writes(), 4);
+
+  // An hour of play, checked every second as the decode task does, with a
+  // pause every ten minutes retried until it gets through
+  int writes = 0;
+  for (int s = 1; s <= HOUR_S; s++) {
+    advance_s(1);
+    pt.offset += 16000;
+    bool paused = s % PAUSE_EVERY_S < RESUME_MIN_INTERVAL_MS / 1000;
+    writes += resume_save(&pt, paused);
+  }
+  printf("1 h of play: %d NVS writes for %d checkpoints\n", writes, HOUR_S);
+  CHECK_EQ(host_stub_nvs_take_writes(), writes);
+  CHECK(writes <= HOUR_S * 1000 / RESUME_SAVE_PERIOD_MS + HOUR_S /
+                                                            PAUSE_EVERY_S);
+  CHECK(writes >= HOUR_S * 1000 / RESUME_SAVE_PERIOD_MS);
+
+  // Power cycle: the last point written is what comes back
+  resume_point_t saved = pt;
+  advance_s(1);
+  pt.offset += 16000;
+  CHECK(!resume_save(&pt, false));
+  resume_init();
+  resume_point_t loaded;
+  CHECK(resume_load(&loaded));
+  CHECK(memcmp(&loaded, &saved, sizeof(saved)) == 0);
+}
+
+/* A stream in memory, decoded straight through as the reference */
+typedef struct {
+  uint8_t *data;
+  uint32_t len;
+  uint32_t off[STREAM_FRAMES + 1];
+  int16_t (*pcm)[MAX_SAMPLES];
+  int samples;
+} stream_t;
+
+static void stream_make(stream_t *st, const mp3_synth_fmt_t *fmt,
+                        uint16_t kbps, uint32_t seed) {
+  FILE *f = tmpfile();
+  st->len = mp3_synth_noise(f, fmt, kbps, STREAM_FRAMES, seed);
+  st->data = malloc(st->len + INPUT_BYTES);
+  memset(st->data + st->len, 0, INPUT_BYTES);
+  rewind(f);
+  CHECK_EQ(fread(st->data, 1, st->len, f), st->len);
+  fclose(f);
+  st->pcm = malloc(STREAM_FRAMES * sizeof(*st->pcm));
+  st->samples = mp3_synth_frame_samples(fmt);
+}
+
+static uint32_t input_len(const stream_t *st, uint32_t off) {
+  return st->len - off < INPUT_BYTES ? st->len - off : INPUT_BYTES;
+}
+
+static double cpu_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/*
+ * From a cold decoder to the first frame heard, as the decode task runs on
+ * boot: returns the samples decoded (the heard frame's included) and
+ * leaves that frame's PCM in pcm. With copy false every priming frame is
+ * decoded instead.
+ */
+static int first_audio(mp3dec_t *dec, const stream_t *st,
+                       const resume_point_t *pt, bool copy, int16_t *pcm) {
+  mp3dec_init(dec);
+  uint32_t off = pt->prime_offset;
+  int decoded = 0;
+  for (;;) {
+    const uint8_t *in = st->data + off;
+    int n = 0;
+    if (copy && off < pt->offset) {
+      n = mp3_prime_frame(dec, in, input_len(st, off), pt->offset - off);
+    }
+    if (n == 0) {
+      mp3dec_frame_info_t info;
+      int samples =
+          mp3dec_decode_frame(dec, in, input_len(st, off), pcm, &info);
+      decoded += samples;
+      n = info.frame_bytes;
+      if (off >= pt->offset && samples > 0) {
+        return decoded;
+      }
+    }
+    if (n == 0) {
+      return decoded;
+    }
+    off += n;
+  }
+}
+
+/* CPU time for first audio at each point, a few rounds over them all */
+static double time_first_audio(mp3dec_t *dec, const stream_t *st,
+                               const resume_point_t *points, int n,
+                               bool copy) {
+  int16_t pcm[MAX_SAMPLES];
+  double t0 = cpu_us();
+  for (int r = 0; r < TIMING_ROUNDS; r++) {
+    for (int p = 0; p < n; p++) {
+      first_audio(dec, st, &points[p], copy, pcm);
+    }
+  }
+  return (cpu_us() - t0) / (TIMING_ROUNDS * n);
+}
+
+static void test_seek(const char *name, const mp3_synth_fmt_t *fmt,
+                      uint16_t kbps) {
+  stream_t st;
+  stream_make(&st, fmt, kbps, 0x1234567 + kbps);
+  static mp3dec_t dec;
+  static resume_marks_t marks;
+  memset(&marks, 0, sizeof(marks));
+
+  // Straight through, picking a point for the frame heard RING_FRAMES
+  // behind the decoder, every few frames
+  resume_point_t points[STREAM_FRAMES];
+  int n_points = 0;
+  uint32_t off = 0;
+  double t0 = cpu_us();
+  mp3dec_init(&dec);
+  for (int i = 0; i < STREAM_FRAMES; i++) {
+    mp3dec_frame_info_t info;
+    int samples = mp3dec_decode_frame(&dec, st.data + off,
+                                      input_len(&st, off), st.pcm[i], &info);
+    CHECK_EQ(samples, st.samples);
+    st.off[i] = off;
+    resume_mark(&marks, off, i * st.samples,
+                mp3_main_data_begin(st.data + off));
+    off += info.frame_bytes;
+
+    int heard = i - RING_FRAMES;
+    if (heard > 0 && rnd(3) == 0) {
+      resume_point_t *pt = &points[n_points++];
+      uint64_t sample = heard * st.samples + rnd(st.samples);
+      CHECK(resume_point_pick(&marks, 7, sample, pt));
+      CHECK_EQ(pt->offset, st.off[heard]);
+      CHECK_EQ(pt->sample, heard * st.samples);
+      CHECK(pt->prime_offset < pt->offset);
+    }
+  }
+  double frame_us = (cpu_us() - t0) / STREAM_FRAMES;
+  CHECK_EQ(off, st.len);
+  CHECK(n_points > STREAM_FRAMES / 5);
+
+  // Cold start at each point, against the straight decode
+  int16_t pcm[MAX_SAMPLES];
+  size_t pcm_bytes = st.samples * (fmt->mono ? 1 : 2) * sizeof(int16_t);
+  int mismatch = 0, mismatch_unprimed = 0;
+  int max_extra = 0, extra_old = 0;
+  for (int p = 0; p < n_points; p++) {
+    const resume_point_t *pt = &points[p];
+    int heard = pt->sample / st.samples;
+    int extra = first_audio(&dec, &st, pt, true, pcm) - st.samples;
+    max_extra = extra > max_extra ? extra : max_extra;
+    mismatch += memcmp(pcm, st.pcm[heard], pcm_bytes) != 0;
+
+    // Straight at the frame, without its reservoir or history
+    resume_point_t bare = *pt;
+    bare.prime_offset = bare.offset;
+    first_audio(&dec, &st, &bare, true, pcm);
+    mismatch_unprimed += memcmp(pcm, st.pcm[heard], pcm_bytes) != 0;
+
+    // Decoding every priming frame, as before
+    extra_old += first_audio(&dec, &st, pt, false, pcm) - st.samples;
+  }
+  resume_point_t top = {0};
+  CHECK_EQ(first_audio(&dec, &st, &top, true, pcm), st.samples);
+
+  double us_top = time_first_audio(&dec, &st, &top, 1, true);
+  double us_resume = time_first_audio(&dec, &st, points, n_points, true);
+  double us_old = time_first_audio(&dec, &st, points, n_points, false);
+  printf("%s: %d points; first audio %.0f us from the top, resumed %.0f us "
+         "(+%.2f MPEG-1 frame decodes, at most %d samples more decoded), "
+         "decoding every priming frame %.0f us (%.1f samples more)\n",
+         name, n_points, us_top, us_resume,
+         (us_resume - us_top) / (frame_us * 1152 / st.samples), max_extra,
+         us_old, (double)extra_old / n_points);
+  CHECK_EQ(mismatch, 0);
+  CHECK(mismatch_unprimed > n_points / 2);
+  CHECK(max_extra <= 1152);
+  CHECK(extra_old > max_extra * n_points);
+
+  free(st.data);
+  free(st.pcm);
+}
+
+int main(void) {
+  host_stub_advance_us(1000000);
+  test_path_hash();
+  test_load_before_init();
+  test_save_throttle();
+  test_seek("44.1 kHz stereo 64 kbit/s", &MP3_SYNTH_44K_STEREO, 64);
+  test_seek("44.1 kHz stereo 128 kbit/s", &MP3_SYNTH_44K_STEREO, 128);
+  test_seek("44.1 kHz mono 64 kbit/s", &(mp3_synth_fmt_t){true, 44100, true},
+            64);
+  test_seek("22.05 kHz stereo 64 kbit/s",
+            &(mp3_synth_fmt_t){false, 22050, false}, 64);
+  test_seek("22.05 kHz mono 32 kbit/s", &(mp3_synth_fmt_t){false, 22050, true},
+            32);
+  return TEST_RESULT();
+}
@@ -0,0 +1,315 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Fast-forward / rewind (scrub.c) and the header walk under it
+ * (mp3_skip_frames() in mp3_info.c). Skipping has to land on frame starts
+ * and count samples exactly, resync from the middle of a frame, not be
+ * taken in by sync patterns in the main data, and stop at the end of the
+ * file. Then the scrub cycle runs as the decode task does it, at 4x, 8x
+ * and 16x both ways over a 10-minute noise track: the speed it reaches,
+ * and its CPU time against decoding the same wall time in normal play.
+ */
+
+#define MINIMP3_IMPLEMENTATION
+#define MINIMP3_ONLY_MP3
+#define MINIMP3_NO_SIMD
+#include "minimp3.h"
+
+#include "host_test.h"
+#include "mp3_info.h"
+#include "mp3_prime.h"
+#include "mp3_synth.h"
+#include "scrub.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define INPUT_BYTES 4096 // INPUT_BUF_SIZE in audio_player.c
+#define TEN_MIN_FRAMES 22969
+#define NOISE_FRAME_BYTES 417 // 128 kbit/s at 44.1 kHz, never padded
+#define TAG_BYTES 2000
+#define BENCH_CYCLES 150
+#define NORMAL_FRAMES 3000
+#define XSPEED_TOL 0.02
+
+static uint32_t s_rng = 0x6a09e667;
+
+static uint32_t rnd(uint32_t n) {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng % n;
+}
+
+static double cpu_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Silent CBR frames, every third one padded, with their offsets */
+static FILE *padded_cbr(const mp3_synth_fmt_t *fmt, uint32_t *off, int n) {
+  FILE *f = tmpfile();
+  off[0] = mp3_synth_id3v2(f, TAG_BYTES, NULL, 0);
+  for (int i = 0; i < n; i++) {
+    off[i + 1] = off[i] + mp3_synth_frame(f, fmt, 128, i % 3 == 0);
+  }
+  return f;
+}
+
+static void test_skip_cbr(const mp3_synth_fmt_t *fmt) {
+  enum { N = 500 };
+  uint32_t off[N + 1];
+  uint8_t buf[INPUT_BYTES];
+  FILE *f = padded_cbr(fmt, off, N);
+  const uint32_t fs = mp3_synth_frame_samples(fmt);
+
+  for (int i = 0; i < 50; i++) {
+    int from = rnd(N / 2), frames = 1 + rnd(N / 2);
+    uint32_t last = 0;
+    uint64_t samples = 7;
+    uint32_t to =
+        mp3_skip_frames(f, buf, sizeof(buf), off[from], frames, &last,
+                        &samples);
+    CHECK_EQ(to, off[from + frames]);
+    CHECK_EQ(last, off[from + frames - 1]);
+    CHECK_EQ(samples, 7 + (uint64_t)frames * fs);
+  }
+  // Both outputs are optional
+  CHECK_EQ(mp3_skip_frames(f, buf, sizeof(buf), off[0], 10, NULL, NULL),
+           off[10]);
+  // Nothing to step over
+  CHECK_EQ(mp3_skip_frames(f, buf, sizeof(buf), off[4], 0, NULL, NULL),
+           off[4]);
+
+  // From inside the tag or a frame: the junk before the next frame is
+  // not counted
+  for (int i = 0; i < 50; i++) {
+    int k = rnd(N - 2);
+    uint32_t from = off[k] + 1 + rnd(off[k + 1] - off[k] - 1);
+    int next = k + 1;
+    if (i % 10 == 0) {
+      from = rnd(TAG_BYTES);
+      next = 0;
+    }
+    uint32_t last = 0;
+    uint64_t samples = 0;
+    CHECK_EQ(mp3_skip_frames(f, buf, sizeof(buf), from, 1, &last, &samples),
+             off[next + 1]);
+    CHECK_EQ(last, off[next]);
+    CHECK_EQ(samples, fs);
+  }
+
+  // The end of the file comes first: the frames there are all counted
+  uint32_t last = 0;
+  uint64_t samples = 0;
+  CHECK_EQ(mp3_skip_frames(f, buf, sizeof(buf), off[N - 10], 50, &last,
+                           &samples),
+           off[N]);
+  CHECK_EQ(last, off[N - 1]);
+  CHECK_EQ(samples, 10 * fs);
+  last = 0;
+  CHECK_EQ(mp3_skip_frames(f, buf, sizeof(buf), off[N], 5, &last, NULL),
+           off[N]);
+  CHECK_EQ(last, 0);
+  fclose(f);
+}
+
+/* A 128 kbit/s noise stream after a tag, its frames all the same size */
+static FILE *noise_track(uint32_t frames, uint32_t seed, uint32_t *len) {
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  FILE *f = tmpfile();
+  uint32_t tag = mp3_synth_id3v2(f, TAG_BYTES, NULL, 0);
+  *len = tag + mp3_synth_noise(f, &fmt, 128, frames, seed);
+  CHECK_EQ(*len, TAG_BYTES + frames * NOISE_FRAME_BYTES);
+  return f;
+}
+
+static void test_false_sync(void) {
+  // Random main data holds header patterns; a lone one must not count
+  enum { N = 3000 };
+  uint32_t len;
+  FILE *f = noise_track(N, 0x1234, &len);
+  uint8_t *data = malloc(len);
+  rewind(f);
+  CHECK_EQ(fread(data, 1, len, f), len);
+  int fakes = 0;
+  for (uint32_t i = TAG_BYTES; i + 4 <= len; i++) {
+    mp3_frame_hdr_t hdr;
+    fakes += (i - TAG_BYTES) % NOISE_FRAME_BYTES != 0 &&
+             mp3_parse_frame_hdr(data + i, &hdr) && hdr.frame_bytes > 0;
+  }
+
+  // Resync from every fake header and from random points
+  uint8_t buf[INPUT_BYTES];
+  int landed = 0, tries = 0;
+  for (uint32_t i = TAG_BYTES; i + 4 <= len; i++) {
+    mp3_frame_hdr_t hdr;
+    uint32_t k = (i - TAG_BYTES) / NOISE_FRAME_BYTES;
+    bool fake = (i - TAG_BYTES) % NOISE_FRAME_BYTES != 0 &&
+                mp3_parse_frame_hdr(data + i, &hdr) && hdr.frame_bytes > 0;
+    if ((!fake && rnd(200) != 0) || k + 2 >= N) {
+      continue;
+    }
+    uint32_t want = TAG_BYTES + (k + 1) * NOISE_FRAME_BYTES;
+    if ((i - TAG_BYTES) % NOISE_FRAME_BYTES == 0) {
+      want = i;
+    }
+    uint32_t last = 0;
+    uint32_t to = mp3_skip_frames(f, buf, sizeof(buf), i, 1, &last, NULL);
+    landed += last == want && to == want + NOISE_FRAME_BYTES;
+    tries++;
+  }
+  printf("noise stream: %d header patterns inside frames, %d/%d resyncs "
+         "on a frame start\n",
+         fakes, landed, tries);
+  CHECK(fakes > 0);
+  CHECK_EQ(landed, tries);
+  free(data);
+  fclose(f);
+}
+
+static void test_jump_ends(void) {
+  enum { N = 400 };
+  const mp3_synth_fmt_t fmt = MP3_SYNTH_44K_STEREO;
+  uint32_t len;
+  FILE *f = noise_track(N, 0x77, &len);
+  mp3_info_t info;
+  CHECK(mp3_info_read(f, &info));
+  uint8_t buf[INPUT_BYTES];
+  scrub_jump_t jump;
+
+  // Forwards past the end: the snippet starts at the end of the file
+  uint32_t k = N - 20;
+  scrub_jump(f, buf, sizeof(buf), &info, 1, 16, info.data_offset +
+             k * NOISE_FRAME_BYTES, k * 1152ULL, &jump);
+  CHECK_EQ(jump.play_off, len);
+  CHECK_EQ(jump.sample, N * 1152ULL);
+
+  // Backwards past the start: the first frame, primed from itself
+  k = 30;
+  scrub_jump(f, buf, sizeof(buf), &info, -1, 16, info.data_offset +
+             k * NOISE_FRAME_BYTES, k * 1152ULL, &jump);
+  CHECK_EQ(jump.prime_off, info.data_offset);
+  CHECK_EQ(jump.play_off, info.data_offset + NOISE_FRAME_BYTES);
+  CHECK_EQ(jump.sample, mp3_synth_frame_samples(&fmt));
+  fclose(f);
+}
+
+/* The decode task from a jump: prime up to the snippet, then play it */
+static uint32_t play_snippet(mp3dec_t *dec, const uint8_t *data,
+                             uint32_t len, const scrub_jump_t *jump) {
+  int16_t pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+  mp3dec_init(dec);
+  uint32_t off = jump->prime_off;
+  int left = SCRUB_SNIPPET_FRAMES;
+  bool fade_in = true;
+  while (left > 0 && off < len) {
+    int avail = len - off < INPUT_BYTES ? len - off : INPUT_BYTES;
+    int n = 0;
+    if (off < jump->play_off) {
+      n = mp3_prime_frame(dec, data + off, avail, jump->play_off - off);
+    }
+    if (n == 0) {
+      mp3dec_frame_info_t info;
+      int samples = mp3dec_decode_frame(dec, data + off, avail, pcm, &info);
+      n = info.frame_bytes;
+      if (n == 0) {
+        break;
+      }
+      if (off >= jump->play_off && samples > 0) {
+        if (fade_in) {
+          scrub_fade(pcm, samples, info.channels, true);
+          fade_in = false;
+        }
+        if (--left == 0) {
+          scrub_fade(pcm, samples, info.channels, false);
+        }
+      }
+    }
+    off += n;
+  }
+  return off;
+}
+
+static void bench(FILE *f, const uint8_t *data, uint32_t len,
+                  const mp3_info_t *info, int dir, int speed,
+                  double frame_us) {
+  mp3dec_t dec;
+  uint8_t buf[INPUT_BYTES];
+  uint32_t k = dir > 0 ? 1000 : TEN_MIN_FRAMES - 1000;
+  uint32_t off = info->data_offset + k * NOISE_FRAME_BYTES;
+  uint64_t sample = k * 1152ULL, start = sample;
+  double t0 = cpu_us();
+  for (int c = 0; c < BENCH_CYCLES; c++) {
+    scrub_jump_t jump;
+    scrub_jump(f, buf, sizeof(buf), info, dir, speed, off, sample, &jump);
+    off = play_snippet(&dec, data, len, &jump);
+    sample = jump.sample + SCRUB_SNIPPET_FRAMES * 1152ULL;
+    // The gap is a memset of silence
+  }
+  double scrub_us = cpu_us() - t0;
+
+  uint32_t wall_frames =
+      BENCH_CYCLES * (SCRUB_SNIPPET_FRAMES + SCRUB_GAP_FRAMES);
+  double x = ((double)sample - start) / (wall_frames * 1152.0);
+  double cpu = scrub_us / (frame_us * wall_frames);
+  printf("%2dx %-8s %+6.1fx, cpu %3.0f%% of normal play\n", speed,
+         dir > 0 ? "forward" : "rewind", x, cpu * 100);
+  CHECK(x * dir > speed * (1 - XSPEED_TOL));
+  CHECK(x * dir < speed * (1 + XSPEED_TOL));
+  CHECK(cpu < 1.0);
+}
+
+static void test_bench(void) {
+  uint32_t len;
+  FILE *f = noise_track(TEN_MIN_FRAMES, 0x5eed, &len);
+  mp3_info_t info;
+  CHECK(mp3_info_read(f, &info));
+  uint8_t *data = malloc(len);
+  fseek(f, 0, SEEK_SET);
+  CHECK_EQ(fread(data, 1, len, f), len);
+
+  // Normal play: every frame decoded
+  mp3dec_t dec;
+  int16_t pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+  mp3dec_init(&dec);
+  uint32_t off = info.data_offset;
+  double t0 = cpu_us();
+  for (int i = 0; i < NORMAL_FRAMES; i++) {
+    mp3dec_frame_info_t fi;
+    mp3dec_decode_frame(&dec, data + off, INPUT_BYTES, pcm, &fi);
+    off += fi.frame_bytes;
+  }
+  double frame_us = (cpu_us() - t0) / NORMAL_FRAMES;
+  printf("normal play: %.1f us per frame\n", frame_us);
+
+  for (int speed = 4; speed <= 16; speed *= 2) {
+    bench(f, data, len, &info, 1, speed, frame_us);
+    bench(f, data, len, &info, -1, speed, frame_us);
+  }
+  free(data);
+  fclose(f);
+}
+
+static void test_speed_steps(void) {
+  CHECK_EQ(scrub_speed(0), 4);
+  CHECK_EQ(scrub_speed(SCRUB_STEP_MS - 1), 4);
+  CHECK_EQ(scrub_speed(SCRUB_STEP_MS), 8);
+  CHECK_EQ(scrub_speed(2 * SCRUB_STEP_MS), 16);
+  CHECK_EQ(scrub_speed(60 * 1000), 16);
+}
+
+int main(void) {
+  test_skip_cbr(&MP3_SYNTH_44K_STEREO);
+  test_skip_cbr(&(mp3_synth_fmt_t){false, 22050, true});
+  test_false_sync();
+  test_jump_ends();
+  test_speed_steps();
+  test_bench();
+  return TEST_RESULT();
+}
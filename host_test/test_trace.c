@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Trace records carry the recording task, and trace_dump() names the
+ * tasks, in the format tools/trace2json.py reads. trace_dump_async() hands
+ * the dump to a task of its own.
+ */
+
+#include "host_stubs.h"
+#include "host_test.h"
+#include "trace.h"
+#include <string.h>
+#include <unistd.h>
+
+static char s_dump[64 * 1024];
+
+/* Run trace_dump() with stdout captured */
+static void capture_dump(void) {
+  FILE *f = tmpfile();
+  int saved = dup(STDOUT_FILENO);
+  fflush(stdout);
+  dup2(fileno(f), STDOUT_FILENO);
+  trace_dump();
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  rewind(f);
+  size_t n = fread(s_dump, 1, sizeof(s_dump) - 1, f);
+  s_dump[n] = '\0';
+  fclose(f);
+}
+
+int main(void) {
+  CHECK_EQ(sizeof(trace_record_t), 16);
+
+  TaskHandle_t decode, bt;
+  CHECK_EQ(xTaskCreate(NULL, "decode", 4096, NULL, 5, &decode), pdPASS);
+  CHECK_EQ(xTaskCreate(NULL, "BtAppTask", 4096, NULL, 5, &bt), pdPASS);
+
+  host_stub_set_current_task(decode);
+  TRACE(TRACE_EVT_DECODE_BEGIN, 512, 0);
+  host_stub_set_current_task(bt);
+  host_stub_advance_us(10);
+  TRACE(TRACE_EVT_DATA_CB_BEGIN, 4096, 0);
+  host_stub_set_current_task(decode);
+  host_stub_advance_us(10);
+  TRACE(TRACE_EVT_DECODE_END, 1152, 417);
+  host_stub_set_current_task(NULL);
+
+  const trace_record_t *r = s_trace_ring;
+  CHECK_EQ(r[0].task, r[2].task);
+  CHECK(r[0].task != r[1].task);
+  CHECK_EQ(r[2].ts_us, 20);
+  CHECK_EQ(r[2].id, TRACE_EVT_DECODE_END);
+  CHECK_EQ(r[2].a, 1152);
+
+  capture_dump();
+  char line[128];
+  snprintf(line, sizeof(line), "%08x%02x%02x%04x%08x%08x\n", 20,
+           TRACE_EVT_DECODE_END, 0, r[2].task, 1152, 417);
+  CHECK(strstr(s_dump, "TRACE BEGIN 3 3\n") == s_dump);
+  CHECK(strstr(s_dump, line) != NULL);
+  snprintf(line, sizeof(line), "TRACE TASK %u decode\n", r[0].task);
+  CHECK(strstr(s_dump, line) != NULL);
+  snprintf(line, sizeof(line), "TRACE TASK %u BtAppTask\nTRACE END\n",
+           r[1].task);
+  CHECK(strstr(s_dump, line) != NULL);
+
+  // Tasks past the table share one id
+  for (int i = 0; i < TRACE_MAX_TASKS + 2; i++) {
+    TaskHandle_t task;
+    char name[16];
+    snprintf(name, sizeof(name), "t%d", i);
+    CHECK_EQ(xTaskCreate(NULL, name, 1024, NULL, 1, &task), pdPASS);
+    host_stub_set_current_task(task);
+    uint16_t id = trace_task_id();
+    CHECK(i + 2 < TRACE_MAX_TASKS ? id == i + 2 : id == TRACE_MAX_TASKS);
+  }
+  host_stub_set_current_task(NULL);
+
+  // The button combo dumps from a task of its own, one at a time
+  uint32_t allocs = host_stub_kernel_allocs();
+  trace_dump_async();
+  trace_dump_async();
+  CHECK(host_stub_find_task("trace_dump") != NULL);
+  CHECK_EQ(host_stub_kernel_allocs(), allocs + 1);
+  return TEST_RESULT();
+}
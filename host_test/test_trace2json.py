@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+"""tools/trace2json.py on synthetic trace_dump() captures."""
+
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "tools"))
+import trace2json  # noqa: E402
+
+DECODE_BEGIN, DECODE_END, DATA_CB_BEGIN, DATA_CB_END, SCRUB = 5, 6, 7, 8, 9
+
+
+def rec(ts, eid, core=0, task=0, a=0, b=0):
+    return "%08x%02x%02x%04x%08x%08x" % (ts & 0xFFFFFFFF, eid, core, task,
+                                         a, b)
+
+
+def dump(records, tasks=()):
+    lines = ["I (1234) BTN: trace", "TRACE BEGIN %d %d" % (len(records),
+                                                           len(records))]
+    lines += records
+    lines += ["TRACE TASK %d %s" % t for t in tasks]
+    lines += ["TRACE END", "I (1240) BTN: done"]
+    return lines
+
+
+def convert(lines):
+    blocks = list(trace2json.parse_dumps(lines))
+    return trace2json.to_events(*blocks[-1])
+
+
+def timed(events):
+    return [e for e in events if e["ph"] != "M"]
+
+
+class Trace2JsonTest(unittest.TestCase):
+    def test_wrap_of_the_32_bit_clock(self):
+        events = timed(convert(dump([rec(0xFFFFFF00, SCRUB),
+                                     rec(0x00000100, SCRUB),
+                                     rec(0x00000200, SCRUB)])))
+        self.assertEqual([e["ts"] for e in events], [0, 0x200, 0x300])
+
+    def test_overwritten_record_is_not_a_wrap(self):
+        # The oldest slot was overwritten mid-dump by a newer record
+        events = timed(convert(dump([rec(1005000, SCRUB, a=1),
+                                     rec(1000000, SCRUB, a=2),
+                                     rec(1000010, SCRUB, a=3)])))
+        by_a = {e["args"]["a"]: e["ts"] for e in events}
+        self.assertEqual(by_a, {2: 0, 3: 10, 1: 5000})
+        self.assertEqual([e["args"]["a"] for e in events], [2, 3, 1])
+
+    def test_out_of_order_across_a_wrap(self):
+        events = timed(convert(dump([rec(0x00000010, SCRUB, a=1),
+                                     rec(0xFFFFFFF0, SCRUB, a=2),
+                                     rec(0x00000020, SCRUB, a=3)])))
+        by_a = {e["args"]["a"]: e["ts"] for e in events}
+        self.assertEqual(by_a, {2: 0, 1: 0x20, 3: 0x30})
+
+    def test_slices_are_keyed_by_task(self):
+        # Two tasks interleave on core 0; task 1 moves to core 1 mid-slice
+        events = timed(convert(dump([
+            rec(100, DECODE_BEGIN, core=0, task=1),
+            rec(110, DATA_CB_BEGIN, core=0, task=2),
+            rec(120, DECODE_END, core=1, task=1),
+            rec(130, DATA_CB_END, core=0, task=2),
+        ])))
+        for tid, name in ((1, "decode"), (2, "data_cb")):
+            own = [e for e in events if e["tid"] == tid]
+            self.assertEqual([e["ph"] for e in own], ["B", "E"])
+            self.assertEqual({e["name"] for e in own}, {name})
+        self.assertEqual(events[2]["args"]["core"], 1)
+
+    def test_task_names(self):
+        events = convert(dump([rec(0, SCRUB, task=0), rec(1, SCRUB, task=3)],
+                              tasks=[(0, "main"), (1, "BtAppTask")]))
+        names = {e["tid"]: e["args"]["name"] for e in events
+                 if e["ph"] == "M"}
+        self.assertEqual(names, {0: "main", 3: "task 3"})
+
+    def test_last_dump_wins(self):
+        lines = dump([rec(0, SCRUB, a=1)]) + dump([rec(0, SCRUB, a=2)])
+        self.assertEqual(timed(convert(lines))[0]["args"]["a"], 2)
+
+
+if __name__ == "__main__":
+    unittest.main()
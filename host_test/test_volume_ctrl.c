@@ -0,0 +1,133 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Absolute-volume commands from volume_ctrl.c to a fake sink that answers
+ * each one after a delay, or not at all. Checks that a held volume key is
+ * merged into fewer commands than steps, that the sink always ends up at
+ * the last local value, and that commands which are never answered are
+ * re-sent once the response timeout fires.
+ */
+
+#include "audio_player.h"
+#include "bt_avrcp.h"
+#include "esp_timer.h"
+#include "fake_avrc.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include "volume_ctrl.h"
+
+#define SINK_RSP_US (30 * 1000LL)
+#define REPEAT_US (150 * 1000LL) // BTN_REPEAT_US in button_control.c
+#define RSP_TIMEOUT_US (1000 * 1000LL) // VOLUME_RSP_TIMEOUT_US
+#define HOLD_STEPS 20
+
+static bool s_answering = true;
+static uint8_t s_rsp_fifo[4];
+static int s_rsp_cnt;
+static esp_timer_handle_t s_rsp_tmr;
+
+static void sink_answer(void *arg) {
+  fake_avrc_volume_rsp(s_rsp_fifo[0]);
+  for (int i = 1; i < s_rsp_cnt; i++) {
+    s_rsp_fifo[i - 1] = s_rsp_fifo[i];
+  }
+  if (--s_rsp_cnt > 0) {
+    esp_timer_start_once(s_rsp_tmr, SINK_RSP_US);
+  }
+}
+
+static void sink_volume(uint8_t tl, uint8_t volume) {
+  if (!s_answering || s_rsp_cnt == 4) {
+    return;
+  }
+  s_rsp_fifo[s_rsp_cnt++] = volume;
+  if (!esp_timer_is_active(s_rsp_tmr)) {
+    esp_timer_start_once(s_rsp_tmr, SINK_RSP_US);
+  }
+}
+
+static void test_held_key_merges(void) {
+  fake_avrc_reset();
+  uint8_t vol = audio_player_get_volume();
+  for (int i = 0; i < HOLD_STEPS; i++) {
+    vol += 5;
+    volume_ctrl_set_local(vol);
+    host_stub_advance_us(REPEAT_US);
+  }
+  host_stub_advance_us(RSP_TIMEOUT_US);
+  int sent = fake_avrc_calls()->abs_volumes;
+  printf("held key: %d steps -> %d commands\n", HOLD_STEPS, sent);
+  CHECK(sent < HOLD_STEPS);
+  CHECK_EQ(fake_avrc_calls()->last_abs_volume, vol);
+}
+
+static void test_unanswered_resent(void) {
+  fake_avrc_reset();
+  s_answering = false;
+  // Two commands in flight, the third change waits for a response
+  volume_ctrl_set_local(60);
+  host_stub_advance_us(REPEAT_US * 2);
+  volume_ctrl_set_local(65);
+  host_stub_advance_us(REPEAT_US * 2);
+  volume_ctrl_set_local(70);
+  host_stub_advance_us(REPEAT_US * 2);
+  CHECK_EQ(fake_avrc_calls()->abs_volumes, 2);
+  CHECK_EQ(fake_avrc_calls()->last_abs_volume, 65);
+
+  // Neither is answered: the target goes out when the timeout fires
+  host_stub_advance_us(RSP_TIMEOUT_US);
+  CHECK_EQ(fake_avrc_calls()->abs_volumes, 3);
+  CHECK_EQ(fake_avrc_calls()->last_abs_volume, 70);
+
+  // Retries are bounded against a sink that never answers
+  host_stub_advance_us(10 * RSP_TIMEOUT_US);
+  int sent = fake_avrc_calls()->abs_volumes;
+  CHECK(sent <= 4);
+
+  // Once it answers again the next change goes through at once
+  s_answering = true;
+  volume_ctrl_set_local(75);
+  host_stub_advance_us(REPEAT_US * 2);
+  CHECK_EQ(fake_avrc_calls()->abs_volumes, sent + 1);
+  CHECK_EQ(fake_avrc_calls()->last_abs_volume, 75);
+}
+
+static void test_timeout_then_answer(void) {
+  fake_avrc_reset();
+  s_answering = false;
+  volume_ctrl_set_local(40);
+  host_stub_advance_us(REPEAT_US * 2);
+  CHECK_EQ(fake_avrc_calls()->abs_volumes, 1);
+  // The re-send is answered; nothing more goes out
+  s_answering = true;
+  host_stub_advance_us(RSP_TIMEOUT_US);
+  CHECK_EQ(fake_avrc_calls()->abs_volumes, 2);
+  host_stub_advance_us(5 * RSP_TIMEOUT_US);
+  CHECK_EQ(fake_avrc_calls()->abs_volumes, 2);
+  CHECK_EQ(fake_avrc_calls()->last_abs_volume, 40);
+}
+
+int main(void) {
+  const esp_timer_create_args_t args = {.callback = sink_answer,
+                                        .name = "sinkRsp"};
+  esp_timer_create(&args, &s_rsp_tmr);
+  bt_avrcp_init();
+  fake_avrc_set_volume_hook(sink_volume);
+
+  // A sink with absolute volume, the initial level answered
+  host_stub_advance_us(1000 * 1000);
+  fake_avrc_conn_state(true);
+  fake_avrc_rn_caps(1 << ESP_AVRC_RN_VOLUME_CHANGE);
+  host_stub_advance_us(1000 * 1000);
+  CHECK_EQ(audio_player_get_volume_mode(), AUDIO_VOLUME_ABSOLUTE);
+  CHECK_EQ(fake_avrc_calls()->abs_volumes, 1);
+
+  test_held_key_merges();
+  test_unanswered_resent();
+  test_timeout_then_answer();
+  return TEST_RESULT();
+}
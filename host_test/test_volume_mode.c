@@ -0,0 +1,133 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Volume ownership: bt_avrcp.c hands the volume to a sink that offers
+ * absolute volume and takes it back otherwise, and the data callback's
+ * gain (pcm_gain.c) then passes PCM bit-exact or scales it. Also times one
+ * data callback's worth of PCM in each mode.
+ */
+
+#include "audio_player.h"
+#include "bt_avrcp.h"
+#include "esp_timer.h"
+#include "fake_avrc.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include "pcm_gain.h"
+#include "volume_ctrl.h"
+#include <string.h>
+#include <time.h>
+
+#define FRAME_SAMPLES 256 // a 512-byte data callback
+#define BENCH_CALLS 20000
+#define INITIAL_VOLUME 20 // bt_avrcp.c
+
+static int16_t s_frame[FRAME_SAMPLES];
+
+/* Run a callback's PCM through the gain the player would use now */
+static void player_gain(int16_t *pcm, float track_gain) {
+  pcm_gain_apply(pcm, FRAME_SAMPLES,
+                 pcm_gain_for(audio_player_get_volume_mode(), track_gain,
+                              audio_player_get_volume()));
+}
+
+static bool passes_untouched(float track_gain) {
+  int16_t pcm[FRAME_SAMPLES];
+  memcpy(pcm, s_frame, sizeof(pcm));
+  player_gain(pcm, track_gain);
+  return memcmp(pcm, s_frame, sizeof(pcm)) == 0;
+}
+
+static void connect_sink(uint16_t rn_caps) {
+  fake_avrc_reset();
+  fake_avrc_conn_state(true);
+  CHECK_EQ(fake_avrc_calls()->cap_queries, 1);
+  fake_avrc_rn_caps(rn_caps);
+  host_stub_advance_us(1000 * 1000);
+}
+
+static void test_absolute_volume_sink(void) {
+  connect_sink(1 << ESP_AVRC_RN_VOLUME_CHANGE);
+  CHECK_EQ(audio_player_get_volume_mode(), AUDIO_VOLUME_ABSOLUTE);
+  CHECK_EQ(audio_player_get_volume(), INITIAL_VOLUME);
+  // The level goes to the sink; the PCM is not touched at any volume
+  CHECK_EQ(fake_avrc_calls()->abs_volumes, 1);
+  CHECK_EQ(fake_avrc_calls()->last_abs_volume, INITIAL_VOLUME);
+  CHECK(passes_untouched(1.0f));
+  volume_ctrl_set_local(127);
+  CHECK(passes_untouched(1.0f));
+
+  // A track's loudness gain still applies, but not the volume
+  int16_t pcm[FRAME_SAMPLES];
+  memcpy(pcm, s_frame, sizeof(pcm));
+  player_gain(pcm, 0.5f);
+  CHECK_EQ(pcm[FRAME_SAMPLES - 1], s_frame[FRAME_SAMPLES - 1] / 2);
+}
+
+static void test_software_volume_sink(void) {
+  fake_avrc_conn_state(false);
+  CHECK_EQ(audio_player_get_volume_mode(), AUDIO_VOLUME_SOFTWARE);
+
+  connect_sink(1 << ESP_AVRC_RN_PLAY_STATUS_CHANGE);
+  CHECK_EQ(audio_player_get_volume_mode(), AUDIO_VOLUME_SOFTWARE);
+  CHECK_EQ(fake_avrc_calls()->abs_volumes, 0);
+  CHECK(!passes_untouched(1.0f));
+  int16_t pcm[FRAME_SAMPLES];
+  memcpy(pcm, s_frame, sizeof(pcm));
+  player_gain(pcm, 1.0f);
+  CHECK_EQ(pcm[FRAME_SAMPLES - 1],
+           (int16_t)(s_frame[FRAME_SAMPLES - 1] * (INITIAL_VOLUME / 127.0f)));
+  // Full volume in software is unity too
+  volume_ctrl_set_local(127);
+  CHECK(passes_untouched(1.0f));
+}
+
+static void test_reconnect_switches_back(void) {
+  fake_avrc_conn_state(false);
+  connect_sink(1 << ESP_AVRC_RN_VOLUME_CHANGE |
+               1 << ESP_AVRC_RN_TRACK_CHANGE);
+  CHECK_EQ(audio_player_get_volume_mode(), AUDIO_VOLUME_ABSOLUTE);
+  fake_avrc_conn_state(false);
+  CHECK_EQ(audio_player_get_volume_mode(), AUDIO_VOLUME_SOFTWARE);
+}
+
+static int64_t bench_ns(audio_volume_mode_t mode) {
+  static int16_t pcm[FRAME_SAMPLES];
+  volatile int32_t sink = 0;
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < BENCH_CALLS; i++) {
+    memcpy(pcm, s_frame, sizeof(pcm));
+    pcm_gain_apply(pcm, FRAME_SAMPLES,
+                   pcm_gain_for(mode, 1.0f, INITIAL_VOLUME));
+    sink += pcm[i % FRAME_SAMPLES];
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return ((t1.tv_sec - t0.tv_sec) * 1000000000LL + t1.tv_nsec - t0.tv_nsec) /
+         BENCH_CALLS;
+}
+
+static void test_callback_cost(void) {
+  int64_t sw_ns = bench_ns(AUDIO_VOLUME_SOFTWARE);
+  int64_t abs_ns = bench_ns(AUDIO_VOLUME_ABSOLUTE);
+  printf("512-byte callback: %lld ns software volume, %lld ns absolute\n",
+         (long long)sw_ns, (long long)abs_ns);
+  CHECK(abs_ns < sw_ns);
+}
+
+int main(void) {
+  for (int i = 0; i < FRAME_SAMPLES; i++) {
+    s_frame[i] = (int16_t)(i * 257 - 32768); // full scale ramp
+  }
+  bt_avrcp_init();
+
+  test_absolute_volume_sink();
+  test_software_volume_sink();
+  test_reconnect_switches_back();
+  test_callback_cost();
+  return TEST_RESULT();
+}
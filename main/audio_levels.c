@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "audio_levels.h"
+#include "esp_timer.h"
+#include "granule.h"
+#include <stdatomic.h>
+#include <string.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+// Energy gain of minimp3's synthesis filterbank to PCM at 1.0 = 32768
+#define LEVELS_SYNTH_GAIN 128.0f
+// Peak hold release per granule (~13 ms): about 35 dB/s
+#define LEVELS_DECAY 0.9f
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+/* First subband of each display band; the last one runs to subband 31 */
+static const uint8_t s_band_start[AUDIO_LEVELS_BANDS] = {
+    0, 1, 2, 3, 4, 5, 6, 8, 10, 12, 14, 17, 20, 23, 26, 29,
+};
+
+/* Single writer (decode task): odd while a write is in progress */
+static atomic_uint_least32_t s_seq = 0;
+static audio_levels_t s_levels;
+
+/* Decode task only */
+static audio_levels_t s_hold;
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void audio_levels_granule(const float *grbuf, int nsamples, int nch) {
+  float sb_energy[GRANULE_SUBBANDS] = {0};
+  float ch_energy[2] = {0};
+
+  for (int ch = 0; ch < nch; ch++) {
+    const float *x = grbuf + ch * GRANULE_CH_STRIDE;
+    float total = 0;
+    for (int sb = 0; sb < GRANULE_SUBBANDS; sb++) {
+      const float *y = x + sb * GRANULE_SUBBAND_STRIDE;
+      float e = 0;
+      for (int i = 0; i < nsamples; i++) {
+        e += y[i] * y[i];
+      }
+      sb_energy[sb] += e;
+      total += e;
+    }
+    ch_energy[ch] = total;
+  }
+  if (nch == 1) {
+    ch_energy[1] = ch_energy[0];
+  }
+
+  // Mean square per output sample, in PCM full-scale units
+  float norm = LEVELS_SYNTH_GAIN / (nsamples * GRANULE_SUBBANDS);
+  for (int ch = 0; ch < 2; ch++) {
+    float e = ch_energy[ch] * norm;
+    float held = s_hold.vu[ch] * LEVELS_DECAY;
+    s_hold.vu[ch] = e > held ? e : held;
+  }
+  norm /= nch;
+  for (int b = 0; b < AUDIO_LEVELS_BANDS; b++) {
+    int end = (b + 1 < AUDIO_LEVELS_BANDS) ? s_band_start[b + 1]
+                                           : GRANULE_SUBBANDS;
+    float e = 0;
+    for (int sb = s_band_start[b]; sb < end; sb++) {
+      e += sb_energy[sb];
+    }
+    e *= norm;
+    float held = s_hold.band[b] * LEVELS_DECAY;
+    s_hold.band[b] = e > held ? e : held;
+  }
+  s_hold.updated_us = esp_timer_get_time();
+
+  uint32_t seq = atomic_load_explicit(&s_seq, memory_order_relaxed);
+  atomic_store_explicit(&s_seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy((void *)&s_levels, &s_hold, sizeof(s_levels));
+  atomic_store_explicit(&s_seq, seq + 2, memory_order_release);
+}
+
+void audio_levels_read(audio_levels_t *levels) {
+  uint32_t seq0;
+  uint32_t seq1;
+
+  do {
+    seq0 = atomic_load_explicit(&s_seq, memory_order_acquire);
+    if (seq0 & 1) {
+      continue;
+    }
+    memcpy(levels, (const void *)&s_levels, sizeof(*levels));
+    atomic_thread_fence(memory_order_acquire);
+    seq1 = atomic_load_explicit(&s_seq, memory_order_relaxed);
+  } while ((seq0 & 1) || seq0 != seq1);
+
+  if (esp_timer_get_time() - levels->updated_us >
+      AUDIO_LEVELS_STALE_MS * 1000LL) {
+    memset(levels, 0, sizeof(*levels));
+  }
+}
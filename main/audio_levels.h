@@ -0,0 +1,53 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __AUDIO_LEVELS_H__
+#define __AUDIO_LEVELS_H__
+
+#include <stdint.h>
+
+/*
+ * Level meter and coarse spectrum taken from the decoder's subband samples.
+ *
+ * The polyphase filterbank already splits every granule into 32 bands, so
+ * summing squares there gives per-channel and per-band energy without an
+ * FFT on the PCM. Values are measured before the software volume and lead
+ * what is heard by the depth of the PCM ring buffer.
+ */
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define AUDIO_LEVELS_BANDS 16
+#define AUDIO_LEVELS_STALE_MS 500 // no granule for this long reads as silence
+
+/**
+ * @brief Snapshot of the decayed peak energies
+ *
+ * Energies are mean squares relative to decoder full scale (1.0 ~ 0 dBFS).
+ */
+typedef struct {
+  float vu[2];                     /*!< left, right (mono duplicates left) */
+  float band[AUDIO_LEVELS_BANDS];  /*!< lowest band first */
+  int64_t updated_us;              /*!< esp_timer time of the last granule */
+} audio_levels_t;
+
+/**
+ * @brief Measure one granule and publish the result (decode task only)
+ *
+ * Same arguments as the minimp3 granule hook; call after any processing
+ * that should show on the meter (the EQ).
+ */
+void audio_levels_granule(const float *grbuf, int nsamples, int nch);
+
+/**
+ * @brief Read a consistent snapshot without blocking the decoder
+ *
+ * @param levels Output snapshot, all zero when nothing was decoded recently
+ */
+void audio_levels_read(audio_levels_t *levels);
+
+#endif /* __AUDIO_LEVELS_H__ */
@@ -5,12 +5,32 @@
  */
 
 #include "audio_player.h"
+#include "audio_levels.h"
+#include "boot_timeline.h"
+#include "buffer_depth.h"
 #include "common.h"
+#include "crossfade.h"
+#include "eq.h"
+#include "esp_cpu.h"
 #include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "mem_budget.h"
+#include "mp3_info.h"
+#include "mp3_prime.h"
+#include "pcm_gain.h"
+#include "play_clock.h"
 #include "freertos/ringbuf.h"
 #include "freertos/task.h"
+#include "intro_cache.h"
+#include "loudness.h"
+#include "player_status.h"
+#include "resume.h"
+#include "scrub.h"
 #include "sd_card.h"
+#include "trace.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,13 +38,44 @@
 #define MINIMP3_IMPLEMENTATION
 #define MINIMP3_ONLY_MP3
 #define MINIMP3_NO_SIMD
+// Equalize and meter in the subband domain, between dequantization and
+// synthesis (grbuf layout in granule.h)
+static uint32_t s_meter_frame_cycles; // decode task only
+static bool s_decoding_tail;          // decode task only
+static eq_stream_t *s_hook_eq;        // gains of the decoder in the hook
+static TaskHandle_t s_decode_task_handle;
+static inline void audio_granule_hook(float *grbuf, int n, int nch) {
+  if (xTaskGetCurrentTaskHandle() != s_decode_task_handle) {
+    return; // the loudness scan decodes on its own task
+  }
+  eq_apply(s_hook_eq, grbuf, n, nch);
+  if (s_decoding_tail) {
+    return; // the meter follows the incoming track through a crossfade
+  }
+  esp_cpu_cycle_count_t c0 = esp_cpu_get_cycle_count();
+  audio_levels_granule(grbuf, n, nch);
+  s_meter_frame_cycles += esp_cpu_get_cycle_count() - c0;
+}
+#define MINIMP3_GRANULE_HOOK(grbuf, n, nch) audio_granule_hook(grbuf, n, nch)
 #include "minimp3.h"
 
 /*********************************
  * CONSTANTS
  ********************************/
-#define RINGBUF_SIZE (32 * 1024) // 32KB for smoother playback
-#define INPUT_BUF_SIZE (4 * 1024)
+#define RINGBUF_SIZE (32 * 1024) // upper bound for the adaptive depth
+#define INPUT_BUF_SIZE (4 * 1024) // holds a whole INTRO_CACHE_BYTES intro
+#define DECODE_TASK_STACK (32 * 1024)
+
+// Adaptive buffer depth (policy in buffer_depth.h)
+#define BUF_ADAPT_INTERVAL_MS 1000
+#define BUF_METRICS_INTERVAL_MS 10000
+
+// Resume points
+#define RESUME_CHECK_INTERVAL_MS 1000
+
+// Crossfade
+#define XFADE_DECODERS (CROSSFADE_MS > 0 ? 2 : 1)
+#define XFADE_LOAD_FRAMES 8 // ~200 ms window for the peak decode load
 
 /*********************************
  * MODULE VARIABLES
@@ -38,14 +89,392 @@ bool s_prev_song_req = false;
  * STATIC VARIABLES
  ********************************/
 static RingbufHandle_t s_ringbuf_handle = NULL;
-static mp3dec_t s_mp3d;
+static mp3dec_t s_mp3d[XFADE_DECODERS];
+static eq_stream_t s_eq[XFADE_DECODERS]; // ramp state follows the decoder
+MEM_STATIC_TASK(s_decode_task, DECODE_TASK_STACK);
+#if CONFIG_EXAMPLE_STATIC_MEMORY
+static int16_t s_pcm_buf[MINIMP3_MAX_SAMPLES_PER_FRAME];
+static uint8_t s_input_buf[XFADE_DECODERS][INPUT_BUF_SIZE];
+#if CROSSFADE_MS
+static int16_t s_tail_pcm_buf[MINIMP3_MAX_SAMPLES_PER_FRAME];
+#endif
+static uint8_t s_ringbuf_storage[RINGBUF_SIZE];
+static StaticRingbuffer_t s_ringbuf_struct;
+#endif
 int s_current_song_idx = 0; // Global for OLED access
 
+// Inputs to the depth decision. The callback side is written from the BT
+// task, the SD side from the decode task; both are read under the lock.
+static portMUX_TYPE s_buf_lock = portMUX_INITIALIZER_UNLOCKED;
+static buffer_depth_t s_depth = BUFFER_DEPTH_INITIALIZER(RINGBUF_SIZE);
+
+// Data-callback cost per volume mode, also under s_buf_lock
+static volatile audio_volume_mode_t s_volume_mode = AUDIO_VOLUME_SOFTWARE;
+static uint64_t s_cb_cycles[AUDIO_VOLUME_MODE_NUM];
+static uint32_t s_cb_calls[AUDIO_VOLUME_MODE_NUM];
+
+// Decode cost per frame with the EQ bypassed [0] and active [1]
+static uint64_t s_dec_cycles[2];
+static uint32_t s_dec_frames[2];
+static uint64_t s_meter_cycles; // part of the above spent on the level meter
+
+// Playback position (play_clock.c), under s_buf_lock
+static play_clock_t s_clock;
+static float s_play_gain = 1.0f; // s_clock.cur.gain for the data callback
+
+// Where recently decoded frames start in the file (decode task only), to
+// turn the playback position into a resume point
+static resume_marks_t s_marks;
+
+// Scrubbing: direction set by the button task, session stats kept by the
+// decode task for the cost report
+static volatile int s_scrub_dir = 0;
+static volatile int64_t s_scrub_start_us = 0;
+static struct {
+  bool active;
+  int64_t start_us;
+  uint64_t start_sample;
+  uint64_t cycles; // header walks plus snippet decoding
+  uint32_t jumps;
+  int max_speed;
+} s_scrub;
+
+// Crossfade: the outgoing track keeps a decoder, input buffer and file of
+// its own while the next one starts (decode task only)
+typedef struct {
+  bool active;
+  FILE *f; // NULL once the file is read to the end
+  mp3dec_t *dec;
+  uint8_t *in;
+  int valid;
+  bool eof;
+  int16_t *pcm;
+  uint32_t hz;
+  int channels;
+  float gain;   // the outgoing track's loudness gain
+  uint32_t pos; // fade samples mixed so far
+  uint32_t len;
+  // Decode load of both streams against real time
+  uint64_t cycles;
+  uint64_t samples;
+  uint64_t tail_cycles;
+  uint32_t tail_frames;
+  uint64_t win_cycles;
+  uint32_t win_samples;
+  uint32_t win_frames;
+  uint32_t peak_pct;
+} xfade_tail_t;
+
+static xfade_tail_t s_xfade;
+
+static const char *s_buf_reason_str[] = {
+    [AUDIO_BUF_REASON_INIT] = "initial",
+    [AUDIO_BUF_REASON_CB_JITTER] = "callback jitter",
+    [AUDIO_BUF_REASON_SD_LATENCY] = "sd read latency",
+    [AUDIO_BUF_REASON_UNDERRUN] = "underrun",
+    [AUDIO_BUF_REASON_SHRINK] = "stable link, shrinking",
+};
+
 /*********************************
  * STATIC FUNCTIONS
  ********************************/
+static uint32_t buffered_bytes(void) {
+  return RINGBUF_SIZE - xRingbufferGetCurFreeSize(s_ringbuf_handle);
+}
+
+/* Re-pick the depth the decode task fills up to, and log the metrics */
+static void buffer_adapt(void) {
+  static int64_t s_last_adapt_us = 0;
+  static int64_t s_last_log_us = 0;
+  int64_t now = esp_timer_get_time();
+  if (now - s_last_adapt_us < BUF_ADAPT_INTERVAL_MS * 1000) {
+    return;
+  }
+  s_last_adapt_us = now;
+
+  portENTER_CRITICAL(&s_buf_lock);
+  buffer_depth_adapt(&s_depth, now);
+  audio_buffer_metrics_t m = s_depth.m;
+  uint32_t sw_avg = s_cb_calls[AUDIO_VOLUME_SOFTWARE]
+                        ? s_cb_cycles[AUDIO_VOLUME_SOFTWARE] /
+                              s_cb_calls[AUDIO_VOLUME_SOFTWARE]
+                        : 0;
+  uint32_t abs_avg = s_cb_calls[AUDIO_VOLUME_ABSOLUTE]
+                         ? s_cb_cycles[AUDIO_VOLUME_ABSOLUTE] /
+                               s_cb_calls[AUDIO_VOLUME_ABSOLUTE]
+                         : 0;
+  uint32_t dec_avg[2];
+  for (int i = 0; i < 2; i++) {
+    dec_avg[i] = s_dec_frames[i] ? s_dec_cycles[i] / s_dec_frames[i] : 0;
+  }
+  uint32_t dec_frames = s_dec_frames[0] + s_dec_frames[1];
+  uint64_t dec_cycles = s_dec_cycles[0] + s_dec_cycles[1];
+  uint32_t meter_avg = dec_frames ? s_meter_cycles / dec_frames : 0;
+  uint32_t meter_pct100 =
+      dec_cycles ? (uint32_t)(s_meter_cycles * 10000 / dec_cycles) : 0;
+  portEXIT_CRITICAL(&s_buf_lock);
+
+  if (now - s_last_log_us >= BUF_METRICS_INTERVAL_MS * 1000) {
+    s_last_log_us = now;
+    ESP_LOGI(BT_AV_TAG,
+             "buffer target %" PRIu32 " B (%" PRIu32 " ms, %s): cb %" PRIu32
+             " us +/- %" PRIu32 " us, sd peak %" PRIu32 " us, sink %" PRIu32
+             ".%" PRIu32 " ms, fill %" PRIu32 " B, underruns %" PRIu32,
+             m.target_bytes, m.target_ms, s_buf_reason_str[m.reason],
+             m.cb_interval_us, m.cb_jitter_us, m.sd_read_peak_us,
+             m.sink_delay_01ms / 10, m.sink_delay_01ms % 10, m.fill_avg_bytes,
+             m.underruns);
+    ESP_LOGI(BT_AV_TAG,
+             "data callback cycles: software volume %" PRIu32
+             ", absolute volume %" PRIu32 " (avg)",
+             sw_avg, abs_avg);
+    ESP_LOGI(BT_AV_TAG,
+             "decode cycles/frame: eq off %" PRIu32 ", eq on %" PRIu32
+             " (avg, preset %s)",
+             dec_avg[0], dec_avg[1], eq_preset_name(eq_get_preset()));
+    ESP_LOGI(BT_AV_TAG,
+             "level meter cycles/frame: %" PRIu32 " (%" PRIu32 ".%02" PRIu32
+             "%% of decode)",
+             meter_avg, meter_pct100 / 100, meter_pct100 % 100);
+  }
+}
+
+/* Start the clock of the track whose first PCM is about to be queued */
+static void clock_track_begin(uint32_t hz, int channels, uint32_t duration_ms,
+                              uint64_t base, float gain) {
+  portENTER_CRITICAL(&s_buf_lock);
+  play_clock_track_begin(&s_clock, hz, channels, duration_ms, base, gain);
+  portEXIT_CRITICAL(&s_buf_lock);
+}
+
+/* Sample the callback has reached, if it is in the track being decoded */
+static bool clock_decoding_track_sample(uint64_t *sample) {
+  portENTER_CRITICAL(&s_buf_lock);
+  bool ok = play_clock_decoding_sample(&s_clock, sample);
+  portEXIT_CRITICAL(&s_buf_lock);
+  return ok;
+}
+
+/*
+ * Save the start of the frame being heard. Frame starts are only known for
+ * the last RESUME_MARKS frames, which covers the ring buffer depth.
+ */
+static void resume_checkpoint(uint32_t path_hash, bool urgent) {
+  uint64_t sample;
+  resume_point_t point;
+  if (clock_decoding_track_sample(&sample) &&
+      resume_point_pick(&s_marks, path_hash, sample, &point)) {
+    resume_save(&point, urgent);
+  }
+}
+
+/* Refine the duration of the track being decoded */
+static void clock_set_duration(uint32_t duration_ms) {
+  portENTER_CRITICAL(&s_buf_lock);
+  play_clock_set_duration(&s_clock, duration_ms);
+  portEXIT_CRITICAL(&s_buf_lock);
+}
+
+/* Log how far a scrub session went and what it cost against normal play */
+static void scrub_report(uint64_t end_sample, uint32_t hz, int frame_samples) {
+  int64_t elapsed_us = esp_timer_get_time() - s_scrub.start_us;
+  if (elapsed_us <= 0 || hz == 0) {
+    return;
+  }
+  int64_t moved_ms =
+      ((int64_t)end_sample - (int64_t)s_scrub.start_sample) * 1000 / hz;
+  uint64_t budget = (uint64_t)elapsed_us * esp_rom_get_cpu_ticks_per_us();
+
+  portENTER_CRITICAL(&s_buf_lock);
+  uint32_t frames = s_dec_frames[0] + s_dec_frames[1];
+  uint64_t cycles = s_dec_cycles[0] + s_dec_cycles[1];
+  portEXIT_CRITICAL(&s_buf_lock);
+  // Decoding in real time takes hz / frame_samples frames per second
+  uint64_t play_per_s = frames ? cycles / frames * hz / frame_samples : 0;
+  uint64_t cpu_per_s = esp_rom_get_cpu_ticks_per_us() * 1000000ULL;
+
+  int speed10 = abs((int)(moved_ms * 10000 / elapsed_us));
+  ESP_LOGI(BT_AV_TAG,
+           "scrub: %+" PRId64 " ms in %" PRId64
+           " ms (%d.%dx, up to %dx), %" PRIu32 " jumps, cpu %" PRIu32
+           "%% vs %" PRIu32 "%% for normal play",
+           moved_ms, elapsed_us / 1000, speed10 / 10, speed10 % 10,
+           s_scrub.max_speed, s_scrub.jumps,
+           (uint32_t)(s_scrub.cycles * 100 / budget),
+           (uint32_t)(play_per_s * 100 / cpu_per_s));
+}
+
+/* CPU cycles it takes to play samples at hz in real time */
+static uint64_t realtime_cycles(uint64_t samples, uint32_t hz) {
+  return samples * esp_rom_get_cpu_ticks_per_us() * 1000000ULL / hz;
+}
+
+/* Hand the playing track over to the fade-out; it keeps its buffers */
+static void xfade_begin(FILE *f, mp3dec_t **dec, uint8_t **in, int valid,
+                        uint32_t hz, int channels, float gain) {
+  xfade_tail_t *t = &s_xfade;
+  mp3dec_t *spare_dec = t->dec;
+  uint8_t *spare_in = t->in;
+  int16_t *pcm = t->pcm;
+  memset(t, 0, sizeof(*t));
+  t->dec = *dec;
+  t->in = *in;
+  t->pcm = pcm;
+  *dec = spare_dec;
+  *in = spare_in;
+
+  t->active = true;
+  t->f = f;
+  t->valid = valid;
+  t->hz = hz;
+  t->channels = channels;
+  t->gain = gain;
+  t->len = (uint64_t)CROSSFADE_MS * hz / 1000;
+  ESP_LOGI(BT_AV_TAG, "crossfade: %d ms into the next track", CROSSFADE_MS);
+}
+
+static void xfade_end(const char *why) {
+  xfade_tail_t *t = &s_xfade;
+  if (!t->active) {
+    return;
+  }
+  t->active = false;
+  if (t->f) {
+    fclose(t->f);
+    t->f = NULL;
+  }
+  if (t->samples == 0) {
+    ESP_LOGI(BT_AV_TAG, "crossfade %s", why);
+    return;
+  }
+  ESP_LOGI(BT_AV_TAG,
+           "crossfade %s after %" PRIu32 " ms: decode load avg %" PRIu32
+           "%%, peak %" PRIu32 "%% (per %d frames), outgoing track %" PRIu32
+           " cycles/frame",
+           why, (uint32_t)(t->pos * 1000ULL / t->hz),
+           (uint32_t)(t->cycles * 100 / realtime_cycles(t->samples, t->hz)),
+           t->peak_pct, XFADE_LOAD_FRAMES,
+           t->tail_frames ? (uint32_t)(t->tail_cycles / t->tail_frames) : 0);
+}
+
+/* Next frame of the outgoing track into its own PCM buffer, 0 at the end */
+static int xfade_tail_decode(void) {
+  xfade_tail_t *t = &s_xfade;
+  while (!t->eof) {
+    if (t->f && t->valid < INPUT_BUF_SIZE) {
+      int read = fread(t->in + t->valid, 1, INPUT_BUF_SIZE - t->valid, t->f);
+      if (read == 0) {
+        fclose(t->f);
+        t->f = NULL;
+      }
+      t->valid += read;
+    }
+
+    mp3dec_frame_info_t info;
+    esp_cpu_cycle_count_t c0 = esp_cpu_get_cycle_count();
+    s_decoding_tail = true;
+    s_hook_eq = &s_eq[t->dec - s_mp3d];
+    int samples = mp3dec_decode_frame(t->dec, t->in, t->valid, t->pcm, &info);
+    s_decoding_tail = false;
+    t->tail_cycles += esp_cpu_get_cycle_count() - c0;
+
+    int consumed = info.frame_bytes;
+    if (consumed > 0 && consumed <= t->valid) {
+      memmove(t->in, t->in + consumed, t->valid - consumed);
+      t->valid -= consumed;
+    } else if (!t->f) {
+      t->eof = true; // nothing decodable left
+    } else if (t->valid == INPUT_BUF_SIZE) {
+      memmove(t->in, t->in + 1, t->valid - 1);
+      t->valid--;
+    }
+    if (samples > 0) {
+      t->tail_frames++;
+      return samples;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Mix the outgoing track under a frame of the incoming one and keep the
+ * decode load of both (dec_cycles is the incoming frame's decode). The
+ * mix is played at the incoming track's loudness gain, so the tail is
+ * scaled by the ratio of the two to carry on at its own level.
+ */
+static void xfade_mix(int16_t *pcm, int samples, uint32_t hz, int channels,
+                      float gain, uint32_t dec_cycles) {
+  xfade_tail_t *t = &s_xfade;
+  if (hz != t->hz || channels != t->channels) {
+    xfade_end("skipped, the tracks differ in format");
+    return;
+  }
+  esp_cpu_cycle_count_t c0 = esp_cpu_get_cycle_count();
+  int tail_samples = xfade_tail_decode();
+  if (tail_samples > 0 && gain > 0.0f) {
+    pcm_gain_apply(t->pcm, tail_samples * channels, t->gain / gain);
+  }
+  crossfade_mix(pcm, tail_samples > 0 ? t->pcm : NULL, tail_samples, samples,
+                channels, t->pos, t->len);
+  uint32_t cycles = dec_cycles + (esp_cpu_get_cycle_count() - c0);
+
+  t->cycles += cycles;
+  t->samples += samples;
+  t->win_cycles += cycles;
+  t->win_samples += samples;
+  if (++t->win_frames == XFADE_LOAD_FRAMES) {
+    uint32_t pct =
+        t->win_cycles * 100 / realtime_cycles(t->win_samples, hz);
+    if (pct > t->peak_pct) {
+      t->peak_pct = pct;
+    }
+    t->win_cycles = 0;
+    t->win_samples = 0;
+    t->win_frames = 0;
+  }
+
+  t->pos += samples;
+  if (t->pos >= t->len) {
+    xfade_end("done");
+  }
+}
+
+/* Wait until a frame fits under the target depth (or playback changes) */
+static void buffer_wait_room(size_t pcm_size) {
+  for (;;) {
+    portENTER_CRITICAL(&s_buf_lock);
+    uint32_t target = s_depth.m.target_bytes;
+    portEXIT_CRITICAL(&s_buf_lock);
+    if (buffered_bytes() + pcm_size <= target || !s_is_playing ||
+        s_next_song_req || s_prev_song_req) {
+      return;
+    }
+    vTaskDelay(pdMS_TO_TICKS(5));
+  }
+}
+
+/* Queue PCM for the data callback, keeping the ring at the adaptive depth */
+static bool queue_pcm(const int16_t *pcm, size_t pcm_size) {
+  buffer_adapt();
+  buffer_wait_room(pcm_size);
+  if (xRingbufferSend(s_ringbuf_handle, pcm, pcm_size, portMAX_DELAY) !=
+      pdTRUE) {
+    ESP_LOGW(BT_AV_TAG, "Ringbuffer send failed");
+    return false;
+  }
+  portENTER_CRITICAL(&s_buf_lock);
+  play_clock_queued(&s_clock, pcm_size);
+  portEXIT_CRITICAL(&s_buf_lock);
+  return true;
+}
+
 static void mp3_decode_task(void *arg) {
+  s_decode_task_handle = xTaskGetCurrentTaskHandle();
+  // Mounting and scanning here runs in parallel with the BT bring-up
+  sd_card_init();
+  boot_mark("sd mounted");
   sd_card_scan_playlist();
+  boot_mark("playlist loaded");
 
   if (sd_card_get_playlist_count() == 0) {
     ESP_LOGE(BT_AV_TAG, "No MP3 files found");
@@ -53,7 +482,39 @@ static void mp3_decode_task(void *arg) {
     return;
   }
 
-  mp3dec_init(&s_mp3d);
+  // Pick up where the last session stopped, if the file is still there
+  resume_point_t resume_pt;
+  bool resume = resume_load(&resume_pt);
+  if (resume) {
+    resume = false;
+    for (int i = 0; i < sd_card_get_playlist_count(); i++) {
+      if (resume_path_hash(sd_card_get_file_path(i)) == resume_pt.path_hash) {
+        s_current_song_idx = i;
+        resume = true;
+        break;
+      }
+    }
+    ESP_LOGI(BT_AV_TAG, "resume: %s",
+             resume ? sd_card_get_file_path(s_current_song_idx)
+                    : "saved track not found");
+  }
+  intro_cache_init();
+  loudness_init((s_current_song_idx + 1) % sd_card_get_playlist_count());
+
+  mp3dec_t *dec = &s_mp3d[0];
+  mp3dec_init(dec);
+  for (int i = 0; i < XFADE_DECODERS; i++) {
+    eq_stream_init(&s_eq[i]);
+  }
+  s_xfade.dec = &s_mp3d[XFADE_DECODERS - 1];
+#if CONFIG_EXAMPLE_STATIC_MEMORY
+  int16_t *pcm_buf = s_pcm_buf;
+  uint8_t *input_buf = s_input_buf[0];
+#if CROSSFADE_MS
+  s_xfade.in = s_input_buf[1];
+  s_xfade.pcm = s_tail_pcm_buf;
+#endif
+#else
   int16_t *pcm_buf = malloc(MINIMP3_MAX_SAMPLES_PER_FRAME * sizeof(int16_t));
   if (!pcm_buf) {
     ESP_LOGE(BT_AV_TAG, "Failed to allocate pcm buffer");
@@ -69,6 +530,19 @@ static void mp3_decode_task(void *arg) {
     return;
   }
 
+  if (CROSSFADE_MS > 0) {
+    s_xfade.in = malloc(INPUT_BUF_SIZE);
+    s_xfade.pcm = malloc(MINIMP3_MAX_SAMPLES_PER_FRAME * sizeof(int16_t));
+    if (!s_xfade.in || !s_xfade.pcm) {
+      ESP_LOGW(BT_AV_TAG, "No memory for the crossfade, playing gapless");
+      free(s_xfade.in);
+      free(s_xfade.pcm);
+      s_xfade.in = NULL;
+      s_xfade.pcm = NULL;
+    }
+  }
+#endif
+
   while (1) {
     // Open current file
     const char *file_path = sd_card_get_file_path(s_current_song_idx);
@@ -78,23 +552,93 @@ static void mp3_decode_task(void *arg) {
       continue;
     }
 
+    player_status_set_track(s_current_song_idx);
     ESP_LOGI(BT_AV_TAG, "Playing: %s", file_path);
-    FILE *f = fopen(file_path, "rb");
-    if (!f) {
-      ESP_LOGE(BT_AV_TAG, "Failed to open file");
-      // Try next one
-      s_current_song_idx =
-          (s_current_song_idx + 1) % sd_card_get_playlist_count();
-      vTaskDelay(pdMS_TO_TICKS(1000));
-      continue;
-    }
+    int64_t start_us = esp_timer_get_time();
+    uint32_t path_hash = resume_path_hash(file_path);
+    intro_cache_hint(s_current_song_idx);
+    float track_gain = loudness_track_gain(path_hash);
 
-    mp3dec_init(&s_mp3d); // Reset decoder state for new file
+    // With the intro cached, decoding starts from RAM and the file is only
+    // opened once the first PCM is queued
+    mp3_info_t minfo;
     int buf_valid = 0;
+    FILE *f = NULL;
+    bool cache_hit =
+        !resume && intro_cache_take(path_hash, &minfo, input_buf, &buf_valid);
+    bool intro_stored = cache_hit;
+    bool start_logged = false;
+    if (!cache_hit) {
+      f = fopen(file_path, "rb");
+      if (!f) {
+        ESP_LOGE(BT_AV_TAG, "Failed to open file");
+        // Try next one
+        s_current_song_idx =
+            (s_current_song_idx + 1) % sd_card_get_playlist_count();
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        continue;
+      }
+      // Length from the first frame's headers; also skips the ID3v2 tag
+      mp3_info_read(f, &minfo);
+    }
+    if (minfo.src != MP3_INFO_SRC_NONE) {
+      static const char *s_src_str[] = {
+          [MP3_INFO_SRC_XING] = "xing",
+          [MP3_INFO_SRC_VBRI] = "vbri",
+          [MP3_INFO_SRC_CBR] = "cbr estimate",
+      };
+      ESP_LOGI(BT_AV_TAG, "Duration %" PRIu32 ":%02" PRIu32 " (%s)",
+               minfo.duration_ms / 60000, minfo.duration_ms / 1000 % 60,
+               s_src_str[minfo.src]);
+    } else {
+      ESP_LOGW(BT_AV_TAG, "No MPEG frame header found, duration unknown");
+    }
+    // Headerless VBR shows up as a bitrate change; the length is then
+    // extrapolated from the bytes and samples decoded so far
+    bool vbr_estimate = false;
+    uint32_t end_ms = minfo.duration_ms;
+    uint64_t track_samples = 0;
+    bool clock_started = false;
+
+    uint32_t buf_off = minfo.src != MP3_INFO_SRC_NONE ? minfo.data_offset : 0;
+    s_marks.cnt = 0;
+    int64_t last_check_us = 0;
+
+    // After a seek (resume, scrub jump) the frames before the target fill
+    // the bit reservoir (mp3_prime.h); nothing from them is heard
+    bool priming = false;
+    bool resuming = false;
+    uint32_t prime_until = 0;
+    uint64_t prime_sample = 0;
+    int64_t prime_t0 = 0;
+    uint32_t prime_frames = 0;
+    if (resume) {
+      resume = false;
+      if (path_hash == resume_pt.path_hash &&
+          resume_pt.prime_offset >= buf_off &&
+          resume_pt.prime_offset <= resume_pt.offset &&
+          resume_pt.offset < buf_off + minfo.audio_bytes &&
+          fseek(f, resume_pt.prime_offset, SEEK_SET) == 0) {
+        buf_off = resume_pt.prime_offset;
+        priming = true;
+        resuming = true;
+        prime_until = resume_pt.offset;
+        prime_sample = resume_pt.sample;
+        prime_t0 = esp_timer_get_time();
+      }
+    }
+    int snippet_left = 0;
+    bool fade_in = false;
+
+    mp3dec_init(dec); // Reset decoder state for new file
     bool file_done = false;
 
     while (!file_done) {
       // Check control flags
+      if (s_xfade.active &&
+          (s_next_song_req || s_prev_song_req || s_scrub_dir != 0)) {
+        xfade_end("cancelled");
+      }
       if (s_next_song_req) {
         s_next_song_req = false;
         s_current_song_idx =
@@ -112,26 +656,159 @@ static void mp3_decode_task(void *arg) {
       }
 
       if (!s_is_playing) {
+        // Retried while paused until the write throttle lets it through
+        resume_checkpoint(path_hash, true);
         vTaskDelay(pdMS_TO_TICKS(100));
         continue;
       }
+      int64_t now_us = esp_timer_get_time();
+      if (now_us - last_check_us >= RESUME_CHECK_INTERVAL_MS * 1000) {
+        last_check_us = now_us;
+        resume_checkpoint(path_hash, false);
+      }
 
-      if (buf_valid < INPUT_BUF_SIZE) {
+      // Scrubbing: a short snippet, a gap of silence, then a jump by
+      // walking frame headers
+      int scrub_dir = s_scrub_dir;
+      if (scrub_dir != 0 && !s_scrub.active) {
+        memset(&s_scrub, 0, sizeof(s_scrub));
+        s_scrub.active = true;
+        s_scrub.start_us = esp_timer_get_time();
+        s_scrub.start_sample = track_samples;
+        snippet_left = 0;
+      } else if (scrub_dir == 0 && s_scrub.active) {
+        s_scrub.active = false;
+        scrub_report(track_samples, minfo.first.hz, minfo.first.samples);
+      }
+      if (scrub_dir != 0 && snippet_left == 0 && !priming && f &&
+          minfo.src != MP3_INFO_SRC_NONE) {
+        if (s_scrub.jumps > 0) {
+          // The gap after a snippet needs no decoding
+          size_t frame_size = minfo.first.samples * minfo.first.channels * 2;
+          memset(pcm_buf, 0, frame_size);
+          for (int i = 0; i < SCRUB_GAP_FRAMES; i++) {
+            queue_pcm(pcm_buf, frame_size);
+          }
+        }
+        esp_cpu_cycle_count_t c0 = esp_cpu_get_cycle_count();
+        int speed =
+            scrub_speed((esp_timer_get_time() - s_scrub_start_us) / 1000);
+        scrub_jump_t jump;
+        scrub_jump(f, input_buf, INPUT_BUF_SIZE, &minfo, scrub_dir, speed,
+                   buf_off, track_samples, &jump);
+        fseek(f, jump.prime_off, SEEK_SET);
+        buf_off = jump.prime_off;
+        buf_valid = 0;
+        mp3dec_init(dec);
+        priming = true;
+        prime_until = jump.play_off;
+        prime_sample = jump.sample;
+        clock_started = false; // the clock restarts at the new position
+        s_marks.cnt = 0;
+        snippet_left = SCRUB_SNIPPET_FRAMES;
+        fade_in = true;
+        s_scrub.cycles += esp_cpu_get_cycle_count() - c0;
+        s_scrub.jumps++;
+        if (speed > s_scrub.max_speed) {
+          s_scrub.max_speed = speed;
+        }
+      }
+
+      if (!f && (track_samples > 0 || buf_valid < INPUT_BUF_SIZE / 2)) {
+        // Cached intro under way: open the file behind it
+        f = fopen(file_path, "rb");
+        if (!f || fseek(f, buf_off + buf_valid, SEEK_SET) != 0) {
+          ESP_LOGE(BT_AV_TAG, "Failed to open file");
+          s_current_song_idx =
+              (s_current_song_idx + 1) % sd_card_get_playlist_count();
+          file_done = true;
+          break;
+        }
+      }
+      if (f && buf_valid < INPUT_BUF_SIZE) {
+        int64_t t0 = esp_timer_get_time();
         int read =
             fread(input_buf + buf_valid, 1, INPUT_BUF_SIZE - buf_valid, f);
+        uint32_t read_us = esp_timer_get_time() - t0;
+        portENTER_CRITICAL(&s_buf_lock);
+        buffer_depth_note_sd_read(&s_depth, read_us);
+        portEXIT_CRITICAL(&s_buf_lock);
         if (read == 0) {
           // End of file, go to next song
+          if (track_samples && minfo.src != MP3_INFO_SRC_NONE) {
+            ESP_LOGI(BT_AV_TAG,
+                     "Decoded %" PRIu32 " ms, header said %" PRIu32 " ms",
+                     (uint32_t)(track_samples * 1000 / minfo.first.hz),
+                     minfo.duration_ms);
+          }
           s_current_song_idx =
               (s_current_song_idx + 1) % sd_card_get_playlist_count();
           file_done = true;
           break;
         }
         buf_valid += read;
+        if (!intro_stored) {
+          // First read of a track opened from the start: keep its intro
+          intro_stored = true;
+          if (buf_off == minfo.data_offset && minfo.src != MP3_INFO_SRC_NONE) {
+            intro_cache_store(path_hash, &minfo, input_buf, buf_valid);
+          }
+        }
       }
 
       mp3dec_frame_info_t info;
-      int samples =
-          mp3dec_decode_frame(&s_mp3d, input_buf, buf_valid, pcm_buf, &info);
+      TRACE(TRACE_EVT_DECODE_BEGIN, buf_valid, 0);
+      s_hook_eq = &s_eq[dec - s_mp3d];
+      int eq_on = eq_is_active(s_hook_eq);
+      s_meter_frame_cycles = 0;
+      esp_cpu_cycle_count_t c0 = esp_cpu_get_cycle_count();
+      int samples = 0;
+      info.frame_bytes = 0;
+      if (priming && buf_off < prime_until) {
+        // Main data copied, not decoded: costs no more than a memcpy
+        info.frame_bytes =
+            mp3_prime_frame(dec, input_buf, buf_valid, prime_until - buf_off);
+      }
+      if (info.frame_bytes == 0) {
+        samples =
+            mp3dec_decode_frame(dec, input_buf, buf_valid, pcm_buf, &info);
+      }
+      uint32_t dec_cycles = esp_cpu_get_cycle_count() - c0;
+      TRACE(TRACE_EVT_DECODE_END, samples, info.frame_bytes);
+      if (samples > 0) {
+        portENTER_CRITICAL(&s_buf_lock);
+        s_dec_cycles[eq_on] += dec_cycles;
+        s_dec_frames[eq_on]++;
+        s_meter_cycles += s_meter_frame_cycles;
+        portEXIT_CRITICAL(&s_buf_lock);
+      }
+      if (s_scrub.active) {
+        s_scrub.cycles += dec_cycles;
+      }
+
+      if (priming && info.frame_bytes > 0) {
+        if (buf_off < prime_until) {
+          // Reservoir only: the output is not heard
+          prime_frames++;
+          samples = 0;
+        } else {
+          priming = false;
+          track_samples = prime_sample;
+          if (resuming) {
+            resuming = false;
+            boot_mark("resume primed");
+            ESP_LOGI(BT_AV_TAG,
+                     "resume: at %" PRIu32 " ms after %" PRIu32
+                     " priming frame(s), %" PRIu32 " us",
+                     (uint32_t)(track_samples * 1000 / info.hz), prime_frames,
+                     (uint32_t)(esp_timer_get_time() - prime_t0));
+          }
+        }
+      }
+      if (samples > 0) {
+        resume_mark(&s_marks, buf_off, track_samples,
+                    mp3_main_data_begin(input_buf));
+      }
 
       if (samples > 0) {
         static bool s_format_logged = false;
@@ -139,14 +816,51 @@ static void mp3_decode_task(void *arg) {
           ESP_LOGI(BT_AV_TAG, "MP3 format: %d Hz, %d channels", info.hz,
                    info.channels);
           s_format_logged = true;
+          boot_mark("first frame decoded");
+        }
+        s_depth.bytes_per_ms = info.hz * info.channels * 2 / 1000;
+        if (!clock_started) {
+          clock_track_begin(info.hz, info.channels, minfo.duration_ms,
+                            track_samples, track_gain);
+          clock_started = true;
+        }
+        track_samples += samples;
+        if (minfo.src == MP3_INFO_SRC_CBR &&
+            info.bitrate_kbps != minfo.first.bitrate_kbps) {
+          vbr_estimate = true;
+        }
+        if (vbr_estimate) {
+          uint64_t decoded_ms = track_samples * 1000 / info.hz;
+          uint32_t decoded_bytes =
+              buf_off + info.frame_bytes - minfo.data_offset;
+          end_ms = (uint64_t)minfo.audio_bytes * decoded_ms / decoded_bytes;
+          clock_set_duration(end_ms);
         }
         // We have PCM data
         size_t pcm_size = samples * info.channels * 2;
+        if (scrub_dir != 0 && snippet_left > 0) {
+          if (fade_in) {
+            scrub_fade(pcm_buf, samples, info.channels, true);
+            fade_in = false;
+          }
+          if (--snippet_left == 0) {
+            scrub_fade(pcm_buf, samples, info.channels, false);
+          }
+        }
+        if (s_xfade.active) {
+          xfade_mix(pcm_buf, samples, info.hz, info.channels, track_gain,
+                    dec_cycles);
+        }
 
-        // Send to ringbuffer, wait indefinitely if full
-        if (xRingbufferSend(s_ringbuf_handle, pcm_buf, pcm_size,
-                            portMAX_DELAY) != pdTRUE) {
-          ESP_LOGW(BT_AV_TAG, "Ringbuffer send failed");
+        if (queue_pcm(pcm_buf, pcm_size) && !start_logged) {
+          uint32_t hits, lookups;
+          intro_cache_stats(&hits, &lookups);
+          ESP_LOGI(BT_AV_TAG,
+                   "track start: %" PRIu32 " ms to first PCM (intro cache "
+                   "%s, %" PRIu32 "/%" PRIu32 " hits)",
+                   (uint32_t)((esp_timer_get_time() - start_us) / 1000),
+                   cache_hit ? "hit" : "miss", hits, lookups);
+          start_logged = true;
         }
       }
 
@@ -155,23 +869,51 @@ static void mp3_decode_task(void *arg) {
       if (consumed > 0 && consumed <= buf_valid) {
         memmove(input_buf, input_buf + consumed, buf_valid - consumed);
         buf_valid -= consumed;
+        buf_off += consumed;
       } else if (consumed == 0) {
         // Error or need more data
         if (buf_valid == INPUT_BUF_SIZE) {
           // Skip one byte to try resync
           memmove(input_buf, input_buf + 1, buf_valid - 1);
           buf_valid--;
+          buf_off++;
         }
         // Yield to prevent tight loop when waiting for more data
         vTaskDelay(pdMS_TO_TICKS(1));
       }
+
+      // Near the end: this track fades out on its own decoder while the
+      // next one starts
+      if (CROSSFADE_MS > 0 && s_xfade.in && !s_xfade.active && f &&
+          samples > 0 && scrub_dir == 0 && !priming &&
+          end_ms > 2 * CROSSFADE_MS &&
+          track_samples * 1000 / info.hz + CROSSFADE_MS >= end_ms) {
+        xfade_begin(f, &dec, &input_buf, buf_valid, info.hz, info.channels,
+                    track_gain);
+        f = NULL;
+        s_current_song_idx =
+            (s_current_song_idx + 1) % sd_card_get_playlist_count();
+        file_done = true;
+      }
     }
 
-    fclose(f);
+    if (s_scrub.active) {
+      // Report per track, a held button carries on into the next one
+      s_scrub.active = false;
+      scrub_report(track_samples, minfo.first.hz, minfo.first.samples);
+    }
+    if (f) {
+      fclose(f);
+    }
+    mem_budget_checkpoint("track change");
   }
 
+#if !CONFIG_EXAMPLE_STATIC_MEMORY
   free(input_buf);
   free(pcm_buf);
+  free(s_xfade.in);
+  free(s_xfade.pcm);
+#endif
   vTaskDelete(NULL);
 }
 
@@ -179,21 +921,44 @@ static void mp3_decode_task(void *arg) {
  * PUBLIC FUNCTIONS
  ********************************/
 void audio_player_init(void) {
+#if CONFIG_EXAMPLE_STATIC_MEMORY
+  s_ringbuf_handle =
+      xRingbufferCreateStatic(RINGBUF_SIZE, RINGBUF_TYPE_BYTEBUF,
+                              s_ringbuf_storage, &s_ringbuf_struct);
+#else
   s_ringbuf_handle = xRingbufferCreate(RINGBUF_SIZE, RINGBUF_TYPE_BYTEBUF);
+#endif
   if (!s_ringbuf_handle) {
     ESP_LOGE(BT_AV_TAG, "Failed to create ringbuffer");
     return;
   }
 
-  xTaskCreate(mp3_decode_task, "mp3_decode", 32 * 1024, NULL, 5, NULL);
+  player_status_set_track(s_current_song_idx);
+  player_status_set_playing(s_is_playing);
+  player_status_set_volume(s_current_volume);
+
+  mem_task_create(mp3_decode_task, "mp3_decode", DECODE_TASK_STACK, NULL, 5,
+                  MEM_TASK_BUFS(s_decode_task));
 }
 
-int32_t audio_player_get_data(uint8_t *data, int32_t len) {
+int32_t audio_player_get_data(uint8_t *data, int32_t len, int32_t *filled) {
+  if (filled) {
+    *filled = 0;
+  }
   if (data == NULL || len < 0) {
     return 0;
   }
 
+  // Paused (grace period before the suspend): hold the buffered PCM so
+  // play resumes from it at once
+  if (!s_is_playing) {
+    memset(data, 0, len);
+    return len;
+  }
+
   if (s_ringbuf_handle) {
+    esp_cpu_cycle_count_t c0 = esp_cpu_get_cycle_count();
+    audio_volume_mode_t mode = s_volume_mode;
     int32_t bytes_filled = 0;
     while (bytes_filled < len) {
       size_t item_size;
@@ -210,30 +975,37 @@ int32_t audio_player_get_data(uint8_t *data, int32_t len) {
       }
     }
 
-    // Apply software volume control to the PCM data
-    if (s_current_volume < 127 && bytes_filled > 0) {
-      // Calculate volume scale factor (0.0 to 1.0)
-      float volume_scale = (float)s_current_volume / 127.0f;
+    // Apply software volume control to the PCM data, unless the sink owns
+    // the volume
+    float gain = pcm_gain_for(mode, s_play_gain, s_current_volume);
+    pcm_gain_apply((int16_t *)data, bytes_filled / 2, gain);
 
-      // Apply volume to 16-bit PCM samples
-      int16_t *samples = (int16_t *)data;
-      int32_t sample_count = bytes_filled / 2; // 16-bit = 2 bytes per sample
+    if (bytes_filled > 0) {
+      boot_timeline_finish();
+    }
 
-      for (int32_t i = 0; i < sample_count; i++) {
-        // Scale the sample and clamp to prevent overflow
-        int32_t scaled = (int32_t)(samples[i] * volume_scale);
-        if (scaled > 32767)
-          scaled = 32767;
-        if (scaled < -32768)
-          scaled = -32768;
-        samples[i] = (int16_t)scaled;
-      }
+    uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+    portENTER_CRITICAL(&s_buf_lock);
+    s_cb_cycles[mode] += cycles;
+    s_cb_calls[mode]++;
+    if (play_clock_consumed(&s_clock, bytes_filled)) {
+      s_play_gain = s_clock.cur.gain;
     }
+    portEXIT_CRITICAL(&s_buf_lock);
+
+    uint32_t buffered = buffered_bytes();
+    portENTER_CRITICAL(&s_buf_lock);
+    buffer_depth_note_callback(&s_depth, esp_timer_get_time(), len,
+                               bytes_filled, buffered, s_is_playing);
+    portEXIT_CRITICAL(&s_buf_lock);
 
     // If we didn't fill the buffer, pad with silence
     if (bytes_filled < len) {
       memset(data + bytes_filled, 0, len - bytes_filled);
     }
+    if (filled) {
+      *filled = bytes_filled;
+    }
     return len;
   }
 
@@ -247,7 +1019,56 @@ void audio_player_set_volume(uint8_t volume) {
     volume = 127;
   }
   s_current_volume = volume;
-  ESP_LOGI(BT_AV_TAG, "Volume set to %d", volume);
+  player_status_set_volume(volume);
+  TRACE(TRACE_EVT_VOLUME, volume, 0);
 }
 
 uint8_t audio_player_get_volume(void) { return s_current_volume; }
+
+void audio_player_set_volume_mode(audio_volume_mode_t mode) {
+  if (mode >= AUDIO_VOLUME_MODE_NUM || mode == s_volume_mode) {
+    return;
+  }
+  s_volume_mode = mode;
+  ESP_LOGI(BT_AV_TAG, "volume owner: %s",
+           mode == AUDIO_VOLUME_ABSOLUTE ? "sink (absolute volume)"
+                                         : "source (software scaling)");
+}
+
+audio_volume_mode_t audio_player_get_volume_mode(void) {
+  return s_volume_mode;
+}
+
+void audio_player_set_sink_delay(uint16_t delay_01ms) {
+  portENTER_CRITICAL(&s_buf_lock);
+  s_depth.m.sink_delay_01ms = delay_01ms;
+  portEXIT_CRITICAL(&s_buf_lock);
+}
+
+void audio_player_get_buffer_metrics(audio_buffer_metrics_t *metrics) {
+  portENTER_CRITICAL(&s_buf_lock);
+  *metrics = s_depth.m;
+  portEXIT_CRITICAL(&s_buf_lock);
+}
+
+uint32_t audio_player_get_position_ms(void) {
+  portENTER_CRITICAL(&s_buf_lock);
+  play_clock_t clk = s_clock;
+  portEXIT_CRITICAL(&s_buf_lock);
+  return play_clock_position_ms(&clk);
+}
+
+uint32_t audio_player_get_duration_ms(void) {
+  portENTER_CRITICAL(&s_buf_lock);
+  uint32_t duration_ms = play_clock_duration_ms(&s_clock);
+  portEXIT_CRITICAL(&s_buf_lock);
+  return duration_ms;
+}
+
+void audio_player_scrub(int direction) {
+  if (direction != 0 && s_scrub_dir == 0) {
+    s_scrub_start_us = esp_timer_get_time();
+  }
+  s_scrub_dir = direction > 0 ? 1 : (direction < 0 ? -1 : 0);
+  TRACE(TRACE_EVT_SCRUB, s_scrub_dir, 0);
+}
@@ -9,6 +9,43 @@
 
 #include <stdint.h>
 
+/**
+ * @brief Who applies the volume
+ */
+typedef enum {
+  AUDIO_VOLUME_SOFTWARE = 0, /*!< PCM is scaled in the data callback */
+  AUDIO_VOLUME_ABSOLUTE,     /*!< sink applies AVRCP absolute volume, PCM
+                                  passes through untouched */
+  AUDIO_VOLUME_MODE_NUM,
+} audio_volume_mode_t;
+
+/**
+ * @brief Why the buffer target last changed
+ */
+typedef enum {
+  AUDIO_BUF_REASON_INIT = 0,
+  AUDIO_BUF_REASON_CB_JITTER,  /*!< grown for data-callback timing */
+  AUDIO_BUF_REASON_SD_LATENCY, /*!< grown for slow SD reads */
+  AUDIO_BUF_REASON_UNDERRUN,   /*!< grown after the callback ran dry */
+  AUDIO_BUF_REASON_SHRINK,     /*!< lowered after a stable period */
+} audio_buf_reason_t;
+
+/**
+ * @brief Adaptive PCM buffer depth and the measurements behind it
+ */
+typedef struct {
+  uint32_t target_bytes;     /*!< depth the decode task fills up to */
+  uint32_t target_ms;        /*!< same, as playback time */
+  audio_buf_reason_t reason; /*!< cause of the last target change */
+  uint32_t sink_delay_01ms;  /*!< delay reported by the sink, 1/10 ms */
+  uint32_t cb_interval_us;   /*!< smoothed data-callback period */
+  uint32_t cb_jitter_us;     /*!< smoothed deviation from that period */
+  uint32_t sd_read_peak_us;  /*!< decaying peak of one SD read */
+  uint32_t fill_avg_bytes;   /*!< mean buffered bytes seen by the callback */
+  uint32_t underruns;        /*!< callbacks padded with silence while playing */
+  int64_t last_underrun_us;
+} audio_buffer_metrics_t;
+
 /**
  * @brief Initialize audio player subsystem
  *
@@ -21,9 +58,11 @@ void audio_player_init(void);
  *
  * @param data Buffer to fill with PCM data
  * @param len Length of buffer in bytes
+ * @param filled Set to the bytes taken from the ring buffer; the rest of
+ *        the buffer is silence (may be NULL)
  * @return Number of bytes written to buffer
  */
-int32_t audio_player_get_data(uint8_t *data, int32_t len);
+int32_t audio_player_get_data(uint8_t *data, int32_t len, int32_t *filled);
 
 /**
  * @brief Set audio volume level
@@ -39,4 +78,60 @@ void audio_player_set_volume(uint8_t volume);
  */
 uint8_t audio_player_get_volume(void);
 
+/**
+ * @brief Select who owns the volume
+ *
+ * Set to AUDIO_VOLUME_ABSOLUTE when the sink supports absolute volume, so
+ * the level is not applied twice.
+ */
+void audio_player_set_volume_mode(audio_volume_mode_t mode);
+
+/**
+ * @brief Current volume owner
+ */
+audio_volume_mode_t audio_player_get_volume_mode(void);
+
+/**
+ * @brief Record the sink's reported delay (ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT)
+ *
+ * @param delay_01ms Delay in 1/10 ms units
+ */
+void audio_player_set_sink_delay(uint16_t delay_01ms);
+
+/**
+ * @brief Snapshot of the adaptive buffer state
+ */
+void audio_player_get_buffer_metrics(audio_buffer_metrics_t *metrics);
+
+/**
+ * @brief Playback position in the current track
+ *
+ * Counted from the PCM frames the data callback has taken, so audio still
+ * queued in the ring buffer is not included. Paused time does not count.
+ *
+ * @return Milliseconds since the start of the track, 0 before any audio
+ */
+uint32_t audio_player_get_position_ms(void);
+
+/**
+ * @brief Length of the current track
+ *
+ * From the Xing/VBRI header when present, else estimated from the file
+ * size and bitrate (refined while decoding if the bitrate varies).
+ *
+ * @return Milliseconds, 0 if unknown
+ */
+uint32_t audio_player_get_duration_ms(void);
+
+/**
+ * @brief Start or stop fast-forward / rewind
+ *
+ * While active the decoder plays a short snippet, then jumps ahead (or
+ * back) by walking frame headers only, at 4x, then 8x, then 16x the longer
+ * it runs. Normal playback continues from the last snippet on stop.
+ *
+ * @param direction 1 forward, -1 backward, 0 stop
+ */
+void audio_player_scrub(int direction);
+
 #endif /* __AUDIO_PLAYER_H__ */
@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "boot_timeline.h"
+#include "common.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <stdbool.h>
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+typedef struct {
+  const char *name;
+  const char *task;
+  int64_t us;
+} boot_mark_t;
+
+static boot_mark_t s_marks[BOOT_TIMELINE_MAX];
+static int s_mark_cnt = 0;
+static bool s_finished = false;
+static portMUX_TYPE s_boot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+static void boot_report(void *arg) {
+  boot_mark_t marks[BOOT_TIMELINE_MAX];
+  portENTER_CRITICAL(&s_boot_lock);
+  int n = s_mark_cnt;
+  for (int i = 0; i < n; i++) {
+    marks[i] = s_marks[i];
+  }
+  portEXIT_CRITICAL(&s_boot_lock);
+
+  // Marks from concurrent tasks can land out of order
+  for (int i = 1; i < n; i++) {
+    boot_mark_t m = marks[i];
+    int j = i - 1;
+    while (j >= 0 && marks[j].us > m.us) {
+      marks[j + 1] = marks[j];
+      j--;
+    }
+    marks[j + 1] = m;
+  }
+
+  ESP_LOGI(BT_AV_TAG, "Boot timeline (ms since reset, +ms since previous):");
+  int64_t prev = 0;
+  for (int i = 0; i < n; i++) {
+    ESP_LOGI(BT_AV_TAG, "  %6" PRId64 " +%5" PRId64 "  %-20s [%s]",
+             marks[i].us / 1000, (marks[i].us - prev) / 1000, marks[i].name,
+             marks[i].task);
+    prev = marks[i].us;
+  }
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void boot_mark(const char *name) {
+  int64_t now = esp_timer_get_time();
+  const char *task = pcTaskGetName(NULL);
+  portENTER_CRITICAL(&s_boot_lock);
+  if (!s_finished && s_mark_cnt < BOOT_TIMELINE_MAX) {
+    s_marks[s_mark_cnt].name = name;
+    s_marks[s_mark_cnt].task = task;
+    s_marks[s_mark_cnt].us = now;
+    s_mark_cnt++;
+  }
+  portEXIT_CRITICAL(&s_boot_lock);
+}
+
+void boot_timeline_finish(void) {
+  static esp_timer_handle_t s_report_tmr = NULL;
+  if (s_finished) {
+    return;
+  }
+  boot_mark("first audio");
+  s_finished = true;
+
+  const esp_timer_create_args_t args = {
+      .callback = boot_report,
+      .name = "boot",
+  };
+  if (esp_timer_create(&args, &s_report_tmr) == ESP_OK) {
+    esp_timer_start_once(s_report_tmr, 0);
+  }
+}
@@ -0,0 +1,33 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __BOOT_TIMELINE_H__
+#define __BOOT_TIMELINE_H__
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define BOOT_TIMELINE_MAX 24 // marks kept; later ones are dropped
+
+/**
+ * @brief Timestamp a startup phase
+ *
+ * Safe from any task, cheap enough for init paths. Marks after the report
+ * has been printed are ignored.
+ *
+ * @param name Static string naming the phase that just completed
+ */
+void boot_mark(const char *name);
+
+/**
+ * @brief Mark the end of startup (first audio) and print the timeline
+ *
+ * The print is deferred to the esp_timer task, so this may be called from
+ * the A2DP data callback. Only the first call has an effect.
+ */
+void boot_timeline_finish(void);
+
+#endif /* __BOOT_TIMELINE_H__ */
@@ -6,11 +6,28 @@
 
 #include "bt_a2dp.h"
 #include "audio_player.h"
+#include "boot_timeline.h"
 #include "bt_app_core.h"
+#include "bt_gap.h"
 #include "common.h"
 #include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "mem_budget.h"
+#include "player_status.h"
+#include "trace.h"
 #include <inttypes.h>
+#include <string.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define HEART_BEAT_MS 10000     /* media-ready poll and connecting watchdog */
+#define RECONNECT_BASE_MS 1000  /* backoff after the immediate first retry */
+#define RECONNECT_MAX_MS 30000
+#define RECOVERY_SAMPLES 16     /* link-loss recoveries kept for statistics */
+#define PAUSE_SUSPEND_GRACE_MS 3000 /* short pauses keep the stream running */
 
 /*********************************
  * MODULE VARIABLES
@@ -25,10 +42,27 @@ uint32_t s_pkt_cnt = 0;
  * STATIC VARIABLES
  ********************************/
 static TimerHandle_t s_tmr; /* handle of heart beat timer */
+static TimerHandle_t s_reconnect_tmr; /* one-shot reconnect backoff */
+static int s_reconnect_attempt = 0;
+static int64_t s_link_lost_us = 0; /* 0 when no link loss is being timed */
+static uint32_t s_recovery_ms[RECOVERY_SAMPLES];
+static int s_recovery_cnt = 0;
+static TimerHandle_t s_suspend_tmr; /* one-shot pause grace period */
+MEM_STATIC_TIMER(s_tmr);
+MEM_STATIC_TIMER(s_reconnect_tmr);
+MEM_STATIC_TIMER(s_suspend_tmr);
+static bool s_resume_pending = false; /* play pressed while SUSPENDING */
+static int64_t s_resume_req_us = 0; /* play press, until first audio */
+static volatile bool s_to_audio_new = false; /* to_audio_ms not logged yet */
+static int64_t s_pause_us = 0;      /* pause start, for the paused summary */
+static uint32_t s_pause_cb_cnt = 0; /* data callbacks while paused */
+static uint32_t s_pause_cb_us = 0;  /* time spent in them */
+static bt_a2dp_pause_stats_t s_pause_stats; /* last completed pause */
 
 /*********************************
  * FORWARD DECLARATIONS
  ********************************/
+static void bt_app_av_state_discovering_hdlr(uint16_t event, void *param);
 static void bt_app_av_state_unconnected_hdlr(uint16_t event, void *param);
 static void bt_app_av_state_connecting_hdlr(uint16_t event, void *param);
 static void bt_app_av_state_connected_hdlr(uint16_t event, void *param);
@@ -39,35 +73,135 @@ static void bt_app_av_media_proc(uint16_t event, void *param);
  * STATIC FUNCTIONS
  ********************************/
 static void bt_app_a2d_heart_beat(TimerHandle_t arg) {
-  bt_app_work_dispatch(bt_a2dp_sm_handler, BT_APP_HEART_BEAT_EVT, NULL, 0,
+  /* a beat still waiting in the queue makes this one redundant */
+  bt_app_work_dispatch_prio(bt_a2dp_sm_handler, BT_APP_HEART_BEAT_EVT, NULL, 0,
+                            NULL, BT_APP_PRIO_LOW);
+}
+
+static void bt_app_a2d_reconnect(TimerHandle_t arg) {
+  bt_app_work_dispatch(bt_a2dp_sm_handler, BT_APP_RECONNECT_EVT, NULL, 0,
                        NULL);
 }
 
-static void bt_app_av_state_unconnected_hdlr(uint16_t event, void *param) {
+static void bt_app_a2d_suspend(TimerHandle_t arg) {
+  bt_app_work_dispatch(bt_a2dp_sm_handler, BT_APP_SUSPEND_EVT, NULL, 0, NULL);
+}
+
+static void bt_app_av_connect_peer(void) {
+  uint8_t *bda = s_peer_bda;
+  ESP_LOGI(BT_AV_TAG, "a2dp connecting to peer: %02x:%02x:%02x:%02x:%02x:%02x",
+           bda[0], bda[1], bda[2], bda[3], bda[4], bda[5]);
+  esp_a2d_source_connect(s_peer_bda);
+  s_a2d_state = APP_AV_STATE_CONNECTING;
+  s_connecting_intv = 0;
+}
+
+/**
+ * Called once the link is down (state already APP_AV_STATE_UNCONNECTED).
+ * The first retry goes out immediately; later ones back off exponentially
+ * with jitter so a sink that is busy or out of range is not hammered.
+ */
+static void bt_app_av_schedule_reconnect(void) {
+  if (s_reconnect_attempt == 0) {
+    s_reconnect_attempt++;
+    bt_app_av_connect_peer();
+    return;
+  }
+
+  int shift = s_reconnect_attempt - 1;
+  uint32_t delay_ms = RECONNECT_MAX_MS;
+  if (shift < 5 && (RECONNECT_BASE_MS << shift) < RECONNECT_MAX_MS) {
+    delay_ms = RECONNECT_BASE_MS << shift;
+  }
+  /* keep half, randomise the other half */
+  delay_ms = delay_ms / 2 + esp_random() % (delay_ms / 2 + 1);
+  s_reconnect_attempt++;
+
+  ESP_LOGI(BT_AV_TAG, "a2dp reconnect attempt %d in %" PRIu32 " ms",
+           s_reconnect_attempt, delay_ms);
+  xTimerChangePeriod(s_reconnect_tmr, pdMS_TO_TICKS(delay_ms), 0);
+}
+
+static void bt_app_av_link_down(void) {
+  s_a2d_state = APP_AV_STATE_UNCONNECTED;
+  bt_app_av_schedule_reconnect();
+}
+
+static void bt_app_av_link_up(void) {
+  xTimerStop(s_reconnect_tmr, 0);
+  s_reconnect_attempt = 0;
+
+  if (s_link_lost_us == 0) {
+    return;
+  }
+  uint32_t recovery_ms = (esp_timer_get_time() - s_link_lost_us) / 1000;
+  s_link_lost_us = 0;
+  s_recovery_ms[s_recovery_cnt % RECOVERY_SAMPLES] = recovery_ms;
+  s_recovery_cnt++;
+
+  uint32_t median_ms, p95_ms;
+  int n = bt_a2dp_get_recovery_stats(&median_ms, &p95_ms);
+  ESP_LOGI(BT_AV_TAG,
+           "a2dp link recovered in %" PRIu32 " ms (median %" PRIu32
+           " ms, p95 %" PRIu32 " ms over %d)",
+           recovery_ms, median_ms, p95_ms, n);
+}
+
+/* the sink's delay feeds the player's buffer depth in any state */
+static void bt_app_av_sink_delay(void *param) {
+  esp_a2d_cb_param_t *a2d = (esp_a2d_cb_param_t *)(param);
+  uint16_t delay = a2d->a2d_report_delay_value_stat.delay_value;
+  ESP_LOGI(BT_AV_TAG, "a2dp sink delay: %u * 1/10 ms", delay);
+  audio_player_set_sink_delay(delay);
+}
+
+/* the link is up, whichever state the connect completed in */
+static void bt_app_av_connected(void) {
+  s_a2d_state = APP_AV_STATE_CONNECTED;
+  s_media_state = APP_AV_MEDIA_STATE_IDLE;
+  bt_gap_peer_connected();
+  bt_app_av_link_up();
+  /* poll media readiness now rather than on the next heart beat */
+  bt_app_av_media_proc(BT_APP_HEART_BEAT_EVT, NULL);
+}
+
+static void bt_app_av_state_discovering_hdlr(uint16_t event, void *param) {
   esp_a2d_cb_param_t *a2d = NULL;
+
+  /* a page to the cached peer can still complete after the inquiry fallback
+   * started */
+  if (event == ESP_A2D_CONNECTION_STATE_EVT) {
+    a2d = (esp_a2d_cb_param_t *)(param);
+    if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTED) {
+      ESP_LOGI(BT_AV_TAG, "a2dp connected, cancel device discovery");
+      esp_bt_gap_cancel_discovery();
+      bt_app_av_connected();
+    }
+  }
+}
+
+static void bt_app_av_state_unconnected_hdlr(uint16_t event, void *param) {
   /* handle the events of interest in unconnected state */
   switch (event) {
   case ESP_A2D_CONNECTION_STATE_EVT:
   case ESP_A2D_AUDIO_STATE_EVT:
   case ESP_A2D_AUDIO_CFG_EVT:
   case ESP_A2D_MEDIA_CTRL_ACK_EVT:
+  case BT_APP_PLAY_STATE_EVT:
+  case BT_APP_SUSPEND_EVT:
     break;
-  case BT_APP_HEART_BEAT_EVT: {
-    uint8_t *bda = s_peer_bda;
-    ESP_LOGI(BT_AV_TAG,
-             "a2dp connecting to peer: %02x:%02x:%02x:%02x:%02x:%02x", bda[0],
-             bda[1], bda[2], bda[3], bda[4], bda[5]);
-    esp_a2d_source_connect(s_peer_bda);
-    s_a2d_state = APP_AV_STATE_CONNECTING;
-    s_connecting_intv = 0;
+  case BT_APP_RECONNECT_EVT:
+    bt_app_av_connect_peer();
     break;
-  }
-  case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT: {
-    a2d = (esp_a2d_cb_param_t *)(param);
-    ESP_LOGI(BT_AV_TAG, "%s, delay value: %u * 1/10 ms", __func__,
-             a2d->a2d_report_delay_value_stat.delay_value);
+  case BT_APP_HEART_BEAT_EVT:
+    /* safety net: a reconnect should always be pending while unconnected */
+    if (!xTimerIsTimerActive(s_reconnect_tmr)) {
+      bt_app_av_schedule_reconnect();
+    }
+    break;
+  case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT:
+    bt_app_av_sink_delay(param);
     break;
-  }
   default: {
     ESP_LOGE(BT_AV_TAG, "%s unhandled event: %d", __func__, event);
     break;
@@ -84,33 +218,32 @@ static void bt_app_av_state_connecting_hdlr(uint16_t event, void *param) {
     a2d = (esp_a2d_cb_param_t *)(param);
     if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTED) {
       ESP_LOGI(BT_AV_TAG, "a2dp connected");
-      s_a2d_state = APP_AV_STATE_CONNECTED;
-      s_media_state = APP_AV_MEDIA_STATE_IDLE;
+      bt_app_av_connected();
     } else if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
-      s_a2d_state = APP_AV_STATE_UNCONNECTED;
+      bt_app_av_link_down();
     }
     break;
   }
   case ESP_A2D_AUDIO_STATE_EVT:
   case ESP_A2D_AUDIO_CFG_EVT:
   case ESP_A2D_MEDIA_CTRL_ACK_EVT:
+  case BT_APP_RECONNECT_EVT:
+  case BT_APP_PLAY_STATE_EVT:
+  case BT_APP_SUSPEND_EVT:
     break;
   case BT_APP_HEART_BEAT_EVT:
     /**
-     * Switch state to APP_AV_STATE_UNCONNECTED
+     * Give up on the attempt and back off
      * when connecting lasts more than 2 heart beat intervals.
      */
     if (++s_connecting_intv >= 2) {
-      s_a2d_state = APP_AV_STATE_UNCONNECTED;
       s_connecting_intv = 0;
+      bt_app_av_link_down();
     }
     break;
-  case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT: {
-    a2d = (esp_a2d_cb_param_t *)(param);
-    ESP_LOGI(BT_AV_TAG, "%s, delay value: %u * 1/10 ms", __func__,
-             a2d->a2d_report_delay_value_stat.delay_value);
+  case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT:
+    bt_app_av_sink_delay(param);
     break;
-  }
   default:
     ESP_LOGE(BT_AV_TAG, "%s unhandled event: %d", __func__, event);
     break;
@@ -142,8 +275,13 @@ static void bt_app_av_media_proc(uint16_t event, void *param) {
       if (a2d->media_ctrl_stat.cmd == ESP_A2D_MEDIA_CTRL_START &&
           a2d->media_ctrl_stat.status == ESP_A2D_MEDIA_CTRL_ACK_SUCCESS) {
         ESP_LOGI(BT_AV_TAG, "a2dp media start successfully.");
+        boot_mark("media started");
         s_intv_cnt = 0;
         s_media_state = APP_AV_MEDIA_STATE_STARTED;
+        /* paused before the stream came up: suspend after the grace period */
+        if (!s_is_playing) {
+          xTimerReset(s_suspend_tmr, 0);
+        }
       } else {
         /* not started successfully, transfer to idle state */
         ESP_LOGI(BT_AV_TAG, "a2dp media start failed.");
@@ -153,8 +291,78 @@ static void bt_app_av_media_proc(uint16_t event, void *param) {
     break;
   }
   case APP_AV_MEDIA_STATE_STARTED: {
-    if (event == BT_APP_HEART_BEAT_EVT) {
-      // Removed auto-suspend logic to allow continuous playback
+    if (event == BT_APP_PLAY_STATE_EVT) {
+      /* a quick pause/play never touches the stream */
+      if (s_is_playing) {
+        xTimerStop(s_suspend_tmr, 0);
+      } else {
+        xTimerReset(s_suspend_tmr, 0);
+      }
+    } else if (event == BT_APP_HEART_BEAT_EVT && s_to_audio_new) {
+      s_to_audio_new = false;
+      ESP_LOGI(BT_AV_TAG, "resume to audio: %" PRIu32 " ms",
+               s_pause_stats.to_audio_ms);
+    } else if (event == BT_APP_SUSPEND_EVT && !s_is_playing) {
+      ESP_LOGI(BT_AV_TAG, "a2dp paused, suspending media ...");
+      esp_a2d_media_ctrl(ESP_A2D_MEDIA_CTRL_SUSPEND);
+      s_resume_pending = false;
+      s_media_state = APP_AV_MEDIA_STATE_SUSPENDING;
+    }
+    break;
+  }
+  case APP_AV_MEDIA_STATE_SUSPENDING: {
+    if (event == BT_APP_PLAY_STATE_EVT) {
+      s_resume_pending = s_is_playing;
+    } else if (event == ESP_A2D_MEDIA_CTRL_ACK_EVT) {
+      a2d = (esp_a2d_cb_param_t *)(param);
+      if (a2d->media_ctrl_stat.cmd != ESP_A2D_MEDIA_CTRL_SUSPEND) {
+        break;
+      }
+      if (a2d->media_ctrl_stat.status != ESP_A2D_MEDIA_CTRL_ACK_SUCCESS) {
+        ESP_LOGW(BT_AV_TAG, "a2dp media suspend failed, keep streaming");
+        s_media_state = APP_AV_MEDIA_STATE_STARTED;
+      } else if (s_resume_pending) {
+        esp_a2d_media_ctrl(ESP_A2D_MEDIA_CTRL_START);
+        s_media_state = APP_AV_MEDIA_STATE_RESUMING;
+      } else {
+        ESP_LOGI(BT_AV_TAG, "a2dp media suspended");
+        s_media_state = APP_AV_MEDIA_STATE_SUSPENDED;
+      }
+    }
+    break;
+  }
+  case APP_AV_MEDIA_STATE_SUSPENDED: {
+    if (event == BT_APP_PLAY_STATE_EVT && s_is_playing) {
+      ESP_LOGI(BT_AV_TAG, "a2dp resuming media ...");
+      esp_a2d_media_ctrl(ESP_A2D_MEDIA_CTRL_START);
+      s_media_state = APP_AV_MEDIA_STATE_RESUMING;
+    }
+    break;
+  }
+  case APP_AV_MEDIA_STATE_RESUMING: {
+    if (event == ESP_A2D_MEDIA_CTRL_ACK_EVT) {
+      a2d = (esp_a2d_cb_param_t *)(param);
+      if (a2d->media_ctrl_stat.cmd != ESP_A2D_MEDIA_CTRL_START) {
+        break;
+      }
+      if (a2d->media_ctrl_stat.status == ESP_A2D_MEDIA_CTRL_ACK_SUCCESS) {
+        if (s_resume_req_us != 0) {
+          s_pause_stats.start_ack_ms =
+              (esp_timer_get_time() - s_resume_req_us) / 1000;
+        }
+        ESP_LOGI(BT_AV_TAG, "a2dp media resumed, start ack after %" PRIu32
+                            " ms",
+                 s_pause_stats.start_ack_ms);
+        s_media_state = APP_AV_MEDIA_STATE_STARTED;
+        /* paused again while the START was in flight */
+        if (!s_is_playing) {
+          xTimerReset(s_suspend_tmr, 0);
+        }
+      } else {
+        /* fall back to the ready check on the next heart beat */
+        ESP_LOGI(BT_AV_TAG, "a2dp media resume failed.");
+        s_media_state = APP_AV_MEDIA_STATE_IDLE;
+      }
     }
     break;
   }
@@ -190,7 +398,9 @@ static void bt_app_av_state_connected_hdlr(uint16_t event, void *param) {
     a2d = (esp_a2d_cb_param_t *)(param);
     if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
       ESP_LOGI(BT_AV_TAG, "a2dp disconnected");
-      s_a2d_state = APP_AV_STATE_UNCONNECTED;
+      xTimerStop(s_suspend_tmr, 0);
+      s_link_lost_us = esp_timer_get_time();
+      bt_app_av_link_down();
     }
     break;
   }
@@ -203,18 +413,18 @@ static void bt_app_av_state_connected_hdlr(uint16_t event, void *param) {
   }
   case ESP_A2D_AUDIO_CFG_EVT:
     // not supposed to occur for A2DP source
+  case BT_APP_RECONNECT_EVT:
     break;
   case ESP_A2D_MEDIA_CTRL_ACK_EVT:
-  case BT_APP_HEART_BEAT_EVT: {
+  case BT_APP_HEART_BEAT_EVT:
+  case BT_APP_PLAY_STATE_EVT:
+  case BT_APP_SUSPEND_EVT: {
     bt_app_av_media_proc(event, param);
     break;
   }
-  case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT: {
-    a2d = (esp_a2d_cb_param_t *)(param);
-    ESP_LOGI(BT_AV_TAG, "%s, delay value: %u * 1/10 ms", __func__,
-             a2d->a2d_report_delay_value_stat.delay_value);
+  case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT:
+    bt_app_av_sink_delay(param);
     break;
-  }
   default: {
     ESP_LOGE(BT_AV_TAG, "%s unhandled event: %d", __func__, event);
     break;
@@ -231,7 +441,7 @@ static void bt_app_av_state_disconnecting_hdlr(uint16_t event, void *param) {
     a2d = (esp_a2d_cb_param_t *)(param);
     if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
       ESP_LOGI(BT_AV_TAG, "a2dp disconnected");
-      s_a2d_state = APP_AV_STATE_UNCONNECTED;
+      bt_app_av_link_down();
     }
     break;
   }
@@ -239,13 +449,13 @@ static void bt_app_av_state_disconnecting_hdlr(uint16_t event, void *param) {
   case ESP_A2D_AUDIO_CFG_EVT:
   case ESP_A2D_MEDIA_CTRL_ACK_EVT:
   case BT_APP_HEART_BEAT_EVT:
+  case BT_APP_RECONNECT_EVT:
+  case BT_APP_PLAY_STATE_EVT:
+  case BT_APP_SUSPEND_EVT:
     break;
-  case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT: {
-    a2d = (esp_a2d_cb_param_t *)(param);
-    ESP_LOGI(BT_AV_TAG, "%s, delay value: 0x%u * 1/10 ms", __func__,
-             a2d->a2d_report_delay_value_stat.delay_value);
+  case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT:
+    bt_app_av_sink_delay(param);
     break;
-  }
   default: {
     ESP_LOGE(BT_AV_TAG, "%s unhandled event: %d", __func__, event);
     break;
@@ -257,22 +467,50 @@ static void bt_app_av_state_disconnecting_hdlr(uint16_t event, void *param) {
  * PUBLIC FUNCTIONS
  ********************************/
 void bt_a2dp_callback(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param) {
-  bt_app_work_dispatch(bt_a2dp_sm_handler, event, param,
-                       sizeof(esp_a2d_cb_param_t), NULL);
+  bt_app_prio_t prio = BT_APP_PRIO_NORMAL;
+  switch (event) {
+  case ESP_A2D_CONNECTION_STATE_EVT:
+  case ESP_A2D_AUDIO_STATE_EVT:
+  case ESP_A2D_MEDIA_CTRL_ACK_EVT:
+    prio = BT_APP_PRIO_HIGH;
+    break;
+  default:
+    break;
+  }
+  bt_app_work_dispatch_prio(bt_a2dp_sm_handler, event, param,
+                            sizeof(esp_a2d_cb_param_t), NULL, prio);
 }
 
 int32_t bt_a2dp_data_callback(uint8_t *data, int32_t len) {
-  return audio_player_get_data(data, len);
+  TRACE(TRACE_EVT_DATA_CB_BEGIN, len, 0);
+  int64_t t0 = esp_timer_get_time();
+  int32_t filled;
+  int32_t ret = audio_player_get_data(data, len, &filled);
+  int64_t t1 = esp_timer_get_time();
+  TRACE(TRACE_EVT_DATA_CB_END, filled, 0);
+
+  if (!s_is_playing) {
+    /* cost of streaming silence during the grace period (or unsuspended) */
+    s_pause_cb_cnt++;
+    s_pause_cb_us += t1 - t0;
+  } else if (s_resume_req_us != 0 && filled > 0) {
+    /* logged on the next heart beat, not from the stack's task */
+    s_pause_stats.to_audio_ms = (t1 - s_resume_req_us) / 1000;
+    TRACE(TRACE_EVT_RESUME_AUDIO, s_pause_stats.to_audio_ms, 0);
+    s_resume_req_us = 0;
+    s_to_audio_new = true;
+  }
+  return ret;
 }
 
 void bt_a2dp_sm_handler(uint16_t event, void *param) {
-  ESP_LOGI(BT_AV_TAG, "%s state: %d, event: 0x%x", __func__, s_a2d_state,
-           event);
+  TRACE(TRACE_EVT_A2D_EVENT, event, s_a2d_state);
 
   /* select handler according to different states */
   switch (s_a2d_state) {
   case APP_AV_STATE_DISCOVERING:
   case APP_AV_STATE_DISCOVERED:
+    bt_app_av_state_discovering_hdlr(event, param);
     break;
   case APP_AV_STATE_UNCONNECTED:
     bt_app_av_state_unconnected_hdlr(event, param);
@@ -290,6 +528,8 @@ void bt_a2dp_sm_handler(uint16_t event, void *param) {
     ESP_LOGE(BT_AV_TAG, "%s invalid state: %d", __func__, s_a2d_state);
     break;
   }
+
+  player_status_set_bt_state(s_a2d_state, s_media_state);
 }
 
 void bt_a2dp_init(void) {
@@ -299,9 +539,70 @@ void bt_a2dp_init(void) {
 
   /* create and start heart beat timer */
   int tmr_id = 0;
-  s_tmr = xTimerCreate("connTmr", (10000 / portTICK_PERIOD_MS), pdTRUE,
-                       (void *)&tmr_id, bt_app_a2d_heart_beat);
+  s_tmr = mem_timer_create("connTmr", (HEART_BEAT_MS / portTICK_PERIOD_MS),
+                           pdTRUE, (void *)&tmr_id, bt_app_a2d_heart_beat,
+                           MEM_TIMER_BUF(s_tmr));
   xTimerStart(s_tmr, portMAX_DELAY);
+
+  /* reconnects are scheduled from connection state events */
+  s_reconnect_tmr = mem_timer_create(
+      "reconnTmr", pdMS_TO_TICKS(RECONNECT_BASE_MS), pdFALSE, NULL,
+      bt_app_a2d_reconnect, MEM_TIMER_BUF(s_reconnect_tmr));
+
+  /* pause grace period before the stream is suspended */
+  s_suspend_tmr = mem_timer_create(
+      "suspTmr", pdMS_TO_TICKS(PAUSE_SUSPEND_GRACE_MS), pdFALSE, NULL,
+      bt_app_a2d_suspend, MEM_TIMER_BUF(s_suspend_tmr));
 }
 
 TimerHandle_t bt_a2dp_get_timer(void) { return s_tmr; }
+
+int bt_a2dp_get_recovery_stats(uint32_t *median_ms, uint32_t *p95_ms) {
+  /* median and p95 over the most recent recoveries */
+  int n = s_recovery_cnt < RECOVERY_SAMPLES ? s_recovery_cnt : RECOVERY_SAMPLES;
+  uint32_t sorted[RECOVERY_SAMPLES];
+  memcpy(sorted, s_recovery_ms, n * sizeof(sorted[0]));
+  for (int i = 1; i < n; i++) {
+    uint32_t v = sorted[i];
+    int j = i - 1;
+    while (j >= 0 && sorted[j] > v) {
+      sorted[j + 1] = sorted[j];
+      j--;
+    }
+    sorted[j + 1] = v;
+  }
+  *median_ms = n ? sorted[n / 2] : 0;
+  *p95_ms = n ? sorted[(n * 95 - 1) / 100] : 0;
+  return n;
+}
+
+void bt_a2dp_play_state_changed(void) {
+  int64_t now = esp_timer_get_time();
+  if (s_is_playing) {
+    if (s_pause_us != 0) {
+      s_pause_stats = (bt_a2dp_pause_stats_t){
+          .paused_ms = (now - s_pause_us) / 1000,
+          .callbacks = s_pause_cb_cnt,
+          .callback_us = s_pause_cb_us,
+      };
+      ESP_LOGI(BT_AV_TAG,
+               "paused %" PRIu32 " ms: %" PRIu32 " data callbacks, %" PRIu32
+               " us in them",
+               s_pause_stats.paused_ms, s_pause_cb_cnt, s_pause_cb_us);
+    }
+    s_pause_us = 0;
+    s_resume_req_us = now;
+  } else {
+    s_pause_us = now;
+    s_pause_cb_cnt = 0;
+    s_pause_cb_us = 0;
+    s_resume_req_us = 0;
+  }
+  /* user action: ahead of background work */
+  bt_app_work_dispatch_prio(bt_a2dp_sm_handler, BT_APP_PLAY_STATE_EVT, NULL, 0,
+                            NULL, BT_APP_PRIO_HIGH);
+}
+
+void bt_a2dp_get_pause_stats(bt_a2dp_pause_stats_t *stats) {
+  *stats = s_pause_stats;
+}
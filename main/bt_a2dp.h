@@ -17,6 +17,17 @@
  */
 void bt_a2dp_init(void);
 
+/**
+ * @brief Cost of the last pause and how fast play came back from it
+ */
+typedef struct {
+  uint32_t paused_ms;    /*!< length of the pause */
+  uint32_t callbacks;    /*!< data callbacks while paused */
+  uint32_t callback_us;  /*!< time spent in them */
+  uint32_t start_ack_ms; /*!< play to START ack, 0 if never suspended */
+  uint32_t to_audio_ms;  /*!< play to the first callback with ring audio */
+} bt_a2dp_pause_stats_t;
+
 /**
  * @brief A2DP callback function
  * @param event A2DP event
@@ -45,4 +56,29 @@ void bt_a2dp_sm_handler(uint16_t event, void *param);
  */
 TimerHandle_t bt_a2dp_get_timer(void);
 
+/**
+ * @brief Link-loss recovery times over the last 16 recoveries
+ *
+ * Measured from the disconnect of an established link to the next
+ * successful connect. Call from the BT app task.
+ *
+ * @return Number of recoveries the figures are based on (0: none yet)
+ */
+int bt_a2dp_get_recovery_stats(uint32_t *median_ms, uint32_t *p95_ms);
+
+/**
+ * @brief Tell the media state machine that s_is_playing changed
+ *
+ * A pause suspends the stream after a grace period; play resumes it.
+ */
+void bt_a2dp_play_state_changed(void);
+
+/**
+ * @brief Figures for the last pause, as logged on resume
+ *
+ * Complete once the first audio after the resume has been sent. Call from
+ * the BT app task.
+ */
+void bt_a2dp_get_pause_stats(bt_a2dp_pause_stats_t *stats);
+
 #endif /* __BT_A2DP_H__ */
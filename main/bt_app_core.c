@@ -7,12 +7,15 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOSConfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "bt_app_core.h"
+#include "mem_budget.h"
 
 /*********************************
  * STATIC FUNCTION DECLARATIONS
@@ -22,14 +25,38 @@
 static void bt_app_task_handler(void *arg);
 /* message sender for Work queue */
 static bool bt_app_send_msg(bt_app_msg_t *msg);
+/* message sender for coalescing slots */
+static bool bt_app_post_slot(bt_app_msg_t *msg);
+/* pick the next message, highest class first */
+static bool bt_app_next_msg(bt_app_msg_t *msg);
 /* handler for dispatched message */
 static void bt_app_work_dispatched(bt_app_msg_t *msg);
+/* handle every pending message, highest class first */
+static void bt_app_drain(void);
 
 /*********************************
  * STATIC VARIABLE DEFINITIONS
  ********************************/
+
+/* a LOW message waiting in a slot; one slot per (handler, event) */
+typedef struct {
+    bool                 used;
+    bool                 pending;
+    bt_app_msg_t         msg;
+} bt_app_slot_t;
+
 static QueueHandle_t s_bt_app_task_queue = NULL;
+static QueueHandle_t s_bt_app_high_queue = NULL;
 static TaskHandle_t s_bt_app_task_handle = NULL;
+static StaticQueue_t s_bt_app_queue_buf;
+static uint8_t s_bt_app_queue_storage[BT_APP_QUEUE_LEN * sizeof(bt_app_msg_t)];
+static StaticQueue_t s_bt_app_high_queue_buf;
+static uint8_t s_bt_app_high_queue_storage[BT_APP_HIGH_QUEUE_LEN * sizeof(bt_app_msg_t)];
+static bt_app_slot_t s_bt_app_slots[BT_APP_COALESCE_SLOTS];
+static int s_bt_app_slot_next = 0;
+static bt_app_stats_t s_bt_app_stats;
+static portMUX_TYPE s_bt_app_lock = portMUX_INITIALIZER_UNLOCKED;
+MEM_STATIC_TASK(s_bt_app_task, BT_APP_TASK_STACK);
 
 /*********************************
  * STATIC FUNCTION DEFINITIONS
@@ -41,81 +68,226 @@ static bool bt_app_send_msg(bt_app_msg_t *msg)
         return false;
     }
 
-    if (pdTRUE != xQueueSend(s_bt_app_task_queue, msg, 10 / portTICK_PERIOD_MS)) {
-        ESP_LOGE(BT_APP_CORE_TAG, "%s xQueue send failed", __func__);
+    QueueHandle_t queue = (msg->prio == BT_APP_PRIO_HIGH) ? s_bt_app_high_queue : s_bt_app_task_queue;
+    if (pdTRUE != xQueueSend(queue, msg, 10 / portTICK_PERIOD_MS)) {
+        portENTER_CRITICAL(&s_bt_app_lock);
+        uint32_t dropped = ++s_bt_app_stats.dropped;
+        portEXIT_CRITICAL(&s_bt_app_lock);
+        ESP_LOGE(BT_APP_CORE_TAG, "%s xQueue send failed, event 0x%x, %u dropped", __func__,
+                 msg->event, (unsigned int)dropped);
         return false;
     }
 
+    uint32_t depth = uxQueueMessagesWaiting(s_bt_app_high_queue) + uxQueueMessagesWaiting(s_bt_app_task_queue);
+    portENTER_CRITICAL(&s_bt_app_lock);
+    s_bt_app_stats.sent++;
+    if (depth > s_bt_app_stats.high_watermark) {
+        s_bt_app_stats.high_watermark = depth;
+    }
+    portEXIT_CRITICAL(&s_bt_app_lock);
+
+    xTaskNotifyGive(s_bt_app_task_handle);
+    return true;
+}
+
+static bool bt_app_post_slot(bt_app_msg_t *msg)
+{
+    bool posted = false;
+    bool coalesced = false;
+    int free_slot = -1;
+
+    portENTER_CRITICAL(&s_bt_app_lock);
+    for (int i = 0; i < BT_APP_COALESCE_SLOTS; i++) {
+        bt_app_slot_t *slot = &s_bt_app_slots[i];
+        if (slot->used && slot->msg.cb == msg->cb && slot->msg.event == msg->event) {
+            /* the newer message replaces a pending one; its queueing time is kept */
+            coalesced = slot->pending;
+            if (coalesced) {
+                msg->enq_us = slot->msg.enq_us;
+            }
+            slot->msg = *msg;
+            slot->pending = true;
+            posted = true;
+            break;
+        }
+        if (!slot->used && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    if (!posted && free_slot >= 0) {
+        s_bt_app_slots[free_slot].used = true;
+        s_bt_app_slots[free_slot].pending = true;
+        s_bt_app_slots[free_slot].msg = *msg;
+        posted = true;
+    }
+    if (coalesced) {
+        s_bt_app_stats.coalesced++;
+    } else if (posted) {
+        s_bt_app_stats.sent++;
+    }
+    portEXIT_CRITICAL(&s_bt_app_lock);
+
+    if (!posted) {
+        /* out of slots: still deliver it, just without coalescing */
+        msg->prio = BT_APP_PRIO_NORMAL;
+        return bt_app_send_msg(msg);
+    }
+    if (!coalesced) {
+        xTaskNotifyGive(s_bt_app_task_handle);
+    }
     return true;
 }
 
+static bool bt_app_next_msg(bt_app_msg_t *msg)
+{
+    if (pdTRUE == xQueueReceive(s_bt_app_high_queue, msg, 0)) {
+        return true;
+    }
+    if (pdTRUE == xQueueReceive(s_bt_app_task_queue, msg, 0)) {
+        return true;
+    }
+
+    bool found = false;
+    portENTER_CRITICAL(&s_bt_app_lock);
+    /* round robin, so one busy event cannot starve the other slots */
+    for (int n = 0; n < BT_APP_COALESCE_SLOTS; n++) {
+        bt_app_slot_t *slot = &s_bt_app_slots[(s_bt_app_slot_next + n) % BT_APP_COALESCE_SLOTS];
+        if (slot->pending) {
+            *msg = slot->msg;
+            slot->pending = false;
+            s_bt_app_slot_next = (s_bt_app_slot_next + n + 1) % BT_APP_COALESCE_SLOTS;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_bt_app_lock);
+    return found;
+}
+
 static void bt_app_work_dispatched(bt_app_msg_t *msg)
 {
     if (msg->cb) {
-        msg->cb(msg->event, msg->param);
+        msg->cb(msg->event, msg->param_len ? &msg->param : NULL);
     }
 }
 
-static void bt_app_task_handler(void *arg)
+static void bt_app_drain(void)
 {
+    static const char *class_name[BT_APP_PRIO_NUM] = {"high", "normal", "low"};
+    static uint32_t handled = 0;
     bt_app_msg_t msg;
 
-    for (;;) {
-        /* receive message from work queue and handle it */
-        if (pdTRUE == xQueueReceive(s_bt_app_task_queue, &msg, (TickType_t)portMAX_DELAY)) {
-            ESP_LOGD(BT_APP_CORE_TAG, "%s, signal: 0x%x, event: 0x%x", __func__, msg.sig, msg.event);
-
-            switch (msg.sig) {
-            case BT_APP_SIG_WORK_DISPATCH:
-                bt_app_work_dispatched(&msg);
-                break;
-            default:
-                ESP_LOGW(BT_APP_CORE_TAG, "%s, unhandled signal: %d", __func__, msg.sig);
-                break;
-            }
+    while (bt_app_next_msg(&msg)) {
+        ESP_LOGD(BT_APP_CORE_TAG, "%s, signal: 0x%x, event: 0x%x", __func__, msg.sig, msg.event);
+
+        uint32_t wait_us = (uint32_t)esp_timer_get_time() - msg.enq_us;
+        portENTER_CRITICAL(&s_bt_app_lock);
+        bt_app_latency_t *lat = &s_bt_app_stats.latency[msg.prio];
+        lat->count++;
+        lat->total_us += wait_us;
+        if (wait_us > lat->max_us) {
+            lat->max_us = wait_us;
+        }
+        portEXIT_CRITICAL(&s_bt_app_lock);
 
-            if (msg.param) {
-                free(msg.param);
+        switch (msg.sig) {
+        case BT_APP_SIG_WORK_DISPATCH:
+            bt_app_work_dispatched(&msg);
+            break;
+        default:
+            ESP_LOGW(BT_APP_CORE_TAG, "%s, unhandled signal: %d", __func__, msg.sig);
+            break;
+        }
+
+        if (++handled % BT_APP_STATS_LOG_INTERVAL == 0) {
+            bt_app_stats_t stats;
+            bt_app_get_stats(&stats);
+            for (int i = 0; i < BT_APP_PRIO_NUM; i++) {
+                bt_app_latency_t *l = &stats.latency[i];
+                ESP_LOGI(BT_APP_CORE_TAG, "%s: %" PRIu32 " msgs, wait avg %" PRIu32 " us, max %" PRIu32 " us",
+                         class_name[i], l->count, l->count ? (uint32_t)(l->total_us / l->count) : 0, l->max_us);
             }
+            ESP_LOGI(BT_APP_CORE_TAG, "sent %" PRIu32 ", coalesced %" PRIu32 ", dropped %" PRIu32 ", high watermark %" PRIu32,
+                     stats.sent, stats.coalesced, stats.dropped, stats.high_watermark);
         }
     }
 }
 
+static void bt_app_task_handler(void *arg)
+{
+    for (;;) {
+        /* one notification per posted message; drain everything pending */
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        bt_app_drain();
+    }
+}
+
 /*********************************
  * EXTERN FUNCTION DEFINITIONS
  ********************************/
 
-bool bt_app_work_dispatch(bt_app_cb_t p_cback, uint16_t event, void *p_params, int param_len, bt_app_copy_cb_t p_copy_cback)
+bool bt_app_work_dispatch_prio(bt_app_cb_t p_cback, uint16_t event, void *p_params, int param_len,
+                               bt_app_copy_cb_t p_copy_cback, bt_app_prio_t prio)
 {
-    ESP_LOGD(BT_APP_CORE_TAG, "%s event: 0x%x, param len: %d", __func__, event, param_len);
+    ESP_LOGD(BT_APP_CORE_TAG, "%s event: 0x%x, param len: %d, prio: %d", __func__, event, param_len, prio);
 
-    bt_app_msg_t msg;
-    memset(&msg, 0, sizeof(bt_app_msg_t));
+    /* callers outside the stack (buttons) may post before the task is up */
+    if (s_bt_app_task_handle == NULL) {
+        return false;
+    }
 
+    bt_app_msg_t msg;
     msg.sig = BT_APP_SIG_WORK_DISPATCH;
     msg.event = event;
+    msg.prio = (prio < BT_APP_PRIO_NUM) ? prio : BT_APP_PRIO_NORMAL;
     msg.cb = p_cback;
+    msg.enq_us = (uint32_t)esp_timer_get_time();
+    msg.param_len = 0;
 
     if (param_len == 0) {
-        return bt_app_send_msg(&msg);
-    } else if (p_params && param_len > 0) {
-        if ((msg.param = malloc(param_len)) != NULL) {
-            memcpy(msg.param, p_params, param_len);
-            /* check if caller has provided a copy callback to do the deep copy */
-            if (p_copy_cback) {
-                p_copy_cback(msg.param, p_params, param_len);
-            }
-            return bt_app_send_msg(&msg);
+        /* fall through to the send below */
+    } else if (p_params && param_len > 0 && param_len <= (int)sizeof(msg.param)) {
+        /* the parameter travels inside the queue element, no heap copy */
+        memcpy(&msg.param, p_params, param_len);
+        msg.param_len = param_len;
+        /* check if caller has provided a copy callback to do the deep copy */
+        if (p_copy_cback) {
+            p_copy_cback(&msg.param, p_params, param_len);
         }
+    } else {
+        ESP_LOGE(BT_APP_CORE_TAG, "%s event 0x%x, param len %d not supported", __func__, event, param_len);
+        portENTER_CRITICAL(&s_bt_app_lock);
+        s_bt_app_stats.dropped++;
+        portEXIT_CRITICAL(&s_bt_app_lock);
+        return false;
     }
 
-    return false;
+    if (msg.prio == BT_APP_PRIO_LOW) {
+        return bt_app_post_slot(&msg);
+    }
+    return bt_app_send_msg(&msg);
+}
+
+bool bt_app_work_dispatch(bt_app_cb_t p_cback, uint16_t event, void *p_params, int param_len, bt_app_copy_cb_t p_copy_cback)
+{
+    return bt_app_work_dispatch_prio(p_cback, event, p_params, param_len, p_copy_cback, BT_APP_PRIO_NORMAL);
+}
+
+void bt_app_get_stats(bt_app_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_bt_app_lock);
+    *stats = s_bt_app_stats;
+    portEXIT_CRITICAL(&s_bt_app_lock);
 }
 
 void bt_app_task_start_up(void)
 {
-    s_bt_app_task_queue = xQueueCreate(10, sizeof(bt_app_msg_t));
-    xTaskCreate(bt_app_task_handler, "BtAppTask", 3072, NULL, 10, &s_bt_app_task_handle);
+    s_bt_app_task_queue = xQueueCreateStatic(BT_APP_QUEUE_LEN, sizeof(bt_app_msg_t),
+                                             s_bt_app_queue_storage, &s_bt_app_queue_buf);
+    s_bt_app_high_queue = xQueueCreateStatic(BT_APP_HIGH_QUEUE_LEN, sizeof(bt_app_msg_t),
+                                             s_bt_app_high_queue_storage, &s_bt_app_high_queue_buf);
+    s_bt_app_task_handle = mem_task_create(bt_app_task_handler, "BtAppTask", BT_APP_TASK_STACK, NULL, 10,
+                                           MEM_TASK_BUFS(s_bt_app_task));
 }
 
 void bt_app_task_shut_down(void)
@@ -128,4 +300,9 @@ void bt_app_task_shut_down(void)
         vQueueDelete(s_bt_app_task_queue);
         s_bt_app_task_queue = NULL;
     }
+    if (s_bt_app_high_queue) {
+        vQueueDelete(s_bt_app_high_queue);
+        s_bt_app_high_queue = NULL;
+    }
+    memset(s_bt_app_slots, 0, sizeof(s_bt_app_slots));
 }
@@ -10,6 +10,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include "esp_a2dp_api.h"
+#include "esp_avrc_api.h"
 
 /* log tag */
 #define BT_APP_CORE_TAG             "BT_APP_CORE"
@@ -17,6 +19,25 @@
 /* signal for dispatcher */
 #define BT_APP_SIG_WORK_DISPATCH    (0x01)
 
+/* depth of the work queues; the queue storage is the message pool */
+#define BT_APP_QUEUE_LEN            (10)
+#define BT_APP_HIGH_QUEUE_LEN       (6)
+/* stack of the application task, in bytes */
+#define BT_APP_TASK_STACK           (3072)
+/* distinct (handler, event) pairs that can be pending in BT_APP_PRIO_LOW */
+#define BT_APP_COALESCE_SLOTS       (4)
+/* handled messages between two statistics log lines */
+#define BT_APP_STATS_LOG_INTERVAL   (200)
+
+/* dispatch class; the task always serves the highest non-empty class first */
+typedef enum {
+    BT_APP_PRIO_HIGH = 0,  /*!< connection state and media-control ACKs */
+    BT_APP_PRIO_NORMAL,    /*!< everything else, FIFO */
+    BT_APP_PRIO_LOW,       /*!< idempotent events: a newer one replaces a pending
+                                one with the same handler and event */
+    BT_APP_PRIO_NUM,
+} bt_app_prio_t;
+
 /**
  * @brief    handler for the dispatched work
  *
@@ -25,14 +46,39 @@
  */
 typedef void (* bt_app_cb_t) (uint16_t event, void *param);
 
+/* largest callback parameter carried in a message */
+typedef union {
+    esp_a2d_cb_param_t      a2d;   /*!< A2DP source callback parameter */
+    esp_avrc_ct_cb_param_t  avrc;  /*!< AVRCP controller callback parameter */
+} bt_app_param_t;
+
 /* message to be sent */
 typedef struct {
-    uint16_t             sig;      /*!< signal to bt_app_task */
-    uint16_t             event;    /*!< message event id */
-    bt_app_cb_t          cb;       /*!< context switch callback */
-    void                 *param;   /*!< parameter area needs to be last */
+    uint16_t             sig;       /*!< signal to bt_app_task */
+    uint16_t             event;     /*!< message event id */
+    uint8_t              prio;      /*!< bt_app_prio_t class */
+    uint16_t             param_len; /*!< bytes used in param, 0 for none */
+    bt_app_cb_t          cb;        /*!< context switch callback */
+    uint32_t             enq_us;    /*!< esp_timer time it was posted (low 32 bits) */
+    bt_app_param_t       param;     /*!< parameter area needs to be last */
 } bt_app_msg_t;
 
+/* time messages of one class spent waiting for the task */
+typedef struct {
+    uint32_t             count;
+    uint32_t             max_us;
+    uint64_t             total_us;
+} bt_app_latency_t;
+
+/* dispatcher counters */
+typedef struct {
+    uint32_t             sent;           /*!< messages queued */
+    uint32_t             coalesced;      /*!< LOW messages merged into a pending one */
+    uint32_t             dropped;        /*!< queue full or parameter too large */
+    uint32_t             high_watermark; /*!< deepest queue depth seen (HIGH + NORMAL) */
+    bt_app_latency_t     latency[BT_APP_PRIO_NUM];
+} bt_app_stats_t;
+
 /**
  * @brief    parameter deep-copy function to be customized
  *
@@ -48,13 +94,33 @@ typedef void (* bt_app_copy_cb_t) (void *p_dest, void *p_src, int len);
  * @param [in] p_cback       handler for the dispatched work (event handler)
  * @param [in] event         message event id
  * @param [in] p_params      pointer to the parameter
- * @param [in] param_len     length of the parameter
+ * @param [in] param_len     length of the parameter, at most sizeof(bt_app_param_t);
+ *                           it is copied into the message, no heap is used
  * @param [in] p_copy_cback  parameter deep-copy function
  *
  * @return  true if work dispatch successfully, false otherwise
  */
 bool bt_app_work_dispatch(bt_app_cb_t p_cback, uint16_t event, void *p_params, int param_len, bt_app_copy_cb_t p_copy_cback);
 
+/**
+ * @brief    work dispatcher with an explicit class
+ *
+ * Same as bt_app_work_dispatch(), which uses BT_APP_PRIO_NORMAL.
+ *
+ * @param [in] prio          dispatch class
+ *
+ * @return  true if work dispatch (or coalescing) successfully, false otherwise
+ */
+bool bt_app_work_dispatch_prio(bt_app_cb_t p_cback, uint16_t event, void *p_params, int param_len,
+                               bt_app_copy_cb_t p_copy_cback, bt_app_prio_t prio);
+
+/**
+ * @brief    read the dispatcher counters
+ *
+ * @param [out] stats  counters since start up
+ */
+void bt_app_get_stats(bt_app_stats_t *stats);
+
 /**
  * @brief    start up the application task
  */
@@ -9,6 +9,7 @@
 #include "bt_app_core.h"
 #include "common.h"
 #include "esp_log.h"
+#include "volume_ctrl.h"
 #include <inttypes.h>
 #include <stdlib.h>
 
@@ -40,9 +41,7 @@ static void bt_av_notify_evt_handler(uint8_t event_id,
   switch (event_id) {
   /* when volume changed locally on target, this event comes */
   case ESP_AVRC_RN_VOLUME_CHANGE: {
-    audio_player_set_volume(event_parameter->volume);
-    ESP_LOGI(BT_RC_CT_TAG, "Volume changed on remote device: %d",
-             event_parameter->volume);
+    volume_ctrl_on_remote(event_parameter->volume);
     // Register for next volume change notification
     bt_av_volume_changed();
     break;
@@ -59,10 +58,16 @@ static void bt_av_notify_evt_handler(uint8_t event_id,
 void bt_avrcp_ct_callback(esp_avrc_ct_cb_event_t event,
                           esp_avrc_ct_cb_param_t *param) {
   switch (event) {
+  case ESP_AVRC_CT_CHANGE_NOTIFY_EVT: {
+    /* only volume change is registered: the latest pending one wins */
+    bt_app_work_dispatch_prio(bt_avrcp_hdl_evt, event, param,
+                              sizeof(esp_avrc_ct_cb_param_t), NULL,
+                              BT_APP_PRIO_LOW);
+    break;
+  }
   case ESP_AVRC_CT_CONNECTION_STATE_EVT:
   case ESP_AVRC_CT_PASSTHROUGH_RSP_EVT:
   case ESP_AVRC_CT_METADATA_RSP_EVT:
-  case ESP_AVRC_CT_CHANGE_NOTIFY_EVT:
   case ESP_AVRC_CT_REMOTE_FEATURES_EVT:
   case ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT:
   case ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT: {
@@ -95,6 +100,8 @@ void bt_avrcp_hdl_evt(uint16_t event, void *p_param) {
     } else {
       s_avrc_peer_rn_cap.bits = 0;
       s_volume_init_done = false; // Reset flag for next connection
+      audio_player_set_volume_mode(AUDIO_VOLUME_SOFTWARE);
+      volume_ctrl_reset();
     }
     break;
   }
@@ -134,12 +141,18 @@ void bt_avrcp_hdl_evt(uint16_t event, void *p_param) {
              rc->get_rn_caps_rsp.cap_count, rc->get_rn_caps_rsp.evt_set.bits);
     s_avrc_peer_rn_cap.bits = rc->get_rn_caps_rsp.evt_set.bits;
 
+    // A sink with absolute volume owns the level; scaling here as well
+    // would attenuate twice
+    bool abs_volume = esp_avrc_rn_evt_bit_mask_operation(
+        ESP_AVRC_BIT_MASK_OP_TEST, &s_avrc_peer_rn_cap,
+        ESP_AVRC_RN_VOLUME_CHANGE);
+    audio_player_set_volume_mode(abs_volume ? AUDIO_VOLUME_ABSOLUTE
+                                            : AUDIO_VOLUME_SOFTWARE);
+
     // Set initial volume when AVRCP connection is established
     if (!s_volume_init_done) {
-      audio_player_set_volume(INITIAL_VOLUME);
       ESP_LOGI(BT_RC_CT_TAG, "Setting initial volume to %d", INITIAL_VOLUME);
-      esp_avrc_ct_send_set_absolute_volume_cmd(APP_RC_CT_TL_RN_VOLUME_CHANGE,
-                                               INITIAL_VOLUME);
+      volume_ctrl_set_local(INITIAL_VOLUME);
       s_volume_init_done = true;
     }
 
@@ -148,8 +161,9 @@ void bt_avrcp_hdl_evt(uint16_t event, void *p_param) {
   }
   /* when set absolute volume responded, this event comes */
   case ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT: {
-    ESP_LOGI(BT_RC_CT_TAG, "Set absolute volume response: volume %d",
+    ESP_LOGD(BT_RC_CT_TAG, "Set absolute volume response: volume %d",
              rc->set_volume_rsp.volume);
+    volume_ctrl_on_set_rsp(rc->set_volume_rsp.volume);
     break;
   }
   /* other */
@@ -161,6 +175,7 @@ void bt_avrcp_hdl_evt(uint16_t event, void *p_param) {
 }
 
 void bt_avrcp_init(void) {
+  volume_ctrl_init();
   esp_avrc_ct_init();
   esp_avrc_ct_register_callback(bt_avrcp_ct_callback);
 
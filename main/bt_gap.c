@@ -5,14 +5,32 @@
  */
 
 #include "bt_gap.h"
+#include "boot_timeline.h"
+#include "bt_app_core.h"
 #include "common.h"
 #include "esp_a2dp_api.h"
 #include "esp_bt_device.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include "mem_budget.h"
+#include "nvs.h"
+#include "player_status.h"
+#include "trace.h"
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define PEER_NVS_NAMESPACE "bt_peer"
+#define PEER_NVS_KEY_BDA "bda"
+#define PEER_NVS_KEY_NAME "name"
+/* Longer than the controller's default 5.12 s page timeout */
+#define PEER_CONNECT_TIMEOUT_MS 6000
+
 /*********************************
  * MODULE VARIABLES
  ********************************/
@@ -23,6 +41,12 @@ uint8_t s_peer_bdname[ESP_BT_GAP_MAX_BDNAME_LEN + 1];
  * STATIC VARIABLES
  ********************************/
 static const char remote_device_name[] = CONFIG_EXAMPLE_PEER_DEVICE_NAME;
+static esp_bd_addr_t s_cached_bda;   /* peer stored in NVS */
+static bool s_cached_valid = false;
+static TimerHandle_t s_peer_tmr;     /* inquiry fallback for the cached peer */
+MEM_STATIC_TIMER(s_peer_tmr);
+static const char *s_connect_path = "inquiry";
+static bool s_first_connect_logged = false;
 
 /*********************************
  * UTILITY FUNCTIONS
@@ -83,18 +107,15 @@ static void filter_inquiry_scan_result(esp_bt_gap_cb_param_t *param) {
   esp_bt_gap_dev_prop_t *p;
 
   /* handle the discovery results */
-  ESP_LOGI(BT_AV_TAG, "Scanned device: %s",
-           bda2str(param->disc_res.bda, bda_str, 18));
+  bda2str(param->disc_res.bda, bda_str, 18);
   for (int i = 0; i < param->disc_res.num_prop; i++) {
     p = param->disc_res.prop + i;
     switch (p->type) {
     case ESP_BT_GAP_DEV_PROP_COD:
       cod = *(uint32_t *)(p->val);
-      ESP_LOGI(BT_AV_TAG, "--Class of Device: 0x%" PRIx32, cod);
       break;
     case ESP_BT_GAP_DEV_PROP_RSSI:
       rssi = *(int8_t *)(p->val);
-      ESP_LOGI(BT_AV_TAG, "--RSSI: %" PRId32, rssi);
       break;
     case ESP_BT_GAP_DEV_PROP_EIR:
       eir = (uint8_t *)(p->val);
@@ -105,6 +126,11 @@ static void filter_inquiry_scan_result(esp_bt_gap_cb_param_t *param) {
     }
   }
 
+  const uint8_t *bda = param->disc_res.bda;
+  TRACE(TRACE_EVT_INQ_RESULT,
+        (uint32_t)bda[2] << 24 | bda[3] << 16 | bda[4] << 8 | bda[5],
+        (cod & 0xFFFFFF) | ((uint32_t)(rssi & 0xFF) << 24));
+
   /* search for device with MAJOR service class as "rendering" in COD */
   if (!esp_bt_gap_is_valid_cod(cod) ||
       !(esp_bt_gap_get_cod_srvc(cod) & ESP_BT_COD_SRVC_RENDERING)) {
@@ -125,6 +151,51 @@ static void filter_inquiry_scan_result(esp_bt_gap_cb_param_t *param) {
   }
 }
 
+/* Load the last connected peer, ignoring it if the target name changed */
+static bool load_cached_peer(void) {
+  nvs_handle_t handle;
+  if (nvs_open(PEER_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    return false;
+  }
+
+  uint8_t name[ESP_BT_GAP_MAX_BDNAME_LEN + 1];
+  size_t bda_len = ESP_BD_ADDR_LEN;
+  size_t name_len = sizeof(name);
+  esp_err_t err =
+      nvs_get_blob(handle, PEER_NVS_KEY_BDA, s_cached_bda, &bda_len);
+  if (err == ESP_OK) {
+    err = nvs_get_str(handle, PEER_NVS_KEY_NAME, (char *)name, &name_len);
+  }
+  nvs_close(handle);
+
+  if (err != ESP_OK || bda_len != ESP_BD_ADDR_LEN ||
+      strcmp((char *)name, remote_device_name) != 0) {
+    return false;
+  }
+  s_cached_valid = true;
+  memcpy(s_peer_bda, s_cached_bda, ESP_BD_ADDR_LEN);
+  memcpy(s_peer_bdname, name, name_len);
+  return true;
+}
+
+static void peer_timeout_hdlr(uint16_t event, void *param) {
+  if (s_a2d_state == APP_AV_STATE_CONNECTED ||
+      s_a2d_state == APP_AV_STATE_DISCONNECTING ||
+      s_a2d_state == APP_AV_STATE_DISCOVERING) {
+    return;
+  }
+  ESP_LOGW(BT_AV_TAG,
+           "Cached peer did not answer within %d ms, falling back to inquiry",
+           PEER_CONNECT_TIMEOUT_MS);
+  s_connect_path = "inquiry fallback";
+  bt_gap_start_discovery();
+}
+
+static void peer_timeout_cb(TimerHandle_t arg) {
+  bt_app_work_dispatch(peer_timeout_hdlr, BT_APP_PEER_TIMEOUT_EVT, NULL, 0,
+                       NULL);
+}
+
 /*********************************
  * PUBLIC FUNCTIONS
  ********************************/
@@ -148,7 +219,7 @@ void bt_gap_callback(esp_bt_gap_cb_event_t event,
         /* connect source to peer device specified by Bluetooth Device Address
          */
         esp_a2d_source_connect(s_peer_bda);
-      } else {
+      } else if (s_a2d_state == APP_AV_STATE_DISCOVERING) {
         /* not discovered, continue to discover */
         ESP_LOGI(BT_AV_TAG, "Device discovery failed, continue to discover...");
         esp_bt_gap_start_discovery(ESP_BT_INQ_MODE_GENERAL_INQUIRY, 10, 0);
@@ -232,6 +303,7 @@ void bt_gap_callback(esp_bt_gap_cb_event_t event,
   }
   }
 
+  player_status_set_bt_state(s_a2d_state, s_media_state);
   return;
 }
 
@@ -240,5 +312,67 @@ void bt_gap_register(void) { esp_bt_gap_register_callback(bt_gap_callback); }
 void bt_gap_start_discovery(void) {
   ESP_LOGI(BT_AV_TAG, "Starting device discovery...");
   s_a2d_state = APP_AV_STATE_DISCOVERING;
+  player_status_set_bt_state(s_a2d_state, s_media_state);
   esp_bt_gap_start_discovery(ESP_BT_INQ_MODE_GENERAL_INQUIRY, 10, 0);
 }
+
+void bt_gap_connect_peer(void) {
+  char bda_str[18];
+
+  if (!load_cached_peer()) {
+    bt_gap_start_discovery();
+    return;
+  }
+
+  ESP_LOGI(BT_AV_TAG, "Connecting to cached peer %s (%s), skipping inquiry",
+           bda2str(s_peer_bda, bda_str, sizeof(bda_str)), s_peer_bdname);
+  s_connect_path = "cached peer";
+  s_a2d_state = APP_AV_STATE_CONNECTING;
+  s_connecting_intv = 0;
+  player_status_set_bt_state(s_a2d_state, s_media_state);
+  esp_a2d_source_connect(s_peer_bda);
+
+  s_peer_tmr = mem_timer_create(
+      "peerTmr", pdMS_TO_TICKS(PEER_CONNECT_TIMEOUT_MS), pdFALSE, NULL,
+      peer_timeout_cb, MEM_TIMER_BUF(s_peer_tmr));
+  xTimerStart(s_peer_tmr, portMAX_DELAY);
+}
+
+void bt_gap_peer_connected(void) {
+  if (s_peer_tmr) {
+    xTimerStop(s_peer_tmr, 0);
+  }
+
+  if (!s_first_connect_logged) {
+    s_first_connect_logged = true;
+    ESP_LOGI(BT_AV_TAG, "Boot to connected: %" PRId64 " ms (%s)",
+             esp_timer_get_time() / 1000, s_connect_path);
+    boot_mark("a2dp connected");
+  }
+
+  /* Only touch flash when the peer actually changed */
+  if (s_cached_valid && memcmp(s_cached_bda, s_peer_bda, ESP_BD_ADDR_LEN) == 0) {
+    return;
+  }
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(PEER_NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err != ESP_OK) {
+    ESP_LOGE(BT_AV_TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+    return;
+  }
+  err = nvs_set_blob(handle, PEER_NVS_KEY_BDA, s_peer_bda, ESP_BD_ADDR_LEN);
+  if (err == ESP_OK) {
+    err = nvs_set_str(handle, PEER_NVS_KEY_NAME, (char *)s_peer_bdname);
+  }
+  if (err == ESP_OK) {
+    err = nvs_commit(handle);
+  }
+  nvs_close(handle);
+
+  if (err == ESP_OK) {
+    memcpy(s_cached_bda, s_peer_bda, ESP_BD_ADDR_LEN);
+    s_cached_valid = true;
+  } else {
+    ESP_LOGE(BT_AV_TAG, "Failed to store peer: %s", esp_err_to_name(err));
+  }
+}
@@ -19,6 +19,23 @@ void bt_gap_register(void);
  */
 void bt_gap_start_discovery(void);
 
+/**
+ * @brief Connect to the target sink at boot
+ *
+ * Pages the last connected peer stored in NVS directly. Inquiry only runs
+ * if there is no cached peer, or if it has not connected within a bounded
+ * timeout.
+ */
+void bt_gap_connect_peer(void);
+
+/**
+ * @brief Record a successful A2DP connection
+ *
+ * Stores the peer in NVS for the next boot (only when it changed) and logs
+ * the boot-to-connected time once.
+ */
+void bt_gap_peer_connected(void);
+
 /**
  * @brief GAP callback function
  * @param event GAP event
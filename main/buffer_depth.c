@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "buffer_depth.h"
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void buffer_depth_note_callback(buffer_depth_t *d, int64_t now_us,
+                                int32_t len, int32_t filled,
+                                uint32_t buffered, bool playing) {
+  audio_buffer_metrics_t *m = &d->m;
+  if (d->last_cb_us != 0 && now_us - d->last_cb_us < BUF_CB_GAP_US) {
+    uint32_t interval = now_us - d->last_cb_us;
+    if (m->cb_interval_us == 0) {
+      m->cb_interval_us = interval;
+    }
+    // RFC 3550 style: smoothed deviation from the smoothed period
+    int32_t dev = (int32_t)interval - (int32_t)m->cb_interval_us;
+    m->cb_interval_us += dev / 16;
+    m->cb_jitter_us += ((dev < 0 ? -dev : dev) - (int32_t)m->cb_jitter_us) / 16;
+  }
+  d->last_cb_us = now_us;
+  d->fill_sum += buffered + filled;
+  d->fill_cnt++;
+  // Count each time a flowing stream runs dry, not every empty callback
+  if (filled < len && playing && d->had_data) {
+    m->underruns++;
+    m->last_underrun_us = now_us;
+    uint32_t grown = m->target_bytes + m->target_bytes / 4;
+    m->target_bytes = grown > d->max_bytes ? d->max_bytes : grown;
+    m->reason = AUDIO_BUF_REASON_UNDERRUN;
+  }
+  d->had_data = (filled == len);
+}
+
+void buffer_depth_note_sd_read(buffer_depth_t *d, uint32_t read_us) {
+  uint32_t peak = d->m.sd_read_peak_us;
+  peak -= peak >> 4;
+  d->m.sd_read_peak_us = read_us > peak ? read_us : peak;
+}
+
+bool buffer_depth_adapt(buffer_depth_t *d, int64_t now_us) {
+  audio_buffer_metrics_t *m = &d->m;
+  // A sink with a deep buffer of its own rides out short gaps
+  uint32_t margin_ms = (m->sink_delay_01ms / 10 >= BUF_SINK_DEEP_MS)
+                           ? BUF_MARGIN_SINK_MS
+                           : BUF_MARGIN_MS;
+  uint32_t cb_us = 2 * m->cb_interval_us + 4 * m->cb_jitter_us;
+  uint32_t need_ms = (cb_us + m->sd_read_peak_us) / 1000 + margin_ms;
+  uint32_t proposal = need_ms * d->bytes_per_ms;
+  if (proposal < BUF_TARGET_MIN) {
+    proposal = BUF_TARGET_MIN;
+  } else if (proposal > d->max_bytes) {
+    proposal = d->max_bytes;
+  }
+  audio_buf_reason_t why = (cb_us >= m->sd_read_peak_us)
+                               ? AUDIO_BUF_REASON_CB_JITTER
+                               : AUDIO_BUF_REASON_SD_LATENCY;
+
+  uint32_t target = m->target_bytes;
+  bool hold = (m->last_underrun_us != 0 &&
+               now_us - m->last_underrun_us < BUF_UNDERRUN_HOLD_MS * 1000LL);
+  if (proposal > target) {
+    target = proposal;
+    d->shrink_since_us = 0;
+  } else if (!hold && proposal < target - target * BUF_HYST_PCT / 100) {
+    if (d->shrink_since_us == 0) {
+      d->shrink_since_us = now_us;
+    } else if (now_us - d->shrink_since_us >= BUF_SHRINK_HOLD_MS * 1000LL) {
+      target = proposal;
+      why = AUDIO_BUF_REASON_SHRINK;
+      d->shrink_since_us = 0;
+    }
+  } else {
+    d->shrink_since_us = 0;
+  }
+
+  bool changed = (target != m->target_bytes);
+  if (changed) {
+    m->target_bytes = target;
+    m->reason = why;
+  }
+  m->target_ms = m->target_bytes / d->bytes_per_ms;
+  if (d->fill_cnt) {
+    m->fill_avg_bytes = d->fill_sum / d->fill_cnt;
+    d->fill_sum = 0;
+    d->fill_cnt = 0;
+  }
+  return changed;
+}
@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __BUFFER_DEPTH_H__
+#define __BUFFER_DEPTH_H__
+
+#include "audio_player.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Adaptive PCM buffer depth.
+ *
+ * The data callback reports its timing and the decode task its SD read
+ * times; once a second buffer_depth_adapt() turns them into the depth the
+ * decode task fills the ring up to. No locking and no clock of its own:
+ * audio_player.c calls it under its buffer lock with esp_timer time.
+ */
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define BUF_TARGET_MIN (6 * 1024)
+#define BUF_MARGIN_MS 40           // safety margin on top of measured needs
+#define BUF_MARGIN_SINK_MS 20      // ... when the sink buffers a lot itself
+#define BUF_SINK_DEEP_MS 150       // sink delay counted as "a lot"
+#define BUF_HYST_PCT 15            // ignore shrink proposals within this band
+#define BUF_SHRINK_HOLD_MS 10000   // proposal must stay lower this long
+#define BUF_UNDERRUN_HOLD_MS 30000 // no shrinking after an underrun
+#define BUF_CB_GAP_US 100000 // longer gaps are stream restarts, not jitter
+
+/**
+ * @brief Depth decision state; the public part is the metrics snapshot
+ */
+typedef struct {
+  audio_buffer_metrics_t m;
+  uint32_t max_bytes;    /*!< ring size, the upper bound */
+  uint32_t bytes_per_ms; /*!< PCM rate of the current track */
+  int64_t last_cb_us;
+  int64_t shrink_since_us;
+  uint32_t fill_sum;
+  uint32_t fill_cnt;
+  bool had_data;
+} buffer_depth_t;
+
+/* Starts at the full ring, 44.1 kHz stereo 16-bit */
+#define BUFFER_DEPTH_INITIALIZER(max)                                          \
+  {                                                                            \
+    .m = {.target_bytes = (max), .reason = AUDIO_BUF_REASON_INIT},             \
+    .max_bytes = (max), .bytes_per_ms = 176,                                   \
+  }
+
+/**
+ * @brief Account one data callback
+ *
+ * @param now_us Time of the callback
+ * @param len Bytes asked for
+ * @param filled Bytes of PCM delivered, the rest was silence
+ * @param buffered Bytes left in the ring after the callback
+ * @param playing The player is playing, so silence is an underrun
+ */
+void buffer_depth_note_callback(buffer_depth_t *d, int64_t now_us,
+                                int32_t len, int32_t filled,
+                                uint32_t buffered, bool playing);
+
+/**
+ * @brief Account one SD read, feeding a peak that decays by 1/16 per read
+ */
+void buffer_depth_note_sd_read(buffer_depth_t *d, uint32_t read_us);
+
+/**
+ * @brief Re-pick the target depth; call about once a second
+ *
+ * Two data-callback periods plus four times the callback jitter cover the
+ * consumer side; the peak SD read time covers a stalled producer. Growth
+ * applies at once, shrinking only after the lower proposal has held for
+ * BUF_SHRINK_HOLD_MS outside the hysteresis band.
+ *
+ * @return true if the target changed
+ */
+bool buffer_depth_adapt(buffer_depth_t *d, int64_t now_us);
+
+#endif /* __BUFFER_DEPTH_H__ */
@@ -6,99 +6,180 @@
 
 #include "button_control.h"
 #include "audio_player.h"
+#include "bt_a2dp.h"
+#include "button_fsm.h"
 #include "common.h"
 #include "driver/gpio.h"
+#include "eq.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "gpio_config.h"
+#include "mem_budget.h"
+#include "player_status.h"
+#include "trace.h"
+#include "volume_ctrl.h"
+#include <stdatomic.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define BTN_DEBOUNCE_US (20 * 1000)
+#define BTN_POLL_US (30 * 1000) // level sampling while a button is down
+#define BTN_LONG_PRESS_US (500 * 1000)
+#define BTN_REPEAT_US (150 * 1000)
+#define BTN_TASK_STACK 3072
+#define VOLUME_STEP 5 // roughly 4%
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+enum { BTN_PREV, BTN_PLAY, BTN_NEXT, BTN_VOL_UP, BTN_VOL_DOWN, BTN_NUM };
+
+static const gpio_num_t s_btn_gpio[BTN_NUM] = {
+    GPIO_BTN_PREV, GPIO_BTN_PLAY, GPIO_BTN_NEXT, GPIO_BTN_VOL_UP,
+    GPIO_BTN_VOL_DOWN,
+};
+
+/* One bit per button: work the task has not picked up yet. Setting a bit
+ * cannot fail the way a full queue could, so no expiry is ever lost. */
+static atomic_uint s_btn_edges = 0;   // falling edges from the ISR
+static atomic_uint s_btn_expired = 0; // debounce/repeat timer expiries
+
+static TaskHandle_t s_btn_task_handle = NULL;
+MEM_STATIC_TASK(s_btn_task, BTN_TASK_STACK);
+static esp_timer_handle_t s_btn_timer[BTN_NUM];
+static button_fsm_t s_btn_fsm[BTN_NUM];
 
 /*********************************
  * STATIC FUNCTIONS
  ********************************/
-static void button_task(void *arg) {
-  // Configure all buttons with internal pull-up
-  gpio_config_t io_conf = {};
-  io_conf.intr_type = GPIO_INTR_DISABLE;
-  io_conf.mode = GPIO_MODE_INPUT;
-  io_conf.pin_bit_mask = (1ULL << GPIO_BTN_PREV) | (1ULL << GPIO_BTN_PLAY) |
-                         (1ULL << GPIO_BTN_NEXT) | (1ULL << GPIO_BTN_VOL_UP) |
-                         (1ULL << GPIO_BTN_VOL_DOWN);
-  io_conf.pull_down_en = 0;
-  io_conf.pull_up_en = 1;
-  gpio_config(&io_conf);
+static void IRAM_ATTR button_isr(void *arg) {
+  atomic_fetch_or(&s_btn_edges, 1u << (uintptr_t)arg);
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(s_btn_task_handle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
 
-  int last_play_state = 1;
-  int last_next_state = 1;
-  int last_prev_state = 1;
-  int last_vol_up_state = 1;
-  int last_vol_down_state = 1;
+static void button_timer_cb(void *arg) {
+  atomic_fetch_or(&s_btn_expired, 1u << (uintptr_t)arg);
+  xTaskNotifyGive(s_btn_task_handle);
+}
 
-  while (1) {
-    int play_state = gpio_get_level(GPIO_BTN_PLAY);
-    int next_state = gpio_get_level(GPIO_BTN_NEXT);
-    int prev_state = gpio_get_level(GPIO_BTN_PREV);
-    int vol_up_state = gpio_get_level(GPIO_BTN_VOL_UP);
-    int vol_down_state = gpio_get_level(GPIO_BTN_VOL_DOWN);
+static void button_arm(int btn, int64_t deadline_us) {
+  esp_timer_stop(s_btn_timer[btn]);
+  if (deadline_us == 0) {
+    return;
+  }
+  int64_t delay = deadline_us - esp_timer_get_time();
+  esp_timer_start_once(s_btn_timer[btn], delay > 0 ? delay : 0);
+}
 
-    if (last_play_state == 1 && play_state == 0) {
+static void button_volume_step(int btn) {
+  int vol = audio_player_get_volume();
+  int new_vol = vol + (btn == BTN_VOL_UP ? VOLUME_STEP : -VOLUME_STEP);
+  if (new_vol > 127) {
+    new_vol = 127;
+  } else if (new_vol < 0) {
+    new_vol = 0;
+  }
+  if (new_vol == vol) {
+    return;
+  }
+  volume_ctrl_set_local(new_vol);
+  TRACE(TRACE_EVT_BUTTON, s_btn_gpio[btn], new_vol);
+}
+
+static void button_handle(int btn, button_evt_t evt) {
+  switch (btn) {
+  case BTN_PLAY: {
+    // Short press toggles play/pause on release, long press cycles the EQ
+    static bool s_play_long = false;
+    if (evt == BUTTON_EVT_PRESS) {
+      s_play_long = false;
+    } else if (evt == BUTTON_EVT_LONG_PRESS) {
+      s_play_long = true;
+      eq_preset_t preset = eq_next_preset();
+      TRACE(TRACE_EVT_BUTTON, GPIO_BTN_PLAY, 0x100 | preset);
+    } else if (evt == BUTTON_EVT_RELEASE && !s_play_long) {
       s_is_playing = !s_is_playing;
-      ESP_LOGI(BT_AV_TAG, "Button: Play/Pause -> %s",
-               s_is_playing ? "Playing" : "Paused");
-      vTaskDelay(pdMS_TO_TICKS(200)); // Debounce
+      player_status_set_playing(s_is_playing);
+      bt_a2dp_play_state_changed();
+      TRACE(TRACE_EVT_BUTTON, GPIO_BTN_PLAY, s_is_playing);
     }
-
-    if (last_next_state == 1 && next_state == 0) {
-      s_next_song_req = true;
-      ESP_LOGI(BT_AV_TAG, "Button: Next");
-      vTaskDelay(pdMS_TO_TICKS(200));
+    break;
+  }
+  case BTN_NEXT:
+  case BTN_PREV: {
+    // Short press changes track on release, holding scrubs through it
+    static bool s_scrubbing[BTN_NUM];
+    bool next = btn == BTN_NEXT;
+    if (evt == BUTTON_EVT_LONG_PRESS) {
+      s_scrubbing[btn] = true;
+      audio_player_scrub(next ? 1 : -1);
+    } else if (evt == BUTTON_EVT_RELEASE) {
+      if (s_scrubbing[btn]) {
+        s_scrubbing[btn] = false;
+        audio_player_scrub(0);
+      } else if (next) {
+        s_next_song_req = true;
+      } else {
+        s_prev_song_req = true;
+      }
+      TRACE(TRACE_EVT_BUTTON, s_btn_gpio[btn], 0);
     }
-
-    if (last_prev_state == 1 && prev_state == 0) {
-      s_prev_song_req = true;
-      ESP_LOGI(BT_AV_TAG, "Button: Prev");
-      vTaskDelay(pdMS_TO_TICKS(200));
+    break;
+  }
+  case BTN_VOL_UP:
+  case BTN_VOL_DOWN: {
+    int other = (btn == BTN_VOL_UP) ? BTN_VOL_DOWN : BTN_VOL_UP;
+    if (evt == BUTTON_EVT_PRESS && button_fsm_is_down(&s_btn_fsm[other])) {
+      // Both volume keys held: print the trace ring from its own task
+      trace_dump_async();
+    } else if (evt == BUTTON_EVT_PRESS || evt == BUTTON_EVT_LONG_PRESS ||
+               evt == BUTTON_EVT_REPEAT) {
+      button_volume_step(btn);
     }
+    break;
+  }
+  default:
+    break;
+  }
+}
 
-    // Volume Up
-    if (last_vol_up_state == 1 && vol_up_state == 0) {
-      uint8_t current_vol = audio_player_get_volume();
-      if (current_vol < 127) {
-        int new_vol = current_vol + 5; // Increase by 5 or roughly 4%
-        if (new_vol > 127)
-          new_vol = 127;
-
-        audio_player_set_volume(new_vol);
-        esp_avrc_ct_send_set_absolute_volume_cmd(APP_RC_CT_TL_RN_VOLUME_CHANGE,
-                                                 new_vol);
-        ESP_LOGI(BT_AV_TAG, "Button: Vol Up -> %d", new_vol);
-      }
-      vTaskDelay(pdMS_TO_TICKS(150)); // Slightly faster repeat
-    }
+/* A timer expiry: sample the pin and step the state machine */
+static void button_expired(int btn, int64_t now) {
+  bool pressed = gpio_get_level(s_btn_gpio[btn]) == 0;
+  int64_t next = 0;
+  button_evt_t evt = button_fsm_timer(&s_btn_fsm[btn], pressed, now, &next);
+  button_arm(btn, next);
+  if (evt != BUTTON_EVT_NONE) {
+    button_handle(btn, evt);
+  }
+}
+
+static void button_task(void *arg) {
+  // Sleeps until an edge or a debounce/repeat timer wakes it
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    unsigned expired = atomic_exchange(&s_btn_expired, 0);
+    unsigned edges = atomic_exchange(&s_btn_edges, 0);
+    int64_t now = esp_timer_get_time();
 
-    // Volume Down
-    if (last_vol_down_state == 1 && vol_down_state == 0) {
-      uint8_t current_vol = audio_player_get_volume();
-      if (current_vol > 0) {
-        int new_vol = current_vol - 5;
-        if (new_vol < 0)
-          new_vol = 0;
-
-        audio_player_set_volume(new_vol);
-        esp_avrc_ct_send_set_absolute_volume_cmd(APP_RC_CT_TL_RN_VOLUME_CHANGE,
-                                                 new_vol);
-        ESP_LOGI(BT_AV_TAG, "Button: Vol Down -> %d", new_vol);
+    for (int i = 0; i < BTN_NUM; i++) {
+      // Expiry first: an edge that came after it may start a new press
+      if (expired & (1u << i)) {
+        button_expired(i, now);
+      }
+      if (edges & (1u << i)) {
+        int64_t deadline = button_fsm_edge(&s_btn_fsm[i], now);
+        if (deadline) {
+          button_arm(i, deadline);
+        }
       }
-      vTaskDelay(pdMS_TO_TICKS(150));
     }
-
-    last_play_state = play_state;
-    last_next_state = next_state;
-    last_prev_state = prev_state;
-    last_vol_up_state = vol_up_state;
-    last_vol_down_state = vol_down_state;
-
-    vTaskDelay(pdMS_TO_TICKS(50));
   }
 }
 
@@ -106,5 +187,42 @@ static void button_task(void *arg) {
  * PUBLIC FUNCTIONS
  ********************************/
 void button_control_init(void) {
-  xTaskCreate(button_task, "button_task", 2048, NULL, 5, NULL);
+  // The ISR and timers notify the task, so it has to exist first
+  s_btn_task_handle =
+      mem_task_create(button_task, "button_task", BTN_TASK_STACK, NULL, 5,
+                      MEM_TASK_BUFS(s_btn_task));
+  if (!s_btn_task_handle) {
+    ESP_LOGE(BT_AV_TAG, "Failed to create button task");
+    return;
+  }
+
+  const button_fsm_cfg_t cfg = {
+      .debounce_us = BTN_DEBOUNCE_US,
+      .poll_us = BTN_POLL_US,
+      .long_press_us = BTN_LONG_PRESS_US,
+      .repeat_us = BTN_REPEAT_US,
+  };
+
+  // Configure all buttons with internal pull-up, interrupt on press
+  gpio_config_t io_conf = {};
+  io_conf.intr_type = GPIO_INTR_NEGEDGE;
+  io_conf.mode = GPIO_MODE_INPUT;
+  io_conf.pull_down_en = 0;
+  io_conf.pull_up_en = 1;
+  for (int i = 0; i < BTN_NUM; i++) {
+    io_conf.pin_bit_mask |= 1ULL << s_btn_gpio[i];
+  }
+  gpio_config(&io_conf);
+  gpio_install_isr_service(0);
+
+  for (int i = 0; i < BTN_NUM; i++) {
+    button_fsm_init(&s_btn_fsm[i], &cfg);
+    const esp_timer_create_args_t targs = {
+        .callback = button_timer_cb,
+        .arg = (void *)(uintptr_t)i,
+        .name = "btn",
+    };
+    esp_timer_create(&targs, &s_btn_timer[i]);
+    gpio_isr_handler_add(s_btn_gpio[i], button_isr, (void *)(uintptr_t)i);
+  }
 }
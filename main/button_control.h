@@ -10,8 +10,10 @@
 /**
  * @brief Initialize button control task
  *
- * This function creates a FreeRTOS task that monitors button GPIO pins
- * and updates playback control flags.
+ * Button GPIOs raise falling-edge interrupts that set a per-button bit and
+ * notify a task; it debounces with esp_timer one-shots (button_fsm), whose
+ * expiries are flagged the same way, and updates the playback control
+ * flags. Volume keys auto-repeat while held.
  */
 void button_control_init(void);
 
@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "button_fsm.h"
+#include <string.h>
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+/* Next wake-up while the button is down */
+static int64_t down_deadline(const button_fsm_t *fsm, int64_t now_us) {
+  int64_t next = now_us + fsm->cfg.poll_us;
+  int64_t due = 0;
+
+  if (fsm->state == BUTTON_STATE_PRESSED && fsm->cfg.long_press_us) {
+    due = fsm->press_us + fsm->cfg.long_press_us;
+  } else if (fsm->state == BUTTON_STATE_HELD && fsm->cfg.repeat_us) {
+    due = fsm->next_repeat_us;
+  }
+  if (due && due < next) {
+    next = due;
+  }
+  return next;
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void button_fsm_init(button_fsm_t *fsm, const button_fsm_cfg_t *cfg) {
+  memset(fsm, 0, sizeof(*fsm));
+  fsm->cfg = *cfg;
+}
+
+int64_t button_fsm_edge(button_fsm_t *fsm, int64_t now_us) {
+  // Bounces while down or releasing are covered by the level sampling
+  if (fsm->state != BUTTON_STATE_IDLE &&
+      now_us - fsm->deadline_us < BUTTON_FSM_LOST_US) {
+    return 0;
+  }
+  fsm->state = BUTTON_STATE_DEBOUNCE;
+  fsm->deadline_us = now_us + fsm->cfg.debounce_us;
+  return fsm->deadline_us;
+}
+
+button_evt_t button_fsm_timer(button_fsm_t *fsm, bool pressed, int64_t now_us,
+                              int64_t *next_us) {
+  button_evt_t evt = BUTTON_EVT_NONE;
+  *next_us = 0;
+
+  switch (fsm->state) {
+  case BUTTON_STATE_IDLE:
+    break;
+
+  case BUTTON_STATE_DEBOUNCE:
+    if (!pressed) {
+      fsm->state = BUTTON_STATE_IDLE; // glitch
+      break;
+    }
+    fsm->state = BUTTON_STATE_PRESSED;
+    fsm->press_us = now_us;
+    fsm->long_fired = false;
+    evt = BUTTON_EVT_PRESS;
+    *next_us = down_deadline(fsm, now_us);
+    break;
+
+  case BUTTON_STATE_PRESSED:
+  case BUTTON_STATE_HELD:
+    if (!pressed) {
+      fsm->state = BUTTON_STATE_RELEASING;
+      *next_us = now_us + fsm->cfg.debounce_us;
+      break;
+    }
+    if (fsm->state == BUTTON_STATE_PRESSED && fsm->cfg.long_press_us &&
+        now_us - fsm->press_us >= fsm->cfg.long_press_us) {
+      fsm->state = BUTTON_STATE_HELD;
+      fsm->long_fired = true;
+      fsm->next_repeat_us = now_us + fsm->cfg.repeat_us;
+      evt = BUTTON_EVT_LONG_PRESS;
+    } else if (fsm->state == BUTTON_STATE_HELD && fsm->cfg.repeat_us &&
+               now_us >= fsm->next_repeat_us) {
+      // Keep the cadence even if a wake-up came late
+      do {
+        fsm->next_repeat_us += fsm->cfg.repeat_us;
+      } while (fsm->next_repeat_us <= now_us);
+      evt = BUTTON_EVT_REPEAT;
+    }
+    *next_us = down_deadline(fsm, now_us);
+    break;
+
+  case BUTTON_STATE_RELEASING:
+    if (pressed) {
+      // Contact bounce on release: still down
+      fsm->state = fsm->long_fired ? BUTTON_STATE_HELD : BUTTON_STATE_PRESSED;
+      *next_us = down_deadline(fsm, now_us);
+      break;
+    }
+    fsm->state = BUTTON_STATE_IDLE;
+    evt = BUTTON_EVT_RELEASE;
+    break;
+  }
+  fsm->deadline_us = *next_us;
+  return evt;
+}
+
+bool button_fsm_is_down(const button_fsm_t *fsm) {
+  return fsm->state == BUTTON_STATE_PRESSED ||
+         fsm->state == BUTTON_STATE_HELD ||
+         fsm->state == BUTTON_STATE_RELEASING;
+}
@@ -0,0 +1,93 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __BUTTON_FSM_H__
+#define __BUTTON_FSM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Debounce, long-press and auto-repeat logic for one active-low button.
+ *
+ * Plain C with no ESP-IDF dependency, so the same file builds on a host and
+ * can be driven by synthetic edge timelines. The caller feeds falling edges
+ * and timer expiries (with the pin level sampled at that moment) and arms a
+ * one-shot timer for the deadline each call returns.
+ */
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define BUTTON_FSM_LOST_US (1000 * 1000) // timer this late counts as lost
+
+/**
+ * @brief Events produced by the state machine
+ */
+typedef enum {
+  BUTTON_EVT_NONE = 0,
+  BUTTON_EVT_PRESS,      /*!< press confirmed after debounce */
+  BUTTON_EVT_LONG_PRESS, /*!< held for long_press_us */
+  BUTTON_EVT_REPEAT,     /*!< every repeat_us after a long press */
+  BUTTON_EVT_RELEASE,    /*!< release confirmed after debounce */
+} button_evt_t;
+
+typedef enum {
+  BUTTON_STATE_IDLE = 0,
+  BUTTON_STATE_DEBOUNCE, /*!< edge seen, waiting to sample */
+  BUTTON_STATE_PRESSED,  /*!< down, before the long-press time */
+  BUTTON_STATE_HELD,     /*!< down, repeating */
+  BUTTON_STATE_RELEASING /*!< seen up, waiting to confirm */
+} button_state_t;
+
+typedef struct {
+  uint32_t debounce_us;   /*!< settle time after an edge */
+  uint32_t poll_us;       /*!< level sampling while down (release check) */
+  uint32_t long_press_us; /*!< 0 disables long press and repeat */
+  uint32_t repeat_us;     /*!< 0 disables repeat */
+} button_fsm_cfg_t;
+
+typedef struct {
+  button_fsm_cfg_t cfg;
+  button_state_t state;
+  bool long_fired;        /*!< LONG_PRESS already reported for this press */
+  int64_t press_us;       /*!< confirmed press time */
+  int64_t next_repeat_us;
+  int64_t deadline_us;    /*!< timer last asked for, 0 for none */
+} button_fsm_t;
+
+/**
+ * @brief Reset to idle with the given timing
+ */
+void button_fsm_init(button_fsm_t *fsm, const button_fsm_cfg_t *cfg);
+
+/**
+ * @brief Feed a falling edge
+ *
+ * Edges while the button is down are ignored, unless the timer asked for
+ * is more than BUTTON_FSM_LOST_US overdue: that expiry was lost, and the
+ * edge starts a new press rather than leaving the button dead.
+ *
+ * @return Absolute time the timer should fire at, or 0 to leave it as is
+ */
+int64_t button_fsm_edge(button_fsm_t *fsm, int64_t now_us);
+
+/**
+ * @brief Feed a timer expiry with the pin level sampled now
+ *
+ * @param pressed true when the pin reads low
+ * @param[out] next_us Absolute time for the next timer, 0 for none
+ * @return Event for the caller to act on
+ */
+button_evt_t button_fsm_timer(button_fsm_t *fsm, bool pressed, int64_t now_us,
+                              int64_t *next_us);
+
+/**
+ * @brief Whether the button currently counts as down
+ */
+bool button_fsm_is_down(const button_fsm_t *fsm);
+
+#endif /* __BUTTON_FSM_H__ */
@@ -29,6 +29,7 @@
  ********************************/
 #define APP_RC_CT_TL_GET_CAPS (0)
 #define APP_RC_CT_TL_RN_VOLUME_CHANGE (1)
+#define APP_RC_CT_TL_SET_VOLUME (2) /* 2..3, one per in-flight command */
 
 /*********************************
  * EVENTS
@@ -36,6 +37,10 @@
 enum {
   BT_APP_STACK_UP_EVT = 0x0000,   /* event for stack up */
   BT_APP_HEART_BEAT_EVT = 0xff00, /* event for heart beat */
+  BT_APP_PEER_TIMEOUT_EVT = 0xff01, /* cached peer did not answer in time */
+  BT_APP_RECONNECT_EVT = 0xff02,    /* reconnect backoff expired */
+  BT_APP_PLAY_STATE_EVT = 0xff03,   /* play/pause toggled */
+  BT_APP_SUSPEND_EVT = 0xff04,      /* pause grace period expired */
 };
 
 /*********************************
@@ -59,6 +64,9 @@ enum {
   APP_AV_MEDIA_STATE_STARTING,
   APP_AV_MEDIA_STATE_STARTED,
   APP_AV_MEDIA_STATE_STOPPING,
+  APP_AV_MEDIA_STATE_SUSPENDING, /* paused, SUSPEND sent */
+  APP_AV_MEDIA_STATE_SUSPENDED,  /* paused, stream suspended, PCM kept */
+  APP_AV_MEDIA_STATE_RESUMING,   /* START sent after play */
 };
 
 /*********************************
@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "crossfade.h"
+#include <stddef.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define XFADE_CURVE_STEPS 64
+#define XFADE_UNITY 32767
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+/* sin(pi/2 * k / 64) in Q15 */
+static const int16_t s_curve[XFADE_CURVE_STEPS + 1] = {
+    0,     804,   1608,  2410,  3212,  4011,  4808,  5602,  6393,
+    7179,  7962,  8739,  9512,  10278, 11039, 11793, 12539, 13279,
+    14010, 14732, 15446, 16151, 16846, 17530, 18204, 18868, 19519,
+    20159, 20787, 21403, 22005, 22594, 23170, 23731, 24279, 24811,
+    25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510, 28898,
+    29268, 29621, 29956, 30273, 30571, 30852, 31113, 31356, 31580,
+    31785, 31971, 32137, 32285, 32412, 32521, 32609, 32678, 32728,
+    32757, 32767,
+};
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+/* Rising gain after pos of len samples, interpolated between table points */
+static int32_t fade_gain(uint32_t pos, uint32_t len) {
+  if (pos >= len) {
+    return XFADE_UNITY;
+  }
+  uint32_t u = (uint32_t)((uint64_t)pos * (XFADE_CURVE_STEPS << 8) / len);
+  int idx = u >> 8;
+  int32_t frac = u & 0xFF;
+  return s_curve[idx] + (((s_curve[idx + 1] - s_curve[idx]) * frac) >> 8);
+}
+
+static int16_t clamp16(int32_t v) {
+  return v > 32767 ? 32767 : (v < -32768 ? -32768 : (int16_t)v);
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void crossfade_mix(int16_t *pcm, const int16_t *tail, int tail_samples,
+                   int samples, int channels, uint32_t pos, uint32_t len) {
+  if (samples <= 0) {
+    return;
+  }
+  uint32_t end = pos + samples;
+  uint32_t rest0 = pos < len ? len - pos : 0;
+  uint32_t rest1 = end < len ? len - end : 0;
+
+  // Gains in Q30 so the per-sample step keeps its fraction
+  int32_t g_in = fade_gain(pos, len) << 15;
+  int32_t g_out = fade_gain(rest0, len) << 15;
+  int32_t step_in = ((fade_gain(end, len) << 15) - g_in) / samples;
+  int32_t step_out = ((fade_gain(rest1, len) << 15) - g_out) / samples;
+  if (!tail) {
+    tail_samples = 0;
+  }
+
+  for (int i = 0; i < samples; i++) {
+    int32_t gi = g_in >> 15;
+    int32_t go = g_out >> 15;
+    for (int ch = 0; ch < channels; ch++, pcm++) {
+      // Two products, each within int32, summed after scaling
+      int32_t v = (*pcm * gi + 0x4000) >> 15;
+      if (i < tail_samples) {
+        v += (tail[i * channels + ch] * go + 0x4000) >> 15;
+      }
+      *pcm = clamp16(v);
+    }
+    g_in += step_in;
+    g_out += step_out;
+  }
+}
@@ -0,0 +1,42 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __CROSSFADE_H__
+#define __CROSSFADE_H__
+
+#include "sdkconfig.h"
+#include <stdint.h>
+
+/*
+ * Equal-power crossfade between the end of one track and the start of the
+ * next, in Q15 fixed point.
+ *
+ * The incoming track rises along a quarter sine and the outgoing one falls
+ * along the matching cosine, so the summed power of uncorrelated material
+ * stays constant through the fade. The curve is a 65-point table; gains are
+ * looked up at the edges of each frame and ramped linearly in between.
+ */
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define CROSSFADE_MS (CONFIG_EXAMPLE_CROSSFADE_SEC * 1000) // 0 = off
+
+/**
+ * @brief Mix one frame of the outgoing track into the incoming one
+ *
+ * @param pcm Incoming track's frame, overwritten with the mix
+ * @param tail Outgoing track's frame, NULL once it has ended
+ * @param tail_samples Samples per channel in tail (the rest is silence)
+ * @param samples Samples per channel in pcm
+ * @param channels Interleaved channels, the same for both
+ * @param pos Samples of the fade already mixed
+ * @param len Fade length in samples
+ */
+void crossfade_mix(int16_t *pcm, const int16_t *tail, int tail_samples,
+                   int samples, int channels, uint32_t pos, uint32_t len);
+
+#endif /* __CROSSFADE_H__ */
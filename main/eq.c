@@ -0,0 +1,221 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "eq.h"
+#include "common.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "nvs.h"
+#include <math.h>
+#include <string.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define EQ_NVS_NAMESPACE "eq"
+#define EQ_NVS_KEY_PRESET "preset"
+#define EQ_NVS_KEY_CUSTOM "custom"
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+/* First subband of each band; the last band runs to subband 31 */
+static const uint8_t s_band_start[EQ_BANDS] = {0, 1, 2, 4, 6, 10, 16, 24};
+
+static const char *s_preset_name[EQ_PRESET_NUM] = {
+    "Flat", "Bass", "Treble", "Vocal", "Loudness", "Custom",
+};
+
+/* dB per band, lowest first */
+static const int8_t s_preset_db[EQ_PRESET_CUSTOM][EQ_BANDS] = {
+    [EQ_PRESET_FLAT] = {0, 0, 0, 0, 0, 0, 0, 0},
+    [EQ_PRESET_BASS] = {8, 4, 1, 0, 0, 0, 0, 0},
+    [EQ_PRESET_TREBLE] = {0, 0, 0, 0, 2, 4, 6, 6},
+    [EQ_PRESET_VOCAL] = {-3, 1, 4, 4, 2, 0, -1, -2},
+    [EQ_PRESET_LOUDNESS] = {6, 2, 0, -1, 0, 2, 4, 4},
+};
+
+static eq_preset_t s_preset = EQ_PRESET_FLAT;
+static int8_t s_custom_db[EQ_BANDS];
+
+/* Handed from the setter to each decoder's stream under the lock */
+static portMUX_TYPE s_eq_lock = portMUX_INITIALIZER_UNLOCKED;
+static float s_pending[EQ_SUBBANDS];
+static volatile uint32_t s_gen = 0; // bumped on every publication
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+static const int8_t *preset_db(eq_preset_t preset) {
+  return preset == EQ_PRESET_CUSTOM ? s_custom_db : s_preset_db[preset];
+}
+
+/*
+ * Turn band dB into per-subband linear gains. The largest boost is taken
+ * off all bands (auto preamp) so a boosted band cannot clip in synthesis.
+ */
+static void eq_publish(void) {
+  const int8_t *db = preset_db(s_preset);
+  int max_db = 0;
+  for (int b = 0; b < EQ_BANDS; b++) {
+    if (db[b] > max_db) {
+      max_db = db[b];
+    }
+  }
+
+  float gains[EQ_SUBBANDS];
+  for (int b = 0; b < EQ_BANDS; b++) {
+    int end = (b + 1 < EQ_BANDS) ? s_band_start[b + 1] : EQ_SUBBANDS;
+    float g = powf(10.0f, (db[b] - max_db) / 20.0f);
+    for (int sb = s_band_start[b]; sb < end; sb++) {
+      gains[sb] = g;
+    }
+  }
+
+  portENTER_CRITICAL(&s_eq_lock);
+  memcpy(s_pending, gains, sizeof(gains));
+  s_gen++;
+  portEXIT_CRITICAL(&s_eq_lock);
+}
+
+static void eq_save(void) {
+  nvs_handle_t handle;
+  if (nvs_open(EQ_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+    return;
+  }
+  esp_err_t err = nvs_set_u8(handle, EQ_NVS_KEY_PRESET, (uint8_t)s_preset);
+  if (err == ESP_OK) {
+    err = nvs_set_blob(handle, EQ_NVS_KEY_CUSTOM, s_custom_db,
+                       sizeof(s_custom_db));
+  }
+  if (err == ESP_OK) {
+    err = nvs_commit(handle);
+  }
+  nvs_close(handle);
+  if (err != ESP_OK) {
+    ESP_LOGW(BT_AV_TAG, "EQ: failed to save preset (%s)", esp_err_to_name(err));
+  }
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void eq_init(void) {
+  nvs_handle_t handle;
+  if (nvs_open(EQ_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+    uint8_t preset = EQ_PRESET_FLAT;
+    size_t len = sizeof(s_custom_db);
+    if (nvs_get_u8(handle, EQ_NVS_KEY_PRESET, &preset) == ESP_OK &&
+        preset < EQ_PRESET_NUM) {
+      s_preset = (eq_preset_t)preset;
+    }
+    if (nvs_get_blob(handle, EQ_NVS_KEY_CUSTOM, s_custom_db, &len) != ESP_OK ||
+        len != sizeof(s_custom_db)) {
+      memset(s_custom_db, 0, sizeof(s_custom_db));
+    }
+    nvs_close(handle);
+  }
+
+  ESP_LOGI(BT_AV_TAG, "EQ preset: %s", s_preset_name[s_preset]);
+  eq_publish();
+}
+
+void eq_set_preset(eq_preset_t preset) {
+  if (preset >= EQ_PRESET_NUM) {
+    return;
+  }
+  s_preset = preset;
+  ESP_LOGI(BT_AV_TAG, "EQ preset: %s", s_preset_name[preset]);
+  eq_publish();
+  eq_save();
+}
+
+eq_preset_t eq_next_preset(void) {
+  eq_set_preset((eq_preset_t)((s_preset + 1) % EQ_PRESET_NUM));
+  return s_preset;
+}
+
+eq_preset_t eq_get_preset(void) { return s_preset; }
+
+const char *eq_preset_name(eq_preset_t preset) {
+  return preset < EQ_PRESET_NUM ? s_preset_name[preset] : "?";
+}
+
+void eq_set_band_db(int band, int db) {
+  if (band < 0 || band >= EQ_BANDS) {
+    return;
+  }
+  if (db < EQ_DB_MIN) {
+    db = EQ_DB_MIN;
+  } else if (db > EQ_DB_MAX) {
+    db = EQ_DB_MAX;
+  }
+  s_custom_db[band] = (int8_t)db;
+  eq_set_preset(EQ_PRESET_CUSTOM);
+}
+
+void eq_stream_init(eq_stream_t *st) {
+  for (int sb = 0; sb < EQ_SUBBANDS; sb++) {
+    st->target[sb] = st->current[sb] = 1.0f;
+  }
+  st->gen = 0;
+  st->ramping = false;
+  st->flat = true;
+}
+
+bool eq_is_active(const eq_stream_t *st) {
+  return !st->flat || st->ramping || st->gen != s_gen;
+}
+
+void eq_apply(eq_stream_t *st, float *grbuf, int nsamples, int nch) {
+  if (st->gen != s_gen) {
+    portENTER_CRITICAL(&s_eq_lock);
+    memcpy(st->target, s_pending, sizeof(st->target));
+    st->gen = s_gen;
+    portEXIT_CRITICAL(&s_eq_lock);
+    st->ramping = true;
+  }
+  if (!st->ramping && st->flat) {
+    return;
+  }
+
+  bool flat = true;
+  for (int sb = 0; sb < EQ_SUBBANDS; sb++) {
+    float from = st->current[sb];
+    float to = st->target[sb];
+    float *x = grbuf + sb * GRANULE_SUBBAND_STRIDE;
+
+    if (from == to) {
+      if (to != 1.0f) {
+        for (int ch = 0; ch < nch; ch++) {
+          float *y = x + ch * GRANULE_CH_STRIDE;
+          for (int i = 0; i < nsamples; i++) {
+            y[i] *= to;
+          }
+        }
+        flat = false;
+      }
+      continue;
+    }
+
+    // Linear ramp across this granule, landing on the target
+    float step = (to - from) / nsamples;
+    for (int ch = 0; ch < nch; ch++) {
+      float *y = x + ch * GRANULE_CH_STRIDE;
+      float g = from;
+      for (int i = 0; i < nsamples; i++) {
+        g += step;
+        y[i] *= g;
+      }
+    }
+    st->current[sb] = to;
+    if (to != 1.0f) {
+      flat = false;
+    }
+  }
+  st->ramping = false;
+  st->flat = flat;
+}
@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __EQ_H__
+#define __EQ_H__
+
+#include "granule.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Equalizer applied in the MP3 subband domain.
+ *
+ * minimp3 reconstructs 32 polyphase subbands x 18 samples per granule before
+ * the synthesis filterbank; scaling a subband there shapes the spectrum for
+ * 18 multiplies per band and granule instead of a biquad chain per output
+ * sample. Band edges follow the subbands (fs/64 wide, ~690 Hz at 44.1 kHz),
+ * so the lowest band cannot separate sub-bass from bass.
+ */
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define EQ_BANDS 8
+#define EQ_SUBBANDS GRANULE_SUBBANDS
+#define EQ_DB_MIN (-12)
+#define EQ_DB_MAX 12
+
+typedef enum {
+  EQ_PRESET_FLAT = 0,
+  EQ_PRESET_BASS,
+  EQ_PRESET_TREBLE,
+  EQ_PRESET_VOCAL,
+  EQ_PRESET_LOUDNESS,
+  EQ_PRESET_CUSTOM, /*!< user gains, persisted in NVS */
+  EQ_PRESET_NUM,
+} eq_preset_t;
+
+/*
+ * Gains as one decoder applies them. A crossfade runs two decoders through
+ * eq_apply(); each ramps to a new preset on its own.
+ */
+typedef struct {
+  float target[EQ_SUBBANDS];
+  float current[EQ_SUBBANDS];
+  uint32_t gen; /*!< publication the target came from */
+  bool ramping;
+  bool flat;
+} eq_stream_t;
+
+/**
+ * @brief Load the saved preset (and custom gains) from NVS
+ *
+ * Call after nvs_flash_init(). Until then the EQ is flat.
+ */
+void eq_init(void);
+
+/**
+ * @brief Switch preset and persist the choice
+ */
+void eq_set_preset(eq_preset_t preset);
+
+/**
+ * @brief Advance to the next preset, wrapping around
+ */
+eq_preset_t eq_next_preset(void);
+
+eq_preset_t eq_get_preset(void);
+
+const char *eq_preset_name(eq_preset_t preset);
+
+/**
+ * @brief Set one band of the custom preset, selects it and persists it
+ *
+ * @param band 0 (lowest) .. EQ_BANDS - 1
+ * @param db Clamped to EQ_DB_MIN .. EQ_DB_MAX
+ */
+void eq_set_band_db(int band, int db);
+
+/**
+ * @brief Start a decoder's gains at flat; the preset ramps in on its first
+ * granule
+ */
+void eq_stream_init(eq_stream_t *st);
+
+/**
+ * @brief Whether the decoder's gains are not flat (apply does work)
+ */
+bool eq_is_active(const eq_stream_t *st);
+
+/**
+ * @brief Scale the subband samples of one granule (decode task only)
+ *
+ * Gain changes are ramped over the granule to avoid zipper noise.
+ *
+ * @param st The decoding stream's gains
+ * @param grbuf Subband samples, laid out as granule.h describes
+ * @param nsamples Samples per subband: 18 for layer III, 12 for layer I/II
+ * @param nch 1 or 2
+ */
+void eq_apply(eq_stream_t *st, float *grbuf, int nsamples, int nch);
+
+#endif /* __EQ_H__ */
@@ -0,0 +1,26 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __GRANULE_H__
+#define __GRANULE_H__
+
+/*
+ * Layout of the subband samples MINIMP3_GRANULE_HOOK hands over, between
+ * dequantization and synthesis (audio_player.c binds the hook):
+ *
+ *   grbuf[ch * GRANULE_CH_STRIDE + subband * GRANULE_SUBBAND_STRIDE + i]
+ *
+ * with i below the hook's sample count: 18 for layer III, 12 for I/II.
+ */
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define GRANULE_SUBBANDS 32
+#define GRANULE_SUBBAND_STRIDE 18
+#define GRANULE_CH_STRIDE (GRANULE_SUBBANDS * GRANULE_SUBBAND_STRIDE)
+
+#endif /* __GRANULE_H__ */
@@ -1,9 +1,13 @@
 #include "driver/gpio.h"
 #include "driver/i2c_master.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "ssd1306.h"
+#include "ssd1306_emu.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
 #include <string.h>
 
 #define TAG "SSD1306"
@@ -14,6 +18,36 @@
 
 #define I2C_TICKS_TO_WAIT 100 // Maximum ticks to wait before issuing a timeout.
 
+static esp_err_t i2c_write(SSD1306_t *dev, const uint8_t *buf, size_t len) {
+  dev->_txCount++;
+  dev->_txBytes += len + 1; // payload plus address byte
+#if CONFIG_EXAMPLE_OLED_EMULATOR
+  ssd1306_emu_i2c_write(ssd1306_emu_get(), buf, len);
+  return ESP_OK;
+#else
+  return i2c_master_transmit(dev->_i2c_dev_handle, buf, len, I2C_TICKS_TO_WAIT);
+#endif
+}
+
+// Set the horizontal-mode column/page window with single-command control
+// bytes (Co=1), then open a data stream, so the data can follow in the same
+// transaction. Returns the number of bytes written to out_buf (13).
+static int i2c_set_window(uint8_t *out_buf, int seg_start, int seg_end,
+                          int page_start, int page_end) {
+  const uint8_t commands[6] = {OLED_CMD_SET_COLUMN_RANGE, // 21
+                               seg_start + CONFIG_OFFSETX,
+                               seg_end + CONFIG_OFFSETX,
+                               OLED_CMD_SET_PAGE_RANGE, // 22
+                               page_start, page_end};
+  int out_index = 0;
+  for (int i = 0; i < (int)sizeof(commands); i++) {
+    out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_SINGLE;
+    out_buf[out_index++] = commands[i];
+  }
+  out_buf[out_index++] = OLED_CONTROL_BYTE_DATA_STREAM;
+  return out_index;
+}
+
 void i2c_master_init(SSD1306_t *dev, int16_t sda, int16_t scl, int16_t reset) {
   ESP_LOGI(TAG, "New i2c driver is used");
   i2c_master_bus_config_t i2c_mst_config = {
@@ -87,8 +121,9 @@ void i2c_init(SSD1306_t *dev, int width, int height) {
   dev->_pages = 8;
   if (dev->_height == 32)
     dev->_pages = 4;
+  dev->_contrast = 0xFF;
 
-  uint8_t out_buf[27];
+  uint8_t out_buf[32];
   int out_index = 0;
   out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_STREAM;
   out_buf[out_index++] = OLED_CMD_DISPLAY_OFF;   // AE
@@ -121,12 +156,14 @@ void i2c_init(SSD1306_t *dev, int width, int height) {
   out_buf[out_index++] = OLED_CMD_SET_VCOMH_DESELCT; // DB
   out_buf[out_index++] = 0x40;
   out_buf[out_index++] = OLED_CMD_SET_MEMORY_ADDR_MODE; // 20
-  // out_buf[out_index++] = OLED_CMD_SET_HORI_ADDR_MODE;	// 00
-  out_buf[out_index++] = OLED_CMD_SET_PAGE_ADDR_MODE; // 02
-  // Set Lower Column Start Address for Page Addressing Mode
+  out_buf[out_index++] = OLED_CMD_SET_HORI_ADDR_MODE;   // 00
+  // Full-panel window; writes set their own window before the data
+  out_buf[out_index++] = OLED_CMD_SET_COLUMN_RANGE; // 21
+  out_buf[out_index++] = 0x00;
+  out_buf[out_index++] = dev->_width - 1;
+  out_buf[out_index++] = OLED_CMD_SET_PAGE_RANGE; // 22
   out_buf[out_index++] = 0x00;
-  // Set Higher Column Start Address for Page Addressing Mode
-  out_buf[out_index++] = 0x10;
+  out_buf[out_index++] = dev->_pages - 1;
   out_buf[out_index++] = OLED_CMD_SET_CHARGE_PUMP; // 8D
   out_buf[out_index++] = 0x14;
   out_buf[out_index++] = OLED_CMD_DEACTIVE_SCROLL; // 2E
@@ -134,8 +171,7 @@ void i2c_init(SSD1306_t *dev, int width, int height) {
   out_buf[out_index++] = OLED_CMD_DISPLAY_ON;      // AF
 
   esp_err_t res;
-  res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, out_index,
-                            I2C_TICKS_TO_WAIT);
+  res = i2c_write(dev, out_buf, out_index);
   if (res == ESP_OK) {
     ESP_LOGI(TAG, "OLED configured successfully");
   } else {
@@ -151,46 +187,54 @@ void i2c_display_image(SSD1306_t *dev, int page, int seg, const uint8_t *images,
   if (seg >= dev->_width)
     return;
 
-  int _seg = seg + CONFIG_OFFSETX;
-  uint8_t columLow = _seg & 0x0F;
-  uint8_t columHigh = (_seg >> 4) & 0x0F;
-
   int _page = page;
   if (dev->_flip) {
     _page = (dev->_pages - page) - 1;
   }
 
-  uint8_t *out_buf;
-  out_buf = malloc(width < 4 ? 4 : width + 1);
-  if (out_buf == NULL) {
-    ESP_LOGE(TAG, "malloc fail");
-    return;
-  }
-  int out_index = 0;
-  out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_STREAM;
-  // Set Lower Column Start Address for Page Addressing Mode
-  out_buf[out_index++] = (0x00 + columLow);
-  // Set Higher Column Start Address for Page Addressing Mode
-  out_buf[out_index++] = (0x10 + columHigh);
-  // Set Page Start Address for Page Addressing Mode
-  out_buf[out_index++] = 0xB0 | _page;
+  if (seg + width > dev->_width)
+    width = dev->_width - seg;
 
-  esp_err_t res;
-  res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, out_index,
-                            I2C_TICKS_TO_WAIT);
+  uint8_t out_buf[13 + 128];
+  int out_index = i2c_set_window(out_buf, seg, seg + width - 1, _page, _page);
+  memcpy(&out_buf[out_index], images, width);
+  out_index += width;
+
+  esp_err_t res = i2c_write(dev, out_buf, out_index);
   if (res != ESP_OK)
     ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)",
              dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
+}
 
-  out_buf[0] = OLED_CONTROL_BYTE_DATA_STREAM;
-  memcpy(&out_buf[1], images, width);
+// Stream the whole internal buffer in one transaction. The panel is in
+// horizontal addressing mode, so the data wraps page by page through the
+// window. I2C on the ESP32 is interrupt driven, so the calling task sleeps
+// while the FIFO drains rather than spinning.
+void i2c_display_frame(SSD1306_t *dev) {
+  // Static so a 1 KB frame does not live on the OLED task stack
+  static uint8_t out_buf[13 + 8 * 128];
+
+  dev->_flushStart = esp_timer_get_time();
+  int out_index =
+      i2c_set_window(out_buf, 0, dev->_width - 1, 0, dev->_pages - 1);
+  for (int page = 0; page < dev->_pages; page++) {
+    int _page = dev->_flip ? (dev->_pages - page) - 1 : page;
+    memcpy(&out_buf[out_index], dev->_page[_page]._segs, dev->_width);
+    out_index += dev->_width;
+  }
 
-  res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, width + 1,
-                            I2C_TICKS_TO_WAIT);
+  esp_err_t res = i2c_write(dev, out_buf, out_index);
   if (res != ESP_OK)
     ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)",
              dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
-  free(out_buf);
+
+  dev->_flushUs = esp_timer_get_time() - dev->_flushStart;
+  dev->_flushBytes = out_index + 1;
+  // 9 clocks per byte (8 data bits + ACK)
+  int64_t bus_us = (int64_t)dev->_flushBytes * 9 * 1000000 / I2C_MASTER_FREQ_HZ;
+  ESP_LOGD(TAG, "frame flush: %" PRIu32 " bytes in %" PRId64 " us, bus %d%%",
+           dev->_flushBytes, dev->_flushUs,
+           dev->_flushUs ? (int)(bus_us * 100 / dev->_flushUs) : 0);
 }
 
 void i2c_contrast(SSD1306_t *dev, int contrast) {
@@ -206,8 +250,7 @@ void i2c_contrast(SSD1306_t *dev, int contrast) {
   out_buf[out_index++] = OLED_CMD_SET_CONTRAST;        // 81
   out_buf[out_index++] = _contrast;
 
-  esp_err_t res =
-      i2c_master_transmit(dev->_i2c_dev_handle, out_buf, 3, I2C_TICKS_TO_WAIT);
+  esp_err_t res = i2c_write(dev, out_buf, 3);
   if (res != ESP_OK)
     ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)",
              dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
@@ -282,8 +325,7 @@ void i2c_hardware_scroll(SSD1306_t *dev, ssd1306_scroll_type_t scroll) {
     out_buf[out_index++] = OLED_CMD_DEACTIVE_SCROLL; // 2E
   }
 
-  esp_err_t res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, out_index,
-                                      I2C_TICKS_TO_WAIT);
+  esp_err_t res = i2c_write(dev, out_buf, out_index);
   if (res != ESP_OK)
     ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)",
              dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
@@ -0,0 +1,212 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "intro_cache.h"
+#include "common.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mem_budget.h"
+#include "resume.h"
+#include "sd_card.h"
+#include <string.h>
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+// A slot is claimed under the lock and copied in or out after it, so the
+// 4 KB copies never run with interrupts masked
+typedef struct {
+  bool valid;
+  bool writing;    // claimed for a store, not readable yet
+  uint8_t readers; // being copied out, not to be reused
+  uint32_t path_hash;
+  uint32_t last_used;
+  mp3_info_t info;
+  int len;
+  uint8_t data[INTRO_CACHE_BYTES];
+} intro_slot_t;
+
+static intro_slot_t s_slots[INTRO_CACHE_SLOTS];
+static uint32_t s_use_tick = 0;
+static uint32_t s_hits = 0;
+static uint32_t s_lookups = 0;
+static portMUX_TYPE s_cache_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t s_fill_task = NULL;
+static volatile int s_hint_idx = 0;
+static uint8_t s_fill_buf[INTRO_CACHE_BYTES]; // fill task only
+MEM_STATIC_TASK(s_cache_task, INTRO_CACHE_TASK_STACK);
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+/* Must be called with s_cache_lock held */
+static intro_slot_t *slot_find(uint32_t path_hash) {
+  for (int i = 0; i < INTRO_CACHE_SLOTS; i++) {
+    if ((s_slots[i].valid || s_slots[i].writing) &&
+        s_slots[i].path_hash == path_hash) {
+      return &s_slots[i];
+    }
+  }
+  return NULL;
+}
+
+/* Least recently used (or empty) slot nobody is copying; s_cache_lock held */
+static intro_slot_t *slot_victim(void) {
+  intro_slot_t *victim = NULL;
+  for (int i = 0; i < INTRO_CACHE_SLOTS; i++) {
+    intro_slot_t *slot = &s_slots[i];
+    if (slot->writing || slot->readers) {
+      continue;
+    }
+    if (!slot->valid) {
+      return slot;
+    }
+    if (!victim || slot->last_used < victim->last_used) {
+      victim = slot;
+    }
+  }
+  return victim;
+}
+
+/* Also marks it used, so fetching one neighbour never evicts the other */
+static bool cached(uint32_t path_hash) {
+  portENTER_CRITICAL(&s_cache_lock);
+  intro_slot_t *slot = slot_find(path_hash);
+  if (slot) {
+    slot->last_used = ++s_use_tick;
+  }
+  portEXIT_CRITICAL(&s_cache_lock);
+  return slot != NULL;
+}
+
+static void intro_cache_fill(const char *path, uint32_t path_hash) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return;
+  }
+  mp3_info_t info;
+  int len = 0;
+  if (mp3_info_read(f, &info)) {
+    len = fread(s_fill_buf, 1, sizeof(s_fill_buf), f);
+  }
+  fclose(f);
+  if (len > 0) {
+    intro_cache_store(path_hash, &info, s_fill_buf, len);
+    ESP_LOGD(BT_AV_TAG, "intro cache: fetched %s", path);
+  }
+}
+
+/* Idle priority: only uses the SD card when the decoder leaves it alone */
+static void intro_cache_task(void *arg) {
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    intro_cache_fetch();
+  }
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void intro_cache_init(void) {
+  if (!s_fill_task) {
+    s_fill_task = mem_task_create(intro_cache_task, "intro_cache",
+                                  INTRO_CACHE_TASK_STACK, NULL,
+                                  tskIDLE_PRIORITY + 1,
+                                  MEM_TASK_BUFS(s_cache_task));
+  }
+}
+
+void intro_cache_hint(int song_idx) {
+  s_hint_idx = song_idx;
+  if (s_fill_task) {
+    xTaskNotifyGive(s_fill_task);
+  }
+}
+
+void intro_cache_fetch(void) {
+  int count = sd_card_get_playlist_count();
+  if (count < 2) {
+    return;
+  }
+  int cur = s_hint_idx;
+  int want[2] = {(cur + 1) % count, (cur - 1 + count) % count};
+  for (int i = 0; i < 2; i++) {
+    const char *path = sd_card_get_file_path(want[i]);
+    if (path && !cached(resume_path_hash(path))) {
+      intro_cache_fill(path, resume_path_hash(path));
+    }
+  }
+}
+
+bool intro_cache_take(uint32_t path_hash, mp3_info_t *info, uint8_t *buf,
+                      int *len) {
+  portENTER_CRITICAL(&s_cache_lock);
+  s_lookups++;
+  intro_slot_t *slot = slot_find(path_hash);
+  if (slot && slot->writing) {
+    slot = NULL; // still being filled: a miss
+  }
+  if (slot) {
+    s_hits++;
+    slot->last_used = ++s_use_tick;
+    slot->readers++;
+  }
+  portEXIT_CRITICAL(&s_cache_lock);
+  if (!slot) {
+    return false;
+  }
+
+  *info = slot->info;
+  memcpy(buf, slot->data, slot->len);
+  *len = slot->len;
+  portENTER_CRITICAL(&s_cache_lock);
+  slot->readers--;
+  portEXIT_CRITICAL(&s_cache_lock);
+  return true;
+}
+
+void intro_cache_store(uint32_t path_hash, const mp3_info_t *info,
+                       const uint8_t *buf, int len) {
+  if (len > INTRO_CACHE_BYTES) {
+    len = INTRO_CACHE_BYTES;
+  }
+  portENTER_CRITICAL(&s_cache_lock);
+  intro_slot_t *slot = slot_find(path_hash);
+  if (slot) {
+    // Already there (or on its way in); the start of a file stays the same
+    slot->last_used = ++s_use_tick;
+    slot = NULL;
+  } else {
+    slot = slot_victim();
+    if (slot) {
+      slot->valid = false;
+      slot->writing = true;
+      slot->path_hash = path_hash;
+    }
+  }
+  portEXIT_CRITICAL(&s_cache_lock);
+  if (!slot) {
+    return; // every slot busy: skip this one
+  }
+
+  slot->info = *info;
+  memcpy(slot->data, buf, len);
+  slot->len = len;
+  portENTER_CRITICAL(&s_cache_lock);
+  slot->writing = false;
+  slot->valid = true;
+  slot->last_used = ++s_use_tick;
+  portEXIT_CRITICAL(&s_cache_lock);
+}
+
+void intro_cache_stats(uint32_t *hits, uint32_t *lookups) {
+  portENTER_CRITICAL(&s_cache_lock);
+  *hits = s_hits;
+  *lookups = s_lookups;
+  portEXIT_CRITICAL(&s_cache_lock);
+}
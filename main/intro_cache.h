@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __INTRO_CACHE_H__
+#define __INTRO_CACHE_H__
+
+#include "mp3_info.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The first bytes of audio of the tracks most likely to be played next.
+ *
+ * Starting a track costs an fopen (FAT directory and cluster chain walk),
+ * the header reads of mp3_info_read() and the first data read, all on the
+ * SPI bus. With the first INTRO_CACHE_BYTES and the parsed info in RAM the
+ * decoder produces audio at once and opens the file behind it. The next
+ * and previous playlist entries are fetched by an idle-priority task;
+ * tracks that were played stay in the least-recently-used slots.
+ */
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define INTRO_CACHE_SLOTS 4
+#define INTRO_CACHE_BYTES (4 * 1024) // ~250 ms at 128 kbps
+#define INTRO_CACHE_TASK_STACK 4096
+
+/**
+ * @brief Start the background fill task
+ */
+void intro_cache_init(void);
+
+/**
+ * @brief Tell the cache which track started, so its neighbours get fetched
+ */
+void intro_cache_hint(int song_idx);
+
+/**
+ * @brief Fetch the neighbours of the last hinted track now
+ *
+ * This is what the fill task does on each hint; it blocks on the SD card.
+ */
+void intro_cache_fetch(void);
+
+/**
+ * @brief Copy out the cached start of a track
+ *
+ * @param path_hash resume_path_hash() of the file
+ * @param info Out: the stream info read when it was cached
+ * @param buf Out: audio bytes from info->data_offset on
+ * @param len Out: bytes copied, at most INTRO_CACHE_BYTES
+ * @return true on a hit (counted for the hit rate either way)
+ */
+bool intro_cache_take(uint32_t path_hash, mp3_info_t *info, uint8_t *buf,
+                      int *len);
+
+/**
+ * @brief Keep the start of a track that was just opened
+ *
+ * Nothing is stored if the track is cached already or every slot is being
+ * copied in or out.
+ *
+ * @param buf Audio bytes from info->data_offset on
+ */
+void intro_cache_store(uint32_t path_hash, const mp3_info_t *info,
+                       const uint8_t *buf, int len);
+
+/**
+ * @brief Hits and lookups so far
+ */
+void intro_cache_stats(uint32_t *hits, uint32_t *lookups);
+
+#endif /* __INTRO_CACHE_H__ */
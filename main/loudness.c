@@ -0,0 +1,486 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "loudness.h"
+#include "audio_player.h"
+#include "common.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mem_budget.h"
+#include "minimp3.h"
+#include "mp3_info.h"
+#include "resume.h"
+#include "sd_card.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define LOUDNESS_INDEX_PATH "/sdcard/LOUDNESS.IDX" // 8.3 names on FAT
+#define LOUDNESS_INDEX_TMP "/sdcard/LOUDNESS.TMP"
+#define LOUDNESS_INDEX_MAGIC 0x3158444C // "LDX1"
+
+// Measure ~1 s of every ~4 s (MPEG-1 frames)
+#define SCAN_SEGMENT_FRAMES 40
+#define SCAN_SKIP_FRAMES 120
+#define SCAN_INPUT_BYTES (4 * 1024)
+// 100 ms sub-blocks; four make a 400 ms gating block (75% overlap)
+#define SCAN_SUBBLOCKS 4
+#define SCAN_GATE_ABS (-70.0f)
+#define SCAN_GATE_REL (-10.0f)
+#define SCAN_HIST_STEP 4 // bins per LU
+#define SCAN_HIST_BINS (75 * SCAN_HIST_STEP) // -70 .. +5 LUFS
+// Playback comes first: after an underrun the scan waits this long
+#define SCAN_UNDERRUN_HOLD_MS 10000
+#define SCAN_BACKOFF_MS 200
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+typedef enum {
+  LOUDNESS_SRC_NONE = MP3_GAIN_SRC_NONE, /*!< no frames: unity gain */
+  LOUDNESS_SRC_ID3 = MP3_GAIN_SRC_ID3,
+  LOUDNESS_SRC_LAME = MP3_GAIN_SRC_LAME,
+  LOUDNESS_SRC_SCAN,
+} loudness_src_t;
+
+static const char *s_src_str[] = {
+    [LOUDNESS_SRC_NONE] = "no audio",
+    [LOUDNESS_SRC_ID3] = "id3 tag",
+    [LOUDNESS_SRC_LAME] = "lame tag",
+    [LOUDNESS_SRC_SCAN] = "scanned",
+};
+
+/* One record of the index file */
+typedef struct {
+  uint32_t path_hash;
+  uint32_t file_size; // a changed file is measured again
+  int16_t gain_cdb;   // 0.01 dB
+  uint16_t peak_q14;  // 1.0 = 16384, 0 if unknown
+  uint8_t src;        // loudness_src_t
+  uint8_t reserved[3];
+} loudness_entry_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t count;
+} loudness_index_hdr_t;
+
+static loudness_entry_t s_index[LOUDNESS_INDEX_MAX];
+static int s_index_cnt = 0;
+static portMUX_TYPE s_index_lock = portMUX_INITIALIZER_UNLOCKED;
+
+typedef struct {
+  float b0, b1, b2, a1, a2;
+} biquad_t;
+
+typedef struct {
+  float z1, z2;
+} biquad_state_t;
+
+/* Decoder and measurement state of the background pass */
+typedef struct {
+  mp3dec_t dec;
+  uint8_t in[SCAN_INPUT_BYTES];
+  int16_t pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+  biquad_t k[2]; // K-weighting: high shelf, then high pass
+  biquad_state_t st[2][2];
+  float sub[SCAN_SUBBLOCKS];
+  uint32_t sub_cnt;
+  float sub_sum;
+  uint32_t sub_n;
+  uint32_t sub_len;
+  int16_t peak;
+  uint32_t hist[SCAN_HIST_BINS];
+} scan_ctx_t;
+
+#if CONFIG_EXAMPLE_STATIC_MEMORY
+static scan_ctx_t s_scan_buf;
+#endif
+static scan_ctx_t *s_scan = NULL;
+static int s_start_idx = 0;
+static uint32_t s_backoffs = 0;
+MEM_STATIC_TASK(s_loudness_task, LOUDNESS_TASK_STACK);
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+/* Must be called with s_index_lock held */
+static loudness_entry_t *index_find(uint32_t path_hash) {
+  for (int i = 0; i < s_index_cnt; i++) {
+    if (s_index[i].path_hash == path_hash) {
+      return &s_index[i];
+    }
+  }
+  return NULL;
+}
+
+static bool in_playlist(uint32_t path_hash) {
+  for (int i = 0; i < sd_card_get_playlist_count(); i++) {
+    if (resume_path_hash(sd_card_get_file_path(i)) == path_hash) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Read the index, keeping the entries of files still on the card */
+static void index_load(void) {
+  FILE *f = fopen(LOUDNESS_INDEX_PATH, "rb");
+  if (!f) {
+    ESP_LOGI(BT_AV_TAG, "loudness: no index yet");
+    return;
+  }
+  loudness_index_hdr_t hdr;
+  loudness_entry_t e;
+  if (fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+      hdr.magic == LOUDNESS_INDEX_MAGIC) {
+    for (uint32_t i = 0; i < hdr.count && s_index_cnt < LOUDNESS_INDEX_MAX &&
+                         fread(&e, sizeof(e), 1, f) == 1;
+         i++) {
+      if (in_playlist(e.path_hash)) {
+        s_index[s_index_cnt++] = e;
+      }
+    }
+  }
+  fclose(f);
+  ESP_LOGI(BT_AV_TAG, "loudness: %d track(s) indexed", s_index_cnt);
+}
+
+/* Rewrite the index; the old one stays until the new one is complete */
+static void index_save(void) {
+  static loudness_entry_t s_copy[LOUDNESS_INDEX_MAX]; // loudness task only
+  portENTER_CRITICAL(&s_index_lock);
+  loudness_index_hdr_t hdr = {LOUDNESS_INDEX_MAGIC, s_index_cnt};
+  memcpy(s_copy, s_index, s_index_cnt * sizeof(s_index[0]));
+  portEXIT_CRITICAL(&s_index_lock);
+
+  FILE *f = fopen(LOUDNESS_INDEX_TMP, "wb");
+  if (!f) {
+    ESP_LOGW(BT_AV_TAG, "loudness: cannot write the index");
+    return;
+  }
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+            fwrite(s_copy, sizeof(s_copy[0]), hdr.count, f) == hdr.count;
+  ok = fclose(f) == 0 && ok;
+  if (ok) {
+    remove(LOUDNESS_INDEX_PATH); // FAT does not rename over a file
+    ok = rename(LOUDNESS_INDEX_TMP, LOUDNESS_INDEX_PATH) == 0;
+  }
+  if (!ok) {
+    ESP_LOGW(BT_AV_TAG, "loudness: index write failed");
+  }
+}
+
+static void index_put(const loudness_entry_t *e) {
+  portENTER_CRITICAL(&s_index_lock);
+  loudness_entry_t *slot = index_find(e->path_hash);
+  if (!slot && s_index_cnt < LOUDNESS_INDEX_MAX) {
+    slot = &s_index[s_index_cnt++];
+  }
+  if (slot) {
+    *slot = *e;
+  }
+  portEXIT_CRITICAL(&s_index_lock);
+}
+
+static bool index_has(uint32_t path_hash, uint32_t file_size) {
+  portENTER_CRITICAL(&s_index_lock);
+  loudness_entry_t *e = index_find(path_hash);
+  bool hit = e && e->file_size == file_size;
+  portEXIT_CRITICAL(&s_index_lock);
+  return hit;
+}
+
+/* BS.1770 K-weighting for the track's sample rate (as in libebur128) */
+static void k_filter_design(uint32_t hz, biquad_t k[2]) {
+  float K = tanf((float)M_PI * 1681.974450955533f / hz);
+  float Q = 0.7071752369554196f;
+  float vh = powf(10.0f, 3.999843853973347f / 20.0f);
+  float vb = powf(vh, 0.4996667741545416f);
+  float a0 = 1.0f + K / Q + K * K;
+  k[0].b0 = (vh + vb * K / Q + K * K) / a0;
+  k[0].b1 = 2.0f * (K * K - vh) / a0;
+  k[0].b2 = (vh - vb * K / Q + K * K) / a0;
+  k[0].a1 = 2.0f * (K * K - 1.0f) / a0;
+  k[0].a2 = (1.0f - K / Q + K * K) / a0;
+
+  K = tanf((float)M_PI * 38.13547087602444f / hz);
+  Q = 0.5003270373238773f;
+  a0 = 1.0f + K / Q + K * K;
+  k[1].b0 = 1.0f;
+  k[1].b1 = -2.0f;
+  k[1].b2 = 1.0f;
+  k[1].a1 = 2.0f * (K * K - 1.0f) / a0;
+  k[1].a2 = (1.0f - K / Q + K * K) / a0;
+}
+
+static inline float biquad(const biquad_t *f, biquad_state_t *s, float x) {
+  float y = f->b0 * x + s->z1;
+  s->z1 = f->b1 * x - f->a1 * y + s->z2;
+  s->z2 = f->b2 * x - f->a2 * y;
+  return y;
+}
+
+static float block_lufs(float mean_square) {
+  return -0.691f + 10.0f * log10f(mean_square);
+}
+
+/* K-weight a frame and bin the loudness of each completed 400 ms block */
+static void scan_pcm(scan_ctx_t *c, int samples, int channels) {
+  const int16_t *p = c->pcm;
+  for (int i = 0; i < samples; i++) {
+    for (int ch = 0; ch < channels; ch++, p++) {
+      int16_t a = *p < 0 ? (*p == -32768 ? 32767 : -*p) : *p;
+      if (a > c->peak) {
+        c->peak = a;
+      }
+      float y = biquad(&c->k[0], &c->st[ch][0], *p * (1.0f / 32768.0f));
+      y = biquad(&c->k[1], &c->st[ch][1], y);
+      c->sub_sum += y * y; // channels weigh 1.0 each
+    }
+    if (++c->sub_n < c->sub_len) {
+      continue;
+    }
+    c->sub[c->sub_cnt++ % SCAN_SUBBLOCKS] = c->sub_sum;
+    c->sub_sum = 0.0f;
+    c->sub_n = 0;
+    if (c->sub_cnt >= SCAN_SUBBLOCKS) {
+      float sum = 0.0f;
+      for (int j = 0; j < SCAN_SUBBLOCKS; j++) {
+        sum += c->sub[j];
+      }
+      float lufs = block_lufs(sum / (SCAN_SUBBLOCKS * c->sub_len));
+      if (lufs >= SCAN_GATE_ABS) {
+        int bin = (int)((lufs - SCAN_GATE_ABS) * SCAN_HIST_STEP);
+        c->hist[bin < SCAN_HIST_BINS ? bin : SCAN_HIST_BINS - 1]++;
+      }
+    }
+  }
+}
+
+/* Integrated loudness from the block histogram (relative gate applied) */
+static bool scan_integrate(const scan_ctx_t *c, float *lufs) {
+  float gate = SCAN_GATE_ABS;
+  for (int pass = 0; pass < 2; pass++) {
+    double sum = 0.0;
+    uint32_t n = 0;
+    for (int b = 0; b < SCAN_HIST_BINS; b++) {
+      float level = SCAN_GATE_ABS + (b + 0.5f) / SCAN_HIST_STEP;
+      if (c->hist[b] && level >= gate) {
+        sum += c->hist[b] * pow(10.0, (level + 0.691) / 10.0);
+        n += c->hist[b];
+      }
+    }
+    if (n == 0) {
+      return false;
+    }
+    *lufs = block_lufs(sum / n);
+    gate = *lufs + SCAN_GATE_REL;
+  }
+  return true;
+}
+
+/* Stay off the CPU and the card while playback is struggling */
+static void scan_yield(void) {
+  for (;;) {
+    audio_buffer_metrics_t m;
+    audio_player_get_buffer_metrics(&m);
+    if (m.last_underrun_us == 0 || esp_timer_get_time() - m.last_underrun_us >=
+                                       SCAN_UNDERRUN_HOLD_MS * 1000LL) {
+      break;
+    }
+    s_backoffs++;
+    vTaskDelay(pdMS_TO_TICKS(SCAN_BACKOFF_MS));
+  }
+  vTaskDelay(1); // and let the idle task in
+}
+
+/*
+ * Measure a track: decode SCAN_SEGMENT_FRAMES, then walk over the next
+ * SCAN_SKIP_FRAMES by their headers. Blocks do not span a skip.
+ */
+static bool scan_track(FILE *f, const mp3_info_t *info, float *lufs,
+                       float *peak) {
+  scan_ctx_t *c = s_scan;
+  if (!c || info->first.hz == 0) {
+    return false;
+  }
+  memset(c->hist, 0, sizeof(c->hist));
+  c->peak = 0;
+  c->sub_len = info->first.hz / 10;
+  k_filter_design(info->first.hz, c->k);
+
+  uint32_t off = info->data_offset;
+  uint32_t end = info->data_offset + info->audio_bytes;
+  while (off < end) {
+    scan_yield();
+    if (fseek(f, off, SEEK_SET) != 0) {
+      break;
+    }
+    mp3dec_init(&c->dec);
+    memset(c->st, 0, sizeof(c->st));
+    c->sub_cnt = 0;
+    c->sub_sum = 0.0f;
+    c->sub_n = 0;
+    int valid = 0;
+    bool file_end = false;
+
+    for (int frames = 0; frames < SCAN_SEGMENT_FRAMES;) {
+      if (!file_end && valid < SCAN_INPUT_BYTES) {
+        int read = fread(c->in + valid, 1, SCAN_INPUT_BYTES - valid, f);
+        file_end = read == 0;
+        valid += read;
+      }
+      mp3dec_frame_info_t fi;
+      int samples = mp3dec_decode_frame(&c->dec, c->in, valid, c->pcm, &fi);
+      int used = fi.frame_bytes;
+      if (used > 0 && used <= valid) {
+        memmove(c->in, c->in + used, valid - used);
+        valid -= used;
+        off += used;
+      } else if (file_end) {
+        off = end;
+        break;
+      } else if (valid == SCAN_INPUT_BYTES) {
+        memmove(c->in, c->in + 1, valid - 1);
+        valid--;
+        off++;
+      }
+      // The first frame after a jump lacks the previous overlap
+      if (samples > 0 && fi.hz == (int)info->first.hz && fi.channels <= 2 &&
+          frames++ > 0) {
+        scan_pcm(c, samples, fi.channels);
+      }
+    }
+    if (off < end) {
+      off = mp3_skip_frames(f, c->in, SCAN_INPUT_BYTES, off, SCAN_SKIP_FRAMES,
+                            NULL, NULL);
+    }
+  }
+
+  *peak = c->peak / 32768.0f;
+  return scan_integrate(c, lufs);
+}
+
+static void loudness_task(void *arg) {
+  int count = sd_card_get_playlist_count();
+  int64_t t0 = esp_timer_get_time();
+  int done = 0;
+  int tagged = 0;
+
+  for (int k = 0; k < count; k++) {
+    const char *path = sd_card_get_file_path((s_start_idx + k) % count);
+    FILE *f = path ? fopen(path, "rb") : NULL;
+    if (!f) {
+      continue;
+    }
+    fseek(f, 0, SEEK_END);
+    loudness_entry_t e = {
+        .path_hash = resume_path_hash(path),
+        .file_size = ftell(f),
+        .src = LOUDNESS_SRC_NONE,
+    };
+    if (index_has(e.path_hash, e.file_size)) {
+      fclose(f);
+      continue;
+    }
+
+    int64_t ts = esp_timer_get_time();
+    mp3_info_t info;
+    float gain_db = 0.0f;
+    float peak = 0.0f;
+    if (mp3_info_read(f, &info)) {
+      e.src = mp3_replaygain_read(f, &info, &gain_db, &peak);
+      float lufs;
+      if (e.src != LOUDNESS_SRC_NONE) {
+        tagged++;
+      } else if (scan_track(f, &info, &lufs, &peak)) {
+        gain_db = LOUDNESS_TARGET_LUFS - lufs;
+        e.src = LOUDNESS_SRC_SCAN;
+      }
+    }
+    fclose(f);
+
+    gain_db = fminf(fmaxf(gain_db, -60.0f), 60.0f);
+    e.gain_cdb = (int16_t)lroundf(gain_db * 100.0f);
+    e.peak_q14 = (uint16_t)fminf(peak * 16384.0f, 65535.0f);
+    index_put(&e);
+    index_save();
+    done++;
+
+    int64_t now = esp_timer_get_time();
+    int cdb = abs(e.gain_cdb);
+    int64_t span = now > t0 ? now - t0 : 1;
+    uint32_t per_min10 = (uint32_t)(done * 600000000LL / span);
+    ESP_LOGI(BT_AV_TAG,
+             "loudness: %s %c%d.%02d dB (%s, %" PRIu32 " ms), %" PRIu32
+             ".%" PRIu32 " tracks/min",
+             path, e.gain_cdb < 0 ? '-' : '+', cdb / 100, cdb % 100,
+             s_src_str[e.src], (uint32_t)((now - ts) / 1000), per_min10 / 10,
+             per_min10 % 10);
+  }
+
+  if (done) {
+    int64_t elapsed_ms = (esp_timer_get_time() - t0) / 1000;
+    ESP_LOGI(BT_AV_TAG,
+             "loudness: index complete, %d new (%d from tags) in %" PRId64
+             " s, %" PRIu32 " backoffs for playback",
+             done, tagged, elapsed_ms / 1000, s_backoffs);
+  }
+#if !CONFIG_EXAMPLE_STATIC_MEMORY
+  free(s_scan);
+  s_scan = NULL;
+#endif
+  // Last stack reading, then out of the report before the TCB goes
+  uint32_t unused = uxTaskGetStackHighWaterMark(NULL);
+  ESP_LOGI(BT_AV_TAG, "loudness: task done, stack peak use %" PRIu32
+                      " of %d B",
+           LOUDNESS_TASK_STACK - unused, LOUDNESS_TASK_STACK);
+  mem_budget_untrack_task(xTaskGetCurrentTaskHandle());
+  vTaskDelete(NULL);
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void loudness_init(int start_idx) {
+  index_load();
+  s_start_idx = start_idx;
+#if CONFIG_EXAMPLE_STATIC_MEMORY
+  s_scan = &s_scan_buf;
+#else
+  s_scan = malloc(sizeof(*s_scan));
+  if (!s_scan) {
+    ESP_LOGW(BT_AV_TAG, "loudness: no memory to scan, using tags only");
+  }
+#endif
+  mem_task_create(loudness_task, "loudness", LOUDNESS_TASK_STACK, NULL,
+                  tskIDLE_PRIORITY + 1, MEM_TASK_BUFS(s_loudness_task));
+}
+
+float loudness_track_gain(uint32_t path_hash) {
+  portENTER_CRITICAL(&s_index_lock);
+  loudness_entry_t *slot = index_find(path_hash);
+  loudness_entry_t e = slot ? *slot : (loudness_entry_t){0};
+  portEXIT_CRITICAL(&s_index_lock);
+
+  if (e.src == LOUDNESS_SRC_NONE) {
+    return 1.0f;
+  }
+  float db = fminf(e.gain_cdb / 100.0f, LOUDNESS_MAX_BOOST_DB);
+  float gain = powf(10.0f, db / 20.0f);
+  if (e.peak_q14 && gain * e.peak_q14 > 16384.0f) {
+    gain = 16384.0f / e.peak_q14; // keep the peak under full scale
+  }
+  return gain;
+}
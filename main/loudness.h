@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __LOUDNESS_H__
+#define __LOUDNESS_H__
+
+#include <stdint.h>
+
+/*
+ * Per-track loudness normalisation, worked out once and kept on the card.
+ *
+ * The gain comes from the ReplayGain tags when a file has them. Untagged
+ * files are measured by a background task at the lowest useful priority:
+ * BS.1770 K-weighting with EBU R128 gating, over about one second of every
+ * four. Results go to an index file next to the music, keyed by path hash
+ * and file size, so each track is looked at only once. The player folds
+ * the gain into its volume multiply.
+ */
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define LOUDNESS_TARGET_LUFS (-18.0f) // ReplayGain 2.0 reference level
+#define LOUDNESS_MAX_BOOST_DB 12      // quiet tracks are lifted at most this
+#define LOUDNESS_INDEX_MAX 64
+#define LOUDNESS_TASK_STACK (20 * 1024) // minimp3 keeps ~16 KB on the stack
+
+/**
+ * @brief Load the index and start the background pass
+ *
+ * Call from the decode task once the playlist is loaded.
+ *
+ * @param start_idx Playlist entry to look at first
+ */
+void loudness_init(int start_idx);
+
+/**
+ * @brief Linear gain for a track
+ *
+ * Limited so the tagged or measured peak stays below full scale.
+ *
+ * @param path_hash resume_path_hash() of the file
+ * @return Gain to multiply the PCM by; 1.0 while the track is not indexed
+ */
+float loudness_track_gain(uint32_t path_hash);
+
+#endif /* __LOUDNESS_H__ */
@@ -5,14 +5,18 @@
  */
 
 #include "audio_player.h"
+#include "boot_timeline.h"
 #include "bt_a2dp.h"
 #include "bt_app_core.h"
 #include "bt_avrcp.h"
 #include "bt_gap.h"
 #include "button_control.h"
 #include "common.h"
+#include "eq.h"
+#include "mem_budget.h"
 #include "oled_display.h"
-#include "sd_card.h"
+#include "player_status.h"
+#include "resume.h"
 
 #include "esp_bt.h"
 #include "esp_bt_device.h"
@@ -24,20 +28,36 @@
 #include "nvs_flash.h"
 #include <stdio.h>
 
+#define OLED_TASK_STACK 4096
+#define OLED_METER_INTERVAL_MS 200 // level meter refresh while playing
+
+MEM_STATIC_TASK(s_oled_task, OLED_TASK_STACK);
+
 /*********************************
  * STATIC FUNCTION DEFINITION
  ********************************/
 
 /**
  * @brief OLED display update task
+ *
+ * Brings the panel up itself, at low priority, so the I2C setup and the
+ * full-screen clear stay off the boot critical path. Then redraws when the
+ * published player status changes. While playing, the progress bar also
+ * needs a 1 s tick; when paused the task sleeps until something changes.
  */
 static void oled_update_task(void *arg) {
-  // Wait for system to stabilize before starting display updates
-  vTaskDelay(pdMS_TO_TICKS(2000));
+  oled_display_init();
+  boot_mark("oled ready");
+  player_status_subscribe(xTaskGetCurrentTaskHandle());
 
   while (1) {
     oled_display_update();
-    vTaskDelay(pdMS_TO_TICKS(1000)); // Update every 1000ms to reduce I2C load
+
+    player_status_t status;
+    player_status_read(&status);
+    ulTaskNotifyTake(pdTRUE, status.is_playing
+                                 ? pdMS_TO_TICKS(OLED_METER_INTERVAL_MS)
+                                 : portMAX_DELAY);
   }
 }
 
@@ -64,8 +84,10 @@ static void bt_av_hdl_stack_evt(uint16_t event, void *p_param) {
     esp_bt_gap_set_scan_mode(ESP_BT_NON_CONNECTABLE, ESP_BT_NON_DISCOVERABLE);
     esp_bt_gap_get_device_name();
 
-    // Start device discovery
-    bt_gap_start_discovery();
+    boot_mark("bt stack up");
+
+    // Page the cached peer, or start device discovery
+    bt_gap_connect_peer();
     break;
   }
   /* other */
@@ -81,17 +103,20 @@ static void bt_av_hdl_stack_evt(uint16_t event, void *p_param) {
  ********************************/
 void app_main(void) {
   char bda_str[18] = {0};
+  boot_mark("app_main");
 
-  // Initialize SD card and audio player
-  sd_card_init();
+  /*
+   * The decode task mounts the SD card and loads the playlist while the
+   * Bluetooth controller comes up below; the OLED is brought up by its own
+   * low-priority task. Neither is needed before the stack is.
+   */
   audio_player_init();
+  mem_task_create(oled_update_task, "oled_update", OLED_TASK_STACK, NULL, 2,
+                  MEM_TASK_BUFS(s_oled_task));
 
   // Initialize button control
   button_control_init();
 
-  // Initialize OLED display
-  oled_display_init();
-
   /* initialize NVS — it is used to store PHY calibration data */
   esp_err_t ret = nvs_flash_init();
   if (ret == ESP_ERR_NVS_NO_FREE_PAGES ||
@@ -100,6 +125,9 @@ void app_main(void) {
     ret = nvs_flash_init();
   }
   ESP_ERROR_CHECK(ret);
+  boot_mark("nvs");
+  eq_init();
+  resume_init();
 
   /*
    * This example only uses the functions of Classical Bluetooth.
@@ -116,6 +144,7 @@ void app_main(void) {
     ESP_LOGE(BT_AV_TAG, "%s enable controller failed", __func__);
     return;
   }
+  boot_mark("bt controller");
 
   esp_bluedroid_config_t bluedroid_cfg = BT_BLUEDROID_INIT_CONFIG_DEFAULT();
 #if (CONFIG_EXAMPLE_SSP_ENABLED == false)
@@ -131,6 +160,7 @@ void app_main(void) {
     ESP_LOGE(BT_AV_TAG, "%s enable bluedroid failed", __func__);
     return;
   }
+  boot_mark("bluedroid");
 
 #if (CONFIG_EXAMPLE_SSP_ENABLED == true)
   /* set default parameters for Secure Simple Pairing */
@@ -154,6 +184,5 @@ void app_main(void) {
   /* Bluetooth device name, connection mode and profile set up */
   bt_app_work_dispatch(bt_av_hdl_stack_evt, BT_APP_STACK_UP_EVT, NULL, 0, NULL);
 
-  // Start OLED update task with LOW priority (below BT audio priority)
-  xTaskCreate(oled_update_task, "oled_update", 4096, NULL, 2, NULL);
+  mem_budget_start();
 }
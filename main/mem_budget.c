@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "mem_budget.h"
+#include "common.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <inttypes.h>
+#include <string.h>
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+typedef struct {
+  TaskHandle_t task;
+  uint32_t stack_bytes;
+} mem_task_t;
+
+static mem_task_t s_tasks[MEM_BUDGET_MAX_TASKS];
+static int s_task_cnt = 0;
+static portMUX_TYPE s_mem_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t s_report_tmr = NULL;
+static mem_budget_trend_t s_trend;
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+static void mem_budget_timer_cb(void *arg) { mem_budget_report(); }
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+TaskHandle_t mem_task_create(TaskFunction_t fn, const char *name,
+                             uint32_t stack_bytes, void *arg,
+                             UBaseType_t prio, StackType_t *stack,
+                             StaticTask_t *tcb) {
+  TaskHandle_t task = NULL;
+  if (stack && tcb) {
+    task = xTaskCreateStatic(fn, name, stack_bytes, arg, prio, stack, tcb);
+  } else if (xTaskCreate(fn, name, stack_bytes, arg, prio, &task) != pdPASS) {
+    task = NULL;
+  }
+  if (task) {
+    mem_budget_track_task(task, stack_bytes);
+  } else {
+    ESP_LOGE(BT_AV_TAG, "Failed to create task %s", name);
+  }
+  return task;
+}
+
+TimerHandle_t mem_timer_create(const char *name, TickType_t period,
+                               UBaseType_t reload, void *id,
+                               TimerCallbackFunction_t cb, StaticTimer_t *buf) {
+  if (buf) {
+    return xTimerCreateStatic(name, period, reload, id, cb, buf);
+  }
+  return xTimerCreate(name, period, reload, id, cb);
+}
+
+void mem_budget_track_task(TaskHandle_t task, uint32_t stack_bytes) {
+  portENTER_CRITICAL(&s_mem_lock);
+  if (s_task_cnt < MEM_BUDGET_MAX_TASKS) {
+    s_tasks[s_task_cnt].task = task;
+    s_tasks[s_task_cnt].stack_bytes = stack_bytes;
+    s_task_cnt++;
+  }
+  portEXIT_CRITICAL(&s_mem_lock);
+}
+
+void mem_budget_untrack_task(TaskHandle_t task) {
+  portENTER_CRITICAL(&s_mem_lock);
+  for (int i = 0; i < s_task_cnt; i++) {
+    if (s_tasks[i].task == task) {
+      s_tasks[i] = s_tasks[--s_task_cnt];
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&s_mem_lock);
+}
+
+void mem_budget_report(void) {
+  // A copy, so a task untracked meanwhile is not looked at
+  mem_task_t tasks[MEM_BUDGET_MAX_TASKS];
+  portENTER_CRITICAL(&s_mem_lock);
+  int n = s_task_cnt;
+  memcpy(tasks, s_tasks, n * sizeof(tasks[0]));
+  portEXIT_CRITICAL(&s_mem_lock);
+
+  ESP_LOGI(BT_AV_TAG, "RAM budget (%s allocation):",
+#if CONFIG_EXAMPLE_STATIC_MEMORY
+           "static"
+#else
+           "heap"
+#endif
+  );
+  for (int i = 0; i < n; i++) {
+    // High-water mark is the stack never touched, in bytes on ESP-IDF
+    uint32_t unused = uxTaskGetStackHighWaterMark(tasks[i].task);
+    ESP_LOGI(BT_AV_TAG, "  %-12s stack %5" PRIu32 " B, peak use %5" PRIu32
+                        " B, %5" PRIu32 " B never used",
+             pcTaskGetName(tasks[i].task), tasks[i].stack_bytes,
+             tasks[i].stack_bytes - unused, unused);
+  }
+  ESP_LOGI(BT_AV_TAG,
+           "  heap free %u B, min ever %u B, largest block %u B, "
+           "internal largest %u B",
+           (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+           (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+           (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+           (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+}
+
+void mem_budget_start(void) {
+  if (s_report_tmr) {
+    return;
+  }
+  const esp_timer_create_args_t args = {
+      .callback = mem_budget_timer_cb,
+      .name = "mem",
+  };
+  if (esp_timer_create(&args, &s_report_tmr) == ESP_OK) {
+    esp_timer_start_periodic(s_report_tmr, MEM_BUDGET_REPORT_MS * 1000ULL);
+  }
+}
+
+void mem_budget_checkpoint(const char *what) {
+  mem_budget_trend_t *t = &s_trend;
+  uint32_t free_now = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  if (t->checkpoints % MEM_TREND_WINDOW == 0 || free_now < t->window_min) {
+    t->window_min = free_now;
+  }
+  if (++t->checkpoints % MEM_TREND_WINDOW != 0) {
+    return;
+  }
+
+  if (t->floor_free == 0) {
+    t->floor_free = t->window_min;
+    return;
+  }
+  if (t->window_min + MEM_TREND_TOL_BYTES >= t->floor_free) {
+    t->falling = 0;
+    return;
+  }
+  if (++t->falling < MEM_TREND_WINDOWS) {
+    return;
+  }
+  ESP_LOGW(BT_AV_TAG,
+           "heap: minimum free down %" PRIu32 " B to %" PRIu32
+           " B over %" PRIu32 " %ss, possible leak",
+           t->floor_free - t->window_min, t->window_min,
+           t->falling * MEM_TREND_WINDOW, what);
+  t->warnings++;
+  t->floor_free = t->window_min;
+  t->falling = 0;
+}
+
+void mem_budget_get_trend(mem_budget_trend_t *trend) { *trend = s_trend; }
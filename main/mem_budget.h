@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __MEM_BUDGET_H__
+#define __MEM_BUDGET_H__
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "sdkconfig.h"
+#include <stdint.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define MEM_BUDGET_MAX_TASKS 8
+#define MEM_BUDGET_REPORT_MS (60 * 1000)
+#define MEM_TREND_WINDOW 16      // checkpoints per minimum-free sample
+#define MEM_TREND_TOL_BYTES 2048 // fragmentation noise below the floor
+#define MEM_TREND_WINDOWS 3      // windows in a row below it to warn
+
+/*
+ * With CONFIG_EXAMPLE_STATIC_MEMORY the stack/TCB and timer storage is
+ * reserved in .bss by these macros and the create helpers use the *Static
+ * FreeRTOS calls; otherwise the macros expand to nothing and the helpers
+ * fall back to the heap.
+ */
+#if CONFIG_EXAMPLE_STATIC_MEMORY
+#define MEM_STATIC_TASK(var, bytes)                                           \
+  static StackType_t var##_stack[(bytes) / sizeof(StackType_t)];              \
+  static StaticTask_t var##_tcb
+#define MEM_TASK_BUFS(var) var##_stack, &var##_tcb
+#define MEM_STATIC_TIMER(var) static StaticTimer_t var##_buf
+#define MEM_TIMER_BUF(var) &var##_buf
+#else
+#define MEM_STATIC_TASK(var, bytes)
+#define MEM_TASK_BUFS(var) NULL, NULL
+#define MEM_STATIC_TIMER(var)
+#define MEM_TIMER_BUF(var) NULL
+#endif
+
+/**
+ * @brief Create a task from static buffers when given, else from the heap,
+ * and add it to the stack report
+ *
+ * @param stack_bytes Stack size in bytes (ESP-IDF convention)
+ * @return Task handle, NULL on failure
+ */
+TaskHandle_t mem_task_create(TaskFunction_t fn, const char *name,
+                             uint32_t stack_bytes, void *arg,
+                             UBaseType_t prio, StackType_t *stack,
+                             StaticTask_t *tcb);
+
+/**
+ * @brief Create a FreeRTOS timer from a static buffer when given
+ */
+TimerHandle_t mem_timer_create(const char *name, TickType_t period,
+                               UBaseType_t reload, void *id,
+                               TimerCallbackFunction_t cb, StaticTimer_t *buf);
+
+/**
+ * @brief Add a task created elsewhere to the stack report
+ */
+void mem_budget_track_task(TaskHandle_t task, uint32_t stack_bytes);
+
+/**
+ * @brief Drop a task from the stack report; call before it is deleted
+ */
+void mem_budget_untrack_task(TaskHandle_t task);
+
+/**
+ * @brief Log stack high-water marks and heap state now
+ */
+void mem_budget_report(void);
+
+/**
+ * @brief Log the report every MEM_BUDGET_REPORT_MS
+ */
+void mem_budget_start(void);
+
+/**
+ * @brief Minimum-free trend seen by mem_budget_checkpoint()
+ */
+typedef struct {
+  uint32_t floor_free;  /*!< reference minimum, 0 until the first window */
+  uint32_t window_min;  /*!< lowest free heap in the current window */
+  uint32_t checkpoints; /*!< checkpoints so far */
+  uint32_t falling;     /*!< windows in a row below the floor */
+  uint32_t warnings;    /*!< leak warnings logged */
+} mem_budget_trend_t;
+
+/**
+ * @brief Track the free-heap minimum at a repeating point
+ *
+ * Call where nothing should be held (e.g. after a track is closed). The
+ * lowest free heap of every MEM_TREND_WINDOW checkpoints is compared with
+ * the floor set by the first window; a leak is reported only when it stays
+ * more than MEM_TREND_TOL_BYTES under the floor for MEM_TREND_WINDOWS
+ * windows in a row, so fragmentation noise and one-off dips stay quiet.
+ * The floor then moves down to the new level.
+ */
+void mem_budget_checkpoint(const char *what);
+
+/**
+ * @brief Copy out the checkpoint trend
+ */
+void mem_budget_get_trend(mem_budget_trend_t *trend);
+
+#endif /* __MEM_BUDGET_H__ */
@@ -43,6 +43,14 @@ int mp3dec_decode_frame(mp3dec_t *dec, const uint8_t *mp3, int mp3_bytes, mp3d_s
 #if defined(MINIMP3_IMPLEMENTATION) && !defined(_MINIMP3_IMPLEMENTATION_GUARD)
 #define _MINIMP3_IMPLEMENTATION_GUARD
 
+/* MINIMP3_GRANULE_HOOK(grbuf, nbands, nch), if defined, is invoked on the
+   dequantized subband samples of every granule right before synthesis.
+   Layout: grbuf[ch*576 + subband*18 + i], i < nbands (18 for L3, 12 for L1/L2),
+   as GRANULE_* in granule.h. */
+#ifndef MINIMP3_GRANULE_HOOK
+#define MINIMP3_GRANULE_HOOK(grbuf, nbands, nch)
+#endif /* MINIMP3_GRANULE_HOOK */
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -1771,6 +1779,7 @@ int mp3dec_decode_frame(mp3dec_t *dec, const uint8_t *mp3, int mp3_bytes, mp3d_s
             {
                 memset(scratch.grbuf[0], 0, 576*2*sizeof(float));
                 L3_decode(dec, &scratch, scratch.gr_info + igr*info->channels, info->channels);
+                MINIMP3_GRANULE_HOOK(scratch.grbuf[0], 18, info->channels);
                 mp3d_synth_granule(dec->qmf_state, scratch.grbuf[0], 18, info->channels, pcm, scratch.syn[0]);
             }
         }
@@ -1790,6 +1799,7 @@ int mp3dec_decode_frame(mp3dec_t *dec, const uint8_t *mp3, int mp3_bytes, mp3d_s
             {
                 i = 0;
                 L12_apply_scf_384(sci, sci->scf + igr, scratch.grbuf[0]);
+                MINIMP3_GRANULE_HOOK(scratch.grbuf[0], 12, info->channels);
                 mp3d_synth_granule(dec->qmf_state, scratch.grbuf[0], 12, info->channels, pcm, scratch.syn[0]);
                 memset(scratch.grbuf[0], 0, 576*2*sizeof(float));
                 pcm += 384*info->channels;
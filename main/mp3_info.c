@@ -0,0 +1,352 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "mp3_info.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define MP3_INFO_SCAN_BYTES 2048 // junk tolerated before the first frame
+#define MP3_INFO_ID3V1_BYTES 128
+#define MP3_INFO_VBRI_OFFSET 36 // from the frame header, fixed by the format
+#define MP3_INFO_LAME_BYTES 19  // encoder string up to the radio gain
+#define MP3_INFO_TXXX_MAX 128   // longer TXXX frames are not ReplayGain
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+static const uint16_t s_bitrate_v1[15] = {0,   32,  40,  48,  56,  64,  80, 96,
+                                          112, 128, 160, 192, 224, 256, 320};
+static const uint16_t s_bitrate_v2[15] = {0,  8,  16, 24,  32,  40,  48, 56,
+                                          64, 80, 96, 112, 128, 144, 160};
+static const uint32_t s_hz_v1[3] = {44100, 48000, 32000};
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+static uint32_t be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t duration_from_frames(const mp3_frame_hdr_t *hdr,
+                                     uint32_t frames) {
+  return (uint32_t)((uint64_t)frames * hdr->samples * 1000 / hdr->hz);
+}
+
+/* ID3v2 "syncsafe" integer: 7 bits per byte */
+static uint32_t syncsafe32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 21) | ((uint32_t)p[1] << 14) |
+         ((uint32_t)p[2] << 7) | p[3];
+}
+
+/* Total size of the ID3v2 tag at the current position, 0 if none */
+static uint32_t id3v2_size(const uint8_t *p) {
+  if (memcmp(p, "ID3", 3) != 0 || ((p[6] | p[7] | p[8] | p[9]) & 0x80)) {
+    return 0;
+  }
+  return 10 + syncsafe32(p + 6) + ((p[5] & 0x10) ? 10 : 0); // footer flag
+}
+
+/* LAME extension after the Xing/Info fields: peak and radio ReplayGain */
+static void read_lame_tag(const uint8_t *p, size_t len, mp3_info_t *info) {
+  if (len < MP3_INFO_LAME_BYTES ||
+      (memcmp(p, "LAME", 4) != 0 && memcmp(p, "Lavc", 4) != 0)) {
+    return;
+  }
+  info->lame_peak = be32(p + 11);
+  // name (1 = radio), originator (0 = not set), sign, 0.1 dB steps
+  uint16_t radio = (p[15] << 8) | p[16];
+  if (((radio >> 13) & 7) == 1 && ((radio >> 10) & 7) != 0) {
+    int16_t gain = radio & 0x1FF;
+    info->lame_gain = true;
+    info->lame_gain_01db = (radio & 0x200) ? -gain : gain;
+  }
+}
+
+/* TXXX payload as "description\0value" in ASCII, for any text encoding */
+static size_t txxx_ascii(const uint8_t *p, size_t n, char *out,
+                         size_t out_len) {
+  bool utf16 = p[0] == 1 || p[0] == 2;
+  size_t step = utf16 ? 2 : 1;
+  size_t o = 0;
+  for (size_t i = 1; i + step <= n && o + 1 < out_len; i += step) {
+    char c = p[i];
+    if (utf16) {
+      if ((p[i] == 0xFF && p[i + 1] == 0xFE) ||
+          (p[i] == 0xFE && p[i + 1] == 0xFF)) {
+        continue; // byte order mark
+      }
+      c = p[i] ? p[i] : p[i + 1]; // either order, ASCII only
+    }
+    out[o++] = c;
+  }
+  out[o] = '\0';
+  return o;
+}
+
+/* REPLAYGAIN_TRACK_* from the TXXX frames of the ID3v2 tags */
+static bool id3_replaygain(FILE *f, float *gain_db, float *peak) {
+  uint8_t buf[MP3_INFO_TXXX_MAX];
+  char text[MP3_INFO_TXXX_MAX + 1];
+  bool found = false;
+  uint32_t start = 0;
+
+  for (;;) {
+    uint8_t h[10];
+    if (fseek(f, start, SEEK_SET) != 0 || fread(h, 1, 10, f) != 10) {
+      break;
+    }
+    uint32_t tag = id3v2_size(h);
+    if (tag == 0) {
+      break;
+    }
+    int version = h[3];
+    uint32_t pos = 10;
+    uint32_t end = tag - ((h[5] & 0x10) ? 10 : 0);
+    if (version < 3 || (h[5] & 0x80)) {
+      start += tag; // v2.2 frame layout or unsynchronised: not handled
+      continue;
+    }
+    if ((h[5] & 0x40) && fread(h, 1, 4, f) == 4) {
+      // Extended header; v2.3 does not count its own size field
+      pos += version == 4 ? syncsafe32(h) : be32(h) + 4;
+    }
+
+    while (pos + 10 <= end) {
+      uint8_t fh[10];
+      if (fseek(f, start + pos, SEEK_SET) != 0 || fread(fh, 1, 10, f) != 10 ||
+          fh[0] == 0) {
+        break; // padding
+      }
+      uint32_t size = version == 4 ? syncsafe32(fh + 4) : be32(fh + 4);
+      if (memcmp(fh, "TXXX", 4) == 0 && size > 1 &&
+          size <= MP3_INFO_TXXX_MAX && fread(buf, 1, size, f) == size) {
+        size_t n = txxx_ascii(buf, size, text, sizeof(text));
+        size_t desc_len = strlen(text);
+        const char *value = desc_len < n ? text + desc_len + 1 : "";
+        if (strcasecmp(text, "REPLAYGAIN_TRACK_GAIN") == 0) {
+          *gain_db = strtof(value, NULL); // "-6.54 dB"
+          found = true;
+        } else if (strcasecmp(text, "REPLAYGAIN_TRACK_PEAK") == 0) {
+          *peak = strtof(value, NULL);
+        }
+      }
+      pos += 10 + size;
+    }
+    start += tag;
+  }
+  return found;
+}
+
+/* Look for the Xing/Info or VBRI header inside the first frame */
+static void read_vbr_header(const uint8_t *frame, size_t len,
+                            mp3_info_t *info) {
+  const mp3_frame_hdr_t *hdr = &info->first;
+  size_t side = hdr->mpeg1 ? (hdr->channels == 2 ? 32 : 17)
+                           : (hdr->channels == 2 ? 17 : 9);
+  const uint8_t *x = frame + 4 + side;
+
+  if (4 + side + 12 <= len &&
+      (memcmp(x, "Xing", 4) == 0 || memcmp(x, "Info", 4) == 0)) {
+    uint32_t flags = be32(x + 4);
+    // Frames, bytes, TOC and quality fields are each optional
+    size_t lame = 4 + side + 8 + ((flags & 1) ? 4 : 0) + ((flags & 2) ? 4 : 0) +
+                  ((flags & 4) ? 100 : 0) + ((flags & 8) ? 4 : 0);
+    if (lame < len) {
+      read_lame_tag(frame + lame, len - lame, info);
+    }
+    if ((flags & 1) && be32(x + 8) > 0) {
+      info->total_frames = be32(x + 8);
+      info->src = MP3_INFO_SRC_XING;
+    }
+    if ((flags & 2) && (flags & 1) && 4 + side + 16 <= len &&
+        be32(x + 12) > 0 && be32(x + 12) <= info->audio_bytes) {
+      info->audio_bytes = be32(x + 12);
+    }
+    return;
+  }
+
+  const uint8_t *v = frame + MP3_INFO_VBRI_OFFSET;
+  if (MP3_INFO_VBRI_OFFSET + 18 <= len && memcmp(v, "VBRI", 4) == 0 &&
+      be32(v + 14) > 0) {
+    info->total_frames = be32(v + 14);
+    info->src = MP3_INFO_SRC_VBRI;
+  }
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+bool mp3_parse_frame_hdr(const uint8_t *p, mp3_frame_hdr_t *hdr) {
+  if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) {
+    return false;
+  }
+  int version = (p[1] >> 3) & 3; // 3 = MPEG-1, 2 = MPEG-2, 0 = MPEG-2.5
+  int layer = (p[1] >> 1) & 3;   // 1 = layer III
+  int br_idx = p[2] >> 4;
+  int hz_idx = (p[2] >> 2) & 3;
+  if (version == 1 || layer != 1 || br_idx == 15 || hz_idx == 3) {
+    return false;
+  }
+
+  hdr->mpeg1 = version == 3;
+  hdr->hz = s_hz_v1[hz_idx] >> (hdr->mpeg1 ? 0 : (version == 2 ? 1 : 2));
+  hdr->bitrate_kbps = hdr->mpeg1 ? s_bitrate_v1[br_idx] : s_bitrate_v2[br_idx];
+  hdr->samples = hdr->mpeg1 ? 1152 : 576;
+  hdr->channels = (p[3] >> 6) == 3 ? 1 : 2;
+  hdr->frame_bytes =
+      hdr->bitrate_kbps
+          ? (uint16_t)(hdr->samples / 8 * hdr->bitrate_kbps * 1000 / hdr->hz +
+                       ((p[2] >> 1) & 1))
+          : 0;
+  return true;
+}
+
+int mp3_main_data_begin(const uint8_t *p) {
+  mp3_frame_hdr_t hdr;
+  if (!mp3_parse_frame_hdr(p, &hdr)) {
+    return -1;
+  }
+  const uint8_t *side = p + 4 + ((p[1] & 1) ? 0 : 2); // CRC when bit is 0
+  if (hdr.mpeg1) {
+    return (side[0] << 1) | (side[1] >> 7); // 9 bits
+  }
+  return side[0]; // 8 bits
+}
+
+uint32_t mp3_skip_frames(FILE *f, uint8_t *buf, size_t buf_len, uint32_t off,
+                         int frames, uint32_t *last_off, uint64_t *samples) {
+  size_t n = 0;
+  size_t pos = 0;
+  bool eof = false;
+
+  while (frames > 0) {
+    // Keep a header and the one after the largest frame in the buffer
+    if (pos + 4 + 1441 + 4 > n && !eof) {
+      off += pos;
+      pos = 0;
+      if (fseek(f, off, SEEK_SET) != 0) {
+        break;
+      }
+      n = fread(buf, 1, buf_len, f);
+      eof = n < buf_len;
+    }
+    if (pos + 4 > n) {
+      break;
+    }
+
+    mp3_frame_hdr_t hdr;
+    if (!mp3_parse_frame_hdr(buf + pos, &hdr) || hdr.frame_bytes == 0) {
+      pos++;
+      continue;
+    }
+    size_t next = pos + hdr.frame_bytes;
+    mp3_frame_hdr_t hdr2;
+    if (next + 4 <= n &&
+        (!mp3_parse_frame_hdr(buf + next, &hdr2) || hdr2.hz != hdr.hz)) {
+      pos++; // false sync inside audio data
+      continue;
+    }
+
+    if (last_off) {
+      *last_off = off + pos;
+    }
+    if (samples) {
+      *samples += hdr.samples;
+    }
+    pos = next;
+    frames--;
+  }
+  return off + (pos < n ? pos : n);
+}
+
+bool mp3_info_read(FILE *f, mp3_info_t *info) {
+  uint8_t buf[MP3_INFO_SCAN_BYTES];
+  memset(info, 0, sizeof(*info));
+
+  if (fseek(f, 0, SEEK_END) != 0) {
+    return false;
+  }
+  long file_size = ftell(f);
+
+  // Skip (possibly several) ID3v2 tags
+  uint32_t start = 0;
+  for (;;) {
+    if (fseek(f, start, SEEK_SET) != 0 || fread(buf, 1, 10, f) != 10) {
+      fseek(f, 0, SEEK_SET);
+      return false;
+    }
+    uint32_t tag = id3v2_size(buf);
+    if (tag == 0) {
+      break;
+    }
+    start += tag;
+  }
+
+  fseek(f, start, SEEK_SET);
+  size_t n = fread(buf, 1, sizeof(buf), f);
+  for (size_t i = 0; i + 4 <= n; i++) {
+    mp3_frame_hdr_t hdr;
+    if (!mp3_parse_frame_hdr(buf + i, &hdr) || hdr.frame_bytes == 0) {
+      continue;
+    }
+    // A real frame is followed by another header of the same stream
+    uint8_t next[4];
+    size_t next_at = i + hdr.frame_bytes;
+    if (next_at + 4 <= n) {
+      memcpy(next, buf + next_at, 4);
+    } else if (fseek(f, start + next_at, SEEK_SET) != 0 ||
+               fread(next, 1, 4, f) != 4) {
+      continue;
+    }
+    mp3_frame_hdr_t hdr2;
+    if (!mp3_parse_frame_hdr(next, &hdr2) || hdr2.hz != hdr.hz) {
+      continue;
+    }
+
+    info->first = hdr;
+    info->data_offset = start + i;
+    info->audio_bytes = file_size - info->data_offset;
+    if (fseek(f, file_size - MP3_INFO_ID3V1_BYTES, SEEK_SET) == 0 &&
+        fread(next, 1, 3, f) == 3 && memcmp(next, "TAG", 3) == 0) {
+      info->audio_bytes -= MP3_INFO_ID3V1_BYTES;
+    }
+
+    read_vbr_header(buf + i, n - i, info);
+    if (info->src == MP3_INFO_SRC_NONE) {
+      info->src = MP3_INFO_SRC_CBR;
+      info->duration_ms = (uint32_t)((uint64_t)info->audio_bytes * 8 /
+                                     hdr.bitrate_kbps);
+    } else {
+      info->duration_ms = duration_from_frames(&hdr, info->total_frames);
+    }
+    fseek(f, info->data_offset, SEEK_SET);
+    return true;
+  }
+
+  fseek(f, 0, SEEK_SET);
+  return false;
+}
+
+mp3_gain_src_t mp3_replaygain_read(FILE *f, const mp3_info_t *info,
+                                   float *gain_db, float *peak) {
+  *peak = 0.0f;
+  mp3_gain_src_t src = MP3_GAIN_SRC_NONE;
+  if (id3_replaygain(f, gain_db, peak)) {
+    src = MP3_GAIN_SRC_ID3;
+  } else if (info->lame_gain) {
+    *gain_db = info->lame_gain_01db / 10.0f;
+    src = MP3_GAIN_SRC_LAME;
+  }
+  if (src != MP3_GAIN_SRC_NONE && *peak <= 0.0f && info->lame_peak) {
+    *peak = info->lame_peak / (float)(1 << 23);
+  }
+  return src;
+}
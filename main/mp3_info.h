@@ -0,0 +1,124 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __MP3_INFO_H__
+#define __MP3_INFO_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Track length from the first MPEG audio frame, without scanning the file.
+ *
+ * Encoders put the frame count in a Xing/Info (LAME) or VBRI header inside
+ * the first frame; without one the stream is taken as CBR and the length
+ * follows from the audio byte count and the first frame's bitrate. Plain C
+ * on stdio, so it builds on a host as well.
+ *
+ * ReplayGain comes from the same places taggers and encoders leave it: a
+ * TXXX frame in the ID3v2 tag, or the LAME extension of the Info header.
+ */
+
+typedef enum {
+  MP3_INFO_SRC_NONE = 0, /*!< no valid frame found */
+  MP3_INFO_SRC_XING,     /*!< Xing/Info frame count */
+  MP3_INFO_SRC_VBRI,     /*!< Fraunhofer VBRI frame count */
+  MP3_INFO_SRC_CBR,      /*!< audio bytes / first frame bitrate */
+} mp3_info_src_t;
+
+typedef enum {
+  MP3_GAIN_SRC_NONE = 0, /*!< not tagged */
+  MP3_GAIN_SRC_ID3,      /*!< REPLAYGAIN_TRACK_GAIN in an ID3v2 TXXX frame */
+  MP3_GAIN_SRC_LAME,     /*!< radio gain in the LAME tag */
+} mp3_gain_src_t;
+
+/**
+ * @brief MPEG layer III frame header fields
+ */
+typedef struct {
+  uint32_t hz;
+  uint16_t bitrate_kbps; /*!< 0 for free format */
+  uint16_t frame_bytes;  /*!< 0 for free format */
+  uint16_t samples;      /*!< per channel: 1152 (MPEG-1) or 576 */
+  uint8_t channels;
+  bool mpeg1;
+} mp3_frame_hdr_t;
+
+typedef struct {
+  mp3_info_src_t src;
+  mp3_frame_hdr_t first;  /*!< header of the first audio frame */
+  uint32_t data_offset;   /*!< file offset of the first audio frame */
+  uint32_t audio_bytes;   /*!< from data_offset, excluding an ID3v1 tag */
+  uint32_t total_frames;  /*!< 0 when src is MP3_INFO_SRC_CBR */
+  uint32_t duration_ms;
+  bool lame_gain;         /*!< the LAME tag carries a radio gain */
+  int16_t lame_gain_01db; /*!< that gain in 0.1 dB */
+  uint32_t lame_peak;     /*!< LAME peak amplitude, 1.0 = 1 << 23; 0 if none */
+} mp3_info_t;
+
+/**
+ * @brief Parse a 4-byte layer III frame header
+ *
+ * @return true if the bytes form a valid header
+ */
+bool mp3_parse_frame_hdr(const uint8_t *p, mp3_frame_hdr_t *hdr);
+
+/**
+ * @brief Bytes of earlier frames' main data this frame's audio starts in
+ *
+ * The layer III bit reservoir: decoding this frame needs at least that
+ * much main data from the frames before it.
+ *
+ * @return main_data_begin, or -1 if p is not a frame header
+ */
+int mp3_main_data_begin(const uint8_t *p);
+
+/**
+ * @brief Walk forward over frames by their headers alone
+ *
+ * Nothing is decoded: each header gives the offset of the next one. A
+ * header is only trusted if another one follows it, so this also resyncs
+ * from an arbitrary offset (the junk skipped is not counted as a frame).
+ *
+ * @param buf Scratch buffer for reading ahead, at least 2 KB
+ * @param off File offset to start at
+ * @param frames Number of frames to step over
+ * @param last_off Out: offset of the last frame stepped over (may be NULL)
+ * @param samples In/out: per-channel samples of the frames stepped over are
+ *                added (may be NULL)
+ * @return Offset of the frame after the last one stepped over; less than
+ *         frames were stepped over if the end of the file came first
+ */
+uint32_t mp3_skip_frames(FILE *f, uint8_t *buf, size_t buf_len, uint32_t off,
+                         int frames, uint32_t *last_off, uint64_t *samples);
+
+/**
+ * @brief Read the stream layout and duration
+ *
+ * Skips ID3v2 tags and any junk before the first frame (which must be
+ * followed by a second valid header). The file is left positioned at
+ * data_offset, or at 0 when nothing was found.
+ *
+ * @return true if a frame was found and info is filled in
+ */
+bool mp3_info_read(FILE *f, mp3_info_t *info);
+
+/**
+ * @brief Read the track ReplayGain from the tags
+ *
+ * ID3v2 REPLAYGAIN_TRACK_GAIN/_PEAK take precedence over the LAME tag.
+ * The file position is left undefined.
+ *
+ * @param info As filled in by mp3_info_read()
+ * @param gain_db Out: gain to apply
+ * @param peak Out: track peak, 1.0 = full scale; 0 if not tagged
+ * @return Where the gain came from; MP3_GAIN_SRC_NONE if untagged
+ */
+mp3_gain_src_t mp3_replaygain_read(FILE *f, const mp3_info_t *info,
+                                   float *gain_db, float *peak);
+
+#endif /* __MP3_INFO_H__ */
@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "mp3_prime.h"
+#include "mp3_info.h"
+#include <string.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define MP3_PRIME_RESERV_MAX ((int)sizeof(((mp3dec_t *)0)->reserv_buf))
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+int mp3_prime_frame(mp3dec_t *dec, const uint8_t *buf, int len,
+                    uint32_t until) {
+  mp3_frame_hdr_t hdr;
+  if (len < 4 || !mp3_parse_frame_hdr(buf, &hdr) || hdr.frame_bytes == 0 ||
+      hdr.frame_bytes > len) {
+    return 0;
+  }
+  // MPEG-2 frames are one granule: the last two before the target decode
+  uint32_t tail = hdr.frame_bytes;
+  if (!hdr.mpeg1) {
+    mp3_frame_hdr_t next;
+    if (len < hdr.frame_bytes + 4 ||
+        !mp3_parse_frame_hdr(buf + hdr.frame_bytes, &next)) {
+      return 0;
+    }
+    tail += next.frame_bytes;
+  }
+  if (tail >= until) {
+    return 0;
+  }
+  // Start over after mp3dec_init() as the decoder would; otherwise the
+  // stream must go on as it locked on to it
+  if (dec->header[0] != 0xFF) {
+    memset(dec, 0, sizeof(*dec));
+  } else if (((buf[1] ^ dec->header[1]) & 0xFE) ||
+             ((buf[2] ^ dec->header[2]) & 0x0C)) {
+    return 0;
+  }
+
+  int side = hdr.mpeg1 ? (hdr.channels == 1 ? 17 : 32)
+                       : (hdr.channels == 1 ? 9 : 17);
+  int skip = 4 + ((buf[1] & 1) ? 0 : 2) + side; // header, CRC, side info
+  int n = hdr.frame_bytes - skip;
+  if (n < 0) {
+    return 0;
+  }
+
+  // Keep the newest MP3_PRIME_RESERV_MAX bytes, as the decoder does
+  if (n >= MP3_PRIME_RESERV_MAX) {
+    memcpy(dec->reserv_buf, buf + hdr.frame_bytes - MP3_PRIME_RESERV_MAX,
+           MP3_PRIME_RESERV_MAX);
+    dec->reserv = MP3_PRIME_RESERV_MAX;
+  } else {
+    int keep = dec->reserv + n > MP3_PRIME_RESERV_MAX
+                   ? MP3_PRIME_RESERV_MAX - n
+                   : dec->reserv;
+    memmove(dec->reserv_buf, dec->reserv_buf + dec->reserv - keep, keep);
+    memcpy(dec->reserv_buf + keep, buf + skip, n);
+    dec->reserv = keep + n;
+  }
+  memcpy(dec->header, buf, 4);
+  return hdr.frame_bytes;
+}
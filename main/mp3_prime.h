@@ -0,0 +1,40 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __MP3_PRIME_H__
+#define __MP3_PRIME_H__
+
+#include "minimp3.h"
+#include <stdint.h>
+
+/*
+ * Decoder state after a seek, without decoding the frames before it.
+ *
+ * A layer III frame's audio can start in the main data of earlier frames
+ * (the bit reservoir), so decoding from a seek point needs those bytes
+ * first. They are copied into the decoder's reservoir here. Only the last
+ * two granules before the target (one MPEG-1 frame, two MPEG-2 ones) are
+ * decoded, for the filter bank history the target's first samples add to.
+ * From there the output is the same as when decoding from the start of the
+ * file.
+ */
+
+/**
+ * @brief Add a frame's main data to the decoder's bit reservoir
+ *
+ * Nothing is decoded. The frames in the last two granules before the seek
+ * target are left to mp3dec_decode_frame() (output dropped), as is
+ * anything that is not a whole frame of the stream being primed.
+ *
+ * @param buf Input starting at a frame header
+ * @param len Bytes in buf
+ * @param until Bytes from buf to the seek target
+ * @return Bytes taken from buf, 0 if the frame has to be decoded instead
+ */
+int mp3_prime_frame(mp3dec_t *dec, const uint8_t *buf, int len,
+                    uint32_t until);
+
+#endif /* __MP3_PRIME_H__ */
@@ -5,13 +5,21 @@
  */
 
 #include "oled_display.h"
+#include "audio_levels.h"
+#include "audio_player.h"
 #include "common.h"
 #include "driver/gpio.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "gpio_config.h"
+#include "player_status.h"
 #include "sd_card.h"
 #include "ssd1306.h"
+#include "ssd1306_emu.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -22,12 +30,31 @@
 #define I2C_MASTER_FREQ_HZ 400000
 
 #define OLED_TAG "OLED"
+#define OLED_LINE_CHARS 16 // 128 px / 8 px glyphs
+#define OLED_TITLE_PAGE 1
+#define OLED_TITLE_MAX_LEN 64
+#define OLED_TITLE_PAGE_MS 2500 // long titles move on this often
+#define OLED_TITLE_STEP 12      // chars per move, 4 kept for context
+#define OLED_WIDTH 128
+#define OLED_PROGRESS_PAGE 2
+#define OLED_PROGRESS_SEG 8    // after the play/pause icon
+#define OLED_PROGRESS_WIDTH 80 // px, ten character cells
+#define OLED_METER_PAGE 3
+#define OLED_METER_RANGE_DB 48.0f // bottom of the scale, dBFS
+#define OLED_VU_WIDTH 30          // L on the upper rows, R on the lower
+#define OLED_SPECTRUM_SEG 32      // spectrum starts at this column
+#define OLED_SPECTRUM_BAR 6       // px per band, last column left blank
 
 /*********************************
  * STATIC VARIABLES
  ********************************/
 static bool s_oled_initialized = false;
 static SSD1306_t s_oled_dev;
+static uint32_t s_line1_seq;
+static int s_line1_total = -1; // -1 forces a redraw of line 1 and the title
+static char s_title[OLED_TITLE_MAX_LEN];
+static int s_title_offset; // first character shown
+static int64_t s_title_paged_us;
 
 /*********************************
  * HELPER FUNCTIONS
@@ -36,8 +63,8 @@ static SSD1306_t s_oled_dev;
 /**
  * @brief Get bluetooth connection state string
  */
-static const char *get_bt_state_str(void) {
-  switch (s_a2d_state) {
+static const char *get_bt_state_str(const player_status_t *status) {
+  switch (status->a2d_state) {
   case APP_AV_STATE_IDLE:
     return "IDLE";
   case APP_AV_STATE_DISCOVERING:
@@ -47,7 +74,7 @@ static const char *get_bt_state_str(void) {
   case APP_AV_STATE_CONNECTING:
     return "CONN";
   case APP_AV_STATE_CONNECTED:
-    if (s_media_state == APP_AV_MEDIA_STATE_STARTED) {
+    if (status->media_state == APP_AV_MEDIA_STATE_STARTED) {
       return "BT";
     }
     return "BT";
@@ -81,6 +108,161 @@ static void get_filename(const char *path, char *filename, size_t max_len) {
   filename[name_len] = '\0';
 }
 
+/**
+ * @brief Render text into a run of cells, blank-padded so a shorter string
+ * clears what the previous one left behind
+ */
+static void draw_text(int page, int seg, const char *text, int cells) {
+  char padded[OLED_LINE_CHARS];
+  size_t len = strlen(text);
+  if (len > (size_t)cells) {
+    len = cells;
+  }
+  memcpy(padded, text, len);
+  memset(padded + len, ' ', cells - len);
+  ssd1306_fb_text(&s_oled_dev, page, seg, padded, cells, false);
+}
+
+/**
+ * @brief Render one full-width text line into the framebuffer
+ */
+static void draw_line(int page, const char *text) {
+  draw_text(page, 0, text, OLED_LINE_CHARS);
+}
+
+/**
+ * @brief Draw the track progress as a pixel bar, thick up to the position
+ */
+static void draw_progress(uint32_t position_ms, uint32_t duration_ms) {
+  uint8_t cols[OLED_PROGRESS_WIDTH];
+  int filled = 0;
+  if (duration_ms) {
+    uint32_t pos = position_ms < duration_ms ? position_ms : duration_ms;
+    filled = (int)((uint64_t)pos * OLED_PROGRESS_WIDTH / duration_ms);
+  }
+  for (int x = 0; x < OLED_PROGRESS_WIDTH; x++) {
+    cols[x] = x < filled ? 0x3C : 0x18;
+  }
+  ssd1306_fb_image(&s_oled_dev, OLED_PROGRESS_PAGE, OLED_PROGRESS_SEG, cols,
+                   OLED_PROGRESS_WIDTH);
+}
+
+/**
+ * @brief Show the track title on its own page
+ *
+ * Titles wider than the display are paged: every OLED_TITLE_PAGE_MS of
+ * playback the window moves on by OLED_TITLE_STEP characters, up to the
+ * end of the title and then back to its start. A move is one span on the
+ * bus. The controller's scroll would be cheaper between moves, but it can
+ * only rotate the 128 columns it holds and has to be stopped for every
+ * write to the other pages, which the meter makes five times a second.
+ */
+static void draw_title(const char *title, bool playing) {
+  int64_t now = esp_timer_get_time();
+  int len = strlen(title);
+
+  if (strcmp(title, s_title) != 0) {
+    strcpy(s_title, title);
+    s_title_offset = 0;
+    s_title_paged_us = now;
+  } else if (len > OLED_LINE_CHARS && playing &&
+             now - s_title_paged_us >= OLED_TITLE_PAGE_MS * 1000LL) {
+    int last = len - OLED_LINE_CHARS;
+    if (s_title_offset >= last) {
+      s_title_offset = 0;
+    } else if (s_title_offset + OLED_TITLE_STEP < last) {
+      s_title_offset += OLED_TITLE_STEP;
+    } else {
+      s_title_offset = last;
+    }
+    s_title_paged_us = now;
+  }
+  draw_line(OLED_TITLE_PAGE, title + s_title_offset);
+}
+
+/**
+ * @brief Map an energy (1.0 = full scale) onto 0..max pixels
+ */
+static int meter_px(float energy, int max) {
+  if (energy <= 0) {
+    return 0;
+  }
+  float db = 10.0f * log10f(energy);
+  int px = (int)((db + OLED_METER_RANGE_DB) * max / OLED_METER_RANGE_DB);
+  if (px < 0) {
+    return 0;
+  }
+  return px > max ? max : px;
+}
+
+/**
+ * @brief Draw the L/R level bars and the spectrum on the bottom page
+ *
+ * Each column byte is built directly (bit 0 is the top row), so the page
+ * costs one framebuffer compare and only moving bars reach the bus.
+ * The meter is blanked while paused, when the display stops refreshing.
+ */
+static void draw_meter(bool playing) {
+  audio_levels_t levels = {0};
+  if (playing) {
+    audio_levels_read(&levels);
+  }
+
+  uint8_t cols[OLED_WIDTH] = {0};
+  int vu_l = meter_px(levels.vu[0], OLED_VU_WIDTH);
+  int vu_r = meter_px(levels.vu[1], OLED_VU_WIDTH);
+  for (int x = 0; x < OLED_VU_WIDTH; x++) {
+    cols[x] = (x < vu_l ? 0x07 : 0) | (x < vu_r ? 0x70 : 0);
+  }
+
+  for (int b = 0; b < AUDIO_LEVELS_BANDS; b++) {
+    int h = meter_px(levels.band[b], 8);
+    uint8_t bar = (uint8_t)(0xFF << (8 - h));
+    int x0 = OLED_SPECTRUM_SEG + b * OLED_SPECTRUM_BAR;
+    for (int x = x0; x < x0 + OLED_SPECTRUM_BAR - 1; x++) {
+      cols[x] = bar;
+    }
+  }
+
+  ssd1306_fb_image(&s_oled_dev, OLED_METER_PAGE, 0, cols, OLED_WIDTH);
+}
+
+#if CONFIG_EXAMPLE_OLED_EMULATOR
+/**
+ * @brief Print the emulated panel and what the update cost on the bus
+ */
+static void dump_emulator(void) {
+  static int64_t s_last_us;
+  ssd1306_emu_t *emu = ssd1306_emu_get();
+
+  // Run the panel's own clock (hardware scroll) up to now
+  int64_t now = esp_timer_get_time();
+  if (s_last_us) {
+    ssd1306_emu_advance(emu, (now - s_last_us) * SSD1306_EMU_FRAME_HZ / 1000000);
+  }
+  s_last_us = now;
+
+  if (emu->stats.transactions == 0) {
+    return;
+  }
+  ESP_LOGI(OLED_TAG,
+           "emu: %" PRIu32 " transactions, %" PRIu32 " bytes (%" PRIu32
+           " data), bus %" PRIu64 " us @400k / %" PRIu64 " us @1M",
+           emu->stats.transactions, emu->stats.bytes, emu->stats.data_bytes,
+           ssd1306_emu_bus_us(emu, 400000), ssd1306_emu_bus_us(emu, 1000000));
+  if (emu->stats.unknown_cmds) {
+    ESP_LOGW(OLED_TAG, "emu: %" PRIu32 " unknown commands",
+             emu->stats.unknown_cmds);
+  }
+  if (emu->stats.scroll_writes) {
+    ESP_LOGW(OLED_TAG, "emu: %" PRIu32 " GDDRAM bytes written while scrolling",
+             emu->stats.scroll_writes);
+  }
+  ssd1306_emu_write_pbm(emu, stdout);
+  ssd1306_emu_reset_stats(emu);
+}
+#endif
+
 /*********************************
  * PUBLIC FUNCTIONS
  ********************************/
@@ -109,6 +291,9 @@ void oled_display_clear(void) {
     return;
   }
   ssd1306_clear_screen(&s_oled_dev, false);
+  s_line1_total = -1;
+  s_title[0] = '\0';
+  s_title_offset = 0;
 }
 
 void oled_display_update(void) {
@@ -119,26 +304,26 @@ void oled_display_update(void) {
   char line1[32] = {0};
   char line2[32] = {0};
 
+  player_status_t status;
+  uint32_t seq = player_status_read(&status);
+
   /******************************************
-   * LINE 1: [BT] Track/Total  Song Name
+   * LINE 1: [BT] Track/Total, title below it
    ******************************************/
-  const char *bt_status = get_bt_state_str();
+  const char *bt_status = get_bt_state_str(&status);
   int total_songs = sd_card_get_playlist_count();
-
-  // Get current song info (keep small to avoid truncation warnings)
-  char song_name[10] = "NoSong";
-  extern int s_current_song_idx; // From audio_player.c
+  char title[OLED_TITLE_MAX_LEN] = "";
 
   if (total_songs > 0) {
-    const char *file_path = sd_card_get_file_path(s_current_song_idx);
+    const char *file_path = sd_card_get_file_path(status.song_idx);
     if (file_path) {
-      get_filename(file_path, song_name, sizeof(song_name));
+      get_filename(file_path, title, sizeof(title));
     }
 // Disable truncation warning - we've sized buffers appropriately
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-truncation"
-    snprintf(line1, sizeof(line1), "[%s]%d/%d %s", bt_status,
-             s_current_song_idx + 1, total_songs, song_name);
+    snprintf(line1, sizeof(line1), "[%s]%d/%d", bt_status,
+             status.song_idx + 1, total_songs);
 #pragma GCC diagnostic pop
   } else {
     snprintf(line1, sizeof(line1), "[%s] No Files", bt_status);
@@ -147,35 +332,35 @@ void oled_display_update(void) {
   /******************************************
    * LINE 2: Progress bar + Volume
    ******************************************/
-  // Create a simple progress bar (12 chars) + volume
-  char progress_bar[13] = "          "; // 10 spaces + null terminator
-  int bar_len = 10;
-
-  // Calculate progress based on playing state
-  static int progress_pos = 0;
-  if (s_is_playing) {
-    progress_pos = (progress_pos + 1) % (bar_len + 1);
-  }
-
-  // Fill progress bar
-  for (int i = 0; i < bar_len; i++) {
-    if (i < progress_pos) {
-      progress_bar[i] = '=';
-    } else if (i == progress_pos) {
-      progress_bar[i] = '>';
-    } else {
-      progress_bar[i] = '-';
-    }
-  }
-
-  // Add play/pause indicator and volume
-  char play_icon = s_is_playing ? '>' : '|';
-  snprintf(line2, sizeof(line2), "%c%s V:%d", play_icon, progress_bar,
-           (s_current_volume * 100) / 127); // Convert to 0-100
+  // Play/pause icon, the bar in the next 10 cells, then the volume
+  char play_icon[2] = {status.is_playing ? '>' : '|', '\0'};
+  snprintf(line2, sizeof(line2), "V:%d",
+           (status.volume * 100) / 127); // Convert to 0-100
 
   /******************************************
    * Update display
    ******************************************/
-  ssd1306_display_text(&s_oled_dev, 0, line1, strlen(line1), false);
-  ssd1306_display_text(&s_oled_dev, 2, line2, strlen(line2), false);
+  uint32_t tx_count = s_oled_dev._txCount;
+  uint32_t tx_bytes = s_oled_dev._txBytes;
+
+  // Line 1 only depends on the published status and playlist size
+  if (total_songs != s_line1_total || player_status_changed_since(s_line1_seq)) {
+    draw_line(0, line1);
+    s_line1_seq = seq;
+    s_line1_total = total_songs;
+  }
+  draw_title(title, status.is_playing);
+  ssd1306_fb_text(&s_oled_dev, OLED_PROGRESS_PAGE, 0, play_icon, 1, false);
+  draw_progress(audio_player_get_position_ms(), audio_player_get_duration_ms());
+  draw_text(OLED_PROGRESS_PAGE, OLED_PROGRESS_SEG + OLED_PROGRESS_WIDTH, line2,
+            (OLED_WIDTH - OLED_PROGRESS_SEG - OLED_PROGRESS_WIDTH) / 8);
+  draw_meter(status.is_playing);
+
+  // Only the columns that changed go out on the bus
+  ssd1306_flush(&s_oled_dev);
+  ESP_LOGD(OLED_TAG, "update: %" PRIu32 " transactions, %" PRIu32 " bytes",
+           s_oled_dev._txCount - tx_count, s_oled_dev._txBytes - tx_bytes);
+#if CONFIG_EXAMPLE_OLED_EMULATOR
+  dump_emulator();
+#endif
 }
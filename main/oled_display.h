@@ -23,6 +23,7 @@ void oled_display_init(void);
  * Updates display showing:
  * - Line 1: Bluetooth status, track number, song name
  * - Line 2: Progress bar and volume level
+ * - Bottom page: L/R level bars and a 16-band spectrum
  */
 void oled_display_update(void);
 
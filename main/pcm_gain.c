@@ -0,0 +1,35 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "pcm_gain.h"
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+float pcm_gain_for(audio_volume_mode_t mode, float track_gain, uint8_t volume) {
+  // The track's loudness gain rides on the same multiply; at unity with the
+  // sink owning the volume the PCM passes bit-exact
+  float gain = track_gain;
+  if (mode == AUDIO_VOLUME_SOFTWARE) {
+    gain *= (float)volume / 127.0f;
+  }
+  return gain;
+}
+
+void pcm_gain_apply(int16_t *pcm, int32_t count, float gain) {
+  if (gain == 1.0f) {
+    return;
+  }
+  for (int32_t i = 0; i < count; i++) {
+    // Scale the sample and clamp to prevent overflow
+    int32_t scaled = (int32_t)(pcm[i] * gain);
+    if (scaled > 32767)
+      scaled = 32767;
+    if (scaled < -32768)
+      scaled = -32768;
+    pcm[i] = (int16_t)scaled;
+  }
+}
@@ -0,0 +1,36 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __PCM_GAIN_H__
+#define __PCM_GAIN_H__
+
+#include "audio_player.h"
+#include <stdint.h>
+
+/**
+ * @brief Gain the data callback applies to the PCM
+ *
+ * The track's loudness gain, times the volume when the source owns it.
+ * With AUDIO_VOLUME_ABSOLUTE and a unity track gain this is exactly 1.0.
+ *
+ * @param mode Volume owner
+ * @param track_gain Loudness gain of the playing track, 1.0 for none
+ * @param volume 0-127
+ */
+float pcm_gain_for(audio_volume_mode_t mode, float track_gain, uint8_t volume);
+
+/**
+ * @brief Scale 16-bit PCM in place, clamping to full scale
+ *
+ * A gain of exactly 1.0 leaves the samples untouched and costs nothing.
+ *
+ * @param pcm Samples, all channels
+ * @param count Number of samples
+ * @param gain Linear gain
+ */
+void pcm_gain_apply(int16_t *pcm, int32_t count, float gain);
+
+#endif /* __PCM_GAIN_H__ */
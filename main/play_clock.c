@@ -0,0 +1,59 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "play_clock.h"
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void play_clock_track_begin(play_clock_t *c, uint32_t hz, int channels,
+                            uint32_t duration_ms, uint64_t base, float gain) {
+  c->next.valid = true;
+  c->next.start = c->sent;
+  c->next.hz = hz;
+  c->next.frame_bytes = channels * 2;
+  c->next.duration_ms = duration_ms;
+  c->next.base = base;
+  c->next.gain = gain;
+}
+
+void play_clock_set_duration(play_clock_t *c, uint32_t duration_ms) {
+  track_clock_t *clk = c->next.valid ? &c->next : &c->cur;
+  clk->duration_ms = duration_ms;
+}
+
+void play_clock_queued(play_clock_t *c, uint32_t bytes) { c->sent += bytes; }
+
+bool play_clock_consumed(play_clock_t *c, uint32_t bytes) {
+  c->consumed += bytes;
+  if (!c->next.valid || c->consumed < c->next.start) {
+    return false;
+  }
+  c->cur = c->next;
+  c->next.valid = false;
+  return true;
+}
+
+bool play_clock_decoding_sample(const play_clock_t *c, uint64_t *sample) {
+  if (!c->cur.valid || c->next.valid || c->consumed < c->cur.start) {
+    return false;
+  }
+  *sample = c->cur.base + (c->consumed - c->cur.start) / c->cur.frame_bytes;
+  return true;
+}
+
+uint32_t play_clock_position_ms(const play_clock_t *c) {
+  if (!c->cur.valid || c->consumed < c->cur.start) {
+    return 0;
+  }
+  uint64_t frames =
+      c->cur.base + (c->consumed - c->cur.start) / c->cur.frame_bytes;
+  return (uint32_t)(frames * 1000 / c->cur.hz);
+}
+
+uint32_t play_clock_duration_ms(const play_clock_t *c) {
+  return c->cur.valid ? c->cur.duration_ms : 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __PLAY_CLOCK_H__
+#define __PLAY_CLOCK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Playback clock: PCM bytes handed to the ring and taken by the data
+ * callback, with the stream offset where each track's PCM begins. The ring
+ * can hold the tail of one track and the head of the next, so the next
+ * start is kept pending until the callback reaches it. No locking:
+ * audio_player.c calls it under its buffer lock.
+ */
+
+/**
+ * @brief One track's place in the PCM stream
+ */
+typedef struct {
+  bool valid;
+  uint64_t start;       /*!< bytes queued when its first PCM was queued */
+  uint32_t hz;
+  uint32_t frame_bytes; /*!< bytes per PCM frame (all channels) */
+  uint32_t duration_ms;
+  uint64_t base;        /*!< track sample at start (non-zero after a seek) */
+  float gain;           /*!< loudness normalisation */
+} track_clock_t;
+
+typedef struct {
+  uint64_t sent;     /*!< PCM bytes queued */
+  uint64_t consumed; /*!< PCM bytes taken by the data callback */
+  track_clock_t cur; /*!< track being heard */
+  track_clock_t next; /*!< track queued behind it, if valid */
+} play_clock_t;
+
+/**
+ * @brief Start the clock of the track whose first PCM is about to be queued
+ */
+void play_clock_track_begin(play_clock_t *c, uint32_t hz, int channels,
+                            uint32_t duration_ms, uint64_t base, float gain);
+
+/**
+ * @brief Refine the duration of the track being decoded
+ */
+void play_clock_set_duration(play_clock_t *c, uint32_t duration_ms);
+
+/**
+ * @brief Account PCM bytes queued to the ring
+ */
+void play_clock_queued(play_clock_t *c, uint32_t bytes);
+
+/**
+ * @brief Account PCM bytes taken by the data callback
+ *
+ * @return true if the callback reached the next track, now c->cur
+ */
+bool play_clock_consumed(play_clock_t *c, uint32_t bytes);
+
+/**
+ * @brief Sample the callback has reached, if it is in the track being
+ * decoded (no other track queued behind it)
+ */
+bool play_clock_decoding_sample(const play_clock_t *c, uint64_t *sample);
+
+/**
+ * @brief Position of the track being heard, 0 before its first PCM
+ */
+uint32_t play_clock_position_ms(const play_clock_t *c);
+
+/**
+ * @brief Duration of the track being heard, 0 if none
+ */
+uint32_t play_clock_duration_ms(const play_clock_t *c);
+
+#endif /* __PLAY_CLOCK_H__ */
@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "player_status.h"
+#include "freertos/FreeRTOS.h"
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+static status_snapshot_t s_status = STATUS_SNAPSHOT_INIT;
+static TaskHandle_t s_listener = NULL;
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+/* Writers are tasks that may share a core with a reader, so sleep a tick */
+static void writer_wait(void) { vTaskDelay(1); }
+
+static void publish(const player_status_t *status) {
+  if (status_snapshot_commit(&s_status, status, writer_wait)) {
+    TaskHandle_t listener = s_listener;
+    if (listener) {
+      xTaskNotifyGive(listener);
+    }
+  }
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+uint32_t player_status_read(player_status_t *status) {
+  return status_snapshot_read(&s_status, status);
+}
+
+bool player_status_changed_since(uint32_t seq) {
+  return status_snapshot_changed_since(&s_status, seq);
+}
+
+void player_status_subscribe(TaskHandle_t task) { s_listener = task; }
+
+void player_status_set_bt_state(int a2d_state, int media_state) {
+  player_status_t status;
+  status_snapshot_begin(&s_status, &status, writer_wait);
+  status.a2d_state = a2d_state;
+  status.media_state = media_state;
+  publish(&status);
+}
+
+void player_status_set_track(int song_idx) {
+  player_status_t status;
+  status_snapshot_begin(&s_status, &status, writer_wait);
+  status.song_idx = song_idx;
+  publish(&status);
+}
+
+void player_status_set_playing(bool is_playing) {
+  player_status_t status;
+  status_snapshot_begin(&s_status, &status, writer_wait);
+  status.is_playing = is_playing;
+  publish(&status);
+}
+
+void player_status_set_volume(uint8_t volume) {
+  player_status_t status;
+  status_snapshot_begin(&s_status, &status, writer_wait);
+  status.volume = volume;
+  publish(&status);
+}
@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __PLAYER_STATUS_H__
+#define __PLAYER_STATUS_H__
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "status_snapshot.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The player status is published by the tasks that own each field (BT app
+ * task, decode task, button task) through status_snapshot. This wraps it
+ * for FreeRTOS: writers wait with a one-tick sleep and the subscribed task
+ * is notified on every change.
+ */
+
+/**
+ * @brief Read a consistent snapshot of the player status
+ *
+ * Wait-free: neither loops nor blocks, whatever the writers are doing.
+ *
+ * @param status Output snapshot
+ * @return Sequence number of the snapshot, for player_status_changed_since()
+ */
+uint32_t player_status_read(player_status_t *status);
+
+/**
+ * @brief Check whether anything was published after a given snapshot
+ *
+ * @param seq Sequence number returned by player_status_read()
+ * @return true if the status changed since that snapshot
+ */
+bool player_status_changed_since(uint32_t seq);
+
+/**
+ * @brief Wake a task whenever a published field changes
+ *
+ * The task is signalled with xTaskNotifyGive(), so it can block in
+ * ulTaskNotifyTake() instead of polling.
+ *
+ * @param task Task to notify, or NULL to stop notifying
+ */
+void player_status_subscribe(TaskHandle_t task);
+
+/**
+ * @brief Publish Bluetooth connection and media state
+ */
+void player_status_set_bt_state(int a2d_state, int media_state);
+
+/**
+ * @brief Publish the current playlist index
+ */
+void player_status_set_track(int song_idx);
+
+/**
+ * @brief Publish play/pause state
+ */
+void player_status_set_playing(bool is_playing);
+
+/**
+ * @brief Publish the current volume (0-127)
+ */
+void player_status_set_volume(uint8_t volume);
+
+#endif /* __PLAYER_STATUS_H__ */
@@ -0,0 +1,180 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "resume.h"
+#include "common.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include <inttypes.h>
+#include <string.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define RESUME_NVS_NAMESPACE "resume"
+#define RESUME_NVS_KEY "point"
+#define RESUME_SIDE_MAX 38 // header, CRC and side info: not main data
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+static portMUX_TYPE s_resume_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_loaded = false;
+static TaskHandle_t s_waiter = NULL;
+static resume_point_t s_saved;
+static bool s_have_saved = false;
+static int64_t s_last_write_us = 0;
+static uint32_t s_writes = 0;
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+/* The i-th most recent mark, from 1 */
+static const resume_mark_t *mark_back(const resume_marks_t *marks,
+                                      uint32_t i) {
+  return &marks->mark[(marks->cnt - i) % RESUME_MARKS];
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void resume_init(void) {
+  nvs_handle_t handle;
+  if (nvs_open(RESUME_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+    size_t len = sizeof(s_saved);
+    s_have_saved =
+        nvs_get_blob(handle, RESUME_NVS_KEY, &s_saved, &len) == ESP_OK &&
+        len == sizeof(s_saved);
+    nvs_close(handle);
+  }
+
+  portENTER_CRITICAL(&s_resume_lock);
+  s_loaded = true;
+  TaskHandle_t waiter = s_waiter;
+  portEXIT_CRITICAL(&s_resume_lock);
+  if (waiter) {
+    xTaskNotifyGive(waiter);
+  }
+}
+
+bool resume_load(resume_point_t *point) {
+  portENTER_CRITICAL(&s_resume_lock);
+  bool loaded = s_loaded;
+  if (!loaded) {
+    s_waiter = xTaskGetCurrentTaskHandle();
+  }
+  portEXIT_CRITICAL(&s_resume_lock);
+
+  if (!loaded && !ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RESUME_WAIT_MS))) {
+    ESP_LOGW(BT_AV_TAG, "resume: NVS not ready, starting from the top");
+    return false;
+  }
+  if (s_have_saved) {
+    *point = s_saved;
+  }
+  return s_have_saved;
+}
+
+bool resume_save(const resume_point_t *point, bool urgent) {
+  if (!s_loaded) {
+    return false;
+  }
+  if (s_have_saved && memcmp(point, &s_saved, sizeof(*point)) == 0) {
+    return false;
+  }
+  // A new track is worth saving soon, a moved position can wait
+  urgent = urgent || !s_have_saved || point->path_hash != s_saved.path_hash;
+  int64_t now = esp_timer_get_time();
+  int64_t min_gap_ms = urgent ? RESUME_MIN_INTERVAL_MS : RESUME_SAVE_PERIOD_MS;
+  if (s_last_write_us && now - s_last_write_us < min_gap_ms * 1000) {
+    return false;
+  }
+
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(RESUME_NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err == ESP_OK) {
+    // One blob keeps it to a single NVS entry per save
+    err = nvs_set_blob(handle, RESUME_NVS_KEY, point, sizeof(*point));
+    if (err == ESP_OK) {
+      err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+  }
+  s_last_write_us = now;
+  if (err != ESP_OK) {
+    ESP_LOGW(BT_AV_TAG, "resume: save failed (%s)", esp_err_to_name(err));
+    return false;
+  }
+
+  s_saved = *point;
+  s_have_saved = true;
+  s_writes++;
+  ESP_LOGD(BT_AV_TAG, "resume: saved offset %" PRIu32 " (%" PRIu32 " writes)",
+           point->offset, s_writes);
+  return true;
+}
+
+void resume_mark(resume_marks_t *marks, uint32_t off, uint32_t sample,
+                 int reservoir) {
+  resume_mark_t *m = &marks->mark[marks->cnt++ % RESUME_MARKS];
+  m->off = off;
+  m->sample = sample;
+  // Junk before the header: assume the worst the format allows
+  m->reservoir = reservoir < 0 ? 511 : reservoir;
+}
+
+bool resume_point_pick(const resume_marks_t *marks, uint32_t path_hash,
+                       uint64_t sample, resume_point_t *point) {
+  uint32_t n = marks->cnt < RESUME_MARKS ? marks->cnt : RESUME_MARKS;
+  uint32_t at = 0;
+  for (uint32_t i = 1; i <= n; i++) {
+    if (mark_back(marks, i)->sample <= sample) {
+      at = i;
+      break;
+    }
+  }
+  if (at == 0) {
+    return false;
+  }
+
+  const resume_mark_t *m = mark_back(marks, at);
+  *point = (resume_point_t){
+      .path_hash = path_hash,
+      .offset = m->off,
+      .prime_offset = m->off,
+      .sample = m->sample,
+  };
+  // The frames in the last RESUME_SETTLE_SAMPLES are decoded, earlier ones
+  // supply the reservoir of the first of them, each with all but its header
+  // and side info
+  uint32_t first = at;
+  while (first < n &&
+         m->sample - mark_back(marks, first)->sample < RESUME_SETTLE_SAMPLES) {
+    first++;
+  }
+  const resume_mark_t *dec = mark_back(marks, first);
+  point->prime_offset = dec->off;
+  for (uint32_t i = first + 1, k = 1; i <= n && dec->reservoir; i++, k++) {
+    const resume_mark_t *p = mark_back(marks, i);
+    point->prime_offset = p->off;
+    if (dec->off - p->off >= dec->reservoir + k * RESUME_SIDE_MAX) {
+      break;
+    }
+  }
+  return true;
+}
+
+uint32_t resume_path_hash(const char *path) {
+  uint32_t h = 2166136261u;
+  while (*path) {
+    h ^= (uint8_t)*path++;
+    h *= 16777619u;
+  }
+  return h;
+}
@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __RESUME_H__
+#define __RESUME_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Where playback stopped, kept in NVS across power cycles.
+ *
+ * The track is identified by a hash of its path, so adding or removing
+ * files does not shift it to another song. The position is a frame start
+ * in the file plus the earlier offset to prime the decoder from (see
+ * mp3_prime.h), so the layer III bit reservoir is filled when that frame
+ * is reached.
+ */
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define RESUME_SAVE_PERIOD_MS (60 * 1000) // while playing
+#define RESUME_MIN_INTERVAL_MS (5 * 1000) // between any two writes
+#define RESUME_WAIT_MS 2000               // for resume_init() at boot
+#define RESUME_MARKS 32 // recent frames, covers the ring plus the reservoir
+#define RESUME_SETTLE_SAMPLES 1152 // decoded before the point: two granules
+
+typedef struct {
+  uint32_t path_hash;
+  uint32_t offset;       /*!< file offset of the frame to resume at */
+  uint32_t prime_offset; /*!< offset to start decoding (output discarded) */
+  uint32_t sample;       /*!< per-channel sample position of that frame */
+} resume_point_t;
+
+typedef struct {
+  uint32_t off;
+  uint32_t sample;
+  uint16_t reservoir; /*!< main_data_begin */
+} resume_mark_t;
+
+/**
+ * @brief Where the last RESUME_MARKS decoded frames start
+ */
+typedef struct {
+  resume_mark_t mark[RESUME_MARKS];
+  uint32_t cnt; /*!< frames marked; 0 to start over */
+} resume_marks_t;
+
+/**
+ * @brief Load the saved point from NVS
+ *
+ * Call once after nvs_flash_init(); releases a task blocked in
+ * resume_load().
+ */
+void resume_init(void);
+
+/**
+ * @brief Get the point saved before the last power cycle
+ *
+ * Blocks up to RESUME_WAIT_MS while NVS is still being brought up.
+ *
+ * @return true if a point was saved
+ */
+bool resume_load(resume_point_t *point);
+
+/**
+ * @brief Store a new point, subject to the write throttle
+ *
+ * Identical points are never rewritten. Otherwise a write is done when
+ * RESUME_SAVE_PERIOD_MS has passed, or RESUME_MIN_INTERVAL_MS if urgent
+ * (pause; a different track always counts as urgent).
+ *
+ * @return true if the point was written
+ */
+bool resume_save(const resume_point_t *point, bool urgent);
+
+/**
+ * @brief Note where a decoded frame starts
+ *
+ * No locking: one decode task owns the marks.
+ *
+ * @param reservoir main_data_begin of the frame, -1 if unknown
+ */
+void resume_mark(resume_marks_t *marks, uint32_t off, uint32_t sample,
+                 int reservoir);
+
+/**
+ * @brief Turn a playback position into a resume point
+ *
+ * Picks the last marked frame starting at or before sample. Priming starts
+ * RESUME_SETTLE_SAMPLES before it, or further back if the bit reservoir of
+ * the frame there reaches into earlier ones.
+ *
+ * @return false if no marked frame starts at or before sample
+ */
+bool resume_point_pick(const resume_marks_t *marks, uint32_t path_hash,
+                       uint64_t sample, resume_point_t *point);
+
+/**
+ * @brief FNV-1a hash of a file path
+ */
+uint32_t resume_path_hash(const char *path);
+
+#endif /* __RESUME_H__ */
@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "scrub.h"
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define SCRUB_CYCLE_FRAMES (SCRUB_SNIPPET_FRAMES + SCRUB_GAP_FRAMES)
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+int scrub_speed(int64_t held_ms) {
+  if (held_ms < SCRUB_STEP_MS) {
+    return 4;
+  }
+  return held_ms < 2 * SCRUB_STEP_MS ? 8 : 16;
+}
+
+void scrub_jump(FILE *f, uint8_t *buf, size_t buf_len, const mp3_info_t *info,
+                int dir, int speed, uint32_t off, uint64_t sample,
+                scrub_jump_t *jump) {
+  jump->prime_off = off;
+  jump->sample = sample;
+  if (dir > 0) {
+    // The snippet just heard counts towards the distance
+    jump->play_off = mp3_skip_frames(
+        f, buf, buf_len, off, speed * SCRUB_CYCLE_FRAMES - SCRUB_SNIPPET_FRAMES,
+        &jump->prime_off, &jump->sample);
+    return;
+  }
+  // Back over the snippet too, and the frame the decoder restarts at
+  uint64_t back =
+      (uint64_t)(speed * SCRUB_CYCLE_FRAMES + SCRUB_SNIPPET_FRAMES + 1) *
+      info->first.samples;
+  jump->sample = sample > back ? sample - back : 0;
+  uint32_t aim = info->data_offset;
+  if (sample) {
+    aim += (uint64_t)(off - info->data_offset) * jump->sample / sample;
+  }
+  jump->play_off = mp3_skip_frames(f, buf, buf_len, aim, 1, &jump->prime_off,
+                                   &jump->sample);
+}
+
+void scrub_fade(int16_t *pcm, int samples, int channels, bool in) {
+  int n = samples < SCRUB_FADE_SAMPLES ? samples : SCRUB_FADE_SAMPLES;
+  int16_t *p = in ? pcm : pcm + (samples - n) * channels;
+  for (int i = 0; i < n; i++) {
+    int g = in ? i : n - 1 - i;
+    for (int ch = 0; ch < channels; ch++, p++) {
+      *p = (int16_t)(*p * g / n);
+    }
+  }
+}
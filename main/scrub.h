@@ -0,0 +1,67 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __SCRUB_H__
+#define __SCRUB_H__
+
+#include "mp3_info.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Fast-forward / rewind while a button is held.
+ *
+ * Each cycle plays a short decoded snippet, then a gap of silence, then
+ * jumps by walking frame headers. The silence needs no decoding, so a
+ * cycle costs less CPU than playing the same stretch normally.
+ */
+
+#define SCRUB_SNIPPET_FRAMES 3 // ~80 ms heard between jumps
+#define SCRUB_GAP_FRAMES 3     // silence after each snippet
+#define SCRUB_STEP_MS 3000     // hold time before the next speed
+#define SCRUB_FADE_SAMPLES 256 // per snippet edge, against clicks
+
+/**
+ * @brief Where the next snippet starts
+ */
+typedef struct {
+  uint32_t prime_off; /*!< Frame to restart the decoder at */
+  uint32_t play_off;  /*!< First frame of the snippet */
+  uint64_t sample;    /*!< Track sample at play_off */
+} scrub_jump_t;
+
+/**
+ * @brief Scrub speed for how long the button has been held
+ *
+ * @return 4, then 8, then 16 (times normal play)
+ */
+int scrub_speed(int64_t held_ms);
+
+/**
+ * @brief Plan the jump after a snippet
+ *
+ * Forwards, frame headers are walked so that one cycle (snippet and gap)
+ * covers speed times its own length. There is no way to walk headers
+ * backwards: rewind aims by the bytes per sample seen so far (holds for
+ * VBR too), then resyncs forwards.
+ *
+ * @param buf Scratch buffer for mp3_skip_frames()
+ * @param info The track
+ * @param dir 1 forwards, -1 backwards
+ * @param off Offset of the frame after the snippet
+ * @param sample Track sample at off
+ */
+void scrub_jump(FILE *f, uint8_t *buf, size_t buf_len, const mp3_info_t *info,
+                int dir, int speed, uint32_t off, uint64_t sample,
+                scrub_jump_t *jump);
+
+/**
+ * @brief Linear ramp over the first (fade in) or last samples of a frame
+ */
+void scrub_fade(int16_t *pcm, int samples, int channels, bool in);
+
+#endif /* __SCRUB_H__ */
@@ -1,9 +1,14 @@
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "ssd1306.h"
+#include "ssd1306_emu.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
 #include <string.h>
 
 #define TAG "SSD1306"
@@ -17,6 +22,10 @@
 #define SPI_DEFAULT_FREQUENCY 1000000 // 1MHz
 int clock_speed_hz = SPI_DEFAULT_FREQUENCY;
 
+// Full-frame DMA source and its transaction; must outlive the queued transfer
+static WORD_ALIGNED_ATTR DMA_ATTR uint8_t s_frame_buf[8 * 128];
+static spi_transaction_t s_frame_trans;
+
 void spi_clock_speed(int speed) {
   ESP_LOGI(TAG, "SPI clock speed=%d MHz", speed / 1000000);
   clock_speed_hz = speed;
@@ -127,8 +136,16 @@ bool spi_master_write_byte(const spi_device_handle_t SPIHandle,
 
 bool spi_master_write_commands(SSD1306_t *dev, const uint8_t *Commands,
                                size_t DataLength) {
+  spi_flush_wait(dev); // D/C must not change under a queued frame
   gpio_set_level(dev->_dc, SPI_COMMAND_MODE);
+  dev->_txCount++;
+  dev->_txBytes += DataLength;
+#if CONFIG_EXAMPLE_OLED_EMULATOR
+  ssd1306_emu_spi_write(ssd1306_emu_get(), false, Commands, DataLength);
+  return true;
+#else
   return spi_master_write_byte(dev->_spi_device_handle, Commands, DataLength);
+#endif
 }
 
 bool spi_master_write_command(SSD1306_t *dev, uint8_t Command) {
@@ -139,8 +156,16 @@ bool spi_master_write_command(SSD1306_t *dev, uint8_t Command) {
 
 bool spi_master_write_data(SSD1306_t *dev, const uint8_t *Data,
                            size_t DataLength) {
+  spi_flush_wait(dev);
   gpio_set_level(dev->_dc, SPI_DATA_MODE);
+  dev->_txCount++;
+  dev->_txBytes += DataLength;
+#if CONFIG_EXAMPLE_OLED_EMULATOR
+  ssd1306_emu_spi_write(ssd1306_emu_get(), true, Data, DataLength);
+  return true;
+#else
   return spi_master_write_byte(dev->_spi_device_handle, Data, DataLength);
+#endif
 }
 
 void spi_init(SSD1306_t *dev, int width, int height) {
@@ -149,6 +174,7 @@ void spi_init(SSD1306_t *dev, int width, int height) {
   dev->_pages = 8;
   if (dev->_height == 32)
     dev->_pages = 4;
+  dev->_contrast = 0xFF;
 
   spi_master_write_command(dev, OLED_CMD_DISPLAY_OFF);   // AE
   spi_master_write_command(dev, OLED_CMD_SET_MUX_RATIO); // A8
@@ -179,12 +205,14 @@ void spi_init(SSD1306_t *dev, int width, int height) {
   spi_master_write_command(dev, OLED_CMD_SET_VCOMH_DESELCT); // DB
   spi_master_write_command(dev, 0x40);
   spi_master_write_command(dev, OLED_CMD_SET_MEMORY_ADDR_MODE); // 20
-  // spi_master_write_command(dev, OLED_CMD_SET_HORI_ADDR_MODE);	// 00
-  spi_master_write_command(dev, OLED_CMD_SET_PAGE_ADDR_MODE); // 02
-  // Set Lower Column Start Address for Page Addressing Mode
+  spi_master_write_command(dev, OLED_CMD_SET_HORI_ADDR_MODE);   // 00
+  // Full-panel window; writes set their own window before the data
+  spi_master_write_command(dev, OLED_CMD_SET_COLUMN_RANGE); // 21
+  spi_master_write_command(dev, 0x00);
+  spi_master_write_command(dev, dev->_width - 1);
+  spi_master_write_command(dev, OLED_CMD_SET_PAGE_RANGE); // 22
   spi_master_write_command(dev, 0x00);
-  // Set Higher Column Start Address for Page Addressing Mode
-  spi_master_write_command(dev, 0x10);
+  spi_master_write_command(dev, dev->_pages - 1);
   spi_master_write_command(dev, OLED_CMD_SET_CHARGE_PUMP); // 8D
   spi_master_write_command(dev, 0x14);
   spi_master_write_command(dev, OLED_CMD_DEACTIVE_SCROLL); // 2E
@@ -200,23 +228,78 @@ void spi_display_image(SSD1306_t *dev, int page, int seg, const uint8_t *images,
     return;
 
   int _seg = seg + CONFIG_OFFSETX;
-  uint8_t columLow = _seg & 0x0F;
-  uint8_t columHigh = (_seg >> 4) & 0x0F;
 
   int _page = page;
   if (dev->_flip) {
     _page = (dev->_pages - page) - 1;
   }
 
-  // Set Lower Column Start Address for Page Addressing Mode, Higher Column
-  // Start Address for Page Addressing Mode and Page Start Address for Page
-  // Addressing Mode
-  uint8_t commands[3] = {0x00 + columLow, 0x10 + columHigh, 0xB0 | _page};
-  spi_master_write_commands(dev, commands, 3);
+  if (seg + width > dev->_width)
+    width = dev->_width - seg;
+
+  // Set the horizontal addressing mode column and page window
+  uint8_t commands[6] = {OLED_CMD_SET_COLUMN_RANGE, _seg, _seg + width - 1,
+                         OLED_CMD_SET_PAGE_RANGE,   _page, _page};
+  spi_master_write_commands(dev, commands, 6);
 
   spi_master_write_data(dev, images, width);
 }
 
+// Queue the whole internal buffer as one DMA transaction and return without
+// waiting. The next command/data write (or spi_flush_wait) collects it.
+void spi_display_frame(SSD1306_t *dev) {
+  spi_flush_wait(dev);
+
+  uint8_t commands[6] = {OLED_CMD_SET_COLUMN_RANGE,
+                         CONFIG_OFFSETX,
+                         CONFIG_OFFSETX + dev->_width - 1,
+                         OLED_CMD_SET_PAGE_RANGE,
+                         0,
+                         dev->_pages - 1};
+  spi_master_write_commands(dev, commands, 6);
+
+  int frame_len = 0;
+  for (int page = 0; page < dev->_pages; page++) {
+    int _page = dev->_flip ? (dev->_pages - page) - 1 : page;
+    memcpy(&s_frame_buf[frame_len], dev->_page[_page]._segs, dev->_width);
+    frame_len += dev->_width;
+  }
+
+  dev->_flushStart = esp_timer_get_time();
+  dev->_flushBytes = frame_len;
+#if CONFIG_EXAMPLE_OLED_EMULATOR
+  dev->_txCount++;
+  dev->_txBytes += frame_len;
+  ssd1306_emu_spi_write(ssd1306_emu_get(), true, s_frame_buf, frame_len);
+  return;
+#endif
+  gpio_set_level(dev->_dc, SPI_DATA_MODE);
+  memset(&s_frame_trans, 0, sizeof(spi_transaction_t));
+  s_frame_trans.length = frame_len * 8;
+  s_frame_trans.tx_buffer = s_frame_buf;
+  if (spi_device_queue_trans(dev->_spi_device_handle, &s_frame_trans,
+                             portMAX_DELAY) == ESP_OK) {
+    dev->_txCount++;
+    dev->_txBytes += frame_len;
+    dev->_flushPending = true;
+  }
+}
+
+void spi_flush_wait(SSD1306_t *dev) {
+  if (!dev->_flushPending)
+    return;
+
+  spi_transaction_t *trans;
+  spi_device_get_trans_result(dev->_spi_device_handle, &trans, portMAX_DELAY);
+  dev->_flushPending = false;
+
+  dev->_flushUs = esp_timer_get_time() - dev->_flushStart;
+  int64_t bus_us = (int64_t)dev->_flushBytes * 8 * 1000000 / clock_speed_hz;
+  ESP_LOGD(TAG, "frame flush: %" PRIu32 " bytes in %" PRId64 " us, bus %d%%",
+           dev->_flushBytes, dev->_flushUs,
+           dev->_flushUs ? (int)(bus_us * 100 / dev->_flushUs) : 0);
+}
+
 void spi_contrast(SSD1306_t *dev, int contrast) {
   int _contrast = contrast;
   if (contrast < 0x0)
@@ -25,6 +25,7 @@ void ssd1306_init(SSD1306_t * dev, int width, int height)
 	// Initialize internal buffer
 	for (int i=0;i<dev->_pages;i++) {
 		memset(dev->_page[i]._segs, 0, 128);
+		dev->_page[i]._spanCount = 0;
 	}
 }
 
@@ -43,16 +44,25 @@ int ssd1306_get_pages(SSD1306_t * dev)
 	return dev->_pages;
 }
 
+// Send the whole internal buffer as a single transaction.
+// On SPI the transfer is queued to DMA and this returns immediately.
 void ssd1306_show_buffer(SSD1306_t * dev)
 {
 	if (dev->_address == SPI_ADDRESS) {
-		for (int page=0; page<dev->_pages;page++) {
-			spi_display_image(dev, page, 0, dev->_page[page]._segs, dev->_width);
-		}
+		spi_display_frame(dev);
 	} else {
-		for (int page=0; page<dev->_pages;page++) {
-			i2c_display_image(dev, page, 0, dev->_page[page]._segs, dev->_width);
-		}
+		i2c_display_frame(dev);
+	}
+	for (int page=0; page<dev->_pages;page++) {
+		dev->_page[page]._spanCount = 0;
+	}
+}
+
+// Block until a queued full-frame transfer has completed
+void ssd1306_flush_wait(SSD1306_t * dev)
+{
+	if (dev->_address == SPI_ADDRESS) {
+		spi_flush_wait(dev);
 	}
 }
 
@@ -112,6 +122,121 @@ void ssd1306_display_text(SSD1306_t * dev, int page, const char * text, int text
 	}
 }
 
+// Record [start, end] of a page as dirty, merging spans that overlap or
+// are closer than SSD1306_SPAN_MERGE_GAP so they go out in one transaction.
+static void _ssd1306_mark_dirty(SSD1306_t * dev, int page, int start, int end)
+{
+	PAGE_t * p = &dev->_page[page];
+	int i = 0;
+	while (i < p->_spanCount) {
+		SPAN_t * span = &p->_spans[i];
+		if (start <= span->_end + SSD1306_SPAN_MERGE_GAP && span->_start <= end + SSD1306_SPAN_MERGE_GAP) {
+			if (span->_start < start) start = span->_start;
+			if (span->_end > end) end = span->_end;
+			p->_spans[i] = p->_spans[--p->_spanCount];
+			i = 0; // the widened span may now reach one already checked
+			continue;
+		}
+		i++;
+	}
+
+	if (p->_spanCount == SSD1306_MAX_SPANS) {
+		// Out of slots: fold the new range into the nearest span
+		int nearest = 0;
+		int nearest_gap = dev->_width;
+		for (i = 0; i < p->_spanCount; i++) {
+			SPAN_t * span = &p->_spans[i];
+			int gap = (span->_start > end) ? span->_start - end : start - span->_end;
+			if (gap < nearest_gap) {
+				nearest_gap = gap;
+				nearest = i;
+			}
+		}
+		if (p->_spans[nearest]._start < start) start = p->_spans[nearest]._start;
+		if (p->_spans[nearest]._end > end) end = p->_spans[nearest]._end;
+		p->_spans[nearest] = p->_spans[--p->_spanCount];
+		_ssd1306_mark_dirty(dev, page, start, end);
+		return;
+	}
+
+	p->_spans[p->_spanCount]._start = start;
+	p->_spans[p->_spanCount]._end = end;
+	p->_spanCount++;
+}
+
+// Write to internal buffer only. Changed columns are sent by ssd1306_flush.
+void ssd1306_fb_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width)
+{
+	if (page >= dev->_pages) return;
+	if (seg >= dev->_width) return;
+	if (seg + width > dev->_width) width = dev->_width - seg;
+
+	uint8_t * segs = &dev->_page[page]._segs[seg];
+	int i = 0;
+	while (i < width) {
+		if (segs[i] == images[i]) {
+			i++;
+			continue;
+		}
+		int start = i;
+		while (i < width && segs[i] != images[i]) {
+			segs[i] = images[i];
+			i++;
+		}
+		_ssd1306_mark_dirty(dev, page, seg + start, seg + i - 1);
+	}
+}
+
+// Render text to internal buffer only. Not show it.
+void ssd1306_fb_text(SSD1306_t * dev, int page, int seg, const char * text, int text_len, bool invert)
+{
+	if (page >= dev->_pages) return;
+	int _text_len = text_len;
+	if (_text_len > (dev->_width - seg) / 8) _text_len = (dev->_width - seg) / 8;
+
+	uint8_t image[8];
+	for (int i = 0; i < _text_len; i++) {
+		memcpy(image, font8x8_basic_tr[(uint8_t)text[i]], 8);
+		if (invert) ssd1306_invert(image, 8);
+		if (dev->_flip) ssd1306_flip(image, 8);
+		ssd1306_fb_image(dev, page, seg, image, 8);
+		seg = seg + 8;
+	}
+}
+
+// Send the dirty spans of the internal buffer, one transaction per span,
+// or the whole frame at once when that is cheaper on the bus.
+void ssd1306_flush(SSD1306_t * dev)
+{
+	int span_bytes = 0;
+	for (int page=0; page<dev->_pages; page++) {
+		PAGE_t * p = &dev->_page[page];
+		for (int i=0; i<p->_spanCount; i++) {
+			span_bytes += p->_spans[i]._end - p->_spans[i]._start + 1 + SSD1306_SPAN_MERGE_GAP;
+		}
+	}
+	if (span_bytes == 0) return;
+
+	if (span_bytes >= dev->_pages * dev->_width + SSD1306_SPAN_MERGE_GAP) {
+		ssd1306_show_buffer(dev);
+		return;
+	}
+
+	for (int page=0; page<dev->_pages; page++) {
+		PAGE_t * p = &dev->_page[page];
+		for (int i=0; i<p->_spanCount; i++) {
+			int seg = p->_spans[i]._start;
+			int width = p->_spans[i]._end - seg + 1;
+			if (dev->_address == SPI_ADDRESS) {
+				spi_display_image(dev, page, seg, &p->_segs[seg], width);
+			} else {
+				i2c_display_image(dev, page, seg, &p->_segs[seg], width);
+			}
+		}
+		p->_spanCount = 0;
+	}
+}
+
 void ssd1306_display_text_box1(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay)
 {
 	if (page >= dev->_pages) return;
@@ -255,11 +380,11 @@ ssd1306_display_text_x3(SSD1306_t * dev, int page, const char * text, int text_l
 
 void ssd1306_clear_screen(SSD1306_t * dev, bool invert)
 {
-	char space[16];
-	memset(space, 0x00, sizeof(space));
+	uint8_t fill = invert ? 0xFF : 0x00;
 	for (int page = 0; page < dev->_pages; page++) {
-		ssd1306_display_text(dev, page, space, sizeof(space), invert);
+		memset(dev->_page[page]._segs, fill, sizeof(dev->_page[page]._segs));
 	}
+	ssd1306_show_buffer(dev);
 }
 
 void ssd1306_clear_line(SSD1306_t * dev, int page, bool invert)
@@ -269,7 +394,7 @@ void ssd1306_clear_line(SSD1306_t * dev, int page, bool invert)
 	ssd1306_display_text(dev, page, space, sizeof(space), invert);
 }
 
-void ssd1306_contrast(SSD1306_t * dev, int contrast)
+static void _ssd1306_set_contrast(SSD1306_t * dev, int contrast)
 {
 	if (dev->_address == SPI_ADDRESS) {
 		spi_contrast(dev, contrast);
@@ -278,6 +403,14 @@ void ssd1306_contrast(SSD1306_t * dev, int contrast)
 	}
 }
 
+void ssd1306_contrast(SSD1306_t * dev, int contrast)
+{
+	if (contrast < 0) contrast = 0;
+	if (contrast > 0xFF) contrast = 0xFF;
+	dev->_contrast = contrast;
+	_ssd1306_set_contrast(dev, contrast);
+}
+
 void ssd1306_software_scroll(SSD1306_t * dev, int start, int end)
 {
 	ESP_LOGD(__FUNCTION__, "software_scroll start=%d end=%d _pages=%d", start, end, dev->_pages);
@@ -300,29 +433,24 @@ void ssd1306_scroll_text(SSD1306_t * dev, const char * text, int text_len, bool
 	ESP_LOGD(__FUNCTION__, "dev->_scEnable=%d", dev->_scEnable);
 	if (dev->_scEnable == false) return;
 
-	void (*func)(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
-	if (dev->_address == SPI_ADDRESS) {
-		func = spi_display_image;
-	} else {
-		func = i2c_display_image;
-	}
-
+	// Shift the pages in the internal buffer, render the new line there too,
+	// then send everything in one flush instead of a write per page and glyph
 	int srcIndex = dev->_scEnd - dev->_scDirection;
 	while(1) {
 		int dstIndex = srcIndex + dev->_scDirection;
 		ESP_LOGD(__FUNCTION__, "srcIndex=%d dstIndex=%d", srcIndex,dstIndex);
-		for(int seg = 0; seg < dev->_width; seg++) {
-			dev->_page[dstIndex]._segs[seg] = dev->_page[srcIndex]._segs[seg];
-		}
-		(*func)(dev, dstIndex, 0, dev->_page[dstIndex]._segs, sizeof(dev->_page[dstIndex]._segs));
+		ssd1306_fb_image(dev, dstIndex, 0, dev->_page[srcIndex]._segs, dev->_width);
 		if (srcIndex == dev->_scStart) break;
 		srcIndex = srcIndex - dev->_scDirection;
 	}
-	
+
+	char line[16];
 	int _text_len = text_len;
 	if (_text_len > 16) _text_len = 16;
-	
-	ssd1306_display_text(dev, srcIndex, text, text_len, invert);
+	memcpy(line, text, _text_len);
+	memset(line + _text_len, ' ', 16 - _text_len);
+	ssd1306_fb_text(dev, srcIndex, 0, line, 16, invert);
+	ssd1306_flush(dev);
 }
 
 void ssd1306_scroll_clear(SSD1306_t * dev)
@@ -794,30 +922,22 @@ uint8_t ssd1306_rotate_byte(uint8_t ch1) {
 }
 
 
+// Fade by ramping the contrast down (one 2-byte command per step), then
+// blank the panel with a single frame write and restore the contrast.
 void ssd1306_fadeout(SSD1306_t * dev)
 {
-	void (*func)(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
-	if (dev->_address == SPI_ADDRESS) {
-		func = spi_display_image;
-	} else {
-		func = i2c_display_image;
+	int contrast = dev->_contrast;
+	for (int step=SSD1306_FADE_STEPS-1; step>=0; step--) {
+		_ssd1306_set_contrast(dev, contrast * step / SSD1306_FADE_STEPS);
+		vTaskDelay(pdMS_TO_TICKS(SSD1306_FADE_STEP_MS));
 	}
 
-	uint8_t image[1];
-	for(int page=0; page<dev->_pages; page++) {
-		image[0] = 0xFF;
-		for(int line=0; line<8; line++) {
-			if (dev->_flip) {
-				image[0] = image[0] >> 1;
-			} else {
-				image[0] = image[0] << 1;
-			}
-			for(int seg=0; seg<128; seg++) {
-				(*func)(dev, page, seg, image, 1);
-				dev->_page[page]._segs[seg] = image[0];
-			}
-		}
+	for (int page=0; page<dev->_pages; page++) {
+		memset(dev->_page[page]._segs, 0, dev->_width);
 	}
+	ssd1306_show_buffer(dev);
+	ssd1306_flush_wait(dev);
+	_ssd1306_set_contrast(dev, contrast);
 }
 
 // Rotate character image
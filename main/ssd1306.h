@@ -73,6 +73,16 @@ Usage:
 #define OLED_CMD_ACTIVE_SCROLL          0x2F
 #define OLED_CMD_VERTICAL               0xA3
 
+// Horizontal scroll step interval, in frames (3rd parameter of 26h/27h)
+#define OLED_SCROLL_INTERVAL_2          0x07
+#define OLED_SCROLL_INTERVAL_3          0x04
+#define OLED_SCROLL_INTERVAL_4          0x05
+#define OLED_SCROLL_INTERVAL_5          0x00
+#define OLED_SCROLL_INTERVAL_25         0x06
+#define OLED_SCROLL_INTERVAL_64         0x01
+#define OLED_SCROLL_INTERVAL_128        0x02
+#define OLED_SCROLL_INTERVAL_256        0x03
+
 #define I2C_ADDRESS 0x3C
 #define SPI_ADDRESS 0xFF
 
@@ -92,10 +102,27 @@ typedef enum {
 	SCROLL_STOP = 7
 } ssd1306_scroll_type_t;
 
+// Dirty column tracking for the RAM framebuffer (ssd1306_fb_* / ssd1306_flush)
+#define SSD1306_MAX_SPANS 4
+// Bytes a separate span costs on the bus (I2C address + addressing prefix).
+// Spans closer than this are cheaper to send as one transaction.
+#define SSD1306_SPAN_MERGE_GAP 14
+
+// Contrast ramp of ssd1306_fadeout(): ~0.5 s, 2 bytes per step
+#define SSD1306_FADE_STEPS 16
+#define SSD1306_FADE_STEP_MS 30
+
+typedef struct {
+	uint8_t _start; // first dirty segment
+	uint8_t _end;   // last dirty segment (inclusive)
+} SPAN_t;
+
 typedef struct {
 	bool _valid; // Not using it anymore
 	int _segLen; // Not using it anymore
 	uint8_t _segs[128];
+	int _spanCount;
+	SPAN_t _spans[SSD1306_MAX_SPANS];
 } PAGE_t;
 
 typedef struct {
@@ -110,6 +137,13 @@ typedef struct {
 	int _scDirection;
 	PAGE_t _page[8];
 	bool _flip;
+	int _contrast; // last contrast set, restored after a fade
+	uint32_t _txCount; // bus transactions issued
+	uint32_t _txBytes; // bytes sent on the bus
+	bool _flushPending; // full-frame SPI DMA still in flight
+	int64_t _flushStart; // esp_timer_get_time() when the last frame flush began
+	int64_t _flushUs; // duration of the last full-frame flush
+	uint32_t _flushBytes; // bytes of the last full-frame flush
 	i2c_port_t _i2c_num;
 	spi_device_handle_t _spi_device_handle;
 #if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0))
@@ -128,12 +162,16 @@ int ssd1306_get_width(SSD1306_t * dev);
 int ssd1306_get_height(SSD1306_t * dev);
 int ssd1306_get_pages(SSD1306_t * dev);
 void ssd1306_show_buffer(SSD1306_t * dev);
+void ssd1306_flush_wait(SSD1306_t * dev);
 void ssd1306_set_buffer(SSD1306_t * dev, const uint8_t * buffer);
 void ssd1306_get_buffer(SSD1306_t * dev, uint8_t * buffer);
 void ssd1306_set_page(SSD1306_t * dev, int page, const uint8_t * buffer);
 void ssd1306_get_page(SSD1306_t * dev, int page, uint8_t * buffer);
 void ssd1306_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
 void ssd1306_display_text(SSD1306_t * dev, int page, const char * text, int text_len, bool invert);
+void ssd1306_fb_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
+void ssd1306_fb_text(SSD1306_t * dev, int page, int seg, const char * text, int text_len, bool invert);
+void ssd1306_flush(SSD1306_t * dev);
 void ssd1306_display_text_box1(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay);
 void ssd1306_display_text_box2(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay);
 void ssd1306_display_text_x3(SSD1306_t * dev, int page, const char * text, int text_len, bool invert);
@@ -166,6 +204,7 @@ void i2c_master_init(SSD1306_t * dev, int16_t sda, int16_t scl, int16_t reset);
 void i2c_device_add(SSD1306_t * dev, i2c_port_t i2c_num, int16_t reset, uint16_t i2c_address);
 void i2c_init(SSD1306_t * dev, int width, int height);
 void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
+void i2c_display_frame(SSD1306_t * dev);
 void i2c_contrast(SSD1306_t * dev, int contrast);
 void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll);
 
@@ -178,6 +217,8 @@ bool spi_master_write_command(SSD1306_t * dev, uint8_t Command );
 bool spi_master_write_data(SSD1306_t * dev, const uint8_t* Data, size_t DataLength );
 void spi_init(SSD1306_t * dev, int width, int height);
 void spi_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
+void spi_display_frame(SSD1306_t * dev);
+void spi_flush_wait(SSD1306_t * dev);
 void spi_contrast(SSD1306_t * dev, int contrast);
 void spi_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll);
 
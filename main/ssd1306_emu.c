@@ -0,0 +1,356 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "ssd1306_emu.h"
+#include <string.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define I2C_CLOCKS_PER_BYTE 9 // 8 data bits + ACK
+#define I2C_CLOCKS_PER_XFER 2 // START + STOP, roughly one clock each
+#define SPI_CLOCKS_PER_BYTE 8
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+static ssd1306_emu_t s_emu;
+static bool s_emu_ready = false;
+
+/* Frames per horizontal scroll step for the 3-bit interval code */
+static const uint16_t s_scroll_frames[8] = {5, 64, 128, 256, 3, 4, 25, 2};
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+/* Total length (opcode + arguments) of a command */
+static uint8_t cmd_length(uint8_t op) {
+  switch (op) {
+  case 0x81: // contrast
+  case 0x20: // memory addressing mode
+  case 0xA8: // multiplex ratio
+  case 0xD3: // display offset
+  case 0xD5: // clock divide
+  case 0xD9: // pre-charge
+  case 0xDA: // COM pins
+  case 0xDB: // VCOMH
+  case 0x8D: // charge pump
+    return 2;
+  case 0x21: // column range
+  case 0x22: // page range
+  case 0xA3: // vertical scroll area
+    return 3;
+  case 0x29: // vertical + horizontal scroll
+  case 0x2A:
+    return 6;
+  case 0x26: // horizontal scroll
+  case 0x27:
+    return 7;
+  default:
+    return 1;
+  }
+}
+
+static void rotate_columns(ssd1306_emu_t *emu, bool right, int steps) {
+  int first = emu->scroll_col_start;
+  int last = emu->scroll_col_end;
+  if (last >= SSD1306_EMU_WIDTH) {
+    last = SSD1306_EMU_WIDTH - 1;
+  }
+  int width = last - first + 1;
+  if (width <= 1) {
+    return;
+  }
+  int k = steps % width;
+  if (k == 0) {
+    return;
+  }
+  if (!right) {
+    k = width - k;
+  }
+
+  uint8_t tmp[SSD1306_EMU_WIDTH];
+  for (int page = emu->scroll_start; page <= emu->scroll_end; page++) {
+    uint8_t *row = &emu->gddram[page & 7][first];
+    for (int i = 0; i < width; i++) {
+      tmp[(i + k) % width] = row[i];
+    }
+    memcpy(row, tmp, width);
+  }
+}
+
+static void scroll_steps(ssd1306_emu_t *emu, uint32_t steps) {
+  bool display_right = (emu->scroll_cmd == 0x26 || emu->scroll_cmd == 0x29);
+  // Columns run right to left on the glass without segment remap
+  bool ram_right = emu->seg_remap ? display_right : !display_right;
+  rotate_columns(emu, ram_right, steps % SSD1306_EMU_WIDTH);
+
+  if (emu->scroll_cmd == 0x29 || emu->scroll_cmd == 0x2A) {
+    // Vertical part approximated as a start-line shift of the whole panel
+    emu->start_line = (emu->start_line + emu->scroll_voffset * steps) & 0x3F;
+  }
+}
+
+static void execute(ssd1306_emu_t *emu, const uint8_t *c) {
+  uint8_t op = c[0];
+  switch (op) {
+  case 0x81:
+    emu->contrast = c[1];
+    break;
+  case 0x20:
+    if ((c[1] & 0x03) != 0x03) {
+      emu->addr_mode = c[1] & 0x03;
+    }
+    break;
+  case 0x21:
+    emu->col_start = c[1] & 0x7F;
+    emu->col_end = c[2] & 0x7F;
+    emu->col = emu->col_start;
+    break;
+  case 0x22:
+    emu->page_start = c[1] & 0x07;
+    emu->page_end = c[2] & 0x07;
+    emu->page = emu->page_start;
+    break;
+  case 0xA8:
+    if ((c[1] & 0x3F) >= 15) {
+      emu->mux = c[1] & 0x3F;
+    }
+    break;
+  case 0xD3:
+    emu->offset = c[1] & 0x3F;
+    break;
+  case 0xD5:
+  case 0xD9:
+  case 0xDA:
+  case 0xDB:
+  case 0x8D:
+  case 0xA3:
+    break; // analog/timing settings, nothing visible to model
+  case 0x26:
+  case 0x27:
+    emu->scroll_cmd = op;
+    emu->scroll_start = c[2] & 0x07;
+    emu->scroll_frames = s_scroll_frames[c[3] & 0x07];
+    emu->scroll_end = c[4] & 0x07;
+    emu->scroll_voffset = 0;
+    emu->scroll_col_start = c[5] & 0x7F;
+    emu->scroll_col_end = c[6] & 0x7F;
+    break;
+  case 0x29:
+  case 0x2A:
+    emu->scroll_cmd = op;
+    emu->scroll_start = c[2] & 0x07;
+    emu->scroll_frames = s_scroll_frames[c[3] & 0x07];
+    emu->scroll_end = c[4] & 0x07;
+    emu->scroll_voffset = c[5] & 0x3F;
+    emu->scroll_col_start = 0;
+    emu->scroll_col_end = SSD1306_EMU_WIDTH - 1;
+    break;
+  case 0x2E:
+    emu->scroll_active = false;
+    break;
+  case 0x2F:
+    emu->scroll_active = true;
+    emu->scroll_frame_count = 0;
+    break;
+  case 0xA0:
+  case 0xA1:
+    emu->seg_remap = (op == 0xA1);
+    break;
+  case 0xC0:
+  case 0xC8:
+    emu->com_remap = (op == 0xC8);
+    break;
+  case 0xA4:
+  case 0xA5:
+    emu->entire_on = (op == 0xA5);
+    break;
+  case 0xA6:
+  case 0xA7:
+    emu->inverted = (op == 0xA7);
+    break;
+  case 0xAE:
+  case 0xAF:
+    emu->display_on = (op == 0xAF);
+    break;
+  default:
+    if (op >= 0x40 && op <= 0x7F) {
+      emu->start_line = op & 0x3F;
+    } else if (op <= 0x0F) {
+      emu->col = (emu->col & 0x70) | op; // page mode, lower nibble
+    } else if (op <= 0x17) {
+      emu->col = (emu->col & 0x0F) | ((op & 0x07) << 4);
+    } else if (op >= 0xB0 && op <= 0xB7) {
+      emu->page = op & 0x07;
+    } else {
+      emu->stats.unknown_cmds++;
+    }
+    break;
+  }
+}
+
+static void feed_command(ssd1306_emu_t *emu, uint8_t b) {
+  emu->stats.cmd_bytes++;
+  emu->cmd[emu->cmd_len++] = b;
+  if (emu->cmd_len >= cmd_length(emu->cmd[0])) {
+    execute(emu, emu->cmd);
+    emu->cmd_len = 0;
+  }
+}
+
+static void feed_data(ssd1306_emu_t *emu, uint8_t b) {
+  emu->stats.data_bytes++;
+  if (emu->scroll_active) {
+    emu->stats.scroll_writes++;
+  }
+  emu->gddram[emu->page][emu->col] = b;
+
+  switch (emu->addr_mode) {
+  case 0: // horizontal: column first, then page
+    if (emu->col >= emu->col_end) {
+      emu->col = emu->col_start;
+      emu->page = (emu->page >= emu->page_end) ? emu->page_start : emu->page + 1;
+    } else {
+      emu->col++;
+    }
+    break;
+  case 1: // vertical: page first, then column
+    if (emu->page >= emu->page_end) {
+      emu->page = emu->page_start;
+      emu->col = (emu->col >= emu->col_end) ? emu->col_start : emu->col + 1;
+    } else {
+      emu->page++;
+    }
+    break;
+  default: // page: column only, the page pointer stays
+    emu->col = (emu->col + 1) & 0x7F;
+    break;
+  }
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void ssd1306_emu_reset(ssd1306_emu_t *emu) {
+  memset(emu, 0, sizeof(*emu));
+  emu->addr_mode = 2;
+  emu->col_end = SSD1306_EMU_WIDTH - 1;
+  emu->page_end = SSD1306_EMU_PAGES - 1;
+  emu->contrast = 0x7F;
+  emu->mux = 63;
+}
+
+void ssd1306_emu_reset_stats(ssd1306_emu_t *emu) {
+  memset(&emu->stats, 0, sizeof(emu->stats));
+}
+
+void ssd1306_emu_i2c_write(ssd1306_emu_t *emu, const uint8_t *buf,
+                           size_t len) {
+  emu->stats.transactions++;
+  emu->stats.bytes += len + 1; // payload plus address byte
+  emu->stats.bus_clocks +=
+      (uint64_t)(len + 1) * I2C_CLOCKS_PER_BYTE + I2C_CLOCKS_PER_XFER;
+
+  size_t i = 0;
+  while (i < len) {
+    uint8_t control = buf[i++];
+    bool single = control & 0x80; // Co: one byte, then another control byte
+    bool data = control & 0x40;   // D/C#
+    while (i < len) {
+      if (data) {
+        feed_data(emu, buf[i++]);
+      } else {
+        feed_command(emu, buf[i++]);
+      }
+      if (single) {
+        break;
+      }
+    }
+  }
+}
+
+void ssd1306_emu_spi_write(ssd1306_emu_t *emu, bool data, const uint8_t *buf,
+                           size_t len) {
+  emu->stats.transactions++;
+  emu->stats.bytes += len;
+  emu->stats.bus_clocks += (uint64_t)len * SPI_CLOCKS_PER_BYTE;
+
+  for (size_t i = 0; i < len; i++) {
+    if (data) {
+      feed_data(emu, buf[i]);
+    } else {
+      feed_command(emu, buf[i]);
+    }
+  }
+}
+
+void ssd1306_emu_advance(ssd1306_emu_t *emu, uint32_t frames) {
+  if (!emu->scroll_active || emu->scroll_frames == 0) {
+    return;
+  }
+  uint32_t total = emu->scroll_frame_count + frames;
+  uint32_t steps = total / emu->scroll_frames;
+  emu->scroll_frame_count = total % emu->scroll_frames;
+  if (steps) {
+    scroll_steps(emu, steps);
+  }
+}
+
+int ssd1306_emu_height(const ssd1306_emu_t *emu) { return emu->mux + 1; }
+
+bool ssd1306_emu_pixel(const ssd1306_emu_t *emu, int x, int y) {
+  if (x < 0 || x >= SSD1306_EMU_WIDTH || y < 0 || y > emu->mux) {
+    return false;
+  }
+  if (!emu->display_on) {
+    return false;
+  }
+  if (emu->entire_on) {
+    return true;
+  }
+
+  // Orientation of the usual modules: A1 + C8 shows RAM upright
+  int row = emu->com_remap ? y : emu->mux - y;
+  row = (row + emu->start_line + emu->offset) & 0x3F;
+  int col = emu->seg_remap ? x : SSD1306_EMU_WIDTH - 1 - x;
+
+  bool on = (emu->gddram[row >> 3][col] >> (row & 7)) & 1;
+  return on != emu->inverted;
+}
+
+uint64_t ssd1306_emu_bus_us(const ssd1306_emu_t *emu, uint32_t hz) {
+  return emu->stats.bus_clocks * 1000000 / hz;
+}
+
+void ssd1306_emu_write_pbm(const ssd1306_emu_t *emu, FILE *f) {
+  int height = ssd1306_emu_height(emu);
+  fprintf(f, "P1\n# ssd1306 contrast=%u display=%s scroll=%s\n%d %d\n",
+          emu->contrast, emu->display_on ? "on" : "off",
+          emu->scroll_active ? "on" : "off", SSD1306_EMU_WIDTH, height);
+
+  // Two lines per row keeps every line under the 70 characters PBM allows
+  char line[SSD1306_EMU_WIDTH / 2 + 2];
+  for (int y = 0; y < height; y++) {
+    for (int half = 0; half < 2; half++) {
+      int x0 = half * SSD1306_EMU_WIDTH / 2;
+      for (int x = 0; x < SSD1306_EMU_WIDTH / 2; x++) {
+        line[x] = ssd1306_emu_pixel(emu, x0 + x, y) ? '1' : '0';
+      }
+      line[SSD1306_EMU_WIDTH / 2] = '\n';
+      line[SSD1306_EMU_WIDTH / 2 + 1] = '\0';
+      fputs(line, f);
+    }
+  }
+}
+
+ssd1306_emu_t *ssd1306_emu_get(void) {
+  if (!s_emu_ready) {
+    ssd1306_emu_reset(&s_emu);
+    s_emu_ready = true;
+  }
+  return &s_emu;
+}
@@ -0,0 +1,135 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __SSD1306_EMU_H__
+#define __SSD1306_EMU_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Command-stream model of the SSD1306 for running without a panel.
+ *
+ * Plain C with no ESP-IDF dependency, so the same file builds on a host.
+ * It decodes the byte stream i2c.c/spi.c send (addressing modes, column and
+ * page windows, horizontal scroll, contrast, display on/off/invert, start
+ * line, remaps) into a 128x64 GDDRAM and counts what crossed the bus.
+ */
+
+#define SSD1306_EMU_WIDTH 128
+#define SSD1306_EMU_PAGES 8
+#define SSD1306_EMU_FRAME_HZ 105 // panel refresh with D5h = 0x80
+
+/**
+ * @brief Bus statistics, reset with ssd1306_emu_reset_stats()
+ */
+typedef struct {
+  uint32_t transactions; /*!< I2C transfers or SPI D/C-level runs */
+  uint32_t bytes;        /*!< bytes on the wire, I2C address byte included */
+  uint32_t cmd_bytes;    /*!< command and command-argument bytes */
+  uint32_t data_bytes;   /*!< GDDRAM bytes */
+  uint64_t bus_clocks;   /*!< clock cycles the bytes take on the bus */
+  uint32_t unknown_cmds; /*!< opcodes the model does not decode */
+  uint32_t scroll_writes; /*!< GDDRAM bytes written during a scroll */
+} ssd1306_emu_stats_t;
+
+typedef struct {
+  uint8_t gddram[SSD1306_EMU_PAGES][SSD1306_EMU_WIDTH];
+
+  // Addressing
+  uint8_t addr_mode; /*!< 0 horizontal, 1 vertical, 2 page */
+  uint8_t col, col_start, col_end;
+  uint8_t page, page_start, page_end;
+
+  // Display state
+  uint8_t contrast;
+  uint8_t mux;        /*!< visible rows - 1 */
+  uint8_t start_line; /*!< 40h-7Fh */
+  uint8_t offset;     /*!< D3h */
+  bool display_on;
+  bool inverted;
+  bool entire_on;
+  bool seg_remap;
+  bool com_remap;
+
+  // Horizontal scroll (26h/27h, 29h/2Ah)
+  bool scroll_active;
+  uint8_t scroll_cmd;
+  uint8_t scroll_start, scroll_end;
+  uint8_t scroll_frames; /*!< frames per step */
+  uint8_t scroll_voffset;
+  uint8_t scroll_col_start, scroll_col_end;
+  uint32_t scroll_frame_count;
+
+  // Command being assembled across bytes (and transactions)
+  uint8_t cmd[8];
+  uint8_t cmd_len;
+
+  ssd1306_emu_stats_t stats;
+} ssd1306_emu_t;
+
+/**
+ * @brief Put the model into the controller's power-on reset state
+ */
+void ssd1306_emu_reset(ssd1306_emu_t *emu);
+
+/**
+ * @brief Clear the bus statistics only
+ */
+void ssd1306_emu_reset_stats(ssd1306_emu_t *emu);
+
+/**
+ * @brief Feed one I2C write transfer (control bytes included)
+ */
+void ssd1306_emu_i2c_write(ssd1306_emu_t *emu, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Feed one SPI transfer
+ *
+ * @param data Level of the D/C line: true for GDDRAM data, false for commands
+ */
+void ssd1306_emu_spi_write(ssd1306_emu_t *emu, bool data, const uint8_t *buf,
+                           size_t len);
+
+/**
+ * @brief Let the panel run for a number of frames (drives the scroll engine)
+ */
+void ssd1306_emu_advance(ssd1306_emu_t *emu, uint32_t frames);
+
+/**
+ * @brief Visible pixel as the panel shows it, after remaps, start line,
+ * invert and display on/off
+ */
+bool ssd1306_emu_pixel(const ssd1306_emu_t *emu, int x, int y);
+
+/**
+ * @brief Number of visible rows (multiplex ratio + 1)
+ */
+int ssd1306_emu_height(const ssd1306_emu_t *emu);
+
+/**
+ * @brief Simulated time the counted traffic takes on the bus
+ *
+ * @param hz Bus clock, e.g. 400000 or 1000000
+ */
+uint64_t ssd1306_emu_bus_us(const ssd1306_emu_t *emu, uint32_t hz);
+
+/**
+ * @brief Write the visible image as a plain (P1) PBM
+ *
+ * P1 is text, so the same output is readable on a serial console and
+ * loadable by image tools.
+ */
+void ssd1306_emu_write_pbm(const ssd1306_emu_t *emu, FILE *f);
+
+/**
+ * @brief Model instance the driver feeds when
+ * CONFIG_EXAMPLE_OLED_EMULATOR is set
+ */
+ssd1306_emu_t *ssd1306_emu_get(void);
+
+#endif /* __SSD1306_EMU_H__ */
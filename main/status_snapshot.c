@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "status_snapshot.h"
+#include <string.h>
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+static void wait_readers(status_snapshot_t *s, unsigned version,
+                         status_wait_fn_t wait) {
+  while (atomic_load(&s->readers[version]) != 0) {
+    if (wait) {
+      wait();
+    }
+  }
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+uint32_t status_snapshot_read(status_snapshot_t *s, player_status_t *out) {
+  unsigned version = atomic_load(&s->version);
+  atomic_fetch_add(&s->readers[version], 1);
+  const status_slot_t *slot = &s->slot[atomic_load(&s->read_idx)];
+  *out = slot->status;
+  uint32_t seq = slot->seq;
+  atomic_fetch_sub(&s->readers[version], 1);
+  return seq;
+}
+
+bool status_snapshot_changed_since(status_snapshot_t *s, uint32_t seq) {
+  return atomic_load(&s->seq) != seq;
+}
+
+void status_snapshot_begin(status_snapshot_t *s, player_status_t *edit,
+                           status_wait_fn_t wait) {
+  while (atomic_flag_test_and_set(&s->writing)) {
+    if (wait) {
+      wait();
+    }
+  }
+  // Writers are serialised, so the published instance is stable here
+  *edit = s->slot[atomic_load(&s->read_idx)].status;
+}
+
+bool status_snapshot_commit(status_snapshot_t *s, const player_status_t *edit,
+                            status_wait_fn_t wait) {
+  unsigned cur = atomic_load(&s->read_idx);
+  bool changed = memcmp(edit, &s->slot[cur].status, sizeof(*edit)) != 0;
+  if (changed) {
+    status_slot_t next = {.status = *edit, .seq = s->slot[cur].seq + 1};
+    // No reader is on the idle instance: they all load read_idx == cur
+    // or announced before the previous writer drained them
+    s->slot[!cur] = next;
+    atomic_store(&s->read_idx, !cur);
+    atomic_store(&s->seq, next.seq);
+
+    // Drain readers that may still hold the old index, on both counters
+    unsigned version = atomic_load(&s->version);
+    wait_readers(s, !version, wait);
+    atomic_store(&s->version, !version);
+    wait_readers(s, version, wait);
+    s->slot[cur] = next;
+  }
+  atomic_flag_clear(&s->writing);
+  return changed;
+}
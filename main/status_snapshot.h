@@ -0,0 +1,85 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __STATUS_SNAPSHOT_H__
+#define __STATUS_SNAPSHOT_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Wait-free publication of the player status, in plain C11 atomics.
+ *
+ * Left-right scheme: the status is kept twice. Readers announce themselves
+ * on one of two counters and copy the instance the writer is not touching,
+ * with no loop and no retry. A writer updates the idle instance, points
+ * readers at it, waits for readers still on the old one to leave, and then
+ * brings the old one up to date. Only writers ever wait; how they do so is
+ * up to the caller (a tick's sleep on FreeRTOS, sched_yield() on a host).
+ */
+
+/**
+ * @brief Consistent snapshot of the player state shown to UI/telemetry
+ */
+typedef struct {
+  int a2d_state;   /*!< APP_AV_STATE_* */
+  int media_state; /*!< APP_AV_MEDIA_STATE_* */
+  int song_idx;    /*!< index of the current playlist entry */
+  bool is_playing; /*!< true when playback is not paused */
+  uint8_t volume;  /*!< current volume (0-127) */
+} player_status_t;
+
+typedef struct {
+  player_status_t status;
+  uint32_t seq;
+} status_slot_t;
+
+typedef struct {
+  status_slot_t slot[2];
+  atomic_uint read_idx;   /*!< instance readers copy */
+  atomic_uint version;    /*!< counter new readers announce on */
+  atomic_uint readers[2]; /*!< readers in flight per counter */
+  atomic_uint seq;        /*!< last published sequence number */
+  atomic_flag writing;
+} status_snapshot_t;
+
+#define STATUS_SNAPSHOT_INIT {.writing = ATOMIC_FLAG_INIT}
+
+/**
+ * @brief How a writer waits for another writer or for readers to leave
+ */
+typedef void (*status_wait_fn_t)(void);
+
+/**
+ * @brief Copy the current status (wait-free)
+ *
+ * @return Sequence number of the copy, for status_snapshot_changed_since()
+ */
+uint32_t status_snapshot_read(status_snapshot_t *s, player_status_t *out);
+
+/**
+ * @brief Check whether anything was published after a given copy
+ */
+bool status_snapshot_changed_since(status_snapshot_t *s, uint32_t seq);
+
+/**
+ * @brief Take the writer side and get the current status to edit
+ *
+ * Must be followed by status_snapshot_commit().
+ */
+void status_snapshot_begin(status_snapshot_t *s, player_status_t *edit,
+                           status_wait_fn_t wait);
+
+/**
+ * @brief Publish the edited status, if it differs, and release the writer
+ *
+ * @return true if a new status was published
+ */
+bool status_snapshot_commit(status_snapshot_t *s, const player_status_t *edit,
+                            status_wait_fn_t wait);
+
+#endif /* __STATUS_SNAPSHOT_H__ */
@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "trace.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <stdio.h>
+
+#if CONFIG_EXAMPLE_TRACE
+
+/*********************************
+ * MODULE VARIABLES
+ ********************************/
+trace_record_t s_trace_ring[TRACE_RING_LEN];
+atomic_uint_least32_t s_trace_head = 0;
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+typedef struct {
+  atomic_uintptr_t handle; // set last, once the name is in place
+  char name[TRACE_TASK_NAME_LEN];
+} trace_task_t;
+
+static trace_task_t s_trace_tasks[TRACE_MAX_TASKS];
+static atomic_uint s_trace_task_cnt = 0; // ids handed out
+static atomic_flag s_trace_dumping = ATOMIC_FLAG_INIT;
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+static void trace_dump_task(void *arg) {
+  trace_dump();
+  atomic_flag_clear(&s_trace_dumping);
+  vTaskDelete(NULL);
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+uint16_t trace_task_id(void) {
+  uintptr_t self = (uintptr_t)xTaskGetCurrentTaskHandle();
+  unsigned n = atomic_load(&s_trace_task_cnt);
+  if (n > TRACE_MAX_TASKS) {
+    n = TRACE_MAX_TASKS;
+  }
+  // Only the task itself registers its handle, so a hit is never stale
+  for (unsigned i = 0; i < n; i++) {
+    if (atomic_load(&s_trace_tasks[i].handle) == self) {
+      return i;
+    }
+  }
+  if (n == TRACE_MAX_TASKS) {
+    return TRACE_MAX_TASKS;
+  }
+
+  unsigned id = atomic_fetch_add(&s_trace_task_cnt, 1);
+  if (id >= TRACE_MAX_TASKS) {
+    return TRACE_MAX_TASKS;
+  }
+  snprintf(s_trace_tasks[id].name, TRACE_TASK_NAME_LEN, "%s",
+           pcTaskGetName(NULL));
+  atomic_store(&s_trace_tasks[id].handle, self);
+  return id;
+}
+
+void trace_dump(void) {
+  uint32_t head = atomic_load_explicit(&s_trace_head, memory_order_relaxed);
+  uint32_t count = head < TRACE_RING_LEN ? head : TRACE_RING_LEN;
+
+  // Writers keep running; a record overwritten mid-dump shows up with a
+  // newer timestamp and is sorted out by the host tool
+  printf("TRACE BEGIN %" PRIu32 " %" PRIu32 "\n", count, head);
+  for (uint32_t i = head - count; i != head; i++) {
+    const trace_record_t *r = &s_trace_ring[i & (TRACE_RING_LEN - 1)];
+    printf("%08" PRIx32 "%02x%02x%04x%08" PRIx32 "%08" PRIx32 "\n", r->ts_us,
+           r->id, r->core, r->task, r->a, r->b);
+  }
+  for (int i = 0; i < TRACE_MAX_TASKS; i++) {
+    if (atomic_load(&s_trace_tasks[i].handle) != 0) {
+      printf("TRACE TASK %d %s\n", i, s_trace_tasks[i].name);
+    }
+  }
+  printf("TRACE END\n");
+}
+
+void trace_dump_async(void) {
+  if (atomic_flag_test_and_set(&s_trace_dumping)) {
+    return; // one dump at a time
+  }
+  // Heap even with static memory: the task only exists for the dump
+  if (xTaskCreate(trace_dump_task, "trace_dump", TRACE_DUMP_STACK, NULL, 1,
+                  NULL) != pdPASS) {
+    atomic_flag_clear(&s_trace_dumping);
+  }
+}
+
+#endif /* CONFIG_EXAMPLE_TRACE */
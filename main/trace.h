@@ -0,0 +1,114 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+#define TRACE_RING_LEN 1024 // records, power of two (16 KB)
+#define TRACE_MAX_TASKS 16  // tasks named in a dump; later ones share an id
+#define TRACE_TASK_NAME_LEN 16
+#define TRACE_DUMP_STACK 3072 // trace_dump_async() task, bytes
+
+/**
+ * @brief Trace event ids
+ *
+ * Keep in sync with EVENTS in tools/trace2json.py. *_BEGIN / *_END pairs
+ * become duration slices in the timeline, the rest instant events.
+ */
+typedef enum {
+  TRACE_EVT_A2D_EVENT = 1,  /*!< a: event id, b: A2DP state */
+  TRACE_EVT_INQ_RESULT,     /*!< a: BDA bytes 2-5, b: COD | RSSI << 24 */
+  TRACE_EVT_VOLUME,         /*!< a: volume (0-127) */
+  TRACE_EVT_BUTTON,         /*!< a: button (GPIO), b: value */
+  TRACE_EVT_DECODE_BEGIN,   /*!< a: input bytes buffered */
+  TRACE_EVT_DECODE_END,     /*!< a: samples, b: frame bytes */
+  TRACE_EVT_DATA_CB_BEGIN,  /*!< a: bytes requested */
+  TRACE_EVT_DATA_CB_END,    /*!< a: bytes filled from the ring buffer */
+  TRACE_EVT_SCRUB,          /*!< a: direction (1 FF, -1 REW, 0 stop) */
+  TRACE_EVT_RESUME_AUDIO,   /*!< a: ms from play to the first ring bytes */
+} trace_event_t;
+
+/**
+ * @brief One trace record (16 bytes)
+ */
+typedef struct {
+  uint32_t ts_us; /*!< esp_timer time, low 32 bits */
+  uint8_t id;     /*!< trace_event_t */
+  uint8_t core;   /*!< CPU the event was recorded on */
+  uint16_t task;  /*!< trace_task_id() of the recording task */
+  uint32_t a;
+  uint32_t b;
+} trace_record_t;
+
+#if CONFIG_EXAMPLE_TRACE
+
+/* Defined in trace.c; only trace_write() should touch them */
+extern trace_record_t s_trace_ring[TRACE_RING_LEN];
+extern atomic_uint_least32_t s_trace_head;
+
+/**
+ * @brief Small id of the calling task
+ *
+ * A task gets the next free id, and its name is kept for the dump, the
+ * first time it records. Slices are keyed on this rather than the core,
+ * since a task can move between cores mid-slice. Tasks beyond
+ * TRACE_MAX_TASKS all get TRACE_MAX_TASKS.
+ */
+uint16_t trace_task_id(void);
+
+/**
+ * @brief Append a record. Lock-free and safe from any task on either core.
+ *
+ * A writer lapping the ring overwrites the oldest records.
+ */
+static inline void trace_write(uint16_t id, uint32_t a, uint32_t b) {
+  uint32_t i = atomic_fetch_add_explicit(&s_trace_head, 1, memory_order_relaxed);
+  trace_record_t *r = &s_trace_ring[i & (TRACE_RING_LEN - 1)];
+  r->ts_us = (uint32_t)esp_timer_get_time();
+  r->id = id;
+  r->core = xPortGetCoreID();
+  r->task = trace_task_id();
+  r->a = a;
+  r->b = b;
+}
+
+#define TRACE(id, a, b) trace_write((id), (uint32_t)(a), (uint32_t)(b))
+
+/**
+ * @brief Print the ring to the console for tools/trace2json.py
+ *
+ * Records are printed oldest first, one hex line each, followed by a
+ * "TRACE TASK <id> <name>" line per task id, between "TRACE BEGIN" and
+ * "TRACE END" markers.
+ */
+void trace_dump(void);
+
+/**
+ * @brief Print the ring from a short-lived low-priority task
+ *
+ * The console output takes far longer than a button press should block
+ * its task. A call while a dump is running is ignored.
+ */
+void trace_dump_async(void);
+
+#else
+
+#define TRACE(id, a, b) ((void)0)
+static inline void trace_dump(void) {}
+static inline void trace_dump_async(void) {}
+
+#endif /* CONFIG_EXAMPLE_TRACE */
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,247 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include "volume_ctrl.h"
+#include "audio_player.h"
+#include "bt_app_core.h"
+#include "common.h"
+#include "esp_avrc_api.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <inttypes.h>
+#include <stdbool.h>
+
+/*********************************
+ * CONFIGURATION
+ ********************************/
+/* longer than the 150 ms button repeat, so a held key merges steps */
+#define VOLUME_COALESCE_US (200 * 1000) // local changes merged per command
+#define VOLUME_MAX_IN_FLIGHT 2
+#define VOLUME_RSP_TIMEOUT_US (1000 * 1000) // in-flight commands given up
+#define VOLUME_RSP_RETRIES 2 // re-sends of the target after a timeout
+#define VOLUME_ECHO_US (1500 * 1000)        // notification counted as echo
+#define VOLUME_ECHO_SLOTS 4
+
+enum {
+  VOLUME_CTRL_FLUSH_EVT = 0,
+  VOLUME_CTRL_TIMEOUT_EVT,
+};
+
+/*********************************
+ * STATIC VARIABLES
+ ********************************/
+typedef struct {
+  uint8_t volume;
+  int64_t sent_us; /* 0 when free */
+} volume_echo_t;
+
+/* Written by any task; everything below it only on the BT app task */
+static volatile uint8_t s_target = 0;
+static volatile uint32_t s_local_cnt = 0;
+static esp_timer_handle_t s_coalesce_tmr = NULL;
+static esp_timer_handle_t s_rsp_tmr = NULL;
+
+static int16_t s_last_sent = -1;
+static int s_in_flight = 0;
+static int s_retries = 0;
+static uint8_t s_tl_next = 0;
+static volume_echo_t s_echo[VOLUME_ECHO_SLOTS];
+
+/* current burst, for the commands-per-second report */
+static int64_t s_burst_start_us = 0;
+static uint32_t s_burst_sent = 0;
+static uint32_t s_burst_local_base = 0;
+static uint32_t s_burst_echoes = 0;
+
+/*********************************
+ * STATIC FUNCTIONS
+ ********************************/
+static void volume_ctrl_hdl(uint16_t event, void *param);
+
+static void volume_coalesce_cb(void *arg) {
+  /* LOW: a flush still queued already covers this one */
+  bt_app_work_dispatch_prio(volume_ctrl_hdl, VOLUME_CTRL_FLUSH_EVT, NULL, 0,
+                            NULL, BT_APP_PRIO_LOW);
+}
+
+static void volume_rsp_timeout_cb(void *arg) {
+  bt_app_work_dispatch_prio(volume_ctrl_hdl, VOLUME_CTRL_TIMEOUT_EVT, NULL, 0,
+                            NULL, BT_APP_PRIO_LOW);
+}
+
+static void volume_burst_report(void) {
+  if (s_burst_sent == 0) {
+    return;
+  }
+  uint32_t ms = (esp_timer_get_time() - s_burst_start_us) / 1000;
+  uint32_t local = s_local_cnt - s_burst_local_base;
+  ESP_LOGI(BT_RC_CT_TAG,
+           "volume burst: %" PRIu32 " changes -> %" PRIu32
+           " commands in %" PRIu32 " ms (%" PRIu32 ".%" PRIu32
+           "/s), %" PRIu32 " echoes dropped",
+           local, s_burst_sent, ms,
+           ms ? s_burst_sent * 1000 / ms : s_burst_sent,
+           ms ? (s_burst_sent * 10000 / ms) % 10 : 0, s_burst_echoes);
+  s_burst_sent = 0;
+  s_burst_echoes = 0;
+}
+
+static void volume_flush(void) {
+  int64_t now = esp_timer_get_time();
+  uint8_t target = s_target;
+
+  if (target == s_last_sent || s_in_flight >= VOLUME_MAX_IN_FLIGHT) {
+    return; /* the next response flushes again */
+  }
+  /* without absolute volume support the level is applied in software */
+  if (audio_player_get_volume_mode() != AUDIO_VOLUME_ABSOLUTE) {
+    s_last_sent = target;
+    return;
+  }
+
+  if (s_burst_sent == 0) {
+    s_burst_start_us = now;
+    s_burst_local_base = s_local_cnt;
+  }
+  uint8_t tl = APP_RC_CT_TL_SET_VOLUME + s_tl_next;
+  s_tl_next = (s_tl_next + 1) % VOLUME_MAX_IN_FLIGHT;
+  esp_avrc_ct_send_set_absolute_volume_cmd(tl, target);
+  s_last_sent = target;
+  s_in_flight++;
+  /* restarted per command: it fires a timeout after the newest one */
+  if (s_rsp_tmr) {
+    esp_timer_stop(s_rsp_tmr);
+    esp_timer_start_once(s_rsp_tmr, VOLUME_RSP_TIMEOUT_US);
+  }
+  s_burst_sent++;
+
+  /* remember it so the sink's notification of it is not applied again */
+  int slot = 0;
+  for (int i = 1; i < VOLUME_ECHO_SLOTS; i++) {
+    if (s_echo[i].sent_us < s_echo[slot].sent_us) {
+      slot = i;
+    }
+  }
+  s_echo[slot].volume = target;
+  s_echo[slot].sent_us = now;
+}
+
+static bool volume_is_echo(uint8_t volume) {
+  int64_t now = esp_timer_get_time();
+  for (int i = 0; i < VOLUME_ECHO_SLOTS; i++) {
+    volume_echo_t *e = &s_echo[i];
+    if (e->sent_us == 0 || now - e->sent_us > VOLUME_ECHO_US) {
+      continue;
+    }
+    /* sinks with coarser steps report the value rounded */
+    int diff = (int)e->volume - (int)volume;
+    if (diff >= -1 && diff <= 1) {
+      e->sent_us = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* No response to anything in flight: whether the sink applied the last
+ * value is unknown, so the target goes out again */
+static void volume_rsp_timeout(void) {
+  if (s_in_flight == 0) {
+    return;
+  }
+  s_in_flight = 0;
+  if (s_retries >= VOLUME_RSP_RETRIES) {
+    ESP_LOGW(BT_RC_CT_TAG, "volume: sink not answering, giving up on %d",
+             s_last_sent);
+    return;
+  }
+  s_retries++;
+  ESP_LOGW(BT_RC_CT_TAG, "volume: command unanswered, re-sending %d",
+           s_target);
+  s_last_sent = -1;
+  volume_flush();
+}
+
+static void volume_ctrl_hdl(uint16_t event, void *param) {
+  if (event == VOLUME_CTRL_FLUSH_EVT) {
+    volume_flush();
+  } else if (event == VOLUME_CTRL_TIMEOUT_EVT) {
+    volume_rsp_timeout();
+  }
+}
+
+/*********************************
+ * PUBLIC FUNCTIONS
+ ********************************/
+void volume_ctrl_init(void) {
+  const esp_timer_create_args_t args = {
+      .callback = volume_coalesce_cb,
+      .name = "vol",
+  };
+  esp_timer_create(&args, &s_coalesce_tmr);
+  const esp_timer_create_args_t rsp_args = {
+      .callback = volume_rsp_timeout_cb,
+      .name = "volRsp",
+  };
+  esp_timer_create(&rsp_args, &s_rsp_tmr);
+}
+
+void volume_ctrl_set_local(uint8_t volume) {
+  if (volume > 127) {
+    volume = 127;
+  }
+  audio_player_set_volume(volume);
+  s_target = volume;
+  s_local_cnt++;
+  /* the first change of a window arms it; later ones ride along */
+  if (s_coalesce_tmr && !esp_timer_is_active(s_coalesce_tmr)) {
+    esp_timer_start_once(s_coalesce_tmr, VOLUME_COALESCE_US);
+  }
+}
+
+void volume_ctrl_on_remote(uint8_t volume) {
+  if (volume_is_echo(volume)) {
+    s_burst_echoes++;
+    return;
+  }
+  ESP_LOGI(BT_RC_CT_TAG, "Volume changed on remote device: %d", volume);
+  /* the sink's own change wins over anything we have not sent yet */
+  if (s_coalesce_tmr) {
+    esp_timer_stop(s_coalesce_tmr);
+  }
+  s_target = volume;
+  s_last_sent = volume;
+  audio_player_set_volume(volume);
+}
+
+void volume_ctrl_on_set_rsp(uint8_t volume) {
+  if (s_in_flight > 0) {
+    s_in_flight--;
+  }
+  s_retries = 0;
+  if (s_in_flight == 0 && s_rsp_tmr) {
+    esp_timer_stop(s_rsp_tmr);
+  }
+  volume_flush();
+  if (s_in_flight == 0 && s_target == s_last_sent &&
+      !(s_coalesce_tmr && esp_timer_is_active(s_coalesce_tmr))) {
+    volume_burst_report();
+  }
+}
+
+void volume_ctrl_reset(void) {
+  if (s_rsp_tmr) {
+    esp_timer_stop(s_rsp_tmr);
+  }
+  s_in_flight = 0;
+  s_retries = 0;
+  s_last_sent = -1;
+  for (int i = 0; i < VOLUME_ECHO_SLOTS; i++) {
+    s_echo[i].sent_us = 0;
+  }
+  s_burst_sent = 0;
+  s_burst_echoes = 0;
+}
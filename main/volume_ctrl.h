@@ -0,0 +1,45 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#ifndef __VOLUME_CTRL_H__
+#define __VOLUME_CTRL_H__
+
+#include <stdint.h>
+
+/**
+ * @brief Create the coalescing timer
+ */
+void volume_ctrl_init(void);
+
+/**
+ * @brief Local volume change (buttons, initial volume)
+ *
+ * Applied to the player at once; the AVRCP absolute-volume command carries
+ * only the latest value of a burst and is sent from the BT app task.
+ * Safe to call from any task.
+ *
+ * @param volume 0-127
+ */
+void volume_ctrl_set_local(uint8_t volume);
+
+/**
+ * @brief Volume change notification from the sink (BT app task)
+ *
+ * Echoes of values we sent ourselves are dropped.
+ */
+void volume_ctrl_on_remote(uint8_t volume);
+
+/**
+ * @brief Absolute-volume command response (BT app task)
+ */
+void volume_ctrl_on_set_rsp(uint8_t volume);
+
+/**
+ * @brief Forget in-flight commands and echoes, e.g. on AVRCP disconnect
+ */
+void volume_ctrl_reset(void);
+
+#endif /* __VOLUME_CTRL_H__ */
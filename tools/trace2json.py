@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+"""Convert a trace_dump() capture from the serial monitor to Chrome trace JSON.
+
+Usage: trace2json.py monitor.log > trace.json
+Open the result in chrome://tracing or https://ui.perfetto.dev.
+"""
+
+import json
+import sys
+
+# Must match trace_event_t in main/trace.h
+EVENTS = {
+    1: "a2d_event",
+    2: "inq_result",
+    3: "volume",
+    4: "button",
+    5: "decode_BEGIN",
+    6: "decode_END",
+    7: "data_cb_BEGIN",
+    8: "data_cb_END",
+    9: "scrub",
+    10: "resume_audio",
+}
+
+
+def parse_dumps(lines):
+    """Yield (records, task names) for every TRACE BEGIN ... TRACE END block."""
+    block = None
+    tasks = None
+    for line in lines:
+        line = line.strip()
+        if "TRACE BEGIN" in line:
+            block = []
+            tasks = {}
+        elif "TRACE END" in line:
+            if block is not None:
+                yield block, tasks
+            block = None
+        elif block is None:
+            continue
+        elif "TRACE TASK" in line:
+            fields = line.split("TRACE TASK", 1)[1].split(None, 1)
+            if fields and fields[0].isdigit():
+                tasks[int(fields[0])] = fields[1] if len(fields) > 1 else ""
+        elif len(line) == 32:
+            block.append(line)
+
+
+def to_events(block, tasks=None):
+    tasks = tasks or {}
+    events = []
+    prev = None
+    now = 0
+    for line in block:
+        try:
+            ts = int(line[0:8], 16)
+            eid = int(line[8:10], 16)
+            core = int(line[10:12], 16)
+            task = int(line[12:16], 16)
+            a = int(line[16:24], 16)
+            b = int(line[24:32], 16)
+        except ValueError:
+            continue
+        # The 32-bit us clock wraps every ~71 min. Step by the signed 32-bit
+        # difference: records overwritten mid-dump are a little out of order,
+        # which must not count as a wrap, while a real wrap is a step of
+        # almost -2**32.
+        if prev is not None:
+            step = (ts - prev) & 0xFFFFFFFF
+            if step >= 1 << 31:
+                step -= 1 << 32
+            now += step
+        prev = ts
+
+        name = EVENTS.get(eid, "evt_%d" % eid)
+        # B/E pairs nest per task; a task can change cores mid-slice
+        ev = {"pid": 0, "tid": task, "ts": now,
+              "args": {"a": a, "b": b, "core": core}}
+        if name.endswith("_BEGIN"):
+            ev.update(name=name[:-6], ph="B")
+        elif name.endswith("_END"):
+            ev.update(name=name[:-4], ph="E")
+        else:
+            ev.update(name=name, ph="i", s="t")
+        events.append(ev)
+
+    if events:
+        base = min(ev["ts"] for ev in events)
+        for ev in events:
+            ev["ts"] -= base
+    events.sort(key=lambda e: e["ts"])
+
+    names = [{"pid": 0, "tid": tid, "ph": "M", "name": "thread_name",
+              "args": {"name": tasks.get(tid, "task %d" % tid)}}
+             for tid in sorted({ev["tid"] for ev in events})]
+    return names + events
+
+
+def main():
+    src = open(sys.argv[1], errors="replace") if len(sys.argv) > 1 else sys.stdin
+    blocks = list(parse_dumps(src))
+    if not blocks:
+        sys.exit("no TRACE BEGIN/END block found")
+    # The last dump is the most recent view of the ring
+    json.dump({"traceEvents": to_events(*blocks[-1])}, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()